@@ -0,0 +1,56 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "MaterialCacheStack.h"
+#include "PrimitiveComponentId.h"
+
+/**
+ * Allocation layout of a set of pending material cache entries
+ * Entries are grouped by primitive, and the evaluated stacks of all pages of a primitive are deduplicated,
+ * so that the per-stack work (render path selection, command lookup) is done once per unique stack.
+ * Everything is ordered by first appearance, the layout is a pure function of the inputs.
+ */
+struct FMaterialCachePageBatch
+{
+	/** Primitive group of each entry, INDEX_NONE for skipped entries */
+	TArray<int32> EntryGroups;
+
+	/** First (flattened) page of each entry */
+	TArray<int32> EntryPageOffsets;
+
+	/** First a-buffer page of each entry, all pages of an entry are allocated as a single contiguous run */
+	TArray<uint32> EntryABufferPageOffsets;
+
+	/** Unique stack of each (flattened) page, INDEX_NONE for empty stacks and pages of skipped entries */
+	TArray<int32> PageStackIndices;
+
+	/** Deduplicated stacks, a unique stack is never shared across primitives */
+	TArray<FMaterialCacheStack> UniqueStacks;
+
+	/** Primitive group of each unique stack */
+	TArray<int32> UniqueStackGroups;
+
+	/** Total number of groups / pages / a-buffer pages */
+	int32 NumGroups = 0;
+	int32 NumPages = 0;
+	uint32 NumABufferPages = 0;
+};
+
+/** Order dependent hash of the materials in a stack */
+uint32 GetMaterialCacheStackHash(const FMaterialCacheStack& Stack);
+
+/** Returns true if both stacks composite the same materials in the same order */
+bool AreMaterialCacheStacksEqual(const FMaterialCacheStack& A, const FMaterialCacheStack& B);
+
+/**
+ * Group the entries by primitive and assign the contiguous a-buffer page runs, in entry order
+ * Entries with an invalid primitive id are skipped, and are not assigned any a-buffer page.
+ */
+void MaterialCacheBuildPageBatch(TConstArrayView<FPrimitiveComponentId> EntryPrimitiveIds, TConstArrayView<int32> EntryPageCounts, FMaterialCachePageBatch& OutBatch);
+
+/**
+ * Deduplicate the evaluated stacks of all (flattened) pages within their primitive group
+ * The unique stacks are moved out of PageStacks.
+ */
+void MaterialCacheDeduplicatePageStacks(TArrayView<FMaterialCacheStack> PageStacks, FMaterialCachePageBatch& InOutBatch);
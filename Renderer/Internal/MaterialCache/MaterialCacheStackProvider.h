@@ -14,13 +14,22 @@ class UMaterialCacheStackProvider : public UObject
 public:
 	/**
 	 * Evaluate the material stack of a given uv-range.
-	 * Called on the render thread.
+	 * Called on the render thread, or concurrently from parallel rendering tasks if IsThreadSafe returns true.
 	 */
 	virtual void Evaluate(const FBox2f& UVRect, FMaterialCacheStack* OutStack)
 	{
 		checkNoEntry();
 	}
 
+	/**
+	 * Whether Evaluate may be called concurrently for independent pages.
+	 * Called on the render thread.
+	 */
+	virtual bool IsThreadSafe() const
+	{
+		return false;
+	}
+
 #if WITH_EDITOR
 	/**
 	 * Called prior to stack evaluation to check if all relevant resources are ready.
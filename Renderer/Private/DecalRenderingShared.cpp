@@ -18,6 +18,7 @@
 #include "PipelineStateCache.h"
 #include "MobileBasePassRendering.h"
 #include "Async/ParallelFor.h"
+#include "DecalSceneCache.h"
 
 static TAutoConsoleVariable<float> CVarDecalFadeScreenSizeMultiplier(
 	TEXT("r.Decal.FadeScreenSizeMult"),
@@ -26,6 +27,14 @@ static TAutoConsoleVariable<float> CVarDecalFadeScreenSizeMultiplier(
 	TEXT("  Smaller means decals fade less aggressively.")
 	);
 
+static TAutoConsoleVariable<int32> CVarDecalOrientedBoxCulling(
+	TEXT("r.Decal.OrientedBoxCulling"),
+	1,
+	TEXT("Frustum cull the decals with their oriented box after the bounding sphere test.")
+	TEXT("  The sphere around the box is much larger than the box for flat decals."),
+	ECVF_RenderThreadSafe
+	);
+
 FVisibleDecal::FVisibleDecal(const FDeferredDecalProxy& InDecalProxy, float InConservativeRadius, float InFadeAlpha, EShaderPlatform ShaderPlatform, ERHIFeatureLevel::Type FeatureLevel)
 	: MaterialProxy(InDecalProxy.DecalMaterial->GetRenderProxy())
 	, Component((uintptr_t)InDecalProxy.Component)
@@ -46,6 +55,190 @@ FVisibleDecal::FVisibleDecal(const FDeferredDecalProxy& InDecalProxy, float InCo
 	BlendDesc = DecalRendering::ComputeDecalBlendDesc(ShaderPlatform, MaterialResource);
 }
 
+void FDecalSceneCache::Add(const FDeferredDecalProxy* Proxy, const FTransform& ComponentTrans)
+{
+	const int32 Index = Proxies.Add(Proxy);
+	ProxyToIndex.Add(Proxy, Index);
+
+	Origins.AddUninitialized();
+	ConservativeRadii.AddUninitialized();
+	MaxAxisScales.AddUninitialized();
+	AxesX.AddUninitialized();
+	AxesY.AddUninitialized();
+	AxesZ.AddUninitialized();
+	UpdateTransform(Index, ComponentTrans);
+
+	bBatchOrderDirty = true;
+}
+
+void FDecalSceneCache::RemoveAtSwap(int32 Index)
+{
+	ProxyToIndex.Remove(Proxies[Index]);
+
+	Proxies.RemoveAtSwap(Index, EAllowShrinking::No);
+	Origins.RemoveAtSwap(Index, EAllowShrinking::No);
+	ConservativeRadii.RemoveAtSwap(Index, EAllowShrinking::No);
+	MaxAxisScales.RemoveAtSwap(Index, EAllowShrinking::No);
+	AxesX.RemoveAtSwap(Index, EAllowShrinking::No);
+	AxesY.RemoveAtSwap(Index, EAllowShrinking::No);
+	AxesZ.RemoveAtSwap(Index, EAllowShrinking::No);
+
+	if (Index < Proxies.Num())
+	{
+		ProxyToIndex.FindChecked(Proxies[Index]) = Index;
+	}
+
+	bBatchOrderDirty = true;
+}
+
+int32 FDecalSceneCache::FindIndex(const FDeferredDecalProxy* Proxy) const
+{
+	const int32* Index = ProxyToIndex.Find(Proxy);
+	return Index ? *Index : INDEX_NONE;
+}
+
+void FDecalSceneCache::UpdateTransform(int32 Index, const FTransform& ComponentTrans)
+{
+	// Same math as the per view decal setup did, so that the culling and fading don't change
+	const FMatrix ComponentToWorldMatrix = ComponentTrans.ToMatrixWithScale();
+	const FVector AxisX = ComponentToWorldMatrix.GetScaledAxis(EAxis::X);
+	const FVector AxisY = ComponentToWorldMatrix.GetScaledAxis(EAxis::Y);
+	const FVector AxisZ = ComponentToWorldMatrix.GetScaledAxis(EAxis::Z);
+
+	Origins[Index] = ComponentToWorldMatrix.GetOrigin();
+	ConservativeRadii[Index] = FMath::Sqrt(AxisX.SizeSquared() + AxisY.SizeSquared() + AxisZ.SizeSquared());
+	MaxAxisScales[Index] = ComponentToWorldMatrix.GetMaximumAxisScale();
+	AxesX[Index] = AxisX;
+	AxesY[Index] = AxisY;
+	AxesZ[Index] = AxisZ;
+}
+
+void FDecalSceneCache::UpdateBatchOrder(TConstArrayView<FDeferredDecalProxy*> Decals)
+{
+	if (!bBatchOrderDirty)
+	{
+		return;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(FDecalSceneCache::UpdateBatchOrder);
+	check(Decals.Num() == Proxies.Num());
+
+	struct FBatchKey
+	{
+		const FMaterialRenderProxy* MaterialProxy;
+		uintptr_t Component;
+		int32 Index;
+	};
+
+	TArray<FBatchKey, SceneRenderingAllocator> BatchKeys;
+	BatchKeys.Reserve(Decals.Num());
+
+	for (int32 Index = 0; Index < Decals.Num(); ++Index)
+	{
+		const FDeferredDecalProxy* DecalProxy = Decals[Index];
+
+		// Decals with an invalid material are never visible, their place in the order doesn't matter
+		const bool bValidMaterial = DecalProxy->DecalMaterial && DecalProxy->DecalMaterial->IsValidLowLevelFast();
+		BatchKeys.Add({ bValidMaterial ? DecalProxy->DecalMaterial->GetRenderProxy() : nullptr, (uintptr_t)DecalProxy->Component, Index });
+	}
+
+	// Tie break of DecalRendering::SortDecalList
+	BatchKeys.Sort([](const FBatchKey& A, const FBatchKey& B)
+	{
+		if (B.MaterialProxy != A.MaterialProxy)
+		{
+			return B.MaterialProxy < A.MaterialProxy;
+		}
+		return B.Component < A.Component;
+	});
+
+	BatchOrder.SetNumUninitialized(BatchKeys.Num(), EAllowShrinking::No);
+	for (int32 Index = 0; Index < BatchKeys.Num(); ++Index)
+	{
+		BatchOrder[Index] = BatchKeys[Index].Index;
+	}
+
+	bBatchOrderDirty = false;
+}
+
+void FDecalSceneCache::Cull(const FConvexVolume& ViewFrustum, const FConvexVolume* InstancedViewFrustum, bool bOrientedBoxCulling, FSceneBitArray& OutVisible) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FDecalSceneCache::Cull);
+
+	OutVisible.Init(false, Num());
+
+	for (int32 Index = 0; Index < Num(); ++Index)
+	{
+		const FVector& Origin = Origins[Index];
+		const float ConservativeRadius = ConservativeRadii[Index];
+
+		if (ConservativeRadius < SMALL_NUMBER)
+		{
+			continue;
+		}
+
+		const auto IsVisible = [&](const FConvexVolume& Frustum)
+		{
+			return Frustum.IntersectSphere(Origin, ConservativeRadius)
+				&& (!bOrientedBoxCulling || IntersectOrientedBox(Frustum, Origin, AxesX[Index], AxesY[Index], AxesZ[Index]));
+		};
+
+		if (IsVisible(ViewFrustum) || (InstancedViewFrustum && IsVisible(*InstancedViewFrustum)))
+		{
+			OutVisible[Index] = true;
+		}
+	}
+}
+
+bool FDecalSceneCache::IntersectOrientedBox(const FConvexVolume& ConvexVolume, const FVector& Origin, const FVector& AxisX, const FVector& AxisY, const FVector& AxisZ)
+{
+	const VectorRegister Orig = VectorLoadFloat3(&Origin);
+	const VectorRegister AxisXV = VectorLoadFloat3(&AxisX);
+	const VectorRegister AxisYV = VectorLoadFloat3(&AxisY);
+	const VectorRegister AxisZV = VectorLoadFloat3(&AxisZ);
+
+	// Splat the origin and the axes
+	const VectorRegister OrigX = VectorReplicate(Orig, 0);
+	const VectorRegister OrigY = VectorReplicate(Orig, 1);
+	const VectorRegister OrigZ = VectorReplicate(Orig, 2);
+	const VectorRegister AxisXX = VectorReplicate(AxisXV, 0);
+	const VectorRegister AxisXY = VectorReplicate(AxisXV, 1);
+	const VectorRegister AxisXZ = VectorReplicate(AxisXV, 2);
+	const VectorRegister AxisYX = VectorReplicate(AxisYV, 0);
+	const VectorRegister AxisYY = VectorReplicate(AxisYV, 1);
+	const VectorRegister AxisYZ = VectorReplicate(AxisYV, 2);
+	const VectorRegister AxisZX = VectorReplicate(AxisZV, 0);
+	const VectorRegister AxisZY = VectorReplicate(AxisZV, 1);
+	const VectorRegister AxisZZ = VectorReplicate(AxisZV, 2);
+
+	const FPlane* RESTRICT PermutedPlanePtr = ConvexVolume.PermutedPlanes.GetData();
+	for (int32 Count = 0; Count < ConvexVolume.PermutedPlanes.Num(); Count += 4)
+	{
+		// Load 4 planes that are already all Xs, Ys, ...
+		const VectorRegister PlanesX = VectorLoadAligned(&PermutedPlanePtr[0]);
+		const VectorRegister PlanesY = VectorLoadAligned(&PermutedPlanePtr[1]);
+		const VectorRegister PlanesZ = VectorLoadAligned(&PermutedPlanePtr[2]);
+		const VectorRegister PlanesW = VectorLoadAligned(&PermutedPlanePtr[3]);
+		PermutedPlanePtr += 4;
+
+		// Distance (x * x) + (y * y) + (z * z) - w
+		const VectorRegister Distance = VectorSubtract(VectorMultiplyAdd(OrigZ, PlanesZ, VectorMultiplyAdd(OrigY, PlanesY, VectorMultiply(OrigX, PlanesX))), PlanesW);
+		// Push out FMath::Abs(AxisX | Normal) + FMath::Abs(AxisY | Normal) + FMath::Abs(AxisZ | Normal)
+		const VectorRegister PushX = VectorAbs(VectorMultiplyAdd(AxisXZ, PlanesZ, VectorMultiplyAdd(AxisXY, PlanesY, VectorMultiply(AxisXX, PlanesX))));
+		const VectorRegister PushY = VectorAbs(VectorMultiplyAdd(AxisYZ, PlanesZ, VectorMultiplyAdd(AxisYY, PlanesY, VectorMultiply(AxisYX, PlanesX))));
+		const VectorRegister PushZ = VectorAbs(VectorMultiplyAdd(AxisZZ, PlanesZ, VectorMultiplyAdd(AxisZY, PlanesY, VectorMultiply(AxisZX, PlanesX))));
+		const VectorRegister PushOut = VectorAdd(VectorAdd(PushX, PushY), PushZ);
+
+		// Check for completely outside
+		if (VectorAnyGreaterThan(Distance, PushOut))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
 FDecalVisibilityTaskData* FDecalVisibilityTaskData::Launch(FRDGBuilder& GraphBuilder, const FScene& Scene, TConstArrayView<FViewInfo> Views)
 {
 	const FSceneViewFamily& ViewFamily = *Views[0].Family;
@@ -75,9 +268,9 @@ FDecalVisibilityViewPacket::FDecalVisibilityViewPacket(const FDecalVisibilityTas
 	: TaskData(InTaskData)
 	, View(InView)
 {
-	VisibleDecals.Task = LaunchSceneRenderTask(TEXT("BuildVisibleDecalList"), [&OutputList = VisibleDecals.List, &InputList = Scene.Decals, &View = View]
+	VisibleDecals.Task = LaunchSceneRenderTask(TEXT("BuildVisibleDecalList"), [&OutputList = VisibleDecals.List, &Scene = Scene, &View = View]
 	{
-		OutputList = DecalRendering::BuildVisibleDecalList(InputList, View);
+		OutputList = DecalRendering::BuildVisibleDecalList(Scene, View);
 	});
 
 	AllTasksEvent.AddPrerequisites(VisibleDecals.Task);
@@ -396,11 +589,16 @@ namespace DecalRendering
 	}
 
 	float CalculateDecalFadeAlpha(float DecalFadeScreenSize, const FMatrix& ComponentToWorldMatrix, const FViewInfo& View, float FadeMultiplier)
+	{
+		return CalculateDecalFadeAlpha(DecalFadeScreenSize, ComponentToWorldMatrix.GetOrigin(), ComponentToWorldMatrix.GetMaximumAxisScale(), View, FadeMultiplier);
+	}
+
+	float CalculateDecalFadeAlpha(float DecalFadeScreenSize, const FVector& Origin, float MaxAxisScale, const FViewInfo& View, float FadeMultiplier)
 	{
 		check(View.IsPerspectiveProjection());
 
-		float Distance = (View.ViewMatrices.GetViewOrigin() - ComponentToWorldMatrix.GetOrigin()).Size();
-		float Radius = ComponentToWorldMatrix.GetMaximumAxisScale();
+		float Distance = (View.ViewMatrices.GetViewOrigin() - Origin).Size();
+		float Radius = MaxAxisScale;
 		float CurrentScreenSize = ((Radius / Distance) * FadeMultiplier);
 
 		// fading coefficient needs to increase with increasing field of view and decrease with increasing resolution
@@ -446,10 +644,20 @@ namespace DecalRendering
 		});
 	}
 
-	FVisibleDecalList BuildVisibleDecalList(TConstArrayView<FDeferredDecalProxy*> Decals, const FViewInfo& View)
+	uint64 GetSortKey(uint32 SortOrder, FDecalBlendDesc BlendDesc)
+	{
+		// Sort order, then decals outputting normals first, then blend desc descending. Only the low 22 bits of the blend desc are used.
+		checkSlow(BlendDesc.Packed < (1u << 31));
+		return (uint64(SortOrder) << 32) | (uint64(BlendDesc.bWriteNormal ? 0 : 1) << 31) | uint64(~BlendDesc.Packed & 0x7FFFFFFFu);
+	}
+
+	FVisibleDecalList BuildVisibleDecalList(const FScene& Scene, const FViewInfo& View)
 	{
 		TRACE_CPUPROFILER_EVENT_SCOPE(BuildVisibleDecalList);
 
+		TConstArrayView<FDeferredDecalProxy*> Decals = Scene.Decals;
+		const FDecalSceneCache& DecalSceneCache = Scene.DecalSceneCache;
+
 		// Don't draw for shader complexity mode.
 		// todo: Handle shader complexity mode for deferred decal.
 		if (Decals.IsEmpty() || View.Family->EngineShowFlags.ShaderComplexity)
@@ -457,6 +665,12 @@ namespace DecalRendering
 			return {};
 		}
 
+		check(DecalSceneCache.Num() == Decals.Num());
+
+		FSceneBitArray VisibleInFrustum;
+		const FViewInfo* InstancedView = View.GetInstancedView();
+		DecalSceneCache.Cull(View.ViewFrustum, InstancedView ? &InstancedView->ViewFrustum : nullptr, CVarDecalOrientedBoxCulling.GetValueOnAnyThread() != 0, VisibleInFrustum);
+
 		FVisibleDecalList VisibleDecals;
 		VisibleDecals.Reserve(Decals.Num());
 
@@ -465,51 +679,65 @@ namespace DecalRendering
 
 		const bool bIsPerspectiveProjection = View.IsPerspectiveProjection();
 
-		for (const FDeferredDecalProxy* DecalProxy : Decals)
+		const auto AddVisibleDecal = [&](int32 DecalIndex)
 		{
-			if (!DecalProxy->DecalMaterial || !DecalProxy->DecalMaterial->IsValidLowLevelFast())
+			if (!VisibleInFrustum[DecalIndex])
 			{
-				continue;
+				return;
 			}
 
-			if (!DecalProxy->IsShown(&View))
+			const FDeferredDecalProxy* DecalProxy = Decals[DecalIndex];
+
+			if (!DecalProxy->DecalMaterial || !DecalProxy->DecalMaterial->IsValidLowLevelFast())
 			{
-				continue;
+				return;
 			}
 
-			const FMatrix ComponentToWorldMatrix = DecalProxy->ComponentTrans.ToMatrixWithScale();
-
-			// can be optimized as we test against a sphere around the box instead of the box itself
-			const float ConservativeRadius = FMath::Sqrt(
-				ComponentToWorldMatrix.GetScaledAxis(EAxis::X).SizeSquared() +
-				ComponentToWorldMatrix.GetScaledAxis(EAxis::Y).SizeSquared() +
-				ComponentToWorldMatrix.GetScaledAxis(EAxis::Z).SizeSquared());
-
-			const bool bIsVisibleInFirstView = View.ViewFrustum.IntersectSphere(ComponentToWorldMatrix.GetOrigin(), ConservativeRadius);
-			const FViewInfo* InstancedView = View.GetInstancedView();
-			const bool bIsVisibleInSecondView = InstancedView ? InstancedView->ViewFrustum.IntersectSphere(ComponentToWorldMatrix.GetOrigin(), ConservativeRadius) : false;
-
-			// can be optimized as the test is too conservative (sphere instead of OBB)
-			if (ConservativeRadius < SMALL_NUMBER || !(bIsVisibleInFirstView || bIsVisibleInSecondView))
+			if (!DecalProxy->IsShown(&View))
 			{
-				continue;
+				return;
 			}
 
 			float FadeAlpha = 1.0f;
 
 			if (bIsPerspectiveProjection && DecalProxy->FadeScreenSize != 0.0f)
 			{
-				FadeAlpha = CalculateDecalFadeAlpha(DecalProxy->FadeScreenSize, ComponentToWorldMatrix, View, FadeMultiplier);
+				FadeAlpha = CalculateDecalFadeAlpha(DecalProxy->FadeScreenSize, DecalSceneCache.GetOrigin(DecalIndex), DecalSceneCache.GetMaxAxisScale(DecalIndex), View, FadeMultiplier);
 			}
 
 			const bool bShouldRender = FadeAlpha > 0.0f;
 
 			if (!bShouldRender)
 			{
-				continue;
+				return;
+			}
+
+			VisibleDecals.Emplace(*DecalProxy, DecalSceneCache.GetConservativeRadius(DecalIndex), FadeAlpha, ShaderPlatform, View.GetFeatureLevel());
+		};
+
+		if (DecalSceneCache.IsBatchOrderValid())
+		{
+			for (int32 DecalIndex : DecalSceneCache.GetBatchOrder())
+			{
+				AddVisibleDecal(DecalIndex);
+			}
+		}
+		else
+		{
+			// Decals were added or removed since the scene update, sort the visible decals in batch order instead
+			for (int32 DecalIndex = 0; DecalIndex < Decals.Num(); ++DecalIndex)
+			{
+				AddVisibleDecal(DecalIndex);
 			}
 
-			VisibleDecals.Emplace(*DecalProxy, ConservativeRadius, FadeAlpha, ShaderPlatform, View.GetFeatureLevel());
+			VisibleDecals.Sort([](const FVisibleDecal& A, const FVisibleDecal& B)
+			{
+				if (B.MaterialProxy != A.MaterialProxy)
+				{
+					return B.MaterialProxy < A.MaterialProxy;
+				}
+				return B.Component < A.Component;
+			});
 		}
 
 		return VisibleDecals;
@@ -519,18 +747,46 @@ namespace DecalRendering
 	{
 		TRACE_CPUPROFILER_EVENT_SCOPE(BuildRelevantDecalList);
 
-		FRelevantDecalList RelevantDecals;
-		RelevantDecals.Reserve(Decals.Num());
+		struct FSortEntry
+		{
+			uint64 Key;
+			const FVisibleDecal* Decal;
+		};
+
+		TArray<FSortEntry, SceneRenderingAllocator> SortEntries;
+		SortEntries.Reserve(Decals.Num());
+
+		uint32 SortOrderMismatch = 0;
 
 		for (const FVisibleDecal& VisibleDecal : Decals)
 		{
 			if (IsCompatibleWithRenderStage(VisibleDecal.BlendDesc, DecalRenderStage))
 			{
-				RelevantDecals.Emplace(&VisibleDecal);
+				SortEntries.Add({ GetSortKey(VisibleDecal.SortOrder, VisibleDecal.BlendDesc), &VisibleDecal });
+				SortOrderMismatch |= VisibleDecal.SortOrder ^ SortEntries[0].Decal->SortOrder;
 			}
 		}
 
-		SortDecalList(RelevantDecals);
+		// The decals are in batch order, which is the tie break of SortDecalList, so a stable sort on the rest of the key gives the same list.
+		// The radix sort is stable, sort on the low half of the key and then on the high half if the decals don't all have the same sort order.
+		TArray<FSortEntry, SceneRenderingAllocator> SortedEntries;
+		SortedEntries.SetNumUninitialized(SortEntries.Num());
+		RadixSort32(SortedEntries.GetData(), SortEntries.GetData(), SortEntries.Num(), [](const FSortEntry& Entry) { return uint32(Entry.Key); });
+
+		if (SortOrderMismatch != 0)
+		{
+			RadixSort32(SortEntries.GetData(), SortedEntries.GetData(), SortedEntries.Num(), [](const FSortEntry& Entry) { return uint32(Entry.Key >> 32); });
+			Swap(SortEntries, SortedEntries);
+		}
+
+		FRelevantDecalList RelevantDecals;
+		RelevantDecals.Reserve(SortedEntries.Num());
+
+		for (const FSortEntry& Entry : SortedEntries)
+		{
+			RelevantDecals.Emplace(Entry.Decal);
+		}
+
 		return RelevantDecals;
 	}
 
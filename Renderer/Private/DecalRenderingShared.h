@@ -148,10 +148,15 @@ namespace DecalRendering
 {
 	float GetDecalFadeScreenSizeMultiplier();
 	float CalculateDecalFadeAlpha(float DecalFadeScreenSize, const FMatrix& ComponentToWorldMatrix, const FViewInfo& View, float FadeMultiplier);
+	float CalculateDecalFadeAlpha(float DecalFadeScreenSize, const FVector& Origin, float MaxAxisScale, const FViewInfo& View, float FadeMultiplier);
 	FMatrix ComputeComponentToClipMatrix(const FViewInfo& View, const FMatrix& DecalComponentToWorld);
 	void SetVertexShaderOnly(FRHICommandList& RHICmdList, FGraphicsPipelineStateInitializer& GraphicsPSOInit, const FViewInfo& View, const FMatrix& FrustumComponentToClip);
 	void SortDecalList(FRelevantDecalList& Decals);
-	FVisibleDecalList BuildVisibleDecalList(TConstArrayView<FDeferredDecalProxy*> Decals, const FViewInfo& View);
+	/** Key of SortDecalList without the material and component tie break, which is the batch order of the visible decals. */
+	uint64 GetSortKey(uint32 SortOrder, FDecalBlendDesc BlendDesc);
+	/** Visible decals of the view, in the batch order of FDecalSceneCache. */
+	FVisibleDecalList BuildVisibleDecalList(const FScene& Scene, const FViewInfo& View);
+	/** Decals relevant to the stage, sorted as SortDecalList. Decals must be in batch order, as built by BuildVisibleDecalList. */
 	FRelevantDecalList BuildRelevantDecalList(TConstArrayView<FVisibleDecal> Decals, EDecalRenderStage DecalRenderStage);
 	bool HasRelevantDecals(TConstArrayView<FVisibleDecal> Decals, EDecalRenderStage DecalRenderStage);
 	bool GetShaders(ERHIFeatureLevel::Type FeatureLevel, const FMaterial& Material, EDecalRenderStage DecalRenderStage, TShaderRef<FShader>& OutVertexShader, TShaderRef<FShader>& OutPixelShader);
@@ -0,0 +1,71 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ConvexVolume.h"
+#include "ScenePrivateBase.h"
+
+class FDeferredDecalProxy;
+
+/**
+ * Scene side cache of the decal culling data, in structure of arrays index parallel with FScene::Decals.
+ * Entries are built when a decal is added or moved, so the views don't need to rebuild the component to world matrix of every decal.
+ * The batch order is the tie break of DecalRendering::SortDecalList (material, then component). Visible decals are emitted in that order,
+ * so that a stable radix sort on DecalRendering::GetSortKey gives the same list as the comparison sort.
+ */
+class FDecalSceneCache
+{
+public:
+	/** Same as FScene::Decals.Add. */
+	void Add(const FDeferredDecalProxy* Proxy, const FTransform& ComponentTrans);
+
+	/** Same as FScene::Decals.RemoveAtSwap. */
+	void RemoveAtSwap(int32 Index);
+
+	/** Index of the decal in FScene::Decals, INDEX_NONE if it isn't in the scene. */
+	int32 FindIndex(const FDeferredDecalProxy* Proxy) const;
+
+	/** Rebuild the culling data of a decal after its transform changed. */
+	void UpdateTransform(int32 Index, const FTransform& ComponentTrans);
+
+	/** Sort the batch order if decals were added or removed since the last update. */
+	void UpdateBatchOrder(TConstArrayView<FDeferredDecalProxy*> Decals);
+
+	/** The batch order is out of date until the next UpdateBatchOrder when decals are added or removed. */
+	bool IsBatchOrderValid() const { return !bBatchOrderDirty; }
+	TConstArrayView<int32> GetBatchOrder() const { return BatchOrder; }
+
+	int32 Num() const { return Origins.Num(); }
+
+	const FVector& GetOrigin(int32 Index) const { return Origins[Index]; }
+	float GetConservativeRadius(int32 Index) const { return ConservativeRadii[Index]; }
+	float GetMaxAxisScale(int32 Index) const { return MaxAxisScales[Index]; }
+
+	/**
+	 * Frustum cull all the decals against the view, and the instanced view if any. OutVisible is index parallel with the decals.
+	 * The bounding sphere is tested first, same as the per decal test, and the oriented box of the survivors if bOrientedBoxCulling.
+	 */
+	void Cull(const FConvexVolume& ViewFrustum, const FConvexVolume* InstancedViewFrustum, bool bOrientedBoxCulling, FSceneBitArray& OutVisible) const;
+
+	/** Same as FConvexVolume::IntersectBox, for a box with the given center and half axes. */
+	static bool IntersectOrientedBox(const FConvexVolume& ConvexVolume, const FVector& Origin, const FVector& AxisX, const FVector& AxisY, const FVector& AxisZ);
+
+private:
+	/** Decal position and conservative bounding sphere radius (length of the scaled unit box diagonal). */
+	TArray<FVector> Origins;
+	TArray<float> ConservativeRadii;
+	/** Largest axis scale, for the screen size fade. */
+	TArray<float> MaxAxisScales;
+	/** Scaled axes of the unit box, i.e., the half axes of the oriented box. */
+	TArray<FVector> AxesX;
+	TArray<FVector> AxesY;
+	TArray<FVector> AxesZ;
+
+	TMap<const FDeferredDecalProxy*, int32> ProxyToIndex;
+	TArray<const FDeferredDecalProxy*> Proxies;
+
+	/** Decal indices sorted by material, then component, both descending. */
+	TArray<int32> BatchOrder;
+	bool bBatchOrderDirty = false;
+};
@@ -45,6 +45,14 @@ FAutoConsoleVariableRef CVarDFParallelUpdate(
 	ECVF_RenderThreadSafe
 );
 
+float GDFFullObjectUploadDensity = 0.5f;
+FAutoConsoleVariableRef CVarDFFullObjectUploadDensity(
+	TEXT("r.DistanceFields.FullObjectUploadDensity"),
+	GDFFullObjectUploadDensity,
+	TEXT("Fraction of dirty distance field objects above which the whole object buffer is uploaded as a single range, instead of walking the dirty objects. <= 0 disables."),
+	ECVF_RenderThreadSafe
+);
+
 int32 GDFReverseAtlasAllocationOrder = 0;
 FAutoConsoleVariableRef CVarDFReverseAtlasAllocationOrder(
 	TEXT("r.DistanceFields.ReverseAtlasAllocationOrder"),
@@ -175,40 +183,66 @@ FDistanceFieldAtlasParameters DistanceField::SetupAtlasParameters(FRDGBuilder& G
 
 const uint32 UpdateObjectsGroupSize = 64;
 
-struct FParallelUpdateRangeDFO
-{
-	int32 ItemStart;
-	int32 ItemCount;
-};
+// Number of objects filled per upload task
+static const int32 UpdateObjectsChunkSize = 256;
 
-struct FParallelUpdateRangesDFO
-{
-	FParallelUpdateRangeDFO Range[4];
-};
+// Number of object moves applied per compaction task
+static const int32 CompactObjectsBatchSize = 1024;
 
-// TODO: Improve and move to shared utility location.
-static int32 PartitionUpdateRangesDFO(FParallelUpdateRangesDFO& Ranges, int32 ItemCount, bool bAllowParallel)
+int32 FDistanceFieldDirtyObjectSlots::ExtractRanges(int32 NumValidSlots, int32 MaxUploads, float FullUploadDensity, TArray<FRange, SceneRenderingAllocator>& OutRanges)
 {
-	if (ItemCount < 256 || !bAllowParallel)
+	OutRanges.Reset();
+
+	if (NumDirty == 0)
 	{
-		Ranges.Range[0].ItemStart = 0;
-		Ranges.Range[0].ItemCount = ItemCount;
-		return 1;
+		return 0;
 	}
 
-	const int32 RangeCount = Align(ItemCount, 4) >> 2;
+	// Dense updates (e.g. mass spawns) are cheaper to upload as a single range than to walk
+	if (FullUploadDensity > 0.0f && NumValidSlots > 0 && NumValidSlots <= MaxUploads && NumDirty >= FullUploadDensity * NumValidSlots)
+	{
+		OutRanges.Add({ 0, NumValidSlots });
+		Reset();
+		return NumValidSlots;
+	}
+
+	uint32* Words = DirtyBits.GetData();
+	const int32 NumWords = FMath::DivideAndRoundUp(DirtyBits.Num(), NumBitsPerDWORD);
+
+	int32 NumUploads = 0;
+	for (int32 WordIndex = 0; WordIndex < NumWords && NumUploads < MaxUploads; ++WordIndex)
+	{
+		while (Words[WordIndex] != 0 && NumUploads < MaxUploads)
+		{
+			const uint32 BitIndex = FMath::CountTrailingZeros(Words[WordIndex]);
+			Words[WordIndex] &= Words[WordIndex] - 1;
+			--NumDirty;
+
+			// Slots past the end were freed by removals, there is nothing to upload
+			const int32 Index = WordIndex * NumBitsPerDWORD + BitIndex;
+			if (Index >= NumValidSlots)
+			{
+				continue;
+			}
 
-	Ranges.Range[0].ItemCount = RangeCount;
-	Ranges.Range[1].ItemCount = RangeCount;
-	Ranges.Range[2].ItemCount = RangeCount;
+			if (!OutRanges.IsEmpty() && OutRanges.Last().Start + OutRanges.Last().Count == Index)
+			{
+				++OutRanges.Last().Count;
+			}
+			else
+			{
+				OutRanges.Add({ Index, 1 });
+			}
+			++NumUploads;
+		}
+	}
 
-	Ranges.Range[0].ItemStart = 0;
-	Ranges.Range[1].ItemStart = RangeCount;
-	Ranges.Range[2].ItemStart = RangeCount * 2;
-	Ranges.Range[3].ItemStart = RangeCount * 3;
-	Ranges.Range[3].ItemCount = ItemCount - Ranges.Range[3].ItemStart;
+	if (NumDirty == 0)
+	{
+		DirtyBits.Reset();
+	}
 
-	return Ranges.Range[3].ItemCount > 0 ? 4 : 3;
+	return NumUploads;
 }
 
 void AddModifiedBounds(FDistanceFieldSceneData& DistanceFieldSceneData, FGlobalDFCacheType CacheType, const FBox& Bounds)
@@ -233,31 +267,66 @@ static void RemoveDistanceFieldInstance(int32 RemoveIndex, FDistanceFieldSceneDa
 
 	DistanceFieldSceneData.PrimitiveInstanceMapping.RemoveAtSwap(RemoveIndex, EAllowShrinking::No);
 
-	if(!DistanceFieldSceneData.IndicesToUpdateInObjectBuffersSet.Contains(RemoveIndex))
+	DistanceFieldSceneData.DirtyObjectSlots.MarkDirty(RemoveIndex);
+}
+
+void BuildDistanceFieldObjectCompaction(TArrayView<int32> RemoveIndices, int32 NumObjects, TArray<FDistanceFieldObjectMove, SceneRenderingAllocator>& OutMoves)
+{
+	OutMoves.Reset();
+
+	const int32 NumRemainingObjects = NumObjects - RemoveIndices.Num();
+	check(NumRemainingObjects >= 0);
+
+	RemoveIndices.Sort(TGreater<int32>());
+
+	// Current source of each slot past the remaining objects, follows the swaps into removed tail slots as the buffer shrinks
+	TArray<int32, SceneRenderingAllocator> TailSources;
+	TailSources.SetNumUninitialized(RemoveIndices.Num());
+	for (int32 TailIndex = 0; TailIndex < TailSources.Num(); ++TailIndex)
 	{
-		DistanceFieldSceneData.IndicesToUpdateInObjectBuffers.Add(RemoveIndex);
-		DistanceFieldSceneData.IndicesToUpdateInObjectBuffersSet.Add(RemoveIndex);
+		TailSources[TailIndex] = NumRemainingObjects + TailIndex;
+	}
+
+	int32 NumSlots = NumObjects;
+	for (int32 RemoveIndex : RemoveIndices)
+	{
+		check(RemoveIndex >= 0 && RemoveIndex < NumSlots);
+		--NumSlots;
+
+		if (RemoveIndex < NumSlots)
+		{
+			const int32 Source = TailSources[NumSlots - NumRemainingObjects];
+
+			if (RemoveIndex >= NumRemainingObjects)
+			{
+				// Removed slot in the tail, the object will move again when the buffer shrinks past it
+				TailSources[RemoveIndex - NumRemainingObjects] = Source;
+			}
+			else
+			{
+				OutMoves.Add({ Source, RemoveIndex });
+			}
+		}
 	}
 }
 
-void ProcessDistanceFieldObjectRemoves(FDistanceFieldSceneData& DistanceFieldSceneData, TArray<FSetElementId>& DistanceFieldAssetRemoves)
+void ProcessDistanceFieldObjectRemoves(FDistanceFieldSceneData& DistanceFieldSceneData, TArray<FSetElementId>& DistanceFieldAssetRemoves, bool bExecuteInParallel)
 {
 	if (DistanceFieldSceneData.PendingRemoveOperations.Num() > 0)
 	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(ProcessDistanceFieldObjectRemoves);
+
 		TArray<int32, SceneRenderingAllocator> PendingRemoveOperations;
 
+		// Refcount decrements are grouped by asset, in order of first removal
+		TMap<const FDistanceFieldVolumeData*, int32> AssetRemoveCounts;
+		AssetRemoveCounts.Reserve(DistanceFieldSceneData.PendingRemoveOperations.Num());
+
 		for (int32 RemoveIndex = 0; RemoveIndex < DistanceFieldSceneData.PendingRemoveOperations.Num(); RemoveIndex++)
 		{
 			const FPrimitiveRemoveInfo& PrimitiveRemoveInfo = DistanceFieldSceneData.PendingRemoveOperations[RemoveIndex];
-			
-			FSetElementId AssetSetId = DistanceFieldSceneData.AssetStateArray.FindId(PrimitiveRemoveInfo.DistanceFieldData);
-			FDistanceFieldAssetState& AssetState = DistanceFieldSceneData.AssetStateArray[AssetSetId];
-			AssetState.RefCount--;
-			
-			if (AssetState.RefCount == 0)
-			{
-				DistanceFieldAssetRemoves.Add(AssetSetId);
-			}
+
+			++AssetRemoveCounts.FindOrAdd(PrimitiveRemoveInfo.DistanceFieldData, 0);
 
 			// Can't dereference the primitive here, it has already been deleted
 			const FPrimitiveSceneInfo* Primitive = PrimitiveRemoveInfo.Primitive;
@@ -282,18 +351,53 @@ void ProcessDistanceFieldObjectRemoves(FDistanceFieldSceneData& DistanceFieldSce
 
 		DistanceFieldSceneData.PendingRemoveOperations.Reset();
 
+		for (const TPair<const FDistanceFieldVolumeData*, int32>& AssetRemoveCount : AssetRemoveCounts)
+		{
+			FSetElementId AssetSetId = DistanceFieldSceneData.AssetStateArray.FindId(AssetRemoveCount.Key);
+			FDistanceFieldAssetState& AssetState = DistanceFieldSceneData.AssetStateArray[AssetSetId];
+			AssetState.RefCount -= AssetRemoveCount.Value;
+			check(AssetState.RefCount >= 0);
+
+			if (AssetState.RefCount == 0)
+			{
+				DistanceFieldAssetRemoves.Add(AssetSetId);
+			}
+		}
+
 		if (PendingRemoveOperations.Num() > 0)
 		{
 			check(DistanceFieldSceneData.NumObjectsInBuffer >= PendingRemoveOperations.Num());
+			checkSlow(DistanceFieldSceneData.NumObjectsInBuffer == DistanceFieldSceneData.PrimitiveInstanceMapping.Num());
+
+			// Pair the removed slots with the surviving tail objects up front, so that the moves can be applied in any order
+			TArray<FDistanceFieldObjectMove, SceneRenderingAllocator> Moves;
+			BuildDistanceFieldObjectCompaction(PendingRemoveOperations, DistanceFieldSceneData.NumObjectsInBuffer, Moves);
 
-			// Sort from largest to smallest so we can safely RemoveAtSwap without invalidating indices in this array
-			PendingRemoveOperations.Sort(TGreater<int32>());
+			TArray<FPrimitiveAndInstance>& PrimitiveInstanceMapping = DistanceFieldSceneData.PrimitiveInstanceMapping;
 
-			for (int32 RemoveIndex : PendingRemoveOperations)
+			ParallelFor(TEXT("DistanceFields.CompactObjects"), Moves.Num(), CompactObjectsBatchSize,
+				[&Moves, &PrimitiveInstanceMapping](int32 MoveIndex)
+				{
+					const FDistanceFieldObjectMove& Move = Moves[MoveIndex];
+					const FPrimitiveAndInstance& PrimitiveAndInstanceBeingMoved = PrimitiveInstanceMapping[Move.From];
+
+					// Fixup indices of the primitive that is being moved, each moved instance writes its own index
+					check(PrimitiveAndInstanceBeingMoved.Primitive && PrimitiveAndInstanceBeingMoved.Primitive->DistanceFieldInstanceIndices.Num() > 0);
+					PrimitiveAndInstanceBeingMoved.Primitive->DistanceFieldInstanceIndices[PrimitiveAndInstanceBeingMoved.InstanceIndex] = Move.To;
+
+					PrimitiveInstanceMapping[Move.To] = PrimitiveAndInstanceBeingMoved;
+				},
+				(bExecuteInParallel && Moves.Num() > CompactObjectsBatchSize) ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread
+			);
+
+			for (const FDistanceFieldObjectMove& Move : Moves)
 			{
-				RemoveDistanceFieldInstance(RemoveIndex, DistanceFieldSceneData);
+				DistanceFieldSceneData.DirtyObjectSlots.MarkDirty(Move.To);
 			}
 
+			DistanceFieldSceneData.NumObjectsInBuffer -= PendingRemoveOperations.Num();
+			PrimitiveInstanceMapping.SetNum(DistanceFieldSceneData.NumObjectsInBuffer, EAllowShrinking::No);
+
 			PendingRemoveOperations.Reset();
 		}
 	}
@@ -429,11 +533,7 @@ void ProcessPrimitiveUpdate(
 					UploadIndex = PrimitiveSceneInfo->DistanceFieldInstanceIndices[TransformIndex];
 				}
 
-				if (!DistanceFieldSceneData.IndicesToUpdateInObjectBuffersSet.Contains(UploadIndex))
-				{
-					DistanceFieldSceneData.IndicesToUpdateInObjectBuffers.Add(UploadIndex);
-					DistanceFieldSceneData.IndicesToUpdateInObjectBuffersSet.Add(UploadIndex);
-				}
+				DistanceFieldSceneData.DirtyObjectSlots.MarkDirty(UploadIndex);
 
 				const FBox WorldBounds = ((FBox)DistanceFieldData->LocalSpaceMeshBounds).TransformBy(LocalToWorld);
 
@@ -511,7 +611,7 @@ void FDistanceFieldSceneData::UpdateDistanceFieldObjectBuffers(
 
 		// Process removes before adds, as the adds will overwrite primitive allocation info
 		// This also prevents re-uploading distance fields on render state recreation
-		ProcessDistanceFieldObjectRemoves(*this, DistanceFieldAssetRemoves);
+		ProcessDistanceFieldObjectRemoves(*this, DistanceFieldAssetRemoves, bExecuteInParallel);
 
 		if ((PendingAddOperations.Num() > 0 || PendingUpdateOperations.Num() > 0) && GDFReverseAtlasAllocationOrder == GDFPreviousReverseAtlasAllocationOrder)
 		{
@@ -566,11 +666,8 @@ void FDistanceFieldSceneData::UpdateDistanceFieldObjectBuffers(
 			// This is not expected to be hit during gameplay.
 			static const int32 MAX_NUM_DISTANCE_FIELD_OBJECT_UPLOADS = (2 << 20);
 
-			check(IndicesToUpdateInObjectBuffers.Num() == IndicesToUpdateInObjectBuffersSet.Num());
-
-			const int32 NumDFObjectUploads = FMath::Min(IndicesToUpdateInObjectBuffers.Num(), MAX_NUM_DISTANCE_FIELD_OBJECT_UPLOADS);
-
-			static FCriticalSection DFUpdateCS;
+			TArray<FDistanceFieldDirtyObjectSlots::FRange, SceneRenderingAllocator> UploadRanges;
+			const int32 NumDFObjectUploads = DirtyObjectSlots.ExtractRanges(PrimitiveInstanceMapping.Num(), MAX_NUM_DISTANCE_FIELD_OBJECT_UPLOADS, GDFFullObjectUploadDensity, UploadRanges);
 
 			if (NumDFObjectUploads > 0)
 			{
@@ -579,134 +676,141 @@ void FDistanceFieldSceneData::UpdateDistanceFieldObjectBuffers(
 
 				const TScenePrimitiveArray<FPrimitiveBounds>& PrimitiveBounds = Scene->PrimitiveBounds;
 
-				FParallelUpdateRangesDFO ParallelRanges;
-
-				int32 RangeCount = PartitionUpdateRangesDFO(ParallelRanges, NumDFObjectUploads, bExecuteInParallel);
+				// Split the ranges in chunks and reserve their upload data up front, so that the chunks can be filled in parallel without locking
+				struct FUploadChunk
+				{
+					int32 Start;
+					int32 Count;
+					FVector4f* UploadObjectData;
+					FVector4f* UploadObjectBounds;
+				};
+
+				TArray<FUploadChunk, SceneRenderingAllocator> UploadChunks;
+				for (const FDistanceFieldDirtyObjectSlots::FRange& Range : UploadRanges)
+				{
+					for (int32 Offset = 0; Offset < Range.Count; Offset += UpdateObjectsChunkSize)
+					{
+						FUploadChunk& Chunk = UploadChunks.AddDefaulted_GetRef();
+						Chunk.Start = Range.Start + Offset;
+						Chunk.Count = FMath::Min(UpdateObjectsChunkSize, Range.Count - Offset);
+						Chunk.UploadObjectData = (FVector4f*)UploadDistanceFieldDataBuffer.Add_GetRef(Chunk.Start, Chunk.Count);
+						Chunk.UploadObjectBounds = (FVector4f*)UploadDistanceFieldBoundsBuffer.Add_GetRef(Chunk.Start, Chunk.Count);
+					}
+				}
 
-				ParallelFor(RangeCount,
-					[this, &ParallelRanges, &PrimitiveBounds, RangeCount](int32 RangeIndex)
+				ParallelFor(TEXT("DistanceFields.UploadObjects"), UploadChunks.Num(), 1,
+					[this, &UploadChunks, &PrimitiveBounds](int32 ChunkIndex)
 					{
-						for (int32 ItemIndex = ParallelRanges.Range[RangeIndex].ItemStart; ItemIndex < ParallelRanges.Range[RangeIndex].ItemStart + ParallelRanges.Range[RangeIndex].ItemCount; ++ItemIndex)
+						const FUploadChunk& Chunk = UploadChunks[ChunkIndex];
+
+						for (int32 ChunkItemIndex = 0; ChunkItemIndex < Chunk.Count; ++ChunkItemIndex)
 						{
-							const int32 Index = IndicesToUpdateInObjectBuffers[ItemIndex];
-							checkf(Index >= 0, TEXT("Invalid instances should've been skipped in ProcessPrimitiveUpdate(...)"));
+							const int32 Index = Chunk.Start + ChunkItemIndex;
+							checkf(Index >= 0 && Index < PrimitiveInstanceMapping.Num(), TEXT("Invalid instances should've been skipped in ProcessPrimitiveUpdate(...)"));
+
+							FVector4f* UploadObjectData = Chunk.UploadObjectData + ChunkItemIndex * GDistanceFieldObjectDataStride;
+							FVector4f* UploadObjectBounds = Chunk.UploadObjectBounds + ChunkItemIndex * GDistanceFieldObjectBoundsStride;
+
+							const FPrimitiveAndInstance& PrimAndInst = PrimitiveInstanceMapping[Index];
+							const FPrimitiveSceneProxy* PrimitiveSceneProxy = PrimAndInst.Primitive->Proxy;
+
+							const FDistanceFieldVolumeData* DistanceFieldData = nullptr;
+							float SelfShadowBias;
+							PrimitiveSceneProxy->GetDistanceFieldAtlasData(DistanceFieldData, SelfShadowBias);
+
+							const FBox3f LocalSpaceMeshBounds = DistanceFieldData->LocalSpaceMeshBounds;
+
+							// Uniformly scale our Volume space to lie within [-1, 1] at the max extent
+							// This is mirrored in the SDF encoding
+							const FBox3f::FReal LocalToVolumeScale = 1.0f / LocalSpaceMeshBounds.GetExtent().GetMax();
+
+							const FDFVector3 WorldPosition(PrimAndInst.Origin + FVector(PrimAndInst.WorldBoundsRelativeToOrigin.GetCenter()));
+
+							FMatrix44f LocalToRelativeWorld = FDFMatrix::MakeToRelativeWorldMatrix(WorldPosition.High, PrimAndInst.GetLocalToWorld()).M;
+							FMatrix44f RelativeWorldToLocal = FMatrix44f(LocalToRelativeWorld.InverseFast());
 
-							if (Index < PrimitiveInstanceMapping.Num())
 							{
-								const FPrimitiveAndInstance& PrimAndInst = PrimitiveInstanceMapping[Index];
-								const FPrimitiveSceneProxy* PrimitiveSceneProxy = PrimAndInst.Primitive->Proxy;
-
-								if (RangeCount > 1)
-								{
-									DFUpdateCS.Lock();
-								}
-
-								FVector4f* UploadObjectData = (FVector4f*)UploadDistanceFieldDataBuffer.Add_GetRef(Index);
-								FVector4f* UploadObjectBounds = (FVector4f*)UploadDistanceFieldBoundsBuffer.Add_GetRef(Index);
-
-								if (RangeCount > 1)
-								{
-									DFUpdateCS.Unlock();
-								}
-
-								const FDistanceFieldVolumeData* DistanceFieldData = nullptr;
-								float SelfShadowBias;
-								PrimitiveSceneProxy->GetDistanceFieldAtlasData(DistanceFieldData, SelfShadowBias);
-
-								const FBox3f LocalSpaceMeshBounds = DistanceFieldData->LocalSpaceMeshBounds;
-
-								// Uniformly scale our Volume space to lie within [-1, 1] at the max extent
-								// This is mirrored in the SDF encoding
-								const FBox3f::FReal LocalToVolumeScale = 1.0f / LocalSpaceMeshBounds.GetExtent().GetMax();
-
-								const FDFVector3 WorldPosition(PrimAndInst.Origin + FVector(PrimAndInst.WorldBoundsRelativeToOrigin.GetCenter()));
-
-								FMatrix44f LocalToRelativeWorld = FDFMatrix::MakeToRelativeWorldMatrix(WorldPosition.High, PrimAndInst.GetLocalToWorld()).M;
-								FMatrix44f RelativeWorldToLocal = FMatrix44f(LocalToRelativeWorld.InverseFast());
-
-								{
-									const FVector3f BoundsExtent = PrimAndInst.WorldBoundsRelativeToOrigin.GetExtent();
-									const FVector4f ObjectBoundingSphere(WorldPosition.Low, BoundsExtent.Size());
-
-									UploadObjectBounds[0] = WorldPosition.High;
-									UploadObjectBounds[1] = ObjectBoundingSphere;
-
-									const FGlobalDFCacheType CacheType = PrimitiveSceneProxy->IsOftenMoving() ? GDF_Full : GDF_MostlyStatic;
-									const bool bOftenMoving = CacheType == GDF_Full;
-									const bool bCastShadow = PrimitiveSceneProxy->CastsDynamicShadow();
-									const bool bIsNaniteMesh = PrimitiveSceneProxy->IsNaniteMesh();
-									const bool bEmissiveLightSource = PrimitiveSceneProxy->IsEmissiveLightSource();
-									const bool bVisible = PrimitiveSceneProxy->IsDrawnInGame(); // Distance field object can be invisible in main view, but cast shadows
-									const bool bAffectIndirectLightingWhileHidden = PrimitiveSceneProxy->AffectsIndirectLightingWhileHidden();
-
-									uint32 Flags = 0;
-									Flags |= bOftenMoving ? 1u : 0;
-									Flags |= bCastShadow ? 2u : 0;
-									Flags |= bIsNaniteMesh ? 4u : 0;
-									Flags |= bEmissiveLightSource ? 8u : 0;
-									Flags |= bVisible ? 16u : 0;
-									Flags |= bAffectIndirectLightingWhileHidden ? 32u : 0;
-
-									FVector4f ObjectWorldExtentAndFlags(BoundsExtent, 0.0f);
-									ObjectWorldExtentAndFlags.W = *(const float*)&Flags;
-									UploadObjectBounds[2] = ObjectWorldExtentAndFlags;
-								}
-
-								const FMatrix44f VolumeToRelativeWorld = FScaleMatrix44f(1.0f / LocalToVolumeScale) * FTranslationMatrix44f(LocalSpaceMeshBounds.GetCenter()) * LocalToRelativeWorld;
-								const FMatrix44f RelativeWorldToVolume = RelativeWorldToLocal * FTranslationMatrix44f(-LocalSpaceMeshBounds.GetCenter()) * FScaleMatrix44f(LocalToVolumeScale);
-
-								UploadObjectData[0] = WorldPosition.High;
-								const FMatrix44f WorldToVolumeT = RelativeWorldToVolume.GetTransposed();
-								// WorldToVolumeT
-								UploadObjectData[1] = (*(FVector4f*)&WorldToVolumeT.M[0]);
-								UploadObjectData[2] = (*(FVector4f*)&WorldToVolumeT.M[1]);
-								UploadObjectData[3] = (*(FVector4f*)&WorldToVolumeT.M[2]);
-
-								const FVector3f VolumePositionExtent = LocalSpaceMeshBounds.GetExtent() * LocalToVolumeScale;
-
-								// Minimal surface bias which increases chance that ray hit will a surface located between two texels
-								float ExpandSurfaceDistance = (GMeshSDFSurfaceBiasExpand * VolumePositionExtent / FVector3f(DistanceFieldData->Mips[0].IndirectionDimensions * DistanceField::UniqueDataBrickSize)).Size();
-
-								const float WSign = DistanceFieldData->bMostlyTwoSided ? -1 : 1;
-								UploadObjectData[4] = FVector4f(VolumePositionExtent, WSign * ExpandSurfaceDistance);
-
-								const int32 PrimIdx = PrimAndInst.Primitive->GetIndex();
-								const FPrimitiveBounds& PrimBounds = PrimitiveBounds[PrimIdx];
-								float MinDrawDist2 = FMath::Square(PrimBounds.MinDrawDistance);
-								// For IEEE compatible machines, float operations goes to inf if overflow
-								// In this case, it will effectively disable max draw distance culling
-								float MaxDrawDist = FMath::Max(PrimBounds.MaxCullDistance, 0.f) * GetCachedScalabilityCVars().ViewDistanceScale;
-
-								const uint32 GPUSceneInstanceIndex = PrimitiveSceneProxy->SupportsInstanceDataBuffer() ?
-									PrimAndInst.Primitive->GetInstanceSceneDataOffset() + PrimAndInst.InstanceIndex :
-									PrimAndInst.Primitive->GetInstanceSceneDataOffset();
-
-								// Bypass NaN checks in FVector4f ctor
-								FVector4f Vector4;
-								Vector4.X = MinDrawDist2;
-								Vector4.Y = MaxDrawDist * MaxDrawDist;
-								Vector4.Z = SelfShadowBias;
-								Vector4.W = *(const float*)&GPUSceneInstanceIndex;
-								UploadObjectData[5] = Vector4;
-
-								const FMatrix44f VolumeToWorldT = VolumeToRelativeWorld.GetTransposed();
-								UploadObjectData[6] = *(FVector4f*)&VolumeToWorldT.M[0];
-								UploadObjectData[7] = *(FVector4f*)&VolumeToWorldT.M[1];
-								UploadObjectData[8] = *(FVector4f*)&VolumeToWorldT.M[2];
-
-								FVector4f FloatVector8(FVector3f(VolumeToRelativeWorld.GetScaleVector()), 0.0f);
-
-								// Bypass NaN checks in FVector4f ctor
-								FSetElementId AssetStateSetId = AssetStateArray.FindId(DistanceFieldData);
-								check(AssetStateSetId.IsValidId());
-								const int32 AssetStateInt = AssetStateSetId.AsInteger();
-								FloatVector8.W = *(const float*)&AssetStateInt;
-
-								UploadObjectData[9] = FloatVector8;
+								const FVector3f BoundsExtent = PrimAndInst.WorldBoundsRelativeToOrigin.GetExtent();
+								const FVector4f ObjectBoundingSphere(WorldPosition.Low, BoundsExtent.Size());
+
+								UploadObjectBounds[0] = WorldPosition.High;
+								UploadObjectBounds[1] = ObjectBoundingSphere;
+
+								const FGlobalDFCacheType CacheType = PrimitiveSceneProxy->IsOftenMoving() ? GDF_Full : GDF_MostlyStatic;
+								const bool bOftenMoving = CacheType == GDF_Full;
+								const bool bCastShadow = PrimitiveSceneProxy->CastsDynamicShadow();
+								const bool bIsNaniteMesh = PrimitiveSceneProxy->IsNaniteMesh();
+								const bool bEmissiveLightSource = PrimitiveSceneProxy->IsEmissiveLightSource();
+								const bool bVisible = PrimitiveSceneProxy->IsDrawnInGame(); // Distance field object can be invisible in main view, but cast shadows
+								const bool bAffectIndirectLightingWhileHidden = PrimitiveSceneProxy->AffectsIndirectLightingWhileHidden();
+
+								uint32 Flags = 0;
+								Flags |= bOftenMoving ? 1u : 0;
+								Flags |= bCastShadow ? 2u : 0;
+								Flags |= bIsNaniteMesh ? 4u : 0;
+								Flags |= bEmissiveLightSource ? 8u : 0;
+								Flags |= bVisible ? 16u : 0;
+								Flags |= bAffectIndirectLightingWhileHidden ? 32u : 0;
+
+								FVector4f ObjectWorldExtentAndFlags(BoundsExtent, 0.0f);
+								ObjectWorldExtentAndFlags.W = *(const float*)&Flags;
+								UploadObjectBounds[2] = ObjectWorldExtentAndFlags;
 							}
+
+							const FMatrix44f VolumeToRelativeWorld = FScaleMatrix44f(1.0f / LocalToVolumeScale) * FTranslationMatrix44f(LocalSpaceMeshBounds.GetCenter()) * LocalToRelativeWorld;
+							const FMatrix44f RelativeWorldToVolume = RelativeWorldToLocal * FTranslationMatrix44f(-LocalSpaceMeshBounds.GetCenter()) * FScaleMatrix44f(LocalToVolumeScale);
+
+							UploadObjectData[0] = WorldPosition.High;
+							const FMatrix44f WorldToVolumeT = RelativeWorldToVolume.GetTransposed();
+							// WorldToVolumeT
+							UploadObjectData[1] = (*(FVector4f*)&WorldToVolumeT.M[0]);
+							UploadObjectData[2] = (*(FVector4f*)&WorldToVolumeT.M[1]);
+							UploadObjectData[3] = (*(FVector4f*)&WorldToVolumeT.M[2]);
+
+							const FVector3f VolumePositionExtent = LocalSpaceMeshBounds.GetExtent() * LocalToVolumeScale;
+
+							// Minimal surface bias which increases chance that ray hit will a surface located between two texels
+							float ExpandSurfaceDistance = (GMeshSDFSurfaceBiasExpand * VolumePositionExtent / FVector3f(DistanceFieldData->Mips[0].IndirectionDimensions * DistanceField::UniqueDataBrickSize)).Size();
+
+							const float WSign = DistanceFieldData->bMostlyTwoSided ? -1 : 1;
+							UploadObjectData[4] = FVector4f(VolumePositionExtent, WSign * ExpandSurfaceDistance);
+
+							const int32 PrimIdx = PrimAndInst.Primitive->GetIndex();
+							const FPrimitiveBounds& PrimBounds = PrimitiveBounds[PrimIdx];
+							float MinDrawDist2 = FMath::Square(PrimBounds.MinDrawDistance);
+							// For IEEE compatible machines, float operations goes to inf if overflow
+							// In this case, it will effectively disable max draw distance culling
+							float MaxDrawDist = FMath::Max(PrimBounds.MaxCullDistance, 0.f) * GetCachedScalabilityCVars().ViewDistanceScale;
+
+							const uint32 GPUSceneInstanceIndex = PrimitiveSceneProxy->SupportsInstanceDataBuffer() ?
+								PrimAndInst.Primitive->GetInstanceSceneDataOffset() + PrimAndInst.InstanceIndex :
+								PrimAndInst.Primitive->GetInstanceSceneDataOffset();
+
+							// Bypass NaN checks in FVector4f ctor
+							FVector4f Vector4;
+							Vector4.X = MinDrawDist2;
+							Vector4.Y = MaxDrawDist * MaxDrawDist;
+							Vector4.Z = SelfShadowBias;
+							Vector4.W = *(const float*)&GPUSceneInstanceIndex;
+							UploadObjectData[5] = Vector4;
+
+							const FMatrix44f VolumeToWorldT = VolumeToRelativeWorld.GetTransposed();
+							UploadObjectData[6] = *(FVector4f*)&VolumeToWorldT.M[0];
+							UploadObjectData[7] = *(FVector4f*)&VolumeToWorldT.M[1];
+							UploadObjectData[8] = *(FVector4f*)&VolumeToWorldT.M[2];
+
+							FVector4f FloatVector8(FVector3f(VolumeToRelativeWorld.GetScaleVector()), 0.0f);
+
+							// Bypass NaN checks in FVector4f ctor
+							FSetElementId AssetStateSetId = AssetStateArray.FindId(DistanceFieldData);
+							check(AssetStateSetId.IsValidId());
+							const int32 AssetStateInt = AssetStateSetId.AsInteger();
+							FloatVector8.W = *(const float*)&AssetStateInt;
+
+							UploadObjectData[9] = FloatVector8;
 						}
 					},
-					RangeCount == 1
+					(bExecuteInParallel && UploadChunks.Num() > 1) ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread
 				);
 
 				UploadDistanceFieldDataBuffer.ResourceUploadTo(GraphBuilder, DFObjectDataBuffer);
@@ -714,26 +818,6 @@ void FDistanceFieldSceneData::UpdateDistanceFieldObjectBuffers(
 
 				ExternalAccessQueue.Add(DFObjectDataBuffer, ERHIAccess::SRVMask, ERHIPipeline::All);
 				ExternalAccessQueue.Add(DFObjectBoundsBuffer, ERHIAccess::SRVMask, ERHIPipeline::All);
-
-				IndicesToUpdateInObjectBuffersSet.Reset();
-
-				if (IndicesToUpdateInObjectBuffers.Num() > NumDFObjectUploads)
-				{
-					// this is not expected to happen frequently since we can perform up to MAX_NUM_DISTANCE_FIELD_OBJECT_UPLOADS per frame
-					// RemoveAtSwap would be more efficient but could potentially result in starvation
-					IndicesToUpdateInObjectBuffers.RemoveAt(0, NumDFObjectUploads, EAllowShrinking::Yes); // allow array to shrink since getting into this code path means array is very large
-
-					for (int32 Index : IndicesToUpdateInObjectBuffers)
-					{
-						IndicesToUpdateInObjectBuffersSet.Add(Index);
-					}
-
-					check(IndicesToUpdateInObjectBuffers.Num() == IndicesToUpdateInObjectBuffersSet.Num());
-				}
-				else
-				{
-					IndicesToUpdateInObjectBuffers.Reset();
-				}
 			}
 		}
 
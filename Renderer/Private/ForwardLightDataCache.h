@@ -0,0 +1,60 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SceneManagement.h"
+#include "BasePassRendering.h"
+
+class FScene;
+struct FLightSceneChangeSet;
+struct FSortedLightSetSceneInfo;
+
+/**
+ * Scene persistent cache of the view independent part of the forward light data, indexed by light scene id.
+ * Entries are invalidated by the light scene updates (add, remove, transform and color) and rebuilt once per frame, for all views.
+ * The atlas slots, light function atlas index and extra data can change without a light update, so they are refreshed every frame and only repacked when they differ.
+ * Directional lights are few and depend on atmosphere state that is not tracked by the light updates, they are always rebuilt.
+ * The view dependent fields (translated position, scaled color, volumetric scattering, virtual shadow map and previous index) are patched per view.
+ */
+class FForwardLightDataCache
+{
+public:
+	struct FEntry
+	{
+		/** Light shader parameters, unscaled color, with the atlas slots of the current frame. */
+		FLightRenderParameters LightParameters;
+		/** Forward light data with the view independent fields filled in. */
+		FForwardLightData PackedData;
+		/** Packed source length and volumetric scattering intensity, with and without the volumetric scattering. */
+		uint32 PackedW = 0;
+		uint32 PackedWNoVolumetricScattering = 0;
+		uint32 LightSceneInfoExtraDataPacked = 0;
+		bool bValid = false;
+	};
+
+	/** Invalidate the entries of the lights added, removed or updated. */
+	void OnPostLightSceneInfoUpdate(const FLightSceneChangeSet& ChangeSet);
+
+	/** Bring the entries of the non simple sorted lights up to date for this frame. */
+	void Update(FScene& Scene, const FSortedLightSetSceneInfo& SortedLightSet, bool bAllowStaticLighting, uint32 LightShaderParameterFlags);
+
+	const FEntry& GetEntry(int32 LightSceneId) const { return Entries[LightSceneId]; }
+
+	/** Pack the view independent fields of the forward light data, the view dependent fields are zeroed. */
+	static void PackViewIndependent(FForwardLightData& Out, const FLightRenderParameters& LightParameters, uint32 LightSceneInfoExtraDataPacked, int32 LightSceneId);
+
+	/** Pack the view dependent fields of the forward light data. LightColor has all the view scales applied. */
+	static void PatchViewDependent(
+		FForwardLightData& Out,
+		const FVector& PreViewTranslation,
+		const FVector& LightWorldPosition,
+		const FLinearColor& LightColor,
+		uint32 PackedW,
+		int32 VirtualShadowMapId,
+		int32 PrevLocalLightIndex);
+
+private:
+	TArray<FEntry> Entries;
+	uint32 CachedLightShaderParameterFlags = 0;
+};
@@ -294,6 +294,14 @@ FAutoConsoleVariableRef CVarGlobalDistanceFieldDebugDrawModifiedPrimitives(
 	ECVF_Scalability | ECVF_RenderThreadSafe
 );
 
+int32 GGlobalDistanceFieldMaxModifiedUpdateBounds = 1024;
+FAutoConsoleVariableRef CVarGlobalDistanceFieldMaxModifiedUpdateBounds(
+	TEXT("r.GlobalDistanceField.MaxModifiedUpdateBounds"),
+	GGlobalDistanceFieldMaxModifiedUpdateBounds,
+	TEXT("Maximum number of update boxes produced by primitive modifications (after snapping to the clipmap pages and merging) before falling back to a full clipmap update."),
+	ECVF_Scalability | ECVF_RenderThreadSafe
+);
+
 bool UseGlobalDistanceField()
 {
 	return GAOGlobalDistanceField != 0;
@@ -640,6 +648,178 @@ void FGlobalDistanceFieldInfo::UpdateParameterData(float MaxOcclusionDistance, b
 	bInitialized = true;
 }
 
+void FGlobalDistanceFieldModifiedBounds::Add(TConstArrayView<FBox> Bounds, double InCellSize)
+{
+	if (Bounds.IsEmpty() || bOverflow)
+	{
+		return;
+	}
+
+	if (CellSize != InCellSize)
+	{
+		if (!CellBoxes.IsEmpty())
+		{
+			// Page size changed with pending modifications (clipmap extent changed), which requires a full update anyway
+			bOverflow = true;
+			CellBoxes.Empty();
+			return;
+		}
+
+		CellSize = InCellSize;
+	}
+
+	const double InvCellSize = 1.0 / CellSize;
+
+	for (const FBox& Box : Bounds)
+	{
+		FCellBox CellBox;
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			CellBox.Min[Axis] = FMath::FloorToInt64(Box.Min[Axis] * InvCellSize);
+			CellBox.Max[Axis] = FMath::Max(FMath::CeilToInt64(Box.Max[Axis] * InvCellSize), CellBox.Min[Axis] + 1);
+		}
+
+		CellBoxes.Add(CellBox);
+	}
+}
+
+bool FGlobalDistanceFieldModifiedBounds::BuildUpdateBounds(const FBox& ClipmapBounds, double InfluenceRadius, int32 MaxUpdateBounds, TArray<FBox>& OutUpdateBounds) const
+{
+	OutUpdateBounds.Reset();
+
+	if (bOverflow)
+	{
+		return false;
+	}
+
+	if (CellBoxes.IsEmpty())
+	{
+		return true;
+	}
+
+	const double InvCellSize = 1.0 / CellSize;
+
+	FInt64Vector GridMin;
+	FInt64Vector GridSize;
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		GridMin[Axis] = FMath::RoundToInt64(ClipmapBounds.Min[Axis] * InvCellSize);
+		GridSize[Axis] = FMath::Max<int64>(FMath::RoundToInt64(ClipmapBounds.Max[Axis] * InvCellSize) - GridMin[Axis], 1);
+	}
+
+	if (GridSize.X * GridSize.Y * GridSize.Z > MAX_int32)
+	{
+		return false;
+	}
+
+	auto GetCellIndex = [&GridSize](int64 X, int64 Y, int64 Z)
+	{
+		return int32((Z * GridSize.Y + Y) * GridSize.X + X);
+	};
+
+	// Rasterize the modified bounds affecting the clipmap into its page grid
+	TBitArray<> DirtyCells(false, int32(GridSize.X * GridSize.Y * GridSize.Z));
+
+	const double InfluenceRadiusSq = InfluenceRadius * InfluenceRadius;
+
+	for (const FCellBox& CellBox : CellBoxes)
+	{
+		const FBox Box(FVector(CellBox.Min) * CellSize, FVector(CellBox.Max) * CellSize);
+		if (Box.ComputeSquaredDistanceToBox(ClipmapBounds) >= InfluenceRadiusSq)
+		{
+			continue;
+		}
+
+		// Clamping to the clipmap grid is conservative, the clamped box is at least as close as the original box to any point in the clipmap
+		FInt64Vector Min;
+		FInt64Vector Max;
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			Min[Axis] = FMath::Clamp<int64>(CellBox.Min[Axis] - GridMin[Axis], 0, GridSize[Axis] - 1);
+			Max[Axis] = FMath::Clamp<int64>(CellBox.Max[Axis] - GridMin[Axis], Min[Axis] + 1, GridSize[Axis]);
+		}
+
+		for (int64 Z = Min.Z; Z < Max.Z; ++Z)
+		{
+			for (int64 Y = Min.Y; Y < Max.Y; ++Y)
+			{
+				DirtyCells.SetRange(GetCellIndex(Min.X, Y, Z), int32(Max.X - Min.X), true);
+			}
+		}
+	}
+
+	auto IsRowDirty = [&DirtyCells, &GetCellIndex](int64 MinX, int64 MaxX, int64 Y, int64 Z)
+	{
+		for (int64 X = MinX; X < MaxX; ++X)
+		{
+			if (!DirtyCells[GetCellIndex(X, Y, Z)])
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+
+	// Greedily merge the dirty pages into boxes, in grid order: grow along X, then Y while the rows are dirty, then Z while the slabs are dirty
+	for (int32 CellIndex = DirtyCells.Find(true); CellIndex != INDEX_NONE; CellIndex = DirtyCells.FindFrom(true, CellIndex + 1))
+	{
+		const int64 X = CellIndex % GridSize.X;
+		const int64 Y = (CellIndex / GridSize.X) % GridSize.Y;
+		const int64 Z = CellIndex / (GridSize.X * GridSize.Y);
+
+		int64 EndX = X + 1;
+		while (EndX < GridSize.X && DirtyCells[GetCellIndex(EndX, Y, Z)])
+		{
+			++EndX;
+		}
+
+		int64 EndY = Y + 1;
+		while (EndY < GridSize.Y && IsRowDirty(X, EndX, EndY, Z))
+		{
+			++EndY;
+		}
+
+		int64 EndZ = Z + 1;
+		for (bool bSlabDirty = true; EndZ < GridSize.Z && bSlabDirty; )
+		{
+			for (int64 SlabY = Y; SlabY < EndY && bSlabDirty; ++SlabY)
+			{
+				bSlabDirty = IsRowDirty(X, EndX, SlabY, EndZ);
+			}
+
+			if (bSlabDirty)
+			{
+				++EndZ;
+			}
+		}
+
+		for (int64 MergedZ = Z; MergedZ < EndZ; ++MergedZ)
+		{
+			for (int64 MergedY = Y; MergedY < EndY; ++MergedY)
+			{
+				DirtyCells.SetRange(GetCellIndex(X, MergedY, MergedZ), int32(EndX - X), false);
+			}
+		}
+
+		if (OutUpdateBounds.Num() >= MaxUpdateBounds)
+		{
+			OutUpdateBounds.Reset();
+			return false;
+		}
+
+		OutUpdateBounds.Add(FBox(FVector(GridMin + FInt64Vector(X, Y, Z)) * CellSize, FVector(GridMin + FInt64Vector(EndX, EndY, EndZ)) * CellSize));
+	}
+
+	return true;
+}
+
+void FGlobalDistanceFieldModifiedBounds::Reset()
+{
+	CellBoxes.Reset();
+	CellSize = 0.0;
+	bOverflow = false;
+}
+
 /** Constructs and adds an update region based on camera movement for the given axis. */
 static void AddUpdateBoundsForAxis(FInt64Vector MovementInPages,
 	const FBox& ClipmapBounds,
@@ -1095,7 +1275,7 @@ static void ComputeUpdateRegionsAndUpdateViewState(
 			for (uint32 CacheType = 0; CacheType < GDF_Num; CacheType++)
 			{
 				const uint32 DestCacheType = GAOGlobalDistanceFieldCacheMostlyStaticSeparately ? CacheType : GDF_Full;
-				ClipmapViewState.Cache[DestCacheType].PrimitiveModifiedBounds.Append(Scene->DistanceFieldSceneData.PrimitiveModifiedBounds[CacheType]);
+				ClipmapViewState.Cache[DestCacheType].PrimitiveModifiedBounds.Add(Scene->DistanceFieldSceneData.PrimitiveModifiedBounds[CacheType], ClipmapPageSize);
 			}
 
 			const bool bForceFullUpdate = bSharedDataReallocated
@@ -1148,33 +1328,28 @@ static void ComputeUpdateRegionsAndUpdateViewState(
 						? &GlobalDistanceFieldInfo.MostlyStaticClipmaps[ClipmapIndex]
 						: &GlobalDistanceFieldInfo.Clipmaps[ClipmapIndex]);
 
-					const TArray<FBox>& PrimitiveModifiedBounds = ClipmapViewState.Cache[CacheType].PrimitiveModifiedBounds;
-
-					uint32 NumCulledPrimitiveModifiedBounds = 0;
+					// Merged update boxes of the primitive modifications affecting this clipmap
+					TArray<FBox> ModifiedUpdateBounds;
+					const bool bModifiedBoundsFitBudget = ClipmapViewState.Cache[CacheType].PrimitiveModifiedBounds.BuildUpdateBounds(ClipmapBounds, ClipmapInfluenceRadius, GGlobalDistanceFieldMaxModifiedUpdateBounds, ModifiedUpdateBounds);
 
-					Clipmap.UpdateBounds.Empty(PrimitiveModifiedBounds.Num() / 2);
+					Clipmap.UpdateBounds.Empty(ModifiedUpdateBounds.Num() + 3);
 
-					for (int32 BoundsIndex = 0; BoundsIndex < PrimitiveModifiedBounds.Num(); BoundsIndex++)
+					for (int32 BoundsIndex = 0; BoundsIndex < ModifiedUpdateBounds.Num(); BoundsIndex++)
 					{
-						const FBox ModifiedBounds = PrimitiveModifiedBounds[BoundsIndex];
+						const FBox ModifiedBounds = ModifiedUpdateBounds[BoundsIndex];
 
-						if (ModifiedBounds.ComputeSquaredDistanceToBox(ClipmapBounds) < ClipmapInfluenceRadius * ClipmapInfluenceRadius)
+						Clipmap.UpdateBounds.Add(FClipmapUpdateBounds(ModifiedBounds.GetCenter(), ModifiedBounds.GetExtent(), true));
+							
+						if (GGlobalDistanceFieldDebugDrawModifiedPrimitives)
 						{
-							++NumCulledPrimitiveModifiedBounds;
+							const uint8 MarkerHue = ((ClipmapIndex * 10 + BoundsIndex) * 10) & 0xFF;
+							const uint8 MarkerSaturation = 0xFF;
+							const uint8 MarkerValue = 0xFF;
 
-							Clipmap.UpdateBounds.Add(FClipmapUpdateBounds(ModifiedBounds.GetCenter(), ModifiedBounds.GetExtent(), true));
-							
-							if (GGlobalDistanceFieldDebugDrawModifiedPrimitives)
-							{
-								const uint8 MarkerHue = ((ClipmapIndex * 10 + BoundsIndex) * 10) & 0xFF;
-								const uint8 MarkerSaturation = 0xFF;
-								const uint8 MarkerValue = 0xFF;
-
-								FLinearColor MarkerColor = FLinearColor::MakeFromHSV8(MarkerHue, MarkerSaturation, MarkerValue);
-								MarkerColor.A = 0.5f;
+							FLinearColor MarkerColor = FLinearColor::MakeFromHSV8(MarkerHue, MarkerSaturation, MarkerValue);
+							MarkerColor.A = 0.5f;
 	
-								DrawWireBox(&ViewPDI, ModifiedBounds, MarkerColor, SDPG_World);
-							}
+							DrawWireBox(&ViewPDI, ModifiedBounds, MarkerColor, SDPG_World);
 						}
 					}
 
@@ -1201,8 +1376,8 @@ static void ComputeUpdateRegionsAndUpdateViewState(
 						}
 					}
 
-					// Only use partial updates with small numbers of primitive modifications
-					bool bUsePartialUpdatesForUpdateBounds = bUsePartialUpdates && NumCulledPrimitiveModifiedBounds < 1024;
+					// Only use partial updates when the primitive modifications merge into a small number of update boxes
+					bool bUsePartialUpdatesForUpdateBounds = bUsePartialUpdates && bModifiedBoundsFitBudget;
 
 					if (!bUsePartialUpdatesForUpdateBounds)
 					{
@@ -1245,7 +1420,7 @@ static void ComputeUpdateRegionsAndUpdateViewState(
 						Clipmap.FullRecaptureReason = EGlobalSDFFullRecaptureReason::MeshSDFStreaming;
 					}
 
-					ClipmapViewState.Cache[CacheType].PrimitiveModifiedBounds.Empty(DistanceField::MinPrimitiveModifiedBoundsAllocation);
+					ClipmapViewState.Cache[CacheType].PrimitiveModifiedBounds.Reset();
 				}
 
 				ClipmapViewState.LastPartialUpdateOriginInPages = PageGridCenter;
@@ -3,6 +3,8 @@
 #pragma once
 
 #include "Math/IntVector.h"
+#include "Math/Box.h"
+#include "Containers/Set.h"
 
 class FDistanceFieldAOParameters;
 class FGlobalDistanceFieldInfo;
@@ -42,6 +44,55 @@ namespace GlobalDistanceField
 	int32 GetMaxPageNum(bool bLumenEnabled, float LumenSceneViewDistance);
 };
 
+/**
+ * Primitive modified bounds of a clipmap cache, accumulated until the clipmap is next updated.
+ * Boxes are snapped to the (world aligned) clipmap page grid as they arrive, which deduplicates repeated modifications of the same region.
+ * On update, the snapped boxes are culled and rasterized into the clipmap page grid, and the dirty pages are merged back into a compact set of boxes.
+ */
+class FGlobalDistanceFieldModifiedBounds
+{
+public:
+	/** Snap and accumulate modified bounds, CellSize is the clipmap page size */
+	void Add(TConstArrayView<FBox> Bounds, double CellSize);
+
+	/**
+	 * Merge the accumulated bounds affecting the clipmap into at most MaxUpdateBounds boxes, in page grid order.
+	 * Returns false if the bounds can't be represented within the budget, in which case the clipmap needs a full update.
+	 */
+	bool BuildUpdateBounds(const FBox& ClipmapBounds, double InfluenceRadius, int32 MaxUpdateBounds, TArray<FBox>& OutUpdateBounds) const;
+
+	void Reset();
+
+	int32 Num() const
+	{
+		return CellBoxes.Num();
+	}
+
+private:
+	/** Half open page range */
+	struct FCellBox
+	{
+		FInt64Vector Min;
+		FInt64Vector Max;
+
+		bool operator==(const FCellBox& Other) const
+		{
+			return Min == Other.Min && Max == Other.Max;
+		}
+
+		friend uint32 GetTypeHash(const FCellBox& CellBox)
+		{
+			return HashCombineFast(GetTypeHash(CellBox.Min), GetTypeHash(CellBox.Max));
+		}
+	};
+
+	TSet<FCellBox> CellBoxes;
+	double CellSize = 0.0;
+
+	/** Bounds were accumulated with different cell sizes and can't be merged anymore */
+	bool bOverflow = false;
+};
+
 /** 
  * Updates the global distance field for a view.  
  * Typically issues updates for just the newly exposed regions of the volume due to camera movement.
@@ -451,6 +451,14 @@ struct FHairStrandsViewData
 	TArray<FDirectionalLightCullData> VisibleShadowCastingDirectionalLights;
 };
 
+// Macro group assignment of the previous frame, used to keep macro groups (and their voxel/deep shadow allocations) temporally stable
+struct FHairStrandsMacroGroupHistory
+{
+	void Reset() { Assignments.Reset(); }
+
+	TMap<uint64, uint32> Assignments; // Primitive key (FHairGroupPublicData::GetUniqueId) -> macro group index
+};
+
 // View State data (i.e., persistent across frame)
 struct FHairStrandsViewStateData
 {
@@ -470,6 +478,9 @@ struct FHairStrandsViewStateData
 	void EnqueuePositionsChanged(FRDGBuilder& GraphBuilder, FRDGBufferRef InBuffer);
 	bool ReadPositionsChanged();
 	TArray<FPositionChangedData> PositionsChangedDatas;
+
+	// Macro group assignment of the previous frame
+	FHairStrandsMacroGroupHistory MacroGroupHistory;
 };
 
 namespace HairStrands
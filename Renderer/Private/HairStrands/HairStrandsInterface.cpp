@@ -275,7 +275,9 @@ bool FHairInstanceCullingResults::IsVisibleInAnyViews(const FHairStrandsInstance
 
 FHairGroupPublicData::FHairGroupPublicData(uint32 InGroupIndex, const FName& InOwnerName)
 {
+	static std::atomic<uint64> NextUniqueId(1);
 	GroupIndex = InGroupIndex;
+	UniqueId = NextUniqueId.fetch_add(1, std::memory_order_relaxed);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
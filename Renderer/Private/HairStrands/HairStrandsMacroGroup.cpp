@@ -110,19 +110,6 @@ static void AddHairMacroGroupAABBPass(
 		FIntVector(1, 1, 1));
 }
 
-static bool DoesGroupExists(uint32 ResourceId, uint32 GroupIndex, const FHairStrandsMacroGroupData::TPrimitiveInfos& PrimitivesGroups)
-{
-	// Simple linear search as the expected number of groups is supposed to be low (<16, see FHairStrandsMacroGroupData::MaxMacroGroupCount)
-	for (const FHairStrandsMacroGroupData::PrimitiveInfo& Group : PrimitivesGroups)
-	{
-		if (Group.GroupIndex == GroupIndex && Group.ResourceId == ResourceId)
-		{
-			return true;
-		}
-	}
-	return false;
-}
-
 bool IsHairStrandsNonVisibleShadowCastingEnable();
 
 static void InternalUpdateMacroGroup(FHairStrandsMacroGroupData& MacroGroup, int32& MaterialId, FHairGroupPublicData* HairData, const FMeshBatch* Mesh, const FPrimitiveSceneProxy* Proxy)
@@ -147,13 +134,318 @@ static void InternalUpdateMacroGroup(FHairStrandsMacroGroupData& MacroGroup, int
 	}
 }
 
+namespace HairStrands
+{
+
+static bool DoMacroGroupBoundsIntersect(const FBoxSphereBounds& A, const FBoxSphereBounds& B)
+{
+	const FSphere SphereA = A.GetSphere();
+	const FSphere SphereB = B.GetSphere();
+
+	const float DistCenters = (SphereA.Center - SphereB.Center).Size();
+	const float AccumRadius = FMath::Max(0.f, SphereA.W + SphereB.W);
+	return DistCenters <= AccumRadius;
+}
+
+static double GetMacroGroupVolume(const FBoxSphereBounds& Bounds)
+{
+	// Clamp extents so that flat/degenerated bounds still have a volume to compare against
+	const FVector Size = (Bounds.BoxExtent * 2.0).ComponentMax(FVector(1.0));
+	return Size.X * Size.Y * Size.Z;
+}
+
+uint32 ClusterMacroGroups(
+	TConstArrayView<FBoxSphereBounds> PrimitiveBounds,
+	TConstArrayView<uint64> PrimitiveKeys,
+	uint32 MaxGroupCount,
+	FHairStrandsMacroGroupHistory* History,
+	TArray<uint32, SceneRenderingAllocator>& OutGroupIndices,
+	TArray<FBoxSphereBounds, SceneRenderingAllocator>& OutGroupBounds)
+{
+	check(PrimitiveBounds.Num() == PrimitiveKeys.Num());
+	check(MaxGroupCount > 0);
+
+	const int32 PrimitiveCount = PrimitiveBounds.Num();
+	OutGroupIndices.SetNumUninitialized(PrimitiveCount);
+	OutGroupBounds.Reset();
+
+	struct FCluster
+	{
+		FBoxSphereBounds Bounds;
+		double Volume = 0;
+		int32 FirstPrimitive = INDEX_NONE;
+		int32 Parent = INDEX_NONE; // Cluster this one has been merged into
+		uint32 Version = 0;
+	};
+	TArray<FCluster, SceneRenderingAllocator> Clusters;
+	Clusters.SetNum(PrimitiveCount);
+	for (int32 PrimitiveIndex = 0; PrimitiveIndex < PrimitiveCount; ++PrimitiveIndex)
+	{
+		Clusters[PrimitiveIndex].Bounds = PrimitiveBounds[PrimitiveIndex];
+		Clusters[PrimitiveIndex].FirstPrimitive = PrimitiveIndex;
+	}
+
+	auto FindRoot = [&Clusters](int32 ClusterIndex)
+	{
+		while (Clusters[ClusterIndex].Parent != INDEX_NONE)
+		{
+			ClusterIndex = Clusters[ClusterIndex].Parent;
+		}
+		return ClusterIndex;
+	};
+
+	// Merge B into A, the lowest index is kept as representative for determinism. Returns the representative.
+	auto MergeClusters = [&Clusters](int32 A, int32 B)
+	{
+		if (B < A)
+		{
+			Swap(A, B);
+		}
+		FCluster& ClusterA = Clusters[A];
+		FCluster& ClusterB = Clusters[B];
+		ClusterA.Bounds = Union(ClusterA.Bounds, ClusterB.Bounds);
+		ClusterA.Volume = GetMacroGroupVolume(ClusterA.Bounds);
+		ClusterA.FirstPrimitive = FMath::Min(ClusterA.FirstPrimitive, ClusterB.FirstPrimitive);
+		++ClusterA.Version;
+		ClusterB.Parent = A;
+		return A;
+	};
+
+	TArray<int32, SceneRenderingAllocator> ActiveClusters;
+	ActiveClusters.Reserve(PrimitiveCount);
+	for (int32 ClusterIndex = 0; ClusterIndex < PrimitiveCount; ++ClusterIndex)
+	{
+		ActiveClusters.Add(ClusterIndex);
+	}
+
+	// 1. Merge intersecting clusters. Unions can intersect clusters their members didn't, so sweep until nothing merges.
+	TArray<int32, SceneRenderingAllocator> SweepOrder;
+	for (bool bMerged = true; bMerged && ActiveClusters.Num() > 1;)
+	{
+		bMerged = false;
+
+		SweepOrder = ActiveClusters;
+		SweepOrder.Sort([&Clusters](int32 A, int32 B)
+		{
+			const FSphere SphereA = Clusters[A].Bounds.GetSphere();
+			const FSphere SphereB = Clusters[B].Bounds.GetSphere();
+			return SphereA.Center.X - SphereA.W < SphereB.Center.X - SphereB.W;
+		});
+
+		// Sweep and prune along X, a cluster merged in this pass is tested through its representative
+		for (int32 SweepIndex = 0; SweepIndex < SweepOrder.Num(); ++SweepIndex)
+		{
+			const int32 A = SweepOrder[SweepIndex];
+			const FSphere SphereA = Clusters[A].Bounds.GetSphere();
+			for (int32 OtherIndex = SweepIndex + 1; OtherIndex < SweepOrder.Num(); ++OtherIndex)
+			{
+				const int32 B = SweepOrder[OtherIndex];
+				const FSphere SphereB = Clusters[B].Bounds.GetSphere();
+				if (SphereB.Center.X - SphereB.W > SphereA.Center.X + SphereA.W)
+				{
+					break;
+				}
+
+				const int32 RootA = FindRoot(A);
+				const int32 RootB = FindRoot(B);
+				if (RootA != RootB && DoMacroGroupBoundsIntersect(Clusters[A].Bounds, Clusters[B].Bounds))
+				{
+					MergeClusters(RootA, RootB);
+					bMerged = true;
+				}
+			}
+		}
+
+		ActiveClusters.RemoveAll([&Clusters](int32 ClusterIndex) { return Clusters[ClusterIndex].Parent != INDEX_NONE; });
+	}
+
+	// 2. While over budget, merge the pair of clusters with the smallest increase of union volume, intersecting pairs first.
+	// Candidate pairs are kept in a heap and discarded lazily once one of their clusters has changed.
+	for (int32 ClusterIndex : ActiveClusters)
+	{
+		Clusters[ClusterIndex].Volume = GetMacroGroupVolume(Clusters[ClusterIndex].Bounds);
+	}
+
+	int32 ClusterCount = ActiveClusters.Num();
+	if (ClusterCount > int32(MaxGroupCount))
+	{
+		struct FMergeCandidate
+		{
+			double Cost;
+			int32 A;
+			int32 B;
+			uint32 VersionA;
+			uint32 VersionB;
+			bool bIntersect;
+
+			bool operator<(const FMergeCandidate& Other) const
+			{
+				// Ties are broken on the cluster indices to keep the result deterministic
+				if (bIntersect != Other.bIntersect) { return bIntersect; }
+				if (Cost != Other.Cost) { return Cost < Other.Cost; }
+				if (A != Other.A) { return A < Other.A; }
+				return B < Other.B;
+			}
+		};
+
+		auto MakeCandidate = [&Clusters](int32 A, int32 B)
+		{
+			const FCluster& ClusterA = Clusters[A];
+			const FCluster& ClusterB = Clusters[B];
+			const double Cost = GetMacroGroupVolume(Union(ClusterA.Bounds, ClusterB.Bounds)) - ClusterA.Volume - ClusterB.Volume;
+			return FMergeCandidate{ Cost, FMath::Min(A, B), FMath::Max(A, B), Clusters[FMath::Min(A, B)].Version, Clusters[FMath::Max(A, B)].Version, DoMacroGroupBoundsIntersect(ClusterA.Bounds, ClusterB.Bounds) };
+		};
+
+		TArray<FMergeCandidate, SceneRenderingAllocator> Candidates;
+		Candidates.Reserve(ClusterCount * (ClusterCount - 1) / 2);
+		for (int32 IndexA = 0; IndexA < ActiveClusters.Num(); ++IndexA)
+		{
+			for (int32 IndexB = IndexA + 1; IndexB < ActiveClusters.Num(); ++IndexB)
+			{
+				Candidates.Add(MakeCandidate(ActiveClusters[IndexA], ActiveClusters[IndexB]));
+			}
+		}
+		Candidates.Heapify();
+
+		while (ClusterCount > 1 && Candidates.Num() > 0)
+		{
+			if (ClusterCount <= int32(MaxGroupCount) && !Candidates.HeapTop().bIntersect)
+			{
+				break;
+			}
+
+			FMergeCandidate Candidate;
+			Candidates.HeapPop(Candidate, EAllowShrinking::No);
+			const FCluster& ClusterA = Clusters[Candidate.A];
+			const FCluster& ClusterB = Clusters[Candidate.B];
+			if (ClusterA.Parent != INDEX_NONE || ClusterB.Parent != INDEX_NONE || ClusterA.Version != Candidate.VersionA || ClusterB.Version != Candidate.VersionB)
+			{
+				continue;
+			}
+
+			const int32 Merged = MergeClusters(Candidate.A, Candidate.B);
+			--ClusterCount;
+
+			for (int32 ClusterIndex : ActiveClusters)
+			{
+				if (ClusterIndex != Merged && Clusters[ClusterIndex].Parent == INDEX_NONE)
+				{
+					Candidates.HeapPush(MakeCandidate(Merged, ClusterIndex));
+				}
+			}
+		}
+
+		ActiveClusters.RemoveAll([&Clusters](int32 ClusterIndex) { return Clusters[ClusterIndex].Parent != INDEX_NONE; });
+	}
+	check(ClusterCount == ActiveClusters.Num());
+
+	// 3. Map the clusters to the previous frame's groups, by number of primitives they have in common. Clusters keep the
+	// index of the previous group they share the most primitives with, so voxel/deep shadow allocations don't move around.
+	TArray<int32, SceneRenderingAllocator> PrimitiveClusters;
+	PrimitiveClusters.SetNumUninitialized(PrimitiveCount);
+	for (int32 PrimitiveIndex = 0; PrimitiveIndex < PrimitiveCount; ++PrimitiveIndex)
+	{
+		PrimitiveClusters[PrimitiveIndex] = FindRoot(PrimitiveIndex);
+	}
+
+	TArray<int32, SceneRenderingAllocator> ClusterToGroup;
+	ClusterToGroup.Init(INDEX_NONE, Clusters.Num());
+	TArray<int32, SceneRenderingAllocator> GroupToCluster;
+	GroupToCluster.Init(INDEX_NONE, ClusterCount);
+
+	if (History && History->Assignments.Num() > 0)
+	{
+		// (Cluster, previous group) -> number of shared primitives
+		TMap<uint64, int32, SceneRenderingSetAllocator> SharedCounts;
+		for (int32 PrimitiveIndex = 0; PrimitiveIndex < PrimitiveCount; ++PrimitiveIndex)
+		{
+			const uint32* PreviousGroupIndex = History->Assignments.Find(PrimitiveKeys[PrimitiveIndex]);
+			if (PreviousGroupIndex && int32(*PreviousGroupIndex) < ClusterCount)
+			{
+				++SharedCounts.FindOrAdd((uint64(PrimitiveClusters[PrimitiveIndex]) << 32) | *PreviousGroupIndex);
+			}
+		}
+
+		struct FGroupMatch
+		{
+			int32 SharedCount;
+			int32 ClusterIndex;
+			int32 PreviousGroupIndex;
+		};
+		TArray<FGroupMatch, SceneRenderingAllocator> Matches;
+		Matches.Reserve(SharedCounts.Num());
+		for (const TPair<uint64, int32>& SharedCount : SharedCounts)
+		{
+			Matches.Add({ SharedCount.Value, int32(SharedCount.Key >> 32), int32(SharedCount.Key & 0xFFFFFFFFu) });
+		}
+		Matches.Sort([](const FGroupMatch& A, const FGroupMatch& B)
+		{
+			if (A.SharedCount != B.SharedCount) { return A.SharedCount > B.SharedCount; }
+			if (A.ClusterIndex != B.ClusterIndex) { return A.ClusterIndex < B.ClusterIndex; }
+			return A.PreviousGroupIndex < B.PreviousGroupIndex;
+		});
+
+		for (const FGroupMatch& Match : Matches)
+		{
+			if (ClusterToGroup[Match.ClusterIndex] == INDEX_NONE && GroupToCluster[Match.PreviousGroupIndex] == INDEX_NONE)
+			{
+				ClusterToGroup[Match.ClusterIndex] = Match.PreviousGroupIndex;
+				GroupToCluster[Match.PreviousGroupIndex] = Match.ClusterIndex;
+			}
+		}
+	}
+
+	// New clusters take the free group indices, in primitive order
+	ActiveClusters.Sort([&Clusters](int32 A, int32 B) { return Clusters[A].FirstPrimitive < Clusters[B].FirstPrimitive; });
+	int32 FreeGroupIndex = 0;
+	for (int32 ClusterIndex : ActiveClusters)
+	{
+		if (ClusterToGroup[ClusterIndex] != INDEX_NONE)
+		{
+			continue;
+		}
+		while (GroupToCluster[FreeGroupIndex] != INDEX_NONE)
+		{
+			++FreeGroupIndex;
+		}
+		GroupToCluster[FreeGroupIndex] = ClusterIndex;
+		ClusterToGroup[ClusterIndex] = FreeGroupIndex;
+	}
+
+	OutGroupBounds.SetNumUninitialized(ClusterCount);
+	for (int32 GroupIndex = 0; GroupIndex < ClusterCount; ++GroupIndex)
+	{
+		OutGroupBounds[GroupIndex] = Clusters[GroupToCluster[GroupIndex]].Bounds;
+	}
+
+	for (int32 PrimitiveIndex = 0; PrimitiveIndex < PrimitiveCount; ++PrimitiveIndex)
+	{
+		OutGroupIndices[PrimitiveIndex] = uint32(ClusterToGroup[PrimitiveClusters[PrimitiveIndex]]);
+	}
+
+	// 4. Record the assignment for the next frame
+	if (History)
+	{
+		History->Assignments.Reset();
+		for (int32 PrimitiveIndex = 0; PrimitiveIndex < PrimitiveCount; ++PrimitiveIndex)
+		{
+			History->Assignments.Add(PrimitiveKeys[PrimitiveIndex], OutGroupIndices[PrimitiveIndex]);
+		}
+	}
+
+	return uint32(ClusterCount);
+}
+
+} // namespace HairStrands
+
 void CreateHairStrandsMacroGroups(
 	FRDGBuilder& GraphBuilder,
 	const FScene* Scene,
 	const FViewInfo& View, 
 	const FHairInstanceCullingResults& CullingResults,
 	FHairStrandsViewData& OutHairStrandsViewData,
-	bool bBuildGPUAABB)
+	bool bBuildGPUAABB,
+	FHairStrandsMacroGroupHistory* History)
 {
 	const bool bHasHairStrandsElements = View.HairStrandsMeshElements.Num() != 0 || Scene->HairStrandsSceneData.RegisteredProxies.Num() != 0;
 	if (!View.Family || !bHasHairStrandsElements || View.bIsReflectionCapture)
@@ -163,11 +455,19 @@ void CreateHairStrandsMacroGroups(
 
 	TArray<FHairStrandsMacroGroupData, SceneRenderingAllocator>& MacroGroups = OutHairStrandsViewData.MacroGroupDatas;
 
-	int32 MaterialId = 0;
-
 	// Aggregate all hair primitives within the same area into macro groups, for allocating/rendering DOM/voxel
-	uint32 MacroGroupId = 0;
-	auto UpdateMacroGroup = [&MacroGroups, &MacroGroupId, &MaterialId](FHairGroupPublicData* HairData, const FMeshBatch* Mesh,  const FPrimitiveSceneProxy* Proxy, const FBoxSphereBounds& Bounds)
+	struct FMacroGroupPrimitive
+	{
+		FHairGroupPublicData* HairData = nullptr;
+		const FMeshBatch* Mesh = nullptr;
+		const FPrimitiveSceneProxy* Proxy = nullptr;
+	};
+	TArray<FMacroGroupPrimitive, SceneRenderingAllocator> Primitives;
+	TArray<FBoxSphereBounds, SceneRenderingAllocator> PrimitiveBounds;
+	TArray<uint64, SceneRenderingAllocator> PrimitiveKeys;
+	TSet<const FHairGroupPublicData*, DefaultKeyFuncs<const FHairGroupPublicData*>, SceneRenderingSetAllocator> AddedHairData;
+
+	auto AddPrimitive = [&](FHairGroupPublicData* HairData, const FMeshBatch* Mesh, const FPrimitiveSceneProxy* Proxy, const FBoxSphereBounds& Bounds)
 	{
 		check(HairData);
 
@@ -176,62 +476,20 @@ void CreateHairStrandsMacroGroups(
 		if (!bIsValid)
 			return;
 
+		// An instance is only added once, even if it is both visible and shadow visible
+		bool bAlreadyAdded = false;
+		AddedHairData.Add(HairData, &bAlreadyAdded);
+		if (bAlreadyAdded)
+			return;
+
 		const FBoxSphereBounds& OriginalPrimitiveBounds = Proxy ? Proxy->GetBounds() : Bounds;
 
 		// Expand hair bound by (half) the groom's max hair-length, to be sure that the bounds are large enough. 
 		// This is important as the primary visibility memory allocation is based on the screen-projection of this CPU bound.
 		// If the bound is too small, the allocation won't be enough, resulting in tile artifacts.
-		FBoxSphereBounds PrimitiveBounds = OriginalPrimitiveBounds.ExpandBy(HairData->VFInput.Strands.Common.Length * 0.5f);
-
-		bool bFound = false;
-		float MinDistance = FLT_MAX;
-		uint32 ClosestMacroGroupId = ~0u;
-		for (FHairStrandsMacroGroupData& MacroGroup : MacroGroups)
-		{
-			const FSphere MacroSphere = MacroGroup.Bounds.GetSphere();
-			const FSphere PrimSphere = PrimitiveBounds.GetSphere();
-
-			const float DistCenters = (MacroSphere.Center - PrimSphere.Center).Size();
-			const float AccumRadius = FMath::Max(0.f, MacroSphere.W + PrimSphere.W);
-			const bool bIntersect = DistCenters <= AccumRadius;
-			
-			if (bIntersect)
-			{
-				MacroGroup.Bounds = Union(MacroGroup.Bounds, PrimitiveBounds);
-
-				InternalUpdateMacroGroup(MacroGroup, MaterialId, HairData, Mesh, Proxy);
-				bFound = true;
-				break;
-			}
-
-			const float MacroToPrimDistance = DistCenters - AccumRadius;
-			if (MacroToPrimDistance < MinDistance)
-			{
-				MinDistance = MacroToPrimDistance;
-				ClosestMacroGroupId = MacroGroup.MacroGroupId;
-			}
-		}
-
-		if (!bFound)
-		{
-			// If we have reached the max number of macro group (MAX_HAIR_MACROGROUP_COUNT), then merge the current one with the closest one.
-			if (MacroGroups.Num() == FHairStrandsMacroGroupData::MaxMacroGroupCount)
-			{
-				check(ClosestMacroGroupId != ~0u);
-				FHairStrandsMacroGroupData& MacroGroup = MacroGroups[ClosestMacroGroupId];
-				check(MacroGroup.MacroGroupId == ClosestMacroGroupId);
-				MacroGroup.Bounds = Union(MacroGroup.Bounds, PrimitiveBounds);
-				InternalUpdateMacroGroup(MacroGroup, MaterialId, HairData, Mesh, Proxy);
-			}
-			else
-			{
-				FHairStrandsMacroGroupData MacroGroup;
-				MacroGroup.MacroGroupId = MacroGroupId++;
-				InternalUpdateMacroGroup(MacroGroup, MaterialId, HairData, Mesh, Proxy);
-				MacroGroup.Bounds = PrimitiveBounds;
-				MacroGroups.Add(MacroGroup);
-			}
-		}
+		PrimitiveBounds.Add(OriginalPrimitiveBounds.ExpandBy(HairData->VFInput.Strands.Common.Length * 0.5f));
+		PrimitiveKeys.Add(HairData->GetUniqueId());
+		Primitives.Add({ HairData, Mesh, Proxy });
 	};
 
 	// 0. Pre-sort visible instances by register index to get stable macro-groups
@@ -258,7 +516,7 @@ void CreateHairStrandsMacroGroups(
 	static FBoxSphereBounds EmptyBound(ForceInit);
 	for (FVisibleBatch& VisibleBatch : VisibleBatches)
 	{
-		UpdateMacroGroup(VisibleBatch.HairData, VisibleBatch.Batch->Mesh, VisibleBatch.Batch->PrimitiveSceneProxy, EmptyBound);
+		AddPrimitive(VisibleBatch.HairData, VisibleBatch.Batch->Mesh, VisibleBatch.Batch->PrimitiveSceneProxy, EmptyBound);
 	}
 
 	// 2. Add all hair-strands instances which are non-visible in primary view(s) but visible in shadow view(s)
@@ -268,11 +526,30 @@ void CreateHairStrandsMacroGroups(
 		{
 			if (Instance && CullingResults.Is(View, *Instance, EHairInstanceVisibilityType::StrandsShadowView))
 			{
-				UpdateMacroGroup(const_cast<FHairGroupPublicData*>(Instance->GetHairData()), nullptr, nullptr, Instance->GetBounds());
+				AddPrimitive(const_cast<FHairGroupPublicData*>(Instance->GetHairData()), nullptr, nullptr, Instance->GetBounds());
 			}
 		}
 	}
 
+	// 3. Cluster the primitives into macro groups
+	TArray<uint32, SceneRenderingAllocator> PrimitiveGroupIndices;
+	TArray<FBoxSphereBounds, SceneRenderingAllocator> GroupBounds;
+	const uint32 NumMacroGroups = HairStrands::ClusterMacroGroups(PrimitiveBounds, PrimitiveKeys, FHairStrandsMacroGroupData::MaxMacroGroupCount, History, PrimitiveGroupIndices, GroupBounds);
+
+	MacroGroups.SetNum(NumMacroGroups);
+	for (uint32 MacroGroupId = 0; MacroGroupId < NumMacroGroups; ++MacroGroupId)
+	{
+		MacroGroups[MacroGroupId].MacroGroupId = MacroGroupId;
+		MacroGroups[MacroGroupId].Bounds = GroupBounds[MacroGroupId];
+	}
+
+	int32 MaterialId = 0;
+	for (int32 PrimitiveIndex = 0; PrimitiveIndex < Primitives.Num(); ++PrimitiveIndex)
+	{
+		const FMacroGroupPrimitive& Primitive = Primitives[PrimitiveIndex];
+		InternalUpdateMacroGroup(MacroGroups[PrimitiveGroupIndices[PrimitiveIndex]], MaterialId, Primitive.HairData, Primitive.Mesh, Primitive.Proxy);
+	}
+
 	// Compute the screen size of macro group projection, for allocation purpose
 	for (FHairStrandsMacroGroupData& MacroGroup : MacroGroups)
 	{
@@ -13,6 +13,7 @@
 class FScene;
 class FViewInfo;
 struct FHairStrandsViewData;
+struct FHairStrandsMacroGroupHistory;
 
 void CreateHairStrandsMacroGroups(
 	FRDGBuilder& GraphBuilder,
@@ -20,4 +21,22 @@ void CreateHairStrandsMacroGroups(
 	const FViewInfo& View, 
 	const FHairInstanceCullingResults& CullingResults,
 	FHairStrandsViewData& OutHairStrandsViewData,
-	bool bBuildGPUAABB=true);
\ No newline at end of file
+	bool bBuildGPUAABB=true,
+	FHairStrandsMacroGroupHistory* History=nullptr);
+
+namespace HairStrands
+{
+	/**
+	 * Cluster primitive bounds into at most MaxGroupCount macro groups. Primitives with intersecting bounds end up in the same group,
+	 * and groups are then merged by smallest increase of union volume until the count fits. Clustering doesn't depend on History:
+	 * it is only used (and updated) to give each group the index of the previous group it shares the most primitives with.
+	 * PrimitiveKeys must not be reused by another primitive across frames. Returns the number of groups.
+	 */
+	uint32 ClusterMacroGroups(
+		TConstArrayView<FBoxSphereBounds> PrimitiveBounds,
+		TConstArrayView<uint64> PrimitiveKeys,
+		uint32 MaxGroupCount,
+		FHairStrandsMacroGroupHistory* History,
+		TArray<uint32, SceneRenderingAllocator>& OutGroupIndices,
+		TArray<FBoxSphereBounds, SceneRenderingAllocator>& OutGroupBounds);
+}
\ No newline at end of file
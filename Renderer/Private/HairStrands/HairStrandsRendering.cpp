@@ -173,7 +173,7 @@ void RenderHairPrePass(
 			View.ViewState->HairStrandsViewStateData.Init();
 		}
 
-		CreateHairStrandsMacroGroups(GraphBuilder, Scene, View, CullingResults, View.HairStrandsViewData);
+		CreateHairStrandsMacroGroups(GraphBuilder, Scene, View, CullingResults, View.HairStrandsViewData, true /*bBuildGPUAABB*/, View.ViewState ? &View.ViewState->HairStrandsViewStateData.MacroGroupHistory : nullptr);
 
 		// Voxelization and Deep Opacity Maps
 		VoxelizeHairStrands(GraphBuilder, Scene, View, InstanceCullingManager, PreViewStereoCorrection);
@@ -268,6 +268,8 @@ void FHairStrandsViewStateData::Release()
 		Data.bHasPendingReadback = false;
 	}
 	PositionsChangedDatas.Empty();
+
+	MacroGroupHistory.Reset();
 }
 
 void FHairStrandsViewStateData::EnqueuePositionsChanged(FRDGBuilder& GraphBuilder, FRDGBufferRef InBuffer)
@@ -17,12 +17,14 @@
 #include "InstanceCullingLoadBalancer.h"
 #include "InstanceCullingMergedContext.h"
 #include "InstanceCullingOcclusionQuery.h"
+#include "InstanceCullingSetupCache.h"
 #include "RenderCore.h"
 #include "MeshDrawCommandStats.h"
 #include "UnrealEngine.h"
 #include "RHIBreadcrumbs.h"
 #include "Materials/MaterialRenderProxy.h"
 #include "ViewData.h"
+#include "Async/ParallelFor.h"
 
 static TAutoConsoleVariable<int32> CVarCullInstances(
 	TEXT("r.CullInstances"),
@@ -50,6 +52,20 @@ static FAutoConsoleVariableRef CVarInstanceCullingAllowOrderPreservation(
 	TEXT("Whether or not to allow instances to preserve instance draw order using GPU compaction."),
 	ECVF_RenderThreadSafe);
 
+static int32 GInstanceCullingParallelSetupDrawCommands = 1;
+static FAutoConsoleVariableRef CVarInstanceCullingParallelSetupDrawCommands(
+	TEXT("r.InstanceCulling.ParallelSetupDrawCommands"),
+	GInstanceCullingParallelSetupDrawCommands,
+	TEXT("Whether to process the visible mesh draw commands in parallel chunks in SetupDrawCommands (only used when the GPU-Scene does not use uniform buffer views)."),
+	ECVF_RenderThreadSafe);
+
+static int32 GInstanceCullingParallelSetupDrawCommandsChunkSize = 2048;
+static FAutoConsoleVariableRef CVarInstanceCullingParallelSetupDrawCommandsChunkSize(
+	TEXT("r.InstanceCulling.ParallelSetupDrawCommands.ChunkSize"),
+	GInstanceCullingParallelSetupDrawCommandsChunkSize,
+	TEXT("Number of visible mesh draw commands processed per task by the parallel SetupDrawCommands, passes with fewer than two chunks are processed serially."),
+	ECVF_RenderThreadSafe);
+
 IMPLEMENT_STATIC_UNIFORM_BUFFER_SLOT(InstanceCullingUbSlot);
 IMPLEMENT_STATIC_UNIFORM_BUFFER_STRUCT(FInstanceCullingGlobalUniforms, "InstanceCulling", InstanceCullingUbSlot);
 
@@ -246,7 +262,7 @@ bool FInstanceCullingContext::IsInstanceOrderPreservationEnabled() const
 	return IsInstanceOrderPreservationAllowed(ShaderPlatform) && !EnumHasAnyFlags(Flags, EInstanceCullingFlags::NoInstanceOrderPreservation);
 }
 
-uint32 FInstanceCullingContext::AllocateIndirectArgs(const FMeshDrawCommand *MeshDrawCommand)
+static bool GetDrawIndexedIndirectArgs(const FMeshDrawCommand* MeshDrawCommand, FRHIDrawIndexedIndirectParameters& OutIndirectArgs)
 {
 	const uint32 NumPrimitives = MeshDrawCommand->NumPrimitives;
 	if (ensure(MeshDrawCommand->PrimitiveType < PT_Num))
@@ -271,7 +287,18 @@ uint32 FInstanceCullingContext::AllocateIndirectArgs(const FMeshDrawCommand *Mes
 			break;
 		}
 
-		return IndirectArgs.Emplace(FRHIDrawIndexedIndirectParameters{ NumVerticesOrIndices, 0U, MeshDrawCommand->FirstIndex, int32(MeshDrawCommand->VertexParams.BaseVertexIndex), 0U });
+		OutIndirectArgs = FRHIDrawIndexedIndirectParameters{ NumVerticesOrIndices, 0U, MeshDrawCommand->FirstIndex, int32(MeshDrawCommand->VertexParams.BaseVertexIndex), 0U };
+		return true;
+	}
+	return false;
+}
+
+uint32 FInstanceCullingContext::AllocateIndirectArgs(const FMeshDrawCommand *MeshDrawCommand)
+{
+	FRHIDrawIndexedIndirectParameters DrawIndirectArgs;
+	if (GetDrawIndexedIndirectArgs(MeshDrawCommand, DrawIndirectArgs))
+	{
+		return IndirectArgs.Emplace(DrawIndirectArgs);
 	}
 	return 0U;
 }
@@ -401,6 +428,29 @@ void FInstanceCullingContext::AddInstanceRunsToDrawCommand(uint32 IndirectArgsOf
 }
 
 
+void FInstanceCullingContext::AddCompactionData(uint32 IndirectArgsOffset, uint32 InstanceIdOffset, uint32 NumInstancesAdded)
+{
+	const uint32 NumViews = ViewIds.Num();
+	const uint32 CompactionDataIndex = uint32(DrawCommandCompactionData.Num());
+	DrawCommandCompactionData.Emplace(
+		NumInstancesAdded,
+		NumViews,
+		uint32(CompactionBlockDataIndices.Num()),
+		IndirectArgsOffset,
+		NumCompactionInstances,
+		InstanceIdOffset);
+
+	const int32 FirstBlock = CompactionBlockDataIndices.Num();
+	const uint32 NumCompactionBlocksThisCommand = FMath::DivideAndRoundUp(NumInstancesAdded, CompactionBlockNumInstances);
+	CompactionBlockDataIndices.AddUninitialized(NumCompactionBlocksThisCommand);
+	for (int32 Block = FirstBlock; Block < CompactionBlockDataIndices.Num(); ++Block)
+	{
+		CompactionBlockDataIndices[Block] = CompactionDataIndex;
+	}
+
+	NumCompactionInstances += NumInstancesAdded * NumViews;
+}
+
 // Base class that provides common functionality between all compaction phases
 class FCompactVisibleInstancesBaseCs : public FGlobalShader
 {
@@ -1434,7 +1484,8 @@ void FInstanceCullingContext::SetupDrawCommands(
 	// Stats
 	int32& MaxInstances,
 	int32& VisibleMeshDrawCommandsNum,
-	int32& NewPassVisibleMeshDrawCommandsNum)
+	int32& NewPassVisibleMeshDrawCommandsNum,
+	FInstanceCullingSetupCacheEntry* SetupCacheEntry)
 {
 	QUICK_SCOPE_CYCLE_COUNTER(STAT_BuildMeshDrawCommandPrimitiveIdBuffer);
 
@@ -1470,6 +1521,50 @@ void FInstanceCullingContext::SetupDrawCommands(
 #endif
 	}
 
+	TArray<int32>* RetainedCommands = nullptr;
+	if (SetupCacheEntry != nullptr)
+	{
+		// Stereo contexts may carry load balancer state across setups, so never cache them.
+		FInstanceCullingSetupCacheEntry::FConfigKey ConfigKey;
+		ConfigKey.NumViews = ViewIds.Num();
+		ConfigKey.SingleInstanceProcessingMode = uint8(SingleInstanceProcessingMode);
+		ConfigKey.bCompactIdenticalCommands = bInCompactIdenticalCommands;
+		ConfigKey.bOrderPreservationEnabled = IsInstanceOrderPreservationEnabled();
+		ConfigKey.bForceInstanceCulling = GOcclusionForceInstanceCulling != 0;
+
+		if (InstanceCullingMode != EInstanceCullingMode::Stereo && SetupCacheEntry->BuildPendingKey(VisibleMeshDrawCommandsInOut, Scene, ConfigKey))
+		{
+			if (SetupCacheEntry->Lookup())
+			{
+				VisibleMeshDrawCommandsNum = VisibleMeshDrawCommandsInOut.Num();
+				SetupCacheEntry->Restore(*this, VisibleMeshDrawCommandsInOut, MaxInstances);
+				NewPassVisibleMeshDrawCommandsNum = VisibleMeshDrawCommandsInOut.Num();
+				return;
+			}
+			RetainedCommands = &SetupCacheEntry->RetainedCommands;
+			RetainedCommands->Reset(VisibleMeshDrawCommandsInOut.Num());
+		}
+		else
+		{
+			SetupCacheEntry->Invalidate();
+			SetupCacheEntry = nullptr;
+		}
+	}
+
+	// The uniform buffer view path splits draws into batches based on the running instance count, which makes every command depend on all previous ones.
+	const int32 ParallelChunkSize = FMath::Max(GInstanceCullingParallelSetupDrawCommandsChunkSize, 1);
+	if (GInstanceCullingParallelSetupDrawCommands != 0 && !bUsesUniformBufferView && VisibleMeshDrawCommandsInOut.Num() >= 2 * ParallelChunkSize)
+	{
+		if (SetupDrawCommandsParallel(VisibleMeshDrawCommandsInOut, bInCompactIdenticalCommands, Scene, ParallelChunkSize, MaxInstances, VisibleMeshDrawCommandsNum, NewPassVisibleMeshDrawCommandsNum, RetainedCommands))
+		{
+			if (SetupCacheEntry != nullptr)
+			{
+				SetupCacheEntry->Store(*this, MaxInstances);
+			}
+			return;
+		}
+	}
+
 	int32 CurrentStateBucketId = -1;
 	EMeshDrawCommandCullingPayloadFlags CurrentCullingPayloadFlags = EMeshDrawCommandCullingPayloadFlags::Default;
 	MaxInstances = 1;
@@ -1479,7 +1574,6 @@ void FInstanceCullingContext::SetupDrawCommands(
 	const int32 NumDrawCommandsIn = VisibleMeshDrawCommandsInOut.Num();
 	int32 NumDrawCommandsOut = 0;
 	uint32 CurrentIndirectArgsOffset = 0U;
-	const int32 NumViews = ViewIds.Num();
 	const bool bAlwaysUseIndirectDraws = (SingleInstanceProcessingMode != EBatchProcessingMode::UnCulled);
 	const bool bOrderPreservationEnabled = IsInstanceOrderPreservationEnabled();
 	const uint32 MaxGenericBatchSize = bUsesUniformBufferView ? PLATFORM_MAX_UNIFORM_BUFFER_RANGE / UniformViewInstanceStride[0] : MAX_uint32;
@@ -1572,6 +1666,10 @@ void FInstanceCullingContext::SetupDrawCommands(
 			{
 				PassVisibleMeshDrawCommands[NumDrawCommandsOut] = PassVisibleMeshDrawCommands[DrawCommandIndex];
 			}
+			if (RetainedCommands != nullptr)
+			{
+				RetainedCommands->Add(DrawCommandIndex);
+			}
 			NumDrawCommandsOut++;
 		}
 
@@ -1626,24 +1724,7 @@ void FInstanceCullingContext::SetupDrawCommands(
 			const uint32 NumInstancesAdded = TotalInstances - InstanceOffset;
 			if (bPreserveInstanceOrder && NumInstancesAdded > 0)
 			{
-				const uint32 CompactionDataIndex = uint32(DrawCommandCompactionData.Num());
-				DrawCommandCompactionData.Emplace(
-					NumInstancesAdded,
-					NumViews,
-					uint32(CompactionBlockDataIndices.Num()),
-					CurrentIndirectArgsOffset,
-					NumCompactionInstances,
-					InstanceIdOffsets.Last());
-
-				const int32 FirstBlock = CompactionBlockDataIndices.Num();
-				const uint32 NumCompactionBlocksThisCommand = FMath::DivideAndRoundUp(NumInstancesAdded, CompactionBlockNumInstances);
-				CompactionBlockDataIndices.AddUninitialized(NumCompactionBlocksThisCommand);
-				for (int32 Block = FirstBlock; Block < CompactionBlockDataIndices.Num(); ++Block)
-				{
-					CompactionBlockDataIndices[Block] = CompactionDataIndex;
-				}
-
-				NumCompactionInstances += NumInstancesAdded * NumViews;
+				AddCompactionData(CurrentIndirectArgsOffset, InstanceIdOffsets.Last(), NumInstancesAdded);
 			}
 		}
 	}
@@ -1656,6 +1737,377 @@ void FInstanceCullingContext::SetupDrawCommands(
 
 	// Resize array post-compaction of dynamic instances
 	VisibleMeshDrawCommandsInOut.SetNum(NumDrawCommandsOut, EAllowShrinking::No);
+
+	if (SetupCacheEntry != nullptr)
+	{
+		SetupCacheEntry->Store(*this, MaxInstances);
+	}
+}
+
+/**
+ * Parallel version of SetupDrawCommands, used for large passes when not using uniform buffer views (so there is no batch splitting and each draw is independent).
+ * 1. Each chunk of visible commands is processed in parallel producing chunk-local draw command infos, indirect args, and instance spans.
+ *    Runs of identical state buckets straddling a chunk boundary are recorded as continuations of the previous chunk's last draw.
+ * 2. A serial prefix sum over the chunks produces the global offsets, which are then used to relocate the chunk data in parallel.
+ * 3. The instance spans are fed serially to the load balancers to produce output that is identical to the serial path.
+ * Returns false (without modifying any state) if the serial path must be used instead.
+ */
+bool FInstanceCullingContext::SetupDrawCommandsParallel(
+	FMeshCommandOneFrameArray& VisibleMeshDrawCommandsInOut,
+	bool bInCompactIdenticalCommands,
+	const FScene* Scene,
+	int32 ChunkSize,
+	int32& MaxInstances,
+	int32& VisibleMeshDrawCommandsNum,
+	int32& NewPassVisibleMeshDrawCommandsNum,
+	TArray<int32>* OutRetainedCommands)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FInstanceCullingContext::SetupDrawCommandsParallel);
+
+	check(!bUsesUniformBufferView);
+
+	struct FInstanceSpan
+	{
+		int32 InstanceDataOffset;
+		uint32 RunOffset;
+		uint32 NumInstances;
+		EInstanceFlags InstanceFlags;
+	};
+
+	struct FCommandInstances
+	{
+		// Index into the chunk-local draws, or INDEX_NONE if the instances go to the last draw of the previous chunk(s).
+		int32 LocalDrawIndex;
+		int32 FirstSpan;
+		int32 NumSpans;
+		bool bPreserveInstanceOrder;
+	};
+
+	struct FChunk
+	{
+		TArray<FMeshDrawCommandInfo, SceneRenderingAllocator> DrawCommandInfos;
+		TArray<FRHIDrawIndexedIndirectParameters, SceneRenderingAllocator> IndirectArgs;
+		TArray<uint32, SceneRenderingAllocator> DrawCommandDescs;
+		// Chunk-local instance count at the point each draw was created
+		TArray<uint32, SceneRenderingAllocator> InstanceOffsets;
+		TArray<int32, SceneRenderingAllocator> RetainedCommands;
+		TArray<FCommandInstances, SceneRenderingAllocator> Commands;
+		TArray<FInstanceSpan, SceneRenderingAllocator> Spans;
+
+		int32 FirstCommand = 0;
+		int32 NumCommands = 0;
+		int32 PrevStateBucketId = -1;
+		EMeshDrawCommandCullingPayloadFlags PrevCullingPayloadFlags = EMeshDrawCommandCullingPayloadFlags::Default;
+
+		// Number of leading commands merged into the previous chunk's last draw
+		uint32 NumContinuations = 0U;
+		uint32 NumInstances = 0U;
+		uint32 TrailingAutoInstanceCount = 1U;
+		int32 MaxInstances = 1;
+
+		// Global offsets, computed by the prefix sum
+		int32 DrawOffset = 0;
+		uint32 InstanceOffset = 0U;
+	};
+
+	const FVisibleMeshDrawCommand* RESTRICT PassVisibleMeshDrawCommands = VisibleMeshDrawCommandsInOut.GetData();
+	const int32 NumDrawCommandsIn = VisibleMeshDrawCommandsInOut.Num();
+	const int32 NumChunks = FMath::DivideAndRoundUp(NumDrawCommandsIn, ChunkSize);
+
+	TArray<FChunk, SceneRenderingAllocator> Chunks;
+	Chunks.SetNum(NumChunks);
+	for (int32 ChunkIndex = 0; ChunkIndex < NumChunks; ++ChunkIndex)
+	{
+		FChunk& Chunk = Chunks[ChunkIndex];
+		Chunk.FirstCommand = ChunkIndex * ChunkSize;
+		Chunk.NumCommands = FMath::Min(ChunkSize, NumDrawCommandsIn - Chunk.FirstCommand);
+		if (ChunkIndex > 0)
+		{
+			const FVisibleMeshDrawCommand& PrevVisibleMeshDrawCommand = PassVisibleMeshDrawCommands[Chunk.FirstCommand - 1];
+			Chunk.PrevStateBucketId = PrevVisibleMeshDrawCommand.StateBucketId;
+			Chunk.PrevCullingPayloadFlags = PrevVisibleMeshDrawCommand.CullingPayloadFlags;
+		}
+	}
+
+	const bool bAlwaysUseIndirectDraws = (SingleInstanceProcessingMode != EBatchProcessingMode::UnCulled);
+	const bool bOrderPreservationEnabled = IsInstanceOrderPreservationEnabled();
+	std::atomic<bool> bUnsupportedCommand(false);
+
+	ParallelFor(TEXT("InstanceCulling.SetupDrawCommands"), NumChunks, 1,
+		[&Chunks, PassVisibleMeshDrawCommands, bInCompactIdenticalCommands, bAlwaysUseIndirectDraws, bOrderPreservationEnabled, Scene, &bUnsupportedCommand](int32 ChunkIndex)
+		{
+			FChunk& Chunk = Chunks[ChunkIndex];
+			Chunk.DrawCommandInfos.Reserve(Chunk.NumCommands);
+			Chunk.IndirectArgs.Reserve(Chunk.NumCommands);
+			Chunk.DrawCommandDescs.Reserve(Chunk.NumCommands);
+			Chunk.InstanceOffsets.Reserve(Chunk.NumCommands);
+			Chunk.RetainedCommands.Reserve(Chunk.NumCommands);
+			Chunk.Commands.Reserve(Chunk.NumCommands);
+			Chunk.Spans.Reserve(Chunk.NumCommands);
+
+			// The compaction decision only depends on the previous command (as a dropped command always has the same state bucket as the current one).
+			int32 CurrentStateBucketId = Chunk.PrevStateBucketId;
+			EMeshDrawCommandCullingPayloadFlags CurrentCullingPayloadFlags = Chunk.PrevCullingPayloadFlags;
+			uint32 CurrentAutoInstanceCount = 1;
+
+			for (int32 DrawCommandIndex = Chunk.FirstCommand; DrawCommandIndex < Chunk.FirstCommand + Chunk.NumCommands; ++DrawCommandIndex)
+			{
+				const FVisibleMeshDrawCommand& RESTRICT VisibleMeshDrawCommand = PassVisibleMeshDrawCommands[DrawCommandIndex];
+				const FMeshDrawCommand* RESTRICT MeshDrawCommand = VisibleMeshDrawCommand.MeshDrawCommand;
+
+				const bool bFetchInstanceCountFromScene = EnumHasAnyFlags(VisibleMeshDrawCommand.Flags, EFVisibleMeshDrawCommandFlags::FetchInstanceCountFromScene);
+				check(!bFetchInstanceCountFromScene || Scene != nullptr);
+
+				const bool bSupportsGPUSceneInstancing = EnumHasAnyFlags(VisibleMeshDrawCommand.Flags, EFVisibleMeshDrawCommandFlags::HasPrimitiveIdStreamIndex);
+				const bool bMaterialUsesWorldPositionOffset = EnumHasAnyFlags(VisibleMeshDrawCommand.Flags, EFVisibleMeshDrawCommandFlags::MaterialUsesWorldPositionOffset);
+				const bool bMaterialAlwaysEvaluatesWorldPositionOffset = EnumHasAnyFlags(VisibleMeshDrawCommand.Flags, EFVisibleMeshDrawCommandFlags::MaterialAlwaysEvaluatesWorldPositionOffset);
+				const bool bForceInstanceCulling = EnumHasAnyFlags(VisibleMeshDrawCommand.Flags, EFVisibleMeshDrawCommandFlags::ForceInstanceCulling) || (GOcclusionForceInstanceCulling != 0);
+				const bool bPreserveInstanceOrder = bOrderPreservationEnabled && EnumHasAnyFlags(VisibleMeshDrawCommand.Flags, EFVisibleMeshDrawCommandFlags::PreserveInstanceOrder);
+				const bool bUseIndirectDraw = bFetchInstanceCountFromScene || bAlwaysUseIndirectDraws || bForceInstanceCulling || (VisibleMeshDrawCommand.NumRuns > 0 || MeshDrawCommand->NumInstances > 1);
+				const bool bCompactIdenticalCommands = bInCompactIdenticalCommands && !(bUseIndirectDraw && bPreserveInstanceOrder);
+
+				int32 LocalDrawIndex = Chunk.DrawCommandInfos.Num() - 1;
+				if (bCompactIdenticalCommands && CurrentStateBucketId != -1 && VisibleMeshDrawCommand.StateBucketId == CurrentStateBucketId && VisibleMeshDrawCommand.CullingPayloadFlags == CurrentCullingPayloadFlags)
+				{
+					CurrentAutoInstanceCount++;
+					if (LocalDrawIndex == INDEX_NONE)
+					{
+						// Merged into the last draw of a previous chunk, stitched up after the prefix sum
+						Chunk.NumContinuations++;
+					}
+					else
+					{
+						Chunk.MaxInstances = FMath::Max<int32>(CurrentAutoInstanceCount, Chunk.MaxInstances);
+
+						FMeshDrawCommandInfo& RESTRICT DrawCmd = Chunk.DrawCommandInfos[LocalDrawIndex];
+						if (DrawCmd.bUseIndirect == 0)
+						{
+							DrawCmd.IndirectArgsOffsetOrNumInstances += 1;
+						}
+					}
+				}
+				else
+				{
+					CurrentAutoInstanceCount = 1;
+
+					FRHIDrawIndexedIndirectParameters DrawIndirectArgs;
+					if (!GetDrawIndexedIndirectArgs(MeshDrawCommand, DrawIndirectArgs))
+					{
+						// The serial path does not allocate indirect args for these, which breaks the 1:1 mapping the relocation relies on.
+						bUnsupportedCommand = true;
+						return;
+					}
+
+					// Offsets are chunk-local and relocated after the prefix sum
+					LocalDrawIndex = Chunk.DrawCommandInfos.Num();
+					FMeshDrawCommandInfo& RESTRICT DrawCmd = Chunk.DrawCommandInfos.AddZeroed_GetRef();
+					DrawCmd.NumBatches = 1;
+					DrawCmd.BatchDataStride = PLATFORM_MAX_UNIFORM_BUFFER_RANGE;
+					DrawCmd.bUseIndirect = bUseIndirectDraw;
+					DrawCmd.IndirectArgsOffsetOrNumInstances = bUseIndirectDraw ? LocalDrawIndex : 1;
+
+					Chunk.IndirectArgs.Add(DrawIndirectArgs);
+					Chunk.DrawCommandDescs.Add(
+						PackDrawCommandDesc(
+							bMaterialUsesWorldPositionOffset,
+							bMaterialAlwaysEvaluatesWorldPositionOffset,
+							VisibleMeshDrawCommand.CullingPayload,
+							VisibleMeshDrawCommand.CullingPayloadFlags
+						)
+					);
+					Chunk.InstanceOffsets.Add(Chunk.NumInstances);
+					Chunk.RetainedCommands.Add(DrawCommandIndex);
+
+					CurrentStateBucketId = VisibleMeshDrawCommand.StateBucketId;
+					CurrentCullingPayloadFlags = VisibleMeshDrawCommand.CullingPayloadFlags;
+				}
+
+				if (bSupportsGPUSceneInstancing)
+				{
+					EInstanceFlags InstanceFlags = EInstanceFlags::None;
+					if (VisibleMeshDrawCommand.PrimitiveIdInfo.bIsDynamicPrimitive)
+					{
+						EnumAddFlags(InstanceFlags, EInstanceFlags::DynamicInstanceDataOffset);
+					}
+					if (bForceInstanceCulling)
+					{
+						EnumAddFlags(InstanceFlags, EInstanceFlags::ForceInstanceCulling);
+					}
+					if (bPreserveInstanceOrder)
+					{
+						EnumAddFlags(InstanceFlags, EInstanceFlags::PreserveInstanceOrder);
+					}
+
+					FCommandInstances& Command = Chunk.Commands.AddDefaulted_GetRef();
+					Command.LocalDrawIndex = LocalDrawIndex;
+					Command.FirstSpan = Chunk.Spans.Num();
+					Command.bPreserveInstanceOrder = bPreserveInstanceOrder;
+
+					const int32 InstanceDataOffset = VisibleMeshDrawCommand.PrimitiveIdInfo.InstanceSceneDataOffset;
+					if (VisibleMeshDrawCommand.RunArray)
+					{
+						uint32 NumInstancesInRuns = 0;
+						for (uint32 Index = 0; Index < VisibleMeshDrawCommand.NumRuns; ++Index)
+						{
+							const uint32 RunStart = VisibleMeshDrawCommand.RunArray[Index * 2];
+							const uint32 RunEndIncl = VisibleMeshDrawCommand.RunArray[Index * 2 + 1];
+							const uint32 NumInstances = (RunEndIncl + 1U) - RunStart;
+							Chunk.Spans.Add(FInstanceSpan{ InstanceDataOffset + int32(RunStart), NumInstancesInRuns, NumInstances, InstanceFlags | EInstanceFlags::ForceInstanceCulling });
+							NumInstancesInRuns += NumInstances;
+						}
+					}
+					else if (bFetchInstanceCountFromScene)
+					{
+						check(!VisibleMeshDrawCommand.PrimitiveIdInfo.bIsDynamicPrimitive);
+						const uint32 NumInstances = uint32(Scene->Primitives[VisibleMeshDrawCommand.PrimitiveIdInfo.ScenePrimitiveId]->GetNumInstanceSceneDataEntries());
+						if (NumInstances > 0u)
+						{
+							Chunk.Spans.Add(FInstanceSpan{ InstanceDataOffset, 0U, NumInstances, InstanceFlags });
+						}
+					}
+					else
+					{
+						if (Scene != nullptr)
+						{
+							// Make sure the cached MDC matches what is stored in the scene
+							checkSlow(VisibleMeshDrawCommand.PrimitiveIdInfo.bIsDynamicPrimitive
+								|| VisibleMeshDrawCommand.MeshDrawCommand->NumInstances == uint32(Scene->Primitives[VisibleMeshDrawCommand.PrimitiveIdInfo.ScenePrimitiveId]->GetNumInstanceSceneDataEntries()));
+							checkSlow(!Scene->Primitives[VisibleMeshDrawCommand.PrimitiveIdInfo.ScenePrimitiveId]->Proxy->DoesMeshBatchesUseSceneInstanceCount());
+						}
+						Chunk.Spans.Add(FInstanceSpan{ InstanceDataOffset, 0U, VisibleMeshDrawCommand.MeshDrawCommand->NumInstances, InstanceFlags });
+					}
+
+					Command.NumSpans = Chunk.Spans.Num() - Command.FirstSpan;
+					for (int32 SpanIndex = Command.FirstSpan; SpanIndex < Chunk.Spans.Num(); ++SpanIndex)
+					{
+						Chunk.NumInstances += Chunk.Spans[SpanIndex].NumInstances;
+					}
+				}
+			}
+			Chunk.TrailingAutoInstanceCount = CurrentAutoInstanceCount;
+		});
+
+	if (bUnsupportedCommand)
+	{
+		return false;
+	}
+
+	// Exclusive prefix sum over the chunk sizes, and stitch the auto-instancing stats of the runs straddling chunk boundaries.
+	int32 NumDraws = 0;
+	uint32 NumInstances = 0U;
+	uint32 CurrentAutoInstanceCount = 1U;
+	MaxInstances = 1;
+	for (FChunk& Chunk : Chunks)
+	{
+		Chunk.DrawOffset = NumDraws;
+		Chunk.InstanceOffset = NumInstances;
+		NumDraws += Chunk.DrawCommandInfos.Num();
+		NumInstances += Chunk.NumInstances;
+
+		if (Chunk.NumContinuations > 0U)
+		{
+			check(Chunk.DrawOffset > 0);
+			CurrentAutoInstanceCount += Chunk.NumContinuations;
+			MaxInstances = FMath::Max<int32>(CurrentAutoInstanceCount, MaxInstances);
+		}
+		if (Chunk.DrawCommandInfos.Num() > 0)
+		{
+			CurrentAutoInstanceCount = Chunk.TrailingAutoInstanceCount;
+		}
+		MaxInstances = FMath::Max(Chunk.MaxInstances, MaxInstances);
+	}
+
+	MeshDrawCommandInfos.SetNumUninitialized(NumDraws);
+	IndirectArgs.SetNumUninitialized(NumDraws);
+	DrawCommandDescs.SetNumUninitialized(NumDraws);
+	InstanceIdOffsets.SetNumUninitialized(NumDraws);
+
+	const uint32 NumViews = ViewIds.Num();
+	ParallelFor(TEXT("InstanceCulling.SetupDrawCommands.Relocate"), NumChunks, 1,
+		[this, &Chunks, NumViews](int32 ChunkIndex)
+		{
+			const FChunk& Chunk = Chunks[ChunkIndex];
+			const int32 NumChunkDraws = Chunk.DrawCommandInfos.Num();
+
+			FMemory::Memcpy(IndirectArgs.GetData() + Chunk.DrawOffset, Chunk.IndirectArgs.GetData(), NumChunkDraws * sizeof(FRHIDrawIndexedIndirectParameters));
+			FMemory::Memcpy(DrawCommandDescs.GetData() + Chunk.DrawOffset, Chunk.DrawCommandDescs.GetData(), NumChunkDraws * sizeof(uint32));
+
+			for (int32 LocalDrawIndex = 0; LocalDrawIndex < NumChunkDraws; ++LocalDrawIndex)
+			{
+				const uint32 DrawIndex = uint32(Chunk.DrawOffset + LocalDrawIndex);
+
+				FMeshDrawCommandInfo DrawCmd = Chunk.DrawCommandInfos[LocalDrawIndex];
+				if (DrawCmd.bUseIndirect)
+				{
+					DrawCmd.IndirectArgsOffsetOrNumInstances = DrawIndex * FInstanceCullingContext::IndirectArgsNumWords * sizeof(uint32);
+				}
+				DrawCmd.InstanceDataByteOffset = StepInstanceDataOffsetBytes(DrawIndex);
+				MeshDrawCommandInfos[DrawIndex] = DrawCmd;
+
+				InstanceIdOffsets[DrawIndex] = (Chunk.InstanceOffset + Chunk.InstanceOffsets[LocalDrawIndex]) * NumViews;
+			}
+		});
+
+	// Serial fix-up: commands at the start of a chunk that were merged into the last draw of the previous chunk(s) and move the retained commands to maintain 1:1.
+	FVisibleMeshDrawCommand* RESTRICT OutVisibleMeshDrawCommands = VisibleMeshDrawCommandsInOut.GetData();
+	int32 NumDrawCommandsOut = 0;
+	for (const FChunk& Chunk : Chunks)
+	{
+		if (Chunk.NumContinuations > 0U)
+		{
+			FMeshDrawCommandInfo& RESTRICT DrawCmd = MeshDrawCommandInfos[Chunk.DrawOffset - 1];
+			if (DrawCmd.bUseIndirect == 0)
+			{
+				DrawCmd.IndirectArgsOffsetOrNumInstances += Chunk.NumContinuations;
+			}
+		}
+
+		for (int32 DrawCommandIndex : Chunk.RetainedCommands)
+		{
+			if (DrawCommandIndex > NumDrawCommandsOut)
+			{
+				OutVisibleMeshDrawCommands[NumDrawCommandsOut] = OutVisibleMeshDrawCommands[DrawCommandIndex];
+			}
+			NumDrawCommandsOut++;
+		}
+
+		if (OutRetainedCommands != nullptr)
+		{
+			OutRetainedCommands->Append(Chunk.RetainedCommands);
+		}
+	}
+	check(NumDrawCommandsOut == NumDraws);
+	check(bInCompactIdenticalCommands || NumDrawCommandsIn == NumDrawCommandsOut);
+
+	// Feed the load balancers in command order, which keeps the batch packing, payloads and compaction data identical to the serial path.
+	for (const FChunk& Chunk : Chunks)
+	{
+		for (const FCommandInstances& Command : Chunk.Commands)
+		{
+			const uint32 IndirectArgsOffset = uint32(Command.LocalDrawIndex != INDEX_NONE ? Chunk.DrawOffset + Command.LocalDrawIndex : Chunk.DrawOffset - 1);
+			const uint32 InstanceOffset = TotalInstances;
+
+			for (int32 SpanIndex = Command.FirstSpan; SpanIndex < Command.FirstSpan + Command.NumSpans; ++SpanIndex)
+			{
+				const FInstanceSpan& Span = Chunk.Spans[SpanIndex];
+				AddInstancesToDrawCommand(IndirectArgsOffset, Span.InstanceDataOffset, Span.RunOffset, Span.NumInstances, Span.InstanceFlags);
+			}
+
+			const uint32 NumInstancesAdded = TotalInstances - InstanceOffset;
+			if (Command.bPreserveInstanceOrder && NumInstancesAdded > 0)
+			{
+				AddCompactionData(IndirectArgsOffset, InstanceIdOffsets[IndirectArgsOffset], NumInstancesAdded);
+			}
+		}
+	}
+	check(TotalInstances == NumInstances);
+
+	VisibleMeshDrawCommandsNum = NumDrawCommandsIn;
+	NewPassVisibleMeshDrawCommandsNum = NumDrawCommandsOut;
+
+	VisibleMeshDrawCommandsInOut.SetNum(NumDrawCommandsOut, EAllowShrinking::No);
+
+	return true;
 }
 
 void FInstanceCullingContext::SubmitDrawCommands(
@@ -237,6 +237,54 @@ public:
 		TotalInstances += Other.GetTotalNumInstances();
 	}
 
+	/**
+	 * Size the storage to hold exactly NumBatches/NumItems, to then be filled using CopyDataAt (possibly from several threads).
+	 * NumInstances must be the sum of the instances of all the load balancers that will be copied in.
+	 */
+	void SetNumStorageUninitialized(int32 NumBatches, int32 NumItems, uint32 NumInstances)
+	{
+		check(CurrentBatchNumItems == 0);
+		Data->Batches.SetNumUninitialized(NumBatches);
+		Data->Items.SetNumUninitialized(NumItems);
+		TotalInstances = NumInstances;
+	}
+
+	/**
+	 * Copy the (finalized) data of another load balancer into a range previously sized using SetNumStorageUninitialized.
+	 * Equivalent to AppendData, but does not modify the storage size so disjoint ranges can be written concurrently.
+	 */
+	template <typename OtherAllocatorType>
+	void CopyDataAt(const TInstanceCullingLoadBalancer<OtherAllocatorType>& Other, int32 BatchOffset, int32 ItemOffset)
+	{
+		const auto& OtherBatches = Other.GetBatches();
+		const auto& OtherItems = Other.GetItems();
+		check(BatchOffset + OtherBatches.Num() <= Data->Batches.Num());
+		check(ItemOffset + OtherItems.Num() <= Data->Items.Num());
+
+		FMemory::Memcpy(Data->Batches.GetData() + BatchOffset, OtherBatches.GetData(), OtherBatches.Num() * sizeof(FPackedBatch));
+		FMemory::Memcpy(Data->Items.GetData() + ItemOffset, OtherItems.GetData(), OtherItems.Num() * sizeof(FPackedItem));
+	}
+
+	/**
+	 * Deep copy of the state of another load balancer, the storage is not shared.
+	 */
+	void CopyFrom(const TInstanceCullingLoadBalancer& Other)
+	{
+		Data = new FData;
+		Data->Batches = Other.Data->Batches;
+		Data->Items = Other.Data->Items;
+		CurrentBatchPrefixSum = Other.CurrentBatchPrefixSum;
+		CurrentBatchNumItems = Other.CurrentBatchNumItems;
+		CurrentBatchPackedPrefixSum = Other.CurrentBatchPackedPrefixSum;
+		CurrentBatchFirstItem = Other.CurrentBatchFirstItem;
+		TotalInstances = Other.TotalInstances;
+	}
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return Data->Batches.GetAllocatedSize() + Data->Items.GetAllocatedSize();
+	}
+
 	bool HasSingleInstanceItemsOnly() const
 	{
 		return TotalInstances == Data->Items.Num();
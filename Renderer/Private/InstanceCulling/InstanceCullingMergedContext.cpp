@@ -3,6 +3,22 @@
 #include "InstanceCulling/InstanceCullingMergedContext.h"
 #include "InstanceCulling/InstanceCullingManager.h"
 #include "RenderGraphBuilder.h"
+#include "Async/ParallelFor.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+static int32 GInstanceCullingParallelMergeBatches = 1;
+static FAutoConsoleVariableRef CVarInstanceCullingParallelMergeBatches(
+	TEXT("r.InstanceCulling.ParallelMergeBatches"),
+	GInstanceCullingParallelMergeBatches,
+	TEXT("Whether to copy & rebase the batches in parallel when merging the deferred instance culling contexts."),
+	ECVF_RenderThreadSafe);
+
+static int32 GInstanceCullingMergeBatchesMinBatchSize = 8;
+static FAutoConsoleVariableRef CVarInstanceCullingMergeBatchesMinBatchSize(
+	TEXT("r.InstanceCulling.ParallelMergeBatches.MinBatchSize"),
+	GInstanceCullingMergeBatchesMinBatchSize,
+	TEXT("Minimum number of contexts processed by each task when merging batches in parallel."),
+	ECVF_RenderThreadSafe);
 
 FInstanceCullingMergedContext::FInstanceCullingMergedContext(EShaderPlatform InShaderPlatform, bool bInMustAddAllContexts, int32 InNumBins)
 	: ShaderPlatform(InShaderPlatform)
@@ -13,8 +29,6 @@ FInstanceCullingMergedContext::FInstanceCullingMergedContext(EShaderPlatform InS
 
 	LoadBalancers.SetNum(InNumBins);
 	BatchInds.SetNum(InNumBins);
-	TotalBatches.SetNumZeroed(InNumBins);
-	TotalItems.SetNumZeroed(InNumBins);
 }
 
 int32 FInstanceCullingMergedContext::GetLoadBalancerIndex(EBatchProcessingMode Mode, const FBatchItem& BatchItem)
@@ -28,6 +42,8 @@ int32 FInstanceCullingMergedContext::GetLoadBalancerIndex(EBatchProcessingMode M
 
 void FInstanceCullingMergedContext::MergeBatches()
 {
+	TRACE_CPUPROFILER_EVENT_SCOPE(FInstanceCullingMergedContext::MergeBatches);
+
 	for (FBatchItem& AsyncBatchItem : AsyncBatches)
 	{
 		AsyncBatchItem.Context->WaitForSetupTask();
@@ -38,25 +54,45 @@ void FInstanceCullingMergedContext::MergeBatches()
 	}
 	AsyncBatches.Reset();
 
-	for (uint32 BinIndex = 0U; BinIndex < uint32(LoadBalancers.Num()); ++BinIndex)
+	// Per-batch destination offsets that are not stored in the FContextBatchInfoPacked.
+	struct FBatchMergeOffsets
+	{
+		uint32 CompactionBlockOffset;
+		uint32 CompactionInstanceOffset;
+		int32 LoadBalancerBatchOffset[uint32(EBatchProcessingMode::Num)];
+		int32 BatchIndsOffset[uint32(EBatchProcessingMode::Num)];
+	};
+	TArray<FBatchMergeOffsets, SceneRenderingAllocator> MergeOffsets;
+	MergeOffsets.SetNumUninitialized(Batches.Num());
+
+	const int32 NumBins = LoadBalancers.Num();
+	TArray<int32, TInlineAllocator<5>> BinNumBatches;
+	TArray<int32, TInlineAllocator<5>> BinNumItems;
+	TArray<uint32, TInlineAllocator<5>> BinNumInstances;
+	TArray<int32, TInlineAllocator<5>> BinBatchIndsOffset;
+	BinNumBatches.SetNumZeroed(NumBins);
+	BinNumItems.SetNumZeroed(NumBins);
+	BinNumInstances.SetNumZeroed(NumBins);
+	BinBatchIndsOffset.SetNumUninitialized(NumBins);
+	for (int32 BinIndex = 0; BinIndex < NumBins; ++BinIndex)
 	{
-		LoadBalancers[BinIndex].ReserveStorage(TotalBatches[BinIndex], TotalItems[BinIndex]);
+		BinBatchIndsOffset[BinIndex] = BatchInds[BinIndex].Num();
 	}
-	// Pre-size all arrays
-	IndirectArgs.Empty(TotalIndirectArgs);
-	DrawCommandDescs.Empty(TotalIndirectArgs);
-	InstanceIdOffsets.Empty(TotalIndirectArgs);
-	PayloadData.Empty(TotalPayloads);
-	ViewIds.Empty(TotalViewIds);
-	DrawCommandCompactionData.Empty(TotalCompactionDrawCommands);
-	CompactionBlockDataIndices.Empty(TotalCompactionBlocks);
-
-	BatchInfos.Reserve(Batches.Num());
+
+	const int32 BatchInfoBaseIndex = BatchInfos.Num();
+	BatchInfos.SetNumUninitialized(BatchInfoBaseIndex + Batches.Num());
+
+	uint32 NumIndirectArgs = 0U;
+	uint32 NumPayloads = 0U;
+	uint32 NumViewIds = 0U;
+	uint32 NumCompactionDrawCommands = 0U;
+	uint32 NumCompactionBlocks = 0U;
+
 	uint32 InstanceIdBufferOffset = 0U; // in buffer elements
 	uint32 InstanceDataByteOffset = 0U;
 	uint32 TempCompactionInstanceOffset = 0U;
-	
-	// Index that maps from each command to the corresponding batch - maybe not the utmost efficiency
+
+	// First pass: exclusive prefix sum over the batch sizes to produce all the destination offsets, this is cheap as it only touches the per-context sizes.
 	for (int32 BatchIndex = 0; BatchIndex < Batches.Num(); ++BatchIndex)
 	{
 		const FBatchItem& BatchItem = Batches[BatchIndex];
@@ -64,94 +100,138 @@ void FInstanceCullingMergedContext::MergeBatches()
 
 		// Empty contexts should never be added to this list!
 		check(InstanceCullingContext.HasCullingCommands());
-
-		int32 BatchInfoIndex = BatchInfos.Num();
-		FContextBatchInfoPacked& BatchInfo = BatchInfos.AddDefaulted_GetRef();
-
-		BatchInfo.IndirectArgsOffset = IndirectArgs.Num();
-		//BatchInfo.NumIndirectArgs = InstanceCullingContext.IndirectArgs.Num();
 		check(InstanceCullingContext.DrawCommandDescs.Num() == InstanceCullingContext.IndirectArgs.Num());
-		IndirectArgs.Append(InstanceCullingContext.IndirectArgs);
-		DrawCommandDescs.Append(InstanceCullingContext.DrawCommandDescs);
-
-		BatchInfo.PayloadDataOffset = PayloadData.Num();
-		PayloadData.Append(InstanceCullingContext.PayloadData);
-
 		check(InstanceCullingContext.InstanceIdOffsets.Num() == InstanceCullingContext.IndirectArgs.Num());
-		InstanceIdOffsets.AddDefaulted(InstanceCullingContext.InstanceIdOffsets.Num());
-		// TODO: perform offset on GPU
-		// InstanceIdOffsets.Append(InstanceCullingContext.InstanceIdOffsets);
-		for (int32 Index = 0; Index < InstanceCullingContext.InstanceIdOffsets.Num(); ++Index)
-		{
-			InstanceIdOffsets[BatchInfo.IndirectArgsOffset + Index] = InstanceCullingContext.InstanceIdOffsets[Index] + InstanceIdBufferOffset;
-		}
+		check(InstanceCullingContext.DynamicInstanceIdOffset >= 0);
+		check(InstanceCullingContext.DynamicInstanceIdNum >= 0);
+
+		FContextBatchInfoPacked& BatchInfo = BatchInfos[BatchInfoBaseIndex + BatchIndex];
+		FBatchMergeOffsets& Offsets = MergeOffsets[BatchIndex];
 
-		BatchInfo.ViewIdsOffset = ViewIds.Num();
+		BatchInfo.IndirectArgsOffset = NumIndirectArgs;
+		BatchInfo.PayloadDataOffset = NumPayloads;
+		BatchInfo.ViewIdsOffset = NumViewIds;
 		BatchInfo.NumViewIds_bAllowOcclusionCulling = uint32(InstanceCullingContext.ViewIds.Num()) << 1u;
 		if (InstanceCullingContext.PrevHZB.IsValid())
 		{
 			BatchInfo.NumViewIds_bAllowOcclusionCulling |= 1u;
 		}
-		ViewIds.Append(InstanceCullingContext.ViewIds);
-
-		check(InstanceCullingContext.DynamicInstanceIdOffset >= 0);
-		check(InstanceCullingContext.DynamicInstanceIdNum >= 0);
-
 		BatchInfo.DynamicInstanceIdOffset = InstanceCullingContext.DynamicInstanceIdOffset;
 		BatchInfo.DynamicInstanceIdMax = InstanceCullingContext.DynamicInstanceIdOffset + InstanceCullingContext.DynamicInstanceIdNum;
+		BatchInfo.InstanceDataWriteOffset = InstanceIdBufferOffset;
+		BatchInfo.CompactionDataOffset = NumCompactionDrawCommands;
 
 		for (uint32 Mode = 0U; Mode < uint32(EBatchProcessingMode::Num); ++Mode)
 		{
 			int32 BinIndex = GetLoadBalancerIndex(static_cast<EBatchProcessingMode>(Mode), BatchItem);
 
-			int32 StartIndex = BatchInds[BinIndex].Num();
-			TInstanceCullingLoadBalancer<SceneRenderingAllocator>* MergedLoadBalancer = &LoadBalancers[BinIndex];
-
-			BatchInfo.ItemDataOffset[Mode] = MergedLoadBalancer->GetItems().Num();
 			FInstanceProcessingGPULoadBalancer* LoadBalancer = InstanceCullingContext.LoadBalancers[Mode];
 			LoadBalancer->FinalizeBatches();
 
 			// UnCulled bucket is used for a single instance mode
 			check(EBatchProcessingMode(Mode) != EBatchProcessingMode::UnCulled || LoadBalancer->HasSingleInstanceItemsOnly());
 
-			BatchInds[BinIndex].AddDefaulted(LoadBalancer->GetBatches().Num());
+			BatchInfo.ItemDataOffset[Mode] = BinNumItems[BinIndex];
+			Offsets.LoadBalancerBatchOffset[Mode] = BinNumBatches[BinIndex];
+			Offsets.BatchIndsOffset[Mode] = BinBatchIndsOffset[BinIndex] + BinNumBatches[BinIndex];
 
-			MergedLoadBalancer->AppendData(*LoadBalancer);
-			for (int32 Index = StartIndex; Index < BatchInds[BinIndex].Num(); ++Index)
-			{
-				BatchInds[BinIndex][Index] = BatchInfoIndex;
-			}
+			BinNumBatches[BinIndex] += LoadBalancer->GetBatches().Num();
+			BinNumItems[BinIndex] += LoadBalancer->GetItems().Num();
+			BinNumInstances[BinIndex] += LoadBalancer->GetTotalNumInstances();
 		}
-		const uint32 BatchTotalInstances = InstanceCullingContext.TotalInstances * InstanceCullingContext.ViewIds.Num();
+
+		Offsets.CompactionBlockOffset = NumCompactionBlocks;
+		Offsets.CompactionInstanceOffset = TempCompactionInstanceOffset;
+
 		const uint32 BatchTotalDraws = InstanceCullingContext.InstanceIdOffsets.Num();
 
 		FInstanceCullingDrawParams& Result = *BatchItem.Result;
 		Result.InstanceDataByteOffset = InstanceDataByteOffset;
 		Result.IndirectArgsByteOffset = BatchInfo.IndirectArgsOffset * FInstanceCullingContext::IndirectArgsNumWords * sizeof(uint32);
 
-		BatchInfo.InstanceDataWriteOffset = InstanceIdBufferOffset;
-
-		// Append the compaction data, but fix up the offsets for the batch
-		BatchInfo.CompactionDataOffset = DrawCommandCompactionData.Num();
-		const uint32 CompactionBlockOffset = CompactionBlockDataIndices.Num();
-		for (auto CompactionData : InstanceCullingContext.DrawCommandCompactionData)
-		{			
-			CompactionData.BlockOffset += CompactionBlockOffset;
-			CompactionData.IndirectArgsIndex += BatchInfo.IndirectArgsOffset;
-			CompactionData.SrcInstanceIdOffset += TempCompactionInstanceOffset;
-			CompactionData.DestInstanceIdOffset += InstanceIdBufferOffset;
-			DrawCommandCompactionData.Add(CompactionData);
-		}
-		for (uint32 CompactionDataIndex : InstanceCullingContext.CompactionBlockDataIndices)
-		{
-			CompactionBlockDataIndices.Add(CompactionDataIndex + BatchInfo.CompactionDataOffset);
-		}
+		NumIndirectArgs += InstanceCullingContext.IndirectArgs.Num();
+		NumPayloads += InstanceCullingContext.PayloadData.Num();
+		NumViewIds += InstanceCullingContext.ViewIds.Num();
+		NumCompactionDrawCommands += InstanceCullingContext.DrawCommandCompactionData.Num();
+		NumCompactionBlocks += InstanceCullingContext.CompactionBlockDataIndices.Num();
 		TempCompactionInstanceOffset += InstanceCullingContext.NumCompactionInstances;
 
 		// Advance offset into instance ID and per-instance buffer
 		InstanceIdBufferOffset += InstanceCullingContext.GetInstanceIdNumElements();
 		InstanceDataByteOffset += InstanceCullingContext.StepInstanceDataOffsetBytes(BatchTotalDraws);
 	}
+
+	// Size all arrays exactly, every element is written by the second pass.
+	IndirectArgs.SetNumUninitialized(NumIndirectArgs);
+	DrawCommandDescs.SetNumUninitialized(NumIndirectArgs);
+	InstanceIdOffsets.SetNumUninitialized(NumIndirectArgs);
+	PayloadData.SetNumUninitialized(NumPayloads);
+	ViewIds.SetNumUninitialized(NumViewIds);
+	DrawCommandCompactionData.SetNumUninitialized(NumCompactionDrawCommands);
+	CompactionBlockDataIndices.SetNumUninitialized(NumCompactionBlocks);
+
+	for (int32 BinIndex = 0; BinIndex < NumBins; ++BinIndex)
+	{
+		LoadBalancers[BinIndex].SetNumStorageUninitialized(BinNumBatches[BinIndex], BinNumItems[BinIndex], BinNumInstances[BinIndex]);
+		BatchInds[BinIndex].SetNumUninitialized(BinBatchIndsOffset[BinIndex] + BinNumBatches[BinIndex]);
+	}
+
+	// Second pass: copy & rebase each batch into its own (disjoint) range of the merged arrays.
+	ParallelFor(TEXT("InstanceCulling.MergeBatches"), Batches.Num(), GInstanceCullingMergeBatchesMinBatchSize,
+		[this, BatchInfoBaseIndex, &MergeOffsets](int32 BatchIndex)
+		{
+			const FBatchItem& BatchItem = Batches[BatchIndex];
+			const FInstanceCullingContext& InstanceCullingContext = *BatchItem.Context;
+			const int32 BatchInfoIndex = BatchInfoBaseIndex + BatchIndex;
+			const FContextBatchInfoPacked& BatchInfo = BatchInfos[BatchInfoIndex];
+			const FBatchMergeOffsets& Offsets = MergeOffsets[BatchIndex];
+
+			const int32 NumBatchIndirectArgs = InstanceCullingContext.IndirectArgs.Num();
+			FMemory::Memcpy(IndirectArgs.GetData() + BatchInfo.IndirectArgsOffset, InstanceCullingContext.IndirectArgs.GetData(), NumBatchIndirectArgs * sizeof(FRHIDrawIndexedIndirectParameters));
+			FMemory::Memcpy(DrawCommandDescs.GetData() + BatchInfo.IndirectArgsOffset, InstanceCullingContext.DrawCommandDescs.GetData(), NumBatchIndirectArgs * sizeof(uint32));
+			FMemory::Memcpy(PayloadData.GetData() + BatchInfo.PayloadDataOffset, InstanceCullingContext.PayloadData.GetData(), InstanceCullingContext.PayloadData.Num() * sizeof(FInstanceCullingContext::FPayloadData));
+			FMemory::Memcpy(ViewIds.GetData() + BatchInfo.ViewIdsOffset, InstanceCullingContext.ViewIds.GetData(), InstanceCullingContext.ViewIds.Num() * sizeof(int32));
+
+			// TODO: perform offset on GPU
+			uint32* RESTRICT DstInstanceIdOffsets = InstanceIdOffsets.GetData() + BatchInfo.IndirectArgsOffset;
+			for (int32 Index = 0; Index < NumBatchIndirectArgs; ++Index)
+			{
+				DstInstanceIdOffsets[Index] = InstanceCullingContext.InstanceIdOffsets[Index] + BatchInfo.InstanceDataWriteOffset;
+			}
+
+			for (uint32 Mode = 0U; Mode < uint32(EBatchProcessingMode::Num); ++Mode)
+			{
+				int32 BinIndex = GetLoadBalancerIndex(static_cast<EBatchProcessingMode>(Mode), BatchItem);
+
+				const FInstanceProcessingGPULoadBalancer* LoadBalancer = InstanceCullingContext.LoadBalancers[Mode];
+				LoadBalancers[BinIndex].CopyDataAt(*LoadBalancer, Offsets.LoadBalancerBatchOffset[Mode], BatchInfo.ItemDataOffset[Mode]);
+
+				TArray<uint32, SceneRenderingAllocator>& BinBatchInds = BatchInds[BinIndex];
+				const int32 NumLoadBalancerBatches = LoadBalancer->GetBatches().Num();
+				for (int32 Index = 0; Index < NumLoadBalancerBatches; ++Index)
+				{
+					BinBatchInds[Offsets.BatchIndsOffset[Mode] + Index] = BatchInfoIndex;
+				}
+			}
+
+			// Copy the compaction data, but fix up the offsets for the batch
+			FInstanceCullingContext::FCompactionData* RESTRICT DstCompactionData = DrawCommandCompactionData.GetData() + BatchInfo.CompactionDataOffset;
+			for (int32 Index = 0; Index < InstanceCullingContext.DrawCommandCompactionData.Num(); ++Index)
+			{
+				FInstanceCullingContext::FCompactionData CompactionData = InstanceCullingContext.DrawCommandCompactionData[Index];
+				CompactionData.BlockOffset += Offsets.CompactionBlockOffset;
+				CompactionData.IndirectArgsIndex += BatchInfo.IndirectArgsOffset;
+				CompactionData.SrcInstanceIdOffset += Offsets.CompactionInstanceOffset;
+				CompactionData.DestInstanceIdOffset += BatchInfo.InstanceDataWriteOffset;
+				DstCompactionData[Index] = CompactionData;
+			}
+			uint32* RESTRICT DstCompactionBlockDataIndices = CompactionBlockDataIndices.GetData() + Offsets.CompactionBlockOffset;
+			for (int32 Index = 0; Index < InstanceCullingContext.CompactionBlockDataIndices.Num(); ++Index)
+			{
+				DstCompactionBlockDataIndices[Index] = InstanceCullingContext.CompactionBlockDataIndices[Index] + BatchInfo.CompactionDataOffset;
+			}
+		},
+		GInstanceCullingParallelMergeBatches != 0 ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread);
 }
 
 void FInstanceCullingMergedContext::AddBatch(FRDGBuilder& GraphBuilder, FInstanceCullingContext* Context, FInstanceCullingDrawParams* InstanceCullingDrawParams)
@@ -190,16 +270,6 @@ void FInstanceCullingMergedContext::AddBatchItem(const FBatchItem& BatchItem)
 	{
 		Batches.Add(BatchItem);
 
-		// Accumulate the totals so the deferred processing can pre-size the arrays
-		for (uint32 Mode = 0U; Mode < uint32(EBatchProcessingMode::Num); ++Mode)
-		{
-			Context->LoadBalancers[Mode]->FinalizeBatches();
-
-			int32 BinIndex = GetLoadBalancerIndex(static_cast<EBatchProcessingMode>(Mode), BatchItem);
-
-			TotalBatches[BinIndex] += Context->LoadBalancers[Mode]->GetBatches().Max();
-			TotalItems[BinIndex] += Context->LoadBalancers[Mode]->GetItems().Max();
-		}
 #if DO_CHECK
 		for (int32 ViewId : Context->ViewIds)
 		{
@@ -207,9 +277,6 @@ void FInstanceCullingMergedContext::AddBatchItem(const FBatchItem& BatchItem)
 		}
 #endif 
 
-		TotalIndirectArgs += Context->IndirectArgs.Num();
-		TotalPayloads += Context->PayloadData.Num();
-		TotalViewIds += Context->ViewIds.Num();
 		InstanceIdBufferElements += Context->GetInstanceIdNumElements();
 		TotalInstances += Context->TotalInstances;
 		TotalCompactionDrawCommands += Context->DrawCommandCompactionData.Num();
@@ -66,12 +66,6 @@ public:
 	bool bMustAddAllContexts = false;
 	// Counters to sum up all sizes to facilitate pre-sizing
 	uint32 InstanceIdBufferElements = 0U;
-	// preallocate 5 to cover all scenarios up to UnCulled bin + 4 HZBs in case of 4 primary views
-	TArray<int32, TInlineAllocator<5>> TotalBatches;
-	TArray<int32, TInlineAllocator<5>> TotalItems;
-	int32 TotalIndirectArgs = 0;
-	int32 TotalPayloads = 0;
-	int32 TotalViewIds = 0;
 	int32 TotalInstances = 0;
 	int32 TotalCompactionDrawCommands = 0;
 	int32 TotalCompactionBlocks = 0;
@@ -0,0 +1,223 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "InstanceCulling/InstanceCullingSetupCache.h"
+#include "ScenePrivate.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+
+static int32 GInstanceCullingSetupCache = 0;
+static FAutoConsoleVariableRef CVarInstanceCullingSetupCache(
+	TEXT("r.InstanceCulling.SetupCache"),
+	GInstanceCullingSetupCache,
+	TEXT("Whether to cache the instance culling setup of the mesh passes of each view across frames, and reuse it when the visible mesh draw command list is unchanged.\n")
+	TEXT("Mostly beneficial for static cameras, costs one copy of the setup data per view & pass."),
+	ECVF_RenderThreadSafe);
+
+DECLARE_STATS_GROUP(TEXT("InstanceCulling"), STATGROUP_InstanceCulling, STATCAT_Advanced);
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Setup Cache Lookups"), STAT_InstanceCulling_SetupCacheLookups, STATGROUP_InstanceCulling);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Setup Cache Hits"), STAT_InstanceCulling_SetupCacheHits, STATGROUP_InstanceCulling);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Setup Cache Reused Commands"), STAT_InstanceCulling_SetupCacheReusedCommands, STATGROUP_InstanceCulling);
+
+CSV_DEFINE_CATEGORY(InstanceCulling, false);
+
+static_assert(sizeof(FInstanceCullingSetupCacheEntry::FCommandKey) == sizeof(const FMeshDrawCommand*) + 9 * sizeof(uint32) + 4, "FCommandKey must not contain any padding as it is compared using Memcmp.");
+static_assert(sizeof(FInstanceCullingSetupCacheEntry::FConfigKey) == sizeof(uint32) + 4, "FConfigKey must not contain any padding as it is compared using Memcmp.");
+
+bool FInstanceCullingSetupCacheEntry::BuildPendingKey(const FMeshCommandOneFrameArray& VisibleMeshDrawCommands, const FScene* Scene, const FConfigKey& InConfigKey)
+{
+	PendingConfigKey = InConfigKey;
+	PendingKeys.SetNumUninitialized(VisibleMeshDrawCommands.Num());
+	PendingRunKeys.Reset();
+
+	for (int32 Index = 0; Index < VisibleMeshDrawCommands.Num(); ++Index)
+	{
+		const FVisibleMeshDrawCommand& VisibleMeshDrawCommand = VisibleMeshDrawCommands[Index];
+		const FMeshDrawCommand* MeshDrawCommand = VisibleMeshDrawCommand.MeshDrawCommand;
+
+		uint32 NumInstances = MeshDrawCommand->NumInstances;
+		if (EnumHasAnyFlags(VisibleMeshDrawCommand.Flags, EFVisibleMeshDrawCommandFlags::FetchInstanceCountFromScene))
+		{
+			if (Scene == nullptr)
+			{
+				return false;
+			}
+			NumInstances = uint32(Scene->Primitives[VisibleMeshDrawCommand.PrimitiveIdInfo.ScenePrimitiveId]->GetNumInstanceSceneDataEntries());
+		}
+
+		FCommandKey& Key = PendingKeys[Index];
+		Key.MeshDrawCommand = MeshDrawCommand;
+		Key.StateBucketId = VisibleMeshDrawCommand.StateBucketId;
+		Key.ScenePrimitiveId = VisibleMeshDrawCommand.PrimitiveIdInfo.ScenePrimitiveId;
+		Key.InstanceSceneDataOffset = VisibleMeshDrawCommand.PrimitiveIdInfo.InstanceSceneDataOffset;
+		Key.NumInstances = NumInstances;
+		Key.NumPrimitives = MeshDrawCommand->NumPrimitives;
+		Key.FirstIndex = MeshDrawCommand->FirstIndex;
+		Key.BaseVertexIndex = MeshDrawCommand->VertexParams.BaseVertexIndex;
+		Key.CullingPayload = VisibleMeshDrawCommand.CullingPayload.PackedData;
+		Key.NumRuns = VisibleMeshDrawCommand.RunArray ? uint32(VisibleMeshDrawCommand.NumRuns) : 0U;
+		Key.Flags = uint8(VisibleMeshDrawCommand.Flags);
+		Key.CullingPayloadFlags = uint8(VisibleMeshDrawCommand.CullingPayloadFlags);
+		Key.PrimitiveType = uint8(MeshDrawCommand->PrimitiveType);
+		Key.bIsDynamicPrimitive = uint8(VisibleMeshDrawCommand.PrimitiveIdInfo.bIsDynamicPrimitive);
+
+		// The run arrays are allocated per frame, so key on the content.
+		if (VisibleMeshDrawCommand.RunArray)
+		{
+			PendingRunKeys.Append(VisibleMeshDrawCommand.RunArray, VisibleMeshDrawCommand.NumRuns * 2);
+		}
+	}
+
+	return true;
+}
+
+bool FInstanceCullingSetupCacheEntry::Lookup()
+{
+	const bool bHit = bValid
+		&& ConfigKey == PendingConfigKey
+		&& Keys.Num() == PendingKeys.Num()
+		&& RunKeys.Num() == PendingRunKeys.Num()
+		&& FMemory::Memcmp(Keys.GetData(), PendingKeys.GetData(), Keys.Num() * sizeof(FCommandKey)) == 0
+		&& FMemory::Memcmp(RunKeys.GetData(), PendingRunKeys.GetData(), RunKeys.Num() * sizeof(uint32)) == 0;
+
+	INC_DWORD_STAT(STAT_InstanceCulling_SetupCacheLookups);
+	CSV_CUSTOM_STAT(InstanceCulling, SetupCacheLookups, 1, ECsvCustomStatOp::Accumulate);
+	if (bHit)
+	{
+		INC_DWORD_STAT(STAT_InstanceCulling_SetupCacheHits);
+		INC_DWORD_STAT_BY(STAT_InstanceCulling_SetupCacheReusedCommands, Keys.Num());
+		CSV_CUSTOM_STAT(InstanceCulling, SetupCacheHits, 1, ECsvCustomStatOp::Accumulate);
+	}
+
+	return bHit;
+}
+
+void FInstanceCullingSetupCacheEntry::Restore(FInstanceCullingContext& Context, FMeshCommandOneFrameArray& VisibleMeshDrawCommandsInOut, int32& OutMaxInstances) const
+{
+	check(bValid);
+
+	Context.MeshDrawCommandInfos.Reset();
+	Context.MeshDrawCommandInfos.Append(MeshDrawCommandInfos);
+	Context.IndirectArgs.Reset();
+	Context.IndirectArgs.Append(IndirectArgs);
+	Context.DrawCommandDescs.Reset();
+	Context.DrawCommandDescs.Append(DrawCommandDescs);
+	Context.PayloadData.Reset();
+	Context.PayloadData.Append(PayloadData);
+	Context.InstanceIdOffsets.Reset();
+	Context.InstanceIdOffsets.Append(InstanceIdOffsets);
+	Context.DrawCommandCompactionData.Reset();
+	Context.DrawCommandCompactionData.Append(DrawCommandCompactionData);
+	Context.CompactionBlockDataIndices.Reset();
+	Context.CompactionBlockDataIndices.Append(CompactionBlockDataIndices);
+	Context.NumCompactionInstances = NumCompactionInstances;
+	Context.TotalInstances = TotalInstances;
+
+	for (uint32 Mode = 0U; Mode < uint32(EBatchProcessingMode::Num); ++Mode)
+	{
+		Context.LoadBalancers[Mode]->CopyFrom(LoadBalancers[Mode]);
+	}
+
+	// The input list is identical (as far as the setup is concerned) to the one the retained indices were recorded for, so compact it the same way.
+	FVisibleMeshDrawCommand* RESTRICT VisibleMeshDrawCommands = VisibleMeshDrawCommandsInOut.GetData();
+	for (int32 Index = 0; Index < StoredRetainedCommands.Num(); ++Index)
+	{
+		const int32 DrawCommandIndex = StoredRetainedCommands[Index];
+		if (DrawCommandIndex > Index)
+		{
+			VisibleMeshDrawCommands[Index] = VisibleMeshDrawCommands[DrawCommandIndex];
+		}
+	}
+	VisibleMeshDrawCommandsInOut.SetNum(StoredRetainedCommands.Num(), EAllowShrinking::No);
+
+	OutMaxInstances = MaxInstances;
+}
+
+void FInstanceCullingSetupCacheEntry::Store(const FInstanceCullingContext& Context, int32 InMaxInstances)
+{
+	check(RetainedCommands.Num() == Context.MeshDrawCommandInfos.Num());
+
+	Swap(ConfigKey, PendingConfigKey);
+	Swap(Keys, PendingKeys);
+	Swap(RunKeys, PendingRunKeys);
+	Swap(StoredRetainedCommands, RetainedCommands);
+	RetainedCommands.Reset();
+
+	MeshDrawCommandInfos.Reset();
+	MeshDrawCommandInfos.Append(Context.MeshDrawCommandInfos);
+	IndirectArgs.Reset();
+	IndirectArgs.Append(Context.IndirectArgs);
+	DrawCommandDescs.Reset();
+	DrawCommandDescs.Append(Context.DrawCommandDescs);
+	PayloadData.Reset();
+	PayloadData.Append(Context.PayloadData);
+	InstanceIdOffsets.Reset();
+	InstanceIdOffsets.Append(Context.InstanceIdOffsets);
+	DrawCommandCompactionData.Reset();
+	DrawCommandCompactionData.Append(Context.DrawCommandCompactionData);
+	CompactionBlockDataIndices.Reset();
+	CompactionBlockDataIndices.Append(Context.CompactionBlockDataIndices);
+	NumCompactionInstances = Context.NumCompactionInstances;
+	TotalInstances = Context.TotalInstances;
+	MaxInstances = InMaxInstances;
+
+	for (uint32 Mode = 0U; Mode < uint32(EBatchProcessingMode::Num); ++Mode)
+	{
+		LoadBalancers[Mode].CopyFrom(*Context.LoadBalancers[Mode]);
+	}
+
+	bValid = true;
+}
+
+void FInstanceCullingSetupCacheEntry::Invalidate()
+{
+	if (bValid)
+	{
+		*this = FInstanceCullingSetupCacheEntry();
+	}
+}
+
+SIZE_T FInstanceCullingSetupCacheEntry::GetAllocatedSize() const
+{
+	SIZE_T Size = RetainedCommands.GetAllocatedSize()
+		+ PendingKeys.GetAllocatedSize()
+		+ PendingRunKeys.GetAllocatedSize()
+		+ Keys.GetAllocatedSize()
+		+ RunKeys.GetAllocatedSize()
+		+ MeshDrawCommandInfos.GetAllocatedSize()
+		+ IndirectArgs.GetAllocatedSize()
+		+ DrawCommandDescs.GetAllocatedSize()
+		+ PayloadData.GetAllocatedSize()
+		+ InstanceIdOffsets.GetAllocatedSize()
+		+ DrawCommandCompactionData.GetAllocatedSize()
+		+ CompactionBlockDataIndices.GetAllocatedSize()
+		+ StoredRetainedCommands.GetAllocatedSize();
+
+	for (const FInstanceProcessingGPULoadBalancer& LoadBalancer : LoadBalancers)
+	{
+		Size += LoadBalancer.GetAllocatedSize();
+	}
+	return Size;
+}
+
+bool FInstanceCullingSetupCache::IsEnabled()
+{
+	return GInstanceCullingSetupCache != 0;
+}
+
+void FInstanceCullingSetupCache::Reset()
+{
+	for (FInstanceCullingSetupCacheEntry& Entry : Entries)
+	{
+		Entry = FInstanceCullingSetupCacheEntry();
+	}
+}
+
+SIZE_T FInstanceCullingSetupCache::GetAllocatedSize() const
+{
+	SIZE_T Size = 0;
+	for (const FInstanceCullingSetupCacheEntry& Entry : Entries)
+	{
+		Size += Entry.GetAllocatedSize();
+	}
+	return Size;
+}
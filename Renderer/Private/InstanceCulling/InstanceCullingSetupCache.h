@@ -0,0 +1,124 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MeshPassProcessor.h"
+#include "InstanceCulling/InstanceCullingContext.h"
+#include "InstanceCulling/InstanceCullingManager.h"
+
+class FScene;
+
+/**
+ * Cache entry for one view & mesh pass, holds the key (packed visible mesh draw command list) and the output of FInstanceCullingContext::SetupDrawCommands from the last frame it was populated.
+ * The setup output is a pure function of the key, so on a match the packed arrays are restored directly and the whole setup loop is skipped.
+ * NOTE: The dynamic primitive instance offsets are relative to the view's dynamic instance range, which is applied later through SetDynamicPrimitiveInstanceOffsets, so it does not need to be part of the key.
+ */
+class FInstanceCullingSetupCacheEntry
+{
+public:
+	/** Everything SetupDrawCommands reads from an FVisibleMeshDrawCommand, packed. */
+	struct FCommandKey
+	{
+		const FMeshDrawCommand* MeshDrawCommand;
+		int32 StateBucketId;
+		int32 ScenePrimitiveId;
+		int32 InstanceSceneDataOffset;
+		uint32 NumInstances;
+		uint32 NumPrimitives;
+		uint32 FirstIndex;
+		uint32 BaseVertexIndex;
+		uint32 CullingPayload;
+		uint32 NumRuns;
+		uint8 Flags;
+		uint8 CullingPayloadFlags;
+		uint8 PrimitiveType;
+		uint8 bIsDynamicPrimitive;
+
+		bool operator==(const FCommandKey& Other) const
+		{
+			return FMemory::Memcmp(this, &Other, sizeof(FCommandKey)) == 0;
+		}
+	};
+
+	/** Context state that changes the setup output. */
+	struct FConfigKey
+	{
+		uint32 NumViews = 0U;
+		uint8 SingleInstanceProcessingMode = 0U;
+		uint8 bCompactIdenticalCommands = 0U;
+		uint8 bOrderPreservationEnabled = 0U;
+		uint8 bForceInstanceCulling = 0U;
+
+		bool operator==(const FConfigKey& Other) const
+		{
+			return FMemory::Memcmp(this, &Other, sizeof(FConfigKey)) == 0;
+		}
+	};
+
+	/**
+	 * Build the key for the given (sorted) visible mesh draw commands into the pending key.
+	 * Returns false if the list cannot be cached.
+	 */
+	bool BuildPendingKey(const FMeshCommandOneFrameArray& VisibleMeshDrawCommands, const FScene* Scene, const FConfigKey& ConfigKey);
+
+	/** Returns true if the pending key matches the key of the stored setup output, and updates the hit stats. */
+	bool Lookup();
+
+	/** Restore the stored setup output into the context, and compact the visible mesh draw commands the same way SetupDrawCommands did. */
+	void Restore(FInstanceCullingContext& Context, FMeshCommandOneFrameArray& VisibleMeshDrawCommandsInOut, int32& MaxInstances) const;
+
+	/** Store the setup output of the context, keyed by the pending key. RetainedCommands must have been filled by SetupDrawCommands. */
+	void Store(const FInstanceCullingContext& Context, int32 MaxInstances);
+
+	/** Drop the stored data and keys. */
+	void Invalidate();
+
+	SIZE_T GetAllocatedSize() const;
+
+	/** Indices (in the input list) of the visible mesh draw commands retained by SetupDrawCommands, filled during setup on a cache miss. */
+	TArray<int32> RetainedCommands;
+
+private:
+	FConfigKey PendingConfigKey;
+	TArray<FCommandKey> PendingKeys;
+	TArray<uint32> PendingRunKeys;
+
+	bool bValid = false;
+	FConfigKey ConfigKey;
+	TArray<FCommandKey> Keys;
+	TArray<uint32> RunKeys;
+
+	TArray<FInstanceCullingContext::FMeshDrawCommandInfo> MeshDrawCommandInfos;
+	TArray<FRHIDrawIndexedIndirectParameters> IndirectArgs;
+	TArray<uint32> DrawCommandDescs;
+	TArray<FInstanceCullingContext::FPayloadData> PayloadData;
+	TArray<uint32> InstanceIdOffsets;
+	TArray<FInstanceCullingContext::FCompactionData> DrawCommandCompactionData;
+	TArray<uint32> CompactionBlockDataIndices;
+	TArray<int32> StoredRetainedCommands;
+	TStaticArray<FInstanceProcessingGPULoadBalancer, static_cast<uint32>(EBatchProcessingMode::Num)> LoadBalancers;
+	uint32 NumCompactionInstances = 0U;
+	uint32 TotalInstances = 0U;
+	int32 MaxInstances = 1;
+};
+
+/**
+ * Opt-in (r.InstanceCulling.SetupCache) per-view cache of the instance culling setup of each mesh pass.
+ * Intended for static cameras, where the visible mesh draw command lists are often identical from frame to frame.
+ */
+class FInstanceCullingSetupCache
+{
+public:
+	static bool IsEnabled();
+
+	FInstanceCullingSetupCacheEntry& GetEntry(EMeshPass::Type PassType) { return Entries[PassType]; }
+
+	/** Drop all the stored data, called when the view state releases its resources (FSceneViewState::ReleaseRHI). */
+	void Reset();
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	TStaticArray<FInstanceCullingSetupCacheEntry, EMeshPass::Num> Entries;
+};
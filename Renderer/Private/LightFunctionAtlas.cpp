@@ -76,6 +76,20 @@ static TAutoConsoleVariable<int32> CVarLightFunctionAtlasMaxLightCount(
 	TEXT("Experimental: Clamp the number of lights that can sample light function atlas. -1 means unlimited light count."),
 	ECVF_RenderThreadSafe);
 
+static TAutoConsoleVariable<int32> CVarLightFunctionAtlasPersistentSlots(
+	TEXT("r.LightFunctionAtlas.PersistentSlots"),
+	1,
+	TEXT("Keep the atlas slot of each light function material and the atlas content across frames, and only render the slots that are new or whose content changed."),
+	ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<int32> CVarLightFunctionAtlasPersistentSlotsStaticMaterials(
+	TEXT("r.LightFunctionAtlas.PersistentSlots.StaticMaterials"),
+	0,
+	TEXT("0: slots are rendered again whenever the world time changes, as light function materials can read the time in shader code (Time node).\n")
+	TEXT("1: light function materials that don't use parameter collections are assumed not to depend on time, their slots are only rendered again when their parameters change."),
+	ECVF_RenderThreadSafe);
+
+
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -226,6 +240,142 @@ FLightFunctionSlotKey::FLightFunctionSlotKey(FLightSceneInfo* InLightSceneInfo)
 
 
 
+//////////////////////////////////////////////////////////////////////////
+
+uint32 HashLightFunctionParameters(const FMaterialRenderProxy* MaterialProxy, const FMaterialShaderMap* ShaderMap, TConstArrayView<uint8> ParameterData)
+{
+	const uint32 Hash = HashCombineFast(PointerHash(MaterialProxy), PointerHash(ShaderMap));
+	return HashCombineFast(Hash, FCrc::MemCrc32(ParameterData.GetData(), ParameterData.Num()));
+}
+
+bool IsLightFunctionTimeVarying(bool bUsesParameterCollections, bool bAssumeStaticMaterials)
+{
+	// Time read in shader code isn't reported by the compiled material, so the slot is time varying unless static materials are opted in.
+	// Parameter collections are bound as their own uniform buffers and are not part of the evaluated parameters, so they always are.
+	return bUsesParameterCollections || !bAssumeStaticMaterials;
+}
+
+static void GetLightFunctionSlotParameters(const FMaterialRenderProxy& MaterialProxy, const FMaterial& Material, ERHIFeatureLevel::Type FeatureLevel, bool bAssumeStaticMaterials, FLightFunctionSlotContent& OutContent)
+{
+	const FMaterialShaderMap* ShaderMap = Material.GetRenderingThreadShaderMap();
+	const FUniformExpressionCache& UniformExpressionCache = MaterialProxy.UniformExpressionCache[FeatureLevel];
+
+	// The material uniform buffer is updated in place when a parameter changes, so the uniform expressions are evaluated again and
+	// their values hashed. This includes the texture references and anything evaluated by the preshaders.
+	TArray<uint8, SceneRenderingAllocator> ParameterData;
+	const FRHIUniformBufferLayout* UniformBufferLayout = ShaderMap ? ShaderMap->GetUniformBufferLayout() : nullptr;
+	if (UniformBufferLayout && UniformBufferLayout->ConstantBufferSize > 0)
+	{
+		ParameterData.SetNumZeroed(UniformBufferLayout->ConstantBufferSize);
+		const FMaterialRenderContext MaterialRenderContext(&MaterialProxy, Material, nullptr);
+		ShaderMap->GetUniformExpressionSet().FillUniformBuffer(MaterialRenderContext, UniformExpressionCache, UniformBufferLayout, ParameterData.GetData(), ParameterData.Num());
+	}
+	OutContent.ParameterHash = HashLightFunctionParameters(&MaterialProxy, ShaderMap, ParameterData);
+
+	OutContent.bTimeVarying = IsLightFunctionTimeVarying(UniformExpressionCache.ParameterCollections.Num() > 0, bAssumeStaticMaterials);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+void FLightFunctionAtlasSlotAllocator::Reset(uint32 InSlotCount)
+{
+	Slots.Reset();
+	Slots.SetNum(InSlotCount);
+	MaterialToSlot.Reset();
+}
+
+void FLightFunctionAtlasSlotAllocator::BeginAllocation(double InWorldTime)
+{
+	++PassIndex;
+	WorldTime = InWorldTime;
+}
+
+int32 FLightFunctionAtlasSlotAllocator::RequestSlot(const FLightFunctionSlotContent& Content)
+{
+	int32 SlotIndex = INDEX_NONE;
+	if (const int32* ExistingSlotIndex = MaterialToSlot.Find(Content.LFMaterialUniqueID))
+	{
+		SlotIndex = *ExistingSlotIndex;
+	}
+	else
+	{
+		// Take a slot that was never assigned, otherwise the least recently requested one. Slots requested in this pass are kept.
+		for (int32 Index = 0; Index < Slots.Num(); ++Index)
+		{
+			const FSlot& Slot = Slots[Index];
+			if (Slot.LastRequestedPass == PassIndex && Slot.bAssigned)
+			{
+				continue;
+			}
+			if (!Slot.bAssigned)
+			{
+				SlotIndex = Index;
+				break;
+			}
+			if (SlotIndex == INDEX_NONE || Slot.LastRequestedPass < Slots[SlotIndex].LastRequestedPass)
+			{
+				SlotIndex = Index;
+			}
+		}
+
+		if (SlotIndex == INDEX_NONE)
+		{
+			return INDEX_NONE;
+		}
+
+		FSlot& Slot = Slots[SlotIndex];
+		if (Slot.bAssigned)
+		{
+			MaterialToSlot.Remove(Slot.Content.LFMaterialUniqueID);
+		}
+		MaterialToSlot.Add(Content.LFMaterialUniqueID, SlotIndex);
+		Slot.bAssigned = true;
+		Slot.bRendered = false;
+	}
+
+	FSlot& Slot = Slots[SlotIndex];
+	if (!(Slot.Content == Content))
+	{
+		Slot.Content = Content;
+		Slot.bRendered = false;
+	}
+	Slot.LastRequestedPass = PassIndex;
+	return SlotIndex;
+}
+
+bool FLightFunctionAtlasSlotAllocator::IsSlotDirty(int32 SlotIndex) const
+{
+	const FSlot& Slot = Slots[SlotIndex];
+	if (!Slot.bAssigned || Slot.LastRequestedPass != PassIndex)
+	{
+		return false;
+	}
+	return !Slot.bRendered || (Slot.Content.bTimeVarying && Slot.RenderedWorldTime != WorldTime);
+}
+
+void FLightFunctionAtlasSlotAllocator::MarkRequestedSlotsDirty()
+{
+	for (FSlot& Slot : Slots)
+	{
+		if (Slot.LastRequestedPass == PassIndex)
+		{
+			Slot.bRendered = false;
+		}
+	}
+}
+
+void FLightFunctionAtlasSlotAllocator::MarkRequestedSlotsRendered()
+{
+	for (FSlot& Slot : Slots)
+	{
+		if (Slot.bAssigned && Slot.LastRequestedPass == PassIndex)
+		{
+			Slot.bRendered = true;
+			Slot.RenderedWorldTime = WorldTime;
+		}
+	}
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 FLightFunctionAtlas::FLightFunctionAtlas()
@@ -255,6 +405,7 @@ void FLightFunctionAtlas::UpdateRegisterLightSceneInfo(FLightSceneInfo* LightSce
 void FLightFunctionAtlas::ClearEmptySceneFrame(FViewInfo* View, uint32 ViewIndex, FLightFunctionAtlasSceneData* LightFunctionAtlasSceneData)
 {
 	RegisteredLights.Empty(64);
+	PersistentData = nullptr;
 	DefaultLightFunctionAtlasGlobalParameters = nullptr;
 	DefaultLightFunctionAtlasGlobalParametersUB = nullptr;
 	ViewLightFunctionAtlasGlobalParametersArray.Empty(4);
@@ -314,6 +465,18 @@ void FLightFunctionAtlas::BeginSceneFrame(const FViewFamilyInfo& ViewFamily, TAr
 			GetTranslucentUsesLightFunctionAtlas()); 
 	}
 
+	// The persistent slots are kept when the atlas is not needed for a frame, so that they are not lost to a scene capture without light functions for instance.
+	FLightFunctionAtlasPersistentData& ScenePersistentData = LightFunctionAtlasSceneData.GetPersistentData();
+	if (CVarLightFunctionAtlasPersistentSlots.GetValueOnRenderThread() > 0)
+	{
+		PersistentData = bLightFunctionAtlasEnabled ? &ScenePersistentData : nullptr;
+	}
+	else
+	{
+		ScenePersistentData.SlotAllocator.Reset(0);
+		ScenePersistentData.AtlasTexture.SafeRelease();
+	}
+
 	// We propagate bLightFunctionAtlasEnabled to all the views to ease later shader parameter decision and binding for lighting, shadow or volumetric fog for instance (avoid sending lots of parameters all over the place)
 	LightFunctionAtlasSceneData.SetData(this, bLightFunctionAtlasEnabled);
 	if (bLightFunctionAtlasEnabled)
@@ -418,32 +581,56 @@ void FLightFunctionAtlas::AllocateAtlasSlots(const TArray<FViewInfo>& Views)
 	LightFunctionsSet.Reset();
 	LightFunctionsSet.Reserve(AtlasMaxLightFunctionCount);
 
-	uint32 NextAtlasSlotX = 0;
-	uint32 NextAtlasSlotY = 0;
+	const bool bAssumeStaticMaterials = CVarLightFunctionAtlasPersistentSlotsStaticMaterials.GetValueOnRenderThread() > 0;
+
+	// Persistent slots are reassigned from scratch when the atlas layout changes
+	if (PersistentData)
+	{
+		if (PersistentData->SlotAllocator.GetSlotCount() != AtlasMaxLightFunctionCount)
+		{
+			PersistentData->SlotAllocator.Reset(AtlasMaxLightFunctionCount);
+		}
+		PersistentData->SlotAllocator.BeginAllocation(View.Family->Time.GetWorldTimeSeconds());
+	}
+
 	auto AddAtlasSlot = [&](FLightFunctionSlotKey Key, const FMaterialRenderProxy* LightFunctionMaterial)
 	{
 		check(uint32(LightFunctionsSet.Num()) < AtlasMaxLightFunctionCount);
 		const uint32 NewSlotIndex = EffectiveLightFunctionSlotArray.Num();
 
+		// Without persistent slots, the atlas is filled in order every frame
+		int32 AtlasSlotIndex = NewSlotIndex;
+		if (PersistentData)
+		{
+			const FMaterialRenderProxy* MaterialProxyForRendering = LightFunctionMaterial;
+			const FMaterial& Material = MaterialProxyForRendering->GetMaterialWithFallback(FeatureLevel, MaterialProxyForRendering);
+
+			FLightFunctionSlotContent Content;
+			Content.LFMaterialUniqueID = Key.LFMaterialUniqueID;
+			Content.LightFunctionMaterial = LightFunctionMaterial;
+			GetLightFunctionSlotParameters(*MaterialProxyForRendering, Material, FeatureLevel, bAssumeStaticMaterials, Content);
+
+			// There is always a slot not requested yet, since fewer light functions than slots have been added
+			AtlasSlotIndex = PersistentData->SlotAllocator.RequestSlot(Content);
+			check(AtlasSlotIndex != INDEX_NONE);
+		}
+
 		Key.EffectiveLightFunctionSlotIndex = NewSlotIndex;
 
 		LightFunctionsSet.Add(Key);
 
 		EffectiveLightFunctionSlot& NewAtlasSlot = EffectiveLightFunctionSlotArray.Emplace_GetRef();
 
-		NewAtlasSlot.Min = FIntPoint(NextAtlasSlotX * AtlasSlotResolution, NextAtlasSlotY * AtlasSlotResolution);
+		const uint32 AtlasSlotX = uint32(AtlasSlotIndex) % uint32(AtlasEdgeSize);
+		const uint32 AtlasSlotY = uint32(AtlasSlotIndex) / uint32(AtlasEdgeSize);
+		NewAtlasSlot.Min = FIntPoint(AtlasSlotX * AtlasSlotResolution, AtlasSlotY * AtlasSlotResolution);
 		NewAtlasSlot.Max = NewAtlasSlot.Min + FIntPoint(AtlasSlotResolution, AtlasSlotResolution);
 		NewAtlasSlot.MinU = (float(NewAtlasSlot.Min.X) + 0.5f) / AtlasResolution;
 		NewAtlasSlot.MinV = (float(NewAtlasSlot.Min.Y) + 0.5f) / AtlasResolution;
+		NewAtlasSlot.AtlasSlotIndex = AtlasSlotIndex;
 
 		NewAtlasSlot.LightFunctionMaterial = LightFunctionMaterial;
 
-		NextAtlasSlotX++;
-		if (NextAtlasSlotX == AtlasEdgeSize)
-		{
-			NextAtlasSlotX = 0;
-			NextAtlasSlotY++;
-		}
 		return NewSlotIndex;
 	};
 
@@ -690,7 +877,7 @@ void FLightFunctionAtlas::RenderLightFunctionAtlas(FRDGBuilder& GraphBuilder, TA
 	}
 }
 
-void FLightFunctionAtlas::AllocateTexture2DAtlas(FRDGBuilder& GraphBuilder)
+bool FLightFunctionAtlas::AllocateTexture2DAtlas(FRDGBuilder& GraphBuilder)
 {
 	const uint32 AtlasSlotResolution = AtlasSetup.SlotResolution;
 	const float AtlasEdgeSize = AtlasSetup.EdgeSize;
@@ -699,14 +886,23 @@ void FLightFunctionAtlas::AllocateTexture2DAtlas(FRDGBuilder& GraphBuilder)
 
 	int32 LightFunctionAtlasFormat = GetLightFunctionAtlasFormat();
 
-	RDGAtlasTexture2D = GraphBuilder.CreateTexture(FRDGTextureDesc::Create2D(
+	const FRDGTextureDesc AtlasDesc = FRDGTextureDesc::Create2D(
 		FIntPoint(AtlasResolution, AtlasResolution),
 		LightFunctionAtlasFormat == 0 ? PF_R8 : PF_R8G8B8A8,
 		FClearValueBinding::Black,
 		ETextureCreateFlags::UAV | ETextureCreateFlags::ShaderResource | ETextureCreateFlags::RenderTargetable,
-		MipCount),
-		TEXT("LightFunction.Atlas"),
-		ERDGTextureFlags::MultiFrame);
+		MipCount);
+
+	if (PersistentData && PersistentData->AtlasTexture.IsValid()
+		&& PersistentData->AtlasTexture->GetDesc().Extent == AtlasDesc.Extent
+		&& PersistentData->AtlasTexture->GetDesc().Format == AtlasDesc.Format)
+	{
+		RDGAtlasTexture2D = GraphBuilder.RegisterExternalTexture(PersistentData->AtlasTexture);
+		return true;
+	}
+
+	RDGAtlasTexture2D = GraphBuilder.CreateTexture(AtlasDesc, TEXT("LightFunction.Atlas"), ERDGTextureFlags::MultiFrame);
+	return false;
 }
 
 BEGIN_SHADER_PARAMETER_STRUCT(FLightFunctionAtlasRenderParameters, )
@@ -716,7 +912,40 @@ END_SHADER_PARAMETER_STRUCT()
 
 void FLightFunctionAtlas::RenderAtlasSlots(FRDGBuilder& GraphBuilder, const TArray<FViewInfo>& Views)
 {
-	AllocateTexture2DAtlas(GraphBuilder);
+	const bool bAtlasContentPreserved = AllocateTexture2DAtlas(GraphBuilder);
+
+	// Only render the slots that are new or whose content changed, the others are preserved in the persistent atlas
+	DirtyLightFunctionSlots.Reset();
+	if (PersistentData)
+	{
+		if (!bAtlasContentPreserved)
+		{
+			PersistentData->SlotAllocator.MarkRequestedSlotsDirty();
+		}
+
+		for (int32 SlotIndex = 0; SlotIndex < EffectiveLightFunctionSlotArray.Num(); ++SlotIndex)
+		{
+			if (PersistentData->SlotAllocator.IsSlotDirty(EffectiveLightFunctionSlotArray[SlotIndex].AtlasSlotIndex))
+			{
+				DirtyLightFunctionSlots.Add(SlotIndex);
+			}
+		}
+		PersistentData->SlotAllocator.MarkRequestedSlotsRendered();
+
+		GraphBuilder.QueueTextureExtraction(RDGAtlasTexture2D, &PersistentData->AtlasTexture);
+	}
+	else
+	{
+		for (int32 SlotIndex = 0; SlotIndex < EffectiveLightFunctionSlotArray.Num(); ++SlotIndex)
+		{
+			DirtyLightFunctionSlots.Add(SlotIndex);
+		}
+	}
+
+	if (DirtyLightFunctionSlots.IsEmpty() && bAtlasContentPreserved)
+	{
+		return;
+	}
 
 	SCOPED_NAMED_EVENT(LightFunctionAtlasGeneration, FColor::Emerald);
 	RDG_EVENT_SCOPE_STAT(GraphBuilder, LightFunctionAtlasGeneration, "LightFunctionAtlasGeneration");
@@ -725,7 +954,7 @@ void FLightFunctionAtlas::RenderAtlasSlots(FRDGBuilder& GraphBuilder, const TArr
 	
 	FLightFunctionAtlasRenderParameters* PassParameters = GraphBuilder.AllocParameters<FLightFunctionAtlasRenderParameters>();
 	PassParameters->View = Views[0].GetShaderParameters();
-	PassParameters->RenderTargets[0] = FRenderTargetBinding(RDGAtlasTexture2D, ERenderTargetLoadAction::ENoAction);
+	PassParameters->RenderTargets[0] = FRenderTargetBinding(RDGAtlasTexture2D, bAtlasContentPreserved ? ERenderTargetLoadAction::ELoad : ERenderTargetLoadAction::ENoAction);
 	GraphBuilder.AddPass(
 		RDG_EVENT_NAME("LightFunctionAtlas Generation"),
 		PassParameters,
@@ -739,9 +968,10 @@ void FLightFunctionAtlas::RenderAtlasSlots(FRDGBuilder& GraphBuilder, const TArr
 			// This always work because in this case we do not need anything from any view.
 			const FViewInfo& View = Views[0];
 
-			// Render all light functions and update light info
-			for (EffectiveLightFunctionSlot& Slot : EffectiveLightFunctionSlotArray)
+			// Render the dirty light functions
+			for (int32 SlotIndex : DirtyLightFunctionSlots)
 			{
+				const EffectiveLightFunctionSlot& Slot = EffectiveLightFunctionSlotArray[SlotIndex];
 				const FMaterialRenderProxy* MaterialProxyForRendering = Slot.LightFunctionMaterial;
 				if (MaterialProxyForRendering == nullptr)
 				{
@@ -6,11 +6,13 @@
 #include "LightSceneProxy.h"
 #include "RenderGraphFwd.h"
 #include "ShaderParameterMacros.h"
+#include "RendererInterface.h"
 
 class FViewFamilyInfo;
 class FViewInfo;
 class FScene;
 class FMaterialRenderProxy;
+class FMaterialShaderMap;
 class FRDGBuilder;
 class FLightSceneInfo;
 class FRDGTexture;
@@ -44,6 +46,76 @@ enum class ELightFunctionAtlasSystem
 
 struct FLightFunctionAtlas;
 
+// What is rendered in an atlas slot. A slot is rendered again when any of it changes.
+struct FLightFunctionSlotContent
+{
+	uint32 LFMaterialUniqueID = 0;
+	const FMaterialRenderProxy* LightFunctionMaterial = nullptr;
+	uint32 ParameterHash = 0;					// Hash of the proxy, shader map and evaluated parameter values the material is rendered with.
+	bool bTimeVarying = false;					// Whether the material depends on state outside of its parameters, and is rendered again when the world time changes.
+
+	bool operator==(const FLightFunctionSlotContent& Other) const
+	{
+		return LFMaterialUniqueID == Other.LFMaterialUniqueID && LightFunctionMaterial == Other.LightFunctionMaterial && ParameterHash == Other.ParameterHash && bTimeVarying == Other.bTimeVarying;
+	}
+};
+
+// Hash of the parameters a light function material is rendered with, ParameterData being its evaluated uniform buffer content.
+uint32 HashLightFunctionParameters(const FMaterialRenderProxy* MaterialProxy, const FMaterialShaderMap* ShaderMap, TConstArrayView<uint8> ParameterData);
+
+// Whether a light function slot is rendered again when the world time changes. Time read in shader code can't be detected, so this is true unless
+// static materials are opted in with r.LightFunctionAtlas.PersistentSlots.StaticMaterials, and always true for materials using parameter collections.
+bool IsLightFunctionTimeVarying(bool bUsesParameterCollections, bool bAssumeStaticMaterials);
+
+// Persistent assignment of light function materials to atlas slots.
+// A material keeps its slot for as long as it is requested. A slot is only reassigned when a new material needs one, never requested or least recently requested first.
+// This keeps slots from moving when the light sort order jitters, and lets the atlas only render the slots whose content changed.
+class FLightFunctionAtlasSlotAllocator
+{
+public:
+	// Drop all assignments, when the atlas layout changes.
+	void Reset(uint32 InSlotCount);
+
+	uint32 GetSlotCount() const { return Slots.Num(); }
+
+	// Start an allocation pass, one per scene render. Time is the view family world time that time varying slots are rendered at, it doesn't advance while paused.
+	void BeginAllocation(double InWorldTime);
+
+	// Request a slot for the content, in priority order. Returns INDEX_NONE when all slots are requested by higher priority materials in this pass.
+	int32 RequestSlot(const FLightFunctionSlotContent& Content);
+
+	// Whether the slot is requested in this pass and needs to be rendered.
+	bool IsSlotDirty(int32 SlotIndex) const;
+
+	// Mark the slots requested in this pass as dirty, when the atlas content was lost.
+	void MarkRequestedSlotsDirty();
+
+	// Record that all the dirty slots requested in this pass have been rendered.
+	void MarkRequestedSlotsRendered();
+
+private:
+	struct FSlot
+	{
+		FLightFunctionSlotContent Content;
+		uint32 LastRequestedPass = 0;
+		double RenderedWorldTime = 0.0;
+		bool bAssigned = false;
+		bool bRendered = false;
+	};
+
+	TArray<FSlot> Slots;
+	TMap<uint32, int32> MaterialToSlot;			// LFMaterialUniqueID to slot index, for assigned slots.
+	uint32 PassIndex = 0;
+	double WorldTime = 0.0;
+};
+
+// Atlas state kept in the scene across frames.
+struct FLightFunctionAtlasPersistentData
+{
+	FLightFunctionAtlasSlotAllocator SlotAllocator;
+	TRefCountPtr<IPooledRenderTarget> AtlasTexture;
+};
+
 struct FLightFunctionAtlasSceneData
 {
 	void SetData(FLightFunctionAtlas* InLightFunctionAtlas, bool bInLightFunctionAtlasEnabled)
@@ -65,11 +137,13 @@ struct FLightFunctionAtlasSceneData
 	FLightFunctionAtlas* GetLightFunctionAtlas()				const { return LightFunctionAtlas; }
 	bool UsesLightFunctionAtlas(ELightFunctionAtlasSystem In)	const { return (SystemFlags & (1u<<uint32(In))) != 0; }
 	bool GetLightFunctionAtlasEnabled()							const { return bLightFunctionAtlasEnabled; }
+	FLightFunctionAtlasPersistentData& GetPersistentData()		{ return PersistentData; }
 
 private:
 	FLightFunctionAtlas* LightFunctionAtlas = nullptr;
 	bool bLightFunctionAtlasEnabled = false;
 	uint32 SystemFlags = 0;
+	FLightFunctionAtlasPersistentData PersistentData;
 };
 
 struct FLightFunctionAtlasViewData
@@ -165,12 +239,16 @@ private:
 
 	void AllocateAtlasSlots(const TArray<FViewInfo>& Views);
 
-	void AllocateTexture2DAtlas(FRDGBuilder& GraphBuilder);
+	// Returns true when the atlas texture of the previous frame is reused, with its content.
+	bool AllocateTexture2DAtlas(FRDGBuilder& GraphBuilder);
 
 	void RenderAtlasSlots(FRDGBuilder& GraphBuilder, const TArray<FViewInfo>& Views);
 
 	bool bLightFunctionAtlasEnabled = false;
 
+	// Slots and atlas texture persistent in the scene, null when r.LightFunctionAtlas.PersistentSlots is disabled.
+	FLightFunctionAtlasPersistentData* PersistentData = nullptr;
+
 	FRDGTextureRef RDGAtlasTexture2D = nullptr;
 	FRDGBufferRef RDGLightInfoDataBuffer = nullptr;
 
@@ -188,9 +266,13 @@ private:
 		FIntPoint Max;
 		float MinU;
 		float MinV;
+		int32 AtlasSlotIndex = 0;		// Physical slot in the atlas texture.
 	};
 	TArray<EffectiveLightFunctionSlot> EffectiveLightFunctionSlotArray;
 
+	// Indices in EffectiveLightFunctionSlotArray of the slots rendered this frame.
+	TArray<int32> DirtyLightFunctionSlots;
+
 	struct EffectiveLocalLightSlot
 	{
 		FLightSceneInfo*	LightSceneInfo = nullptr;
@@ -39,6 +39,8 @@ LightGridInjection.cpp
 #include "LightGridDefinitions.h"
 #include "VolumetricFog.h"
 #include "LightViewData.h"
+#include "ForwardLightDataCache.h"
+#include "Async/ParallelFor.h"
 
 static TAutoConsoleVariable<bool> CVarLightGridAsyncCompute(
 	TEXT("r.Forward.LightGridAsyncCompute"),
@@ -64,6 +66,15 @@ static FAutoConsoleVariableRef CVarLightBufferMode(
 	ECVF_RenderThreadSafe
 );
 
+static int32 GForwardLightBufferCache = 1;
+static FAutoConsoleVariableRef CVarForwardLightBufferCache(
+	TEXT("r.Forward.LightBuffer.Cache"),
+	GForwardLightBufferCache,
+	TEXT("Whether to cache the view independent part of the forward light data in the scene, across frames and views.\n")
+	TEXT("The view dependent part is patched in parallel for each view."),
+	ECVF_RenderThreadSafe
+);
+
 int32 GLightGridPixelSize = 64;
 FAutoConsoleVariableRef CVarLightGridPixelSize(
 	TEXT("r.Forward.LightGridPixelSize"),
@@ -486,21 +497,8 @@ static void PackLightData(
 	Out.RectDataAndVirtualShadowMapIdOrPrevLocalLightIndex	= FVector4f(FMath::AsFloat(RectPackedX), FMath::AsFloat(RectPackedY), FMath::AsFloat(RectPackedZ), FMath::AsFloat(VirtualShadowMapIdAndPrevLocalLightIndex));
 }
 
-static void PackLightData(
-	FForwardLightData& Out,
-	const FViewInfo& View,
-	const FLightRenderParameters& LightParameters,
-	const uint32 LightSceneInfoExtraDataPacked,
-	const int32 LightSceneId,
-	const int32 VirtualShadowMapId,
-	const int32 PrevLocalLightIndex,
-	const float VolumetricScatteringIntensity)
+void FForwardLightDataCache::PackViewIndependent(FForwardLightData& Out, const FLightRenderParameters& LightParameters, uint32 LightSceneInfoExtraDataPacked, int32 LightSceneId)
 {
-	const FVector3f LightTranslatedWorldPosition(View.ViewMatrices.GetPreViewTranslation() + LightParameters.WorldPosition);
-
-	// Pack both values into a single float to keep float4 alignment
-	const uint32 PackedW = PackRG16(LightParameters.SourceLength, VolumetricScatteringIntensity);
-
 	// Pack both SourceRadius and SoftSourceRadius
 	const uint32 PackedZ = PackRG16(LightParameters.SourceRadius, LightParameters.SoftSourceRadius);
 	
@@ -517,18 +515,163 @@ static void PackLightData(
 	// IESAtlasIndex requires scaling because PackRGB10 expects inputs to be [0:1]
 	const uint32 SpecularScale_DiffuseScale_IESData = PackRGB10(LightParameters.SpecularScale, LightParameters.DiffuseScale, (LightParameters.IESAtlasIndex + 1) * (1.f / 1023.f)); // pack atlas id here? 16bit specular 8bit IES and 8 bit LightFunction
 
-	const FVector2f LightColorPacked = PackLightColor(FVector3f(LightParameters.Color));
+	// NOTE: SpotAngles needs full-precision for VSM one pass projection
+	Out.LightPositionAndInvRadius							= FVector4f(0.0f, 0.0f, 0.0f, LightParameters.InvRadius);
+	Out.LightColorAndIdAndFalloffExponent					= FVector4f(0.0f, 0.0f, LightSceneId, LightParameters.FalloffExponent);
+	Out.LightDirectionAndSceneInfoExtraDataPacked			= FVector4f(LightParameters.Direction, FMath::AsFloat(LightSceneInfoExtraDataPacked));
+	Out.SpotAnglesAndSourceRadiusPacked						= FVector4f(LightParameters.SpotAngles.X, LightParameters.SpotAngles.Y, FMath::AsFloat(PackedZ), 0.0f);
+	Out.LightTangentAndIESDataAndSpecularScale				= FVector4f(LightParameters.Tangent, FMath::AsFloat(SpecularScale_DiffuseScale_IESData));
+	Out.RectDataAndVirtualShadowMapIdOrPrevLocalLightIndex	= FVector4f(FMath::AsFloat(RectPackedX), FMath::AsFloat(RectPackedY), FMath::AsFloat(RectPackedZ), 0.0f);
+}
+
+void FForwardLightDataCache::PatchViewDependent(
+	FForwardLightData& Out,
+	const FVector& PreViewTranslation,
+	const FVector& LightWorldPosition,
+	const FLinearColor& LightColor,
+	uint32 PackedW,
+	int32 VirtualShadowMapId,
+	int32 PrevLocalLightIndex)
+{
+	const FVector3f LightTranslatedWorldPosition(PreViewTranslation + LightWorldPosition);
+	const FVector2f LightColorPacked = PackLightColor(FVector3f(LightColor));
 
 	const uint32 VirtualShadowMapIdAndPrevLocalLightIndex = 
 		PackVirtualShadowMapIdAndPrevLocalLightIndex(VirtualShadowMapId, PrevLocalLightIndex);
 
-	// NOTE: SpotAngles needs full-precision for VSM one pass projection
-	Out.LightPositionAndInvRadius							= FVector4f(LightTranslatedWorldPosition, LightParameters.InvRadius);
-	Out.LightColorAndIdAndFalloffExponent					= FVector4f(LightColorPacked.X, LightColorPacked.Y, LightSceneId, LightParameters.FalloffExponent);
-	Out.LightDirectionAndSceneInfoExtraDataPacked			= FVector4f(LightParameters.Direction, FMath::AsFloat(LightSceneInfoExtraDataPacked));
-	Out.SpotAnglesAndSourceRadiusPacked						= FVector4f(LightParameters.SpotAngles.X, LightParameters.SpotAngles.Y, FMath::AsFloat(PackedZ), FMath::AsFloat(PackedW));
-	Out.LightTangentAndIESDataAndSpecularScale				= FVector4f(LightParameters.Tangent, FMath::AsFloat(SpecularScale_DiffuseScale_IESData));
-	Out.RectDataAndVirtualShadowMapIdOrPrevLocalLightIndex	= FVector4f(FMath::AsFloat(RectPackedX), FMath::AsFloat(RectPackedY), FMath::AsFloat(RectPackedZ), FMath::AsFloat(VirtualShadowMapIdAndPrevLocalLightIndex));
+	Out.LightPositionAndInvRadius.X = LightTranslatedWorldPosition.X;
+	Out.LightPositionAndInvRadius.Y = LightTranslatedWorldPosition.Y;
+	Out.LightPositionAndInvRadius.Z = LightTranslatedWorldPosition.Z;
+	Out.LightColorAndIdAndFalloffExponent.X = LightColorPacked.X;
+	Out.LightColorAndIdAndFalloffExponent.Y = LightColorPacked.Y;
+	Out.SpotAnglesAndSourceRadiusPacked.W = FMath::AsFloat(PackedW);
+	Out.RectDataAndVirtualShadowMapIdOrPrevLocalLightIndex.W = FMath::AsFloat(VirtualShadowMapIdAndPrevLocalLightIndex);
+}
+
+static void PackLightData(
+	FForwardLightData& Out,
+	const FViewInfo& View,
+	const FLightRenderParameters& LightParameters,
+	const uint32 LightSceneInfoExtraDataPacked,
+	const int32 LightSceneId,
+	const int32 VirtualShadowMapId,
+	const int32 PrevLocalLightIndex,
+	const float VolumetricScatteringIntensity)
+{
+	// Pack both values into a single float to keep float4 alignment
+	const uint32 PackedW = PackRG16(LightParameters.SourceLength, VolumetricScatteringIntensity);
+
+	FForwardLightDataCache::PackViewIndependent(Out, LightParameters, LightSceneInfoExtraDataPacked, LightSceneId);
+	FForwardLightDataCache::PatchViewDependent(Out, View.ViewMatrices.GetPreViewTranslation(), LightParameters.WorldPosition, LightParameters.Color, PackedW, VirtualShadowMapId, PrevLocalLightIndex);
+}
+
+void FForwardLightDataCache::OnPostLightSceneInfoUpdate(const FLightSceneChangeSet& ChangeSet)
+{
+	auto Invalidate = [this](int32 LightSceneId)
+	{
+		if (Entries.IsValidIndex(LightSceneId))
+		{
+			Entries[LightSceneId].bValid = false;
+		}
+	};
+
+	for (int32 LightSceneId : ChangeSet.RemovedLightIds)
+	{
+		Invalidate(LightSceneId);
+	}
+	for (int32 LightSceneId : ChangeSet.AddedLightIds)
+	{
+		Invalidate(LightSceneId);
+	}
+	ChangeSet.SceneLightInfoUpdates.ForEachCommand(ESceneUpdateCommandFilter::AddedUpdated, [&](const FUpdateLightCommand& UpdateLightCommand)
+	{
+		Invalidate(UpdateLightCommand.GetSceneInfo()->Id);
+	});
+}
+
+void FForwardLightDataCache::Update(FScene& Scene, const FSortedLightSetSceneInfo& SortedLightSet, bool bAllowStaticLighting, uint32 LightShaderParameterFlags)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FForwardLightDataCache::Update);
+
+	if (LightShaderParameterFlags != CachedLightShaderParameterFlags)
+	{
+		Entries.Reset();
+		CachedLightShaderParameterFlags = LightShaderParameterFlags;
+	}
+
+	if (Entries.Num() < Scene.Lights.GetMaxIndex())
+	{
+		Entries.SetNum(Scene.Lights.GetMaxIndex());
+	}
+
+	const bool bRectAsSpotLight = (LightShaderParameterFlags & ELightShaderParameterFlags::RectAsSpotLight) != 0;
+	const TArray<FSortedLightSceneInfo, SceneRenderingAllocator>& SortedLights = SortedLightSet.SortedLights;
+	const int32 NumLights = SortedLights.Num() - SortedLightSet.SimpleLightsEnd;
+
+	ParallelFor(TEXT("ForwardLightDataCache.Update"), NumLights, 32, [&](int32 Index)
+	{
+		const FSortedLightSceneInfo& SortedLightInfo = SortedLights[SortedLightSet.SimpleLightsEnd + Index];
+		const FLightSceneInfo* const LightSceneInfo = SortedLightInfo.LightSceneInfo;
+		const FLightSceneProxy* LightProxy = LightSceneInfo->Proxy;
+		FEntry& Entry = Entries[LightSceneInfo->Id];
+
+		bool bRepack = false;
+
+		if (!Entry.bValid || SortedLightInfo.SortKey.Fields.LightType == LightType_Directional)
+		{
+			LightProxy->GetLightShaderParameters(Entry.LightParameters, LightShaderParameterFlags);
+
+			if (LightProxy->IsInverseSquared())
+			{
+				Entry.LightParameters.FalloffExponent = 0;
+			}
+
+			const float VolumetricScatteringIntensity = LightProxy->GetVolumetricScatteringIntensity();
+			Entry.PackedW = PackRG16(Entry.LightParameters.SourceLength, VolumetricScatteringIntensity);
+			Entry.PackedWNoVolumetricScattering = PackRG16(Entry.LightParameters.SourceLength, 0.0f);
+			Entry.bValid = true;
+			bRepack = true;
+		}
+		else
+		{
+			// Refresh what can change without a light scene update
+			FLightRenderParameters& LightParameters = Entry.LightParameters;
+			const float IESAtlasIndex = LightParameters.IESAtlasIndex;
+			const FVector2f RectLightAtlasUVOffset = LightParameters.RectLightAtlasUVOffset;
+			const FVector2f RectLightAtlasUVScale = LightParameters.RectLightAtlasUVScale;
+			const float RectLightAtlasMaxLevel = LightParameters.RectLightAtlasMaxLevel;
+			const uint32 LightFunctionAtlasLightIndex = LightParameters.LightFunctionAtlasLightIndex;
+
+			const bool bRectLight = LightProxy->IsRectLight();
+			if (!bRectLight || !bRectAsSpotLight)
+			{
+				Scene.GetLightIESAtlasSlot(LightProxy, &LightParameters);
+			}
+			if (bRectLight && !bRectAsSpotLight)
+			{
+				Scene.GetRectLightAtlasSlot((const FRectLightSceneProxy*)LightProxy, &LightParameters);
+			}
+			LightParameters.LightFunctionAtlasLightIndex = LightProxy->GetLightFunctionAtlasLightIndex();
+
+			bRepack = IESAtlasIndex != LightParameters.IESAtlasIndex
+				|| RectLightAtlasUVOffset != LightParameters.RectLightAtlasUVOffset
+				|| RectLightAtlasUVScale != LightParameters.RectLightAtlasUVScale
+				|| RectLightAtlasMaxLevel != LightParameters.RectLightAtlasMaxLevel
+				|| LightFunctionAtlasLightIndex != LightParameters.LightFunctionAtlasLightIndex;
+		}
+
+		const uint32 LightSceneInfoExtraDataPacked = LightSceneInfo->PackExtraData(
+			bAllowStaticLighting,
+			SortedLightInfo.SortKey.Fields.bLightFunction,
+			SortedLightInfo.SortKey.Fields.bHandledByMegaLights,
+			!SortedLightInfo.SortKey.Fields.bClusteredDeferredNotSupported);
+
+		if (bRepack || LightSceneInfoExtraDataPacked != Entry.LightSceneInfoExtraDataPacked)
+		{
+			Entry.LightSceneInfoExtraDataPacked = LightSceneInfoExtraDataPacked;
+			PackViewIndependent(Entry.PackedData, Entry.LightParameters, LightSceneInfoExtraDataPacked, LightSceneInfo->Id);
+		}
+	});
 }
 
 static const uint32 NUM_PLANES_PER_RECT_LIGHT = 4;
@@ -810,6 +953,31 @@ FComputeLightGridOutput FSceneRenderer::ComputeLightGrid(FRDGBuilder& GraphBuild
 	bool bMultipleDirLightsConflictForForwardShading = false;
 #endif
 
+	const uint32 LightShaderParameterFlags = bRenderRectLightsAsSpotLights ? ELightShaderParameterFlags::RectAsSpotLight : 0u;
+
+	// The view independent part of the forward light data is cached in the scene and updated once for all views
+	FForwardLightDataCache* ForwardLightDataCache = nullptr;
+	if (bCullLightsToGrid && GForwardLightBufferCache != 0)
+	{
+		if (!Scene->ForwardLightDataCache.IsValid())
+		{
+			Scene->ForwardLightDataCache = MakePimpl<FForwardLightDataCache>();
+		}
+		ForwardLightDataCache = Scene->ForwardLightDataCache.Get();
+		ForwardLightDataCache->Update(*Scene, SortedLightSet, bAllowStaticLighting, LightShaderParameterFlags);
+	}
+
+	/** View dependent fields of a cached light, patched once all the lights of the view are assigned. */
+	struct FForwardLightDataPatch
+	{
+		int32 IndexInBuffer;
+		int32 LightSceneId;
+		int32 VirtualShadowMapId;
+		int32 PrevForwardLightIndex;
+		FLinearColor LightColor;
+		bool bDisableVolumetricScattering;
+	};
+
 	for (int32 ViewIndex = 0; ViewIndex < Views.Num(); ViewIndex++)
 	{
 		FViewInfo& View = Views[ViewIndex];
@@ -844,6 +1012,8 @@ FComputeLightGridOutput FSceneRenderer::ComputeLightGrid(FRDGBuilder& GraphBuild
 
 		TArray<int32, SceneRenderingAllocator> IndirectionIndices;
 
+		TArray<FForwardLightDataPatch, SceneRenderingAllocator> ForwardLightDataPatches;
+
 		float FurthestLight = 1000;
 
 		int32 ConflictingLightCountForForwardShading = 0;
@@ -881,7 +1051,6 @@ FComputeLightGridOutput FSceneRenderer::ComputeLightGrid(FRDGBuilder& GraphBuild
 				ViewSpaceRectPlanesData.AddZeroed(SimpleLightsEnd * NUM_PLANES_PER_RECT_LIGHT);
 			}
 
-			const uint32 LightShaderParameterFlags = bRenderRectLightsAsSpotLights ? ELightShaderParameterFlags::RectAsSpotLight : 0u;
 			float SelectedForwardDirectionalLightIntensitySq = 0.0f;
 			int32 SelectedForwardDirectionalLightPriority = -1;
 			const TArray<FSortedLightSceneInfo, SceneRenderingAllocator>& SortedLights = SortedLightSet.SortedLights;
@@ -899,11 +1068,28 @@ FComputeLightGridOutput FSceneRenderer::ComputeLightGrid(FRDGBuilder& GraphBuild
 					(AssociatedPrimaryView && LightSceneInfo->ShouldRenderLight(*AssociatedPrimaryView)))
 				{
 					FLightRenderParameters LightParameters;
-					LightProxy->GetLightShaderParameters(LightParameters, LightShaderParameterFlags);
+					uint32 LightSceneInfoExtraDataPacked;
 
-					if (LightProxy->IsInverseSquared())
+					if (ForwardLightDataCache)
 					{
-						LightParameters.FalloffExponent = 0;
+						const FForwardLightDataCache::FEntry& CacheEntry = ForwardLightDataCache->GetEntry(LightSceneInfo->Id);
+						LightParameters = CacheEntry.LightParameters;
+						LightSceneInfoExtraDataPacked = CacheEntry.LightSceneInfoExtraDataPacked;
+					}
+					else
+					{
+						LightProxy->GetLightShaderParameters(LightParameters, LightShaderParameterFlags);
+
+						if (LightProxy->IsInverseSquared())
+						{
+							LightParameters.FalloffExponent = 0;
+						}
+
+						LightSceneInfoExtraDataPacked = LightSceneInfo->PackExtraData(
+							bAllowStaticLighting,
+							SortedLightInfo.SortKey.Fields.bLightFunction,
+							SortedLightInfo.SortKey.Fields.bHandledByMegaLights,
+							!SortedLightInfo.SortKey.Fields.bClusteredDeferredNotSupported);
 					}
 
 					// When rendering reflection captures, the direct lighting of the light is actually the indirect specular from the main view
@@ -912,12 +1098,6 @@ FComputeLightGridOutput FSceneRenderer::ComputeLightGrid(FRDGBuilder& GraphBuild
 						LightParameters.Color *= LightProxy->GetIndirectLightingScale();
 					}
 
-					uint32 LightSceneInfoExtraDataPacked = LightSceneInfo->PackExtraData(
-						bAllowStaticLighting,
-						SortedLightInfo.SortKey.Fields.bLightFunction,
-						SortedLightInfo.SortKey.Fields.bHandledByMegaLights,
-						!SortedLightInfo.SortKey.Fields.bClusteredDeferredNotSupported);
-
 					const bool bDynamicShadows = ViewFamily.EngineShowFlags.DynamicShadows && VisibleLightInfos.IsValidIndex(LightSceneInfo->Id);
 					const int32 VirtualShadowMapId = bDynamicShadows ? VisibleLightInfos[LightSceneInfo->Id].GetVirtualShadowMapId( &View ) : INDEX_NONE;
 
@@ -928,7 +1108,6 @@ FComputeLightGridOutput FSceneRenderer::ComputeLightGrid(FRDGBuilder& GraphBuild
 						|| (GLightBufferMode != (int32)ELightBufferMode::VisibleLocalLights && SortedLightInfo.SortKey.Fields.LightType == LightType_Directional && ViewFamily.EngineShowFlags.DirectionalLights))
 					{
 						const int32 IndexInBuffer = GLightBufferMode == (int32)ELightBufferMode::VisibleLightsStableIndices ? LightSceneInfo->Id : ForwardLightData.AddUninitialized(1);
-						FForwardLightData& LightData = ForwardLightData[IndexInBuffer];
 
 						int32 PrevForwardLightIndex = INDEX_NONE;
 						if (View.ViewState)
@@ -955,22 +1134,27 @@ FComputeLightGridOutput FSceneRenderer::ComputeLightGrid(FRDGBuilder& GraphBuild
 						LightParameters.Color *= LightFade;
 						LightParameters.Color *= LightParameters.GetLightExposureScale(Exposure);
 
-						float VolumetricScatteringIntensity = LightProxy->GetVolumetricScatteringIntensity();
-						if (LightNeedsSeparateInjectionIntoVolumetricFogForOpaqueShadow(View, LightSceneInfo, VisibleLightInfos[LightSceneInfo->Id], *Scene))
+						// Disable this lights forward shading volumetric scattering contribution
+						const bool bDisableVolumetricScattering = LightNeedsSeparateInjectionIntoVolumetricFogForOpaqueShadow(View, LightSceneInfo, VisibleLightInfos[LightSceneInfo->Id], *Scene);
+
+						if (ForwardLightDataCache)
 						{
-							// Disable this lights forward shading volumetric scattering contribution
-							VolumetricScatteringIntensity = 0;
+							ForwardLightDataPatches.Add({ IndexInBuffer, LightSceneInfo->Id, VirtualShadowMapId, PrevForwardLightIndex, LightParameters.Color, bDisableVolumetricScattering });
+						}
+						else
+						{
+							const float VolumetricScatteringIntensity = bDisableVolumetricScattering ? 0.0f : LightProxy->GetVolumetricScatteringIntensity();
+
+							PackLightData(
+								ForwardLightData[IndexInBuffer],
+								View,
+								LightParameters,
+								LightSceneInfoExtraDataPacked,
+								LightSceneInfo->Id,
+								VirtualShadowMapId,
+								PrevForwardLightIndex,
+								VolumetricScatteringIntensity);
 						}
-
-						PackLightData(
-							LightData,
-							View,
-							LightParameters,
-							LightSceneInfoExtraDataPacked,
-							LightSceneInfo->Id,
-							VirtualShadowMapId,
-							PrevForwardLightIndex,
-							VolumetricScatteringIntensity);
 					}
 
 					if ((SortedLightInfo.SortKey.Fields.LightType == LightType_Point && ViewFamily.EngineShowFlags.PointLights)
@@ -1149,6 +1333,30 @@ FComputeLightGridOutput FSceneRenderer::ComputeLightGrid(FRDGBuilder& GraphBuild
 				}
 			}
 
+			// 2. patch the view dependent fields of the cached lights
+			if (ForwardLightDataPatches.Num() > 0)
+			{
+				const FVector PreViewTranslation = View.ViewMatrices.GetPreViewTranslation();
+
+				ParallelFor(TEXT("ForwardLightData.PatchViewDependent"), ForwardLightDataPatches.Num(), 64, [&](int32 PatchIndex)
+				{
+					const FForwardLightDataPatch& Patch = ForwardLightDataPatches[PatchIndex];
+					const FForwardLightDataCache::FEntry& CacheEntry = ForwardLightDataCache->GetEntry(Patch.LightSceneId);
+
+					FForwardLightData& LightData = ForwardLightData[Patch.IndexInBuffer];
+					LightData = CacheEntry.PackedData;
+
+					FForwardLightDataCache::PatchViewDependent(
+						LightData,
+						PreViewTranslation,
+						CacheEntry.LightParameters.WorldPosition,
+						Patch.LightColor,
+						Patch.bDisableVolumetricScattering ? CacheEntry.PackedWNoVolumetricScattering : CacheEntry.PackedW,
+						Patch.VirtualShadowMapId,
+						Patch.PrevForwardLightIndex);
+				});
+			}
+
 			// 3. add simple lights into ForwardLightData and fill uninitialized ViewSpacePosAndRadiusData/IndirectionIndices
 			if (SimpleLightsEnd > 0)
 			{
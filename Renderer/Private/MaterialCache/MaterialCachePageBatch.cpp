@@ -0,0 +1,127 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "MaterialCache/MaterialCachePageBatch.h"
+#include "Containers/Map.h"
+
+uint32 GetMaterialCacheStackHash(const FMaterialCacheStack& Stack)
+{
+	uint32 Hash = GetTypeHash(Stack.Stack.Num());
+	for (const FMaterialCacheStackEntry& Entry : Stack.Stack)
+	{
+		Hash = HashCombineFast(Hash, GetTypeHash(Entry.Material));
+	}
+	return Hash;
+}
+
+bool AreMaterialCacheStacksEqual(const FMaterialCacheStack& A, const FMaterialCacheStack& B)
+{
+	if (A.Stack.Num() != B.Stack.Num())
+	{
+		return false;
+	}
+
+	for (int32 StackIndex = 0; StackIndex < A.Stack.Num(); StackIndex++)
+	{
+		if (A.Stack[StackIndex].Material != B.Stack[StackIndex].Material)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void MaterialCacheBuildPageBatch(TConstArrayView<FPrimitiveComponentId> EntryPrimitiveIds, TConstArrayView<int32> EntryPageCounts, FMaterialCachePageBatch& OutBatch)
+{
+	check(EntryPrimitiveIds.Num() == EntryPageCounts.Num());
+
+	OutBatch = FMaterialCachePageBatch();
+	OutBatch.EntryGroups.SetNumUninitialized(EntryPrimitiveIds.Num());
+	OutBatch.EntryPageOffsets.SetNumUninitialized(EntryPrimitiveIds.Num());
+	OutBatch.EntryABufferPageOffsets.SetNumUninitialized(EntryPrimitiveIds.Num());
+
+	TMap<FPrimitiveComponentId, int32> PrimitiveGroups;
+	PrimitiveGroups.Reserve(EntryPrimitiveIds.Num());
+
+	for (int32 EntryIndex = 0; EntryIndex < EntryPrimitiveIds.Num(); EntryIndex++)
+	{
+		const int32 PageCount = EntryPageCounts[EntryIndex];
+		check(PageCount >= 0);
+
+		OutBatch.EntryPageOffsets[EntryIndex] = OutBatch.NumPages;
+		OutBatch.NumPages += PageCount;
+
+		if (!EntryPrimitiveIds[EntryIndex].IsValid())
+		{
+			OutBatch.EntryGroups[EntryIndex] = INDEX_NONE;
+			OutBatch.EntryABufferPageOffsets[EntryIndex] = UINT32_MAX;
+			continue;
+		}
+
+		int32& Group = PrimitiveGroups.FindOrAdd(EntryPrimitiveIds[EntryIndex], INDEX_NONE);
+		if (Group == INDEX_NONE)
+		{
+			Group = OutBatch.NumGroups++;
+		}
+
+		OutBatch.EntryGroups[EntryIndex] = Group;
+		OutBatch.EntryABufferPageOffsets[EntryIndex] = OutBatch.NumABufferPages;
+		OutBatch.NumABufferPages += PageCount;
+	}
+
+	OutBatch.PageStackIndices.Init(INDEX_NONE, OutBatch.NumPages);
+}
+
+void MaterialCacheDeduplicatePageStacks(TArrayView<FMaterialCacheStack> PageStacks, FMaterialCachePageBatch& InOutBatch)
+{
+	check(PageStacks.Num() == InOutBatch.NumPages);
+
+	InOutBatch.UniqueStacks.Reset();
+	InOutBatch.UniqueStackGroups.Reset();
+
+	// Group and stack hash to the first unique stack, hash collisions are chained
+	TMap<uint64, int32> FirstUniqueStacks;
+	TArray<int32> NextUniqueStacks;
+
+	for (int32 EntryIndex = 0; EntryIndex < InOutBatch.EntryGroups.Num(); EntryIndex++)
+	{
+		const int32 Group = InOutBatch.EntryGroups[EntryIndex];
+		if (Group == INDEX_NONE)
+		{
+			continue;
+		}
+
+		const int32 PageBegin = InOutBatch.EntryPageOffsets[EntryIndex];
+		const int32 PageEnd = EntryIndex + 1 < InOutBatch.EntryPageOffsets.Num() ? InOutBatch.EntryPageOffsets[EntryIndex + 1] : InOutBatch.NumPages;
+
+		for (int32 PageIndex = PageBegin; PageIndex < PageEnd; PageIndex++)
+		{
+			FMaterialCacheStack& Stack = PageStacks[PageIndex];
+			if (Stack.Stack.IsEmpty())
+			{
+				InOutBatch.PageStackIndices[PageIndex] = INDEX_NONE;
+				continue;
+			}
+
+			const uint64 Key = (uint64(Group) << 32) | GetMaterialCacheStackHash(Stack);
+
+			int32& FirstUniqueStack = FirstUniqueStacks.FindOrAdd(Key, INDEX_NONE);
+
+			int32 UniqueStackIndex = FirstUniqueStack;
+			while (UniqueStackIndex != INDEX_NONE && !AreMaterialCacheStacksEqual(InOutBatch.UniqueStacks[UniqueStackIndex], Stack))
+			{
+				UniqueStackIndex = NextUniqueStacks[UniqueStackIndex];
+			}
+
+			if (UniqueStackIndex == INDEX_NONE)
+			{
+				UniqueStackIndex = InOutBatch.UniqueStacks.Add(MoveTemp(Stack));
+				InOutBatch.UniqueStackGroups.Add(Group);
+				NextUniqueStacks.Add(FirstUniqueStack);
+				FirstUniqueStack = UniqueStackIndex;
+			}
+
+			InOutBatch.PageStackIndices[PageIndex] = UniqueStackIndex;
+		}
+	}
+}
@@ -18,10 +18,12 @@
 #include "RendererModule.h"
 #include "MaterialCache/MaterialCache.h"
 #include "MaterialCache/MaterialCacheMeshProcessor.h"
+#include "MaterialCache/MaterialCachePageBatch.h"
 #include "MaterialCache/MaterialCachePrimitiveData.h"
 #include "MaterialCache/MaterialCacheSceneExtension.h"
 #include "MaterialCache/MaterialCacheStackProvider.h"
 #include "Materials/MaterialRenderProxy.h"
+#include "Async/ParallelFor.h"
 
 static void MaterialCacheInvalidateRenderStates(IConsoleVariable*)
 {
@@ -55,6 +57,14 @@ static FAutoConsoleVariableRef CVarMaterialCacheCommandCaching(
 	ECVF_RenderThreadSafe | ECVF_Scalability
 );
 
+bool GMaterialCacheParallelStackEvaluation = true;
+static FAutoConsoleVariableRef CVarMaterialCacheParallelStackEvaluation(
+	TEXT("r.MaterialCache.ParallelStackEvaluation"),
+	GMaterialCacheParallelStackEvaluation,
+	TEXT("Enable parallel evaluation of the page stacks of thread-safe stack providers"),
+	ECVF_RenderThreadSafe
+);
+
 BEGIN_SHADER_PARAMETER_STRUCT(FMaterialCacheABufferParameters, )
 	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2DArray<float4>, RWABuffer0)
 	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2DArray<float4>, RWABuffer1)
@@ -479,12 +489,6 @@ void MaterialCacheAllocateHardwareRasterPage(FSceneRenderer* Renderer, const FMa
 	}
 }
 
-static uint32_t AllocateMaterialCacheABufferPage(FMaterialCacheRenderData& RenderData, const FMaterialCachePageEntry& Page)
-{
-	RenderData.ABuffer.Pages.Add(Page);
-	return RenderData.ABuffer.Pages.Num() - 1;
-}
-
 static FMaterialCachePageAllocation AllocateMaterialCacheRenderPathPage(FMaterialCacheRenderData& RenderData, FMaterialCachePendingPageEntry& Page, uint32_t EntryIndex, EMaterialCacheRenderPath RenderPath, uint32& PageAllocationSet)
 {
 	FMaterialCachePageCollection& Collection = RenderData.PageCollections[static_cast<uint32>(RenderPath)];
@@ -564,71 +568,222 @@ static const FMaterialRenderProxy* GetMaterialCacheDefaultMaterial(const FPrimit
 	}
 }
 
-static void MaterialCacheAllocateAndBatchPages(FSceneRenderer* Renderer, FRDGBuilder& GraphBuilder, FMaterialCacheSceneExtension& SceneExtension, FMaterialCacheBlackboardData& Data)
+/** Primitive state resolved once per group of entries */
+struct FMaterialCacheResolvedPrimitive
 {
-	FMaterialCacheRenderData& RenderData = Data.RenderData;
+	const FPrimitiveSceneProxy* PrimitiveSceneProxy = nullptr;
+	const FPrimitiveSceneInfo* PrimitiveSceneInfo = nullptr;
+	FMaterialCachePrimitiveData* PrimitiveData = nullptr;
+	UMaterialCacheStackProvider* Provider = nullptr;
+};
 
-	for (int32 EntryIndex = 0; EntryIndex < Data.PendingEntries.Num(); EntryIndex++)
+static bool MaterialCacheResolvePrimitive(FMaterialCacheSceneExtension& SceneExtension, FPrimitiveComponentId PrimitiveComponentId, FMaterialCacheResolvedPrimitive& OutPrimitive)
+{
+	OutPrimitive.PrimitiveSceneProxy = SceneExtension.GetSceneProxy(PrimitiveComponentId);
+	if (!OutPrimitive.PrimitiveSceneProxy)
 	{
-		FMaterialCacheBlackboardPendingEntry& Entry = Data.PendingEntries[EntryIndex];
+		UE_LOG(LogRenderer, Error, TEXT("Failed to get primitive scene proxy"));
+		return false;
+	}
+
+	OutPrimitive.PrimitiveSceneInfo = OutPrimitive.PrimitiveSceneProxy->GetPrimitiveSceneInfo();
+	if (!OutPrimitive.PrimitiveSceneInfo)
+	{
+		UE_LOG(LogRenderer, Error, TEXT("Failed to get primitive scene info"));
+		return false;
+	}
+	
+	OutPrimitive.PrimitiveData = SceneExtension.GetPrimitiveData(PrimitiveComponentId);
+	if (!OutPrimitive.PrimitiveData)
+	{
+		UE_LOG(LogRenderer, Error, TEXT("Failed to get primitive data"));
+		return false;
+	}
+
+	// If caching is disabled, always rebuild
+	if (!GMaterialCacheComamndCaching)
+	{
+		OutPrimitive.PrimitiveData->CachedCommands = {};
+	}
+
+	OutPrimitive.Provider = OutPrimitive.PrimitiveData->Provider.StackProvider.Get();
+	return true;
+}
+
+static void MaterialCacheEvaluatePageStacks(const FMaterialCacheBlackboardData& Data, const FMaterialCachePageBatch& Batch, TConstArrayView<FMaterialCacheResolvedPrimitive> Primitives, TArrayView<FMaterialCacheStack> OutPageStacks)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(MaterialCacheEvaluatePageStacks);
 
-		const FPrimitiveSceneProxy* PrimitiveSceneProxy = SceneExtension.GetSceneProxy(Entry.Setup.PrimitiveComponentId);
-		if (!PrimitiveSceneProxy)
+	struct FPageEvaluation
+	{
+		UMaterialCacheStackProvider* Provider;
+		const FBox2f* UVRect;
+		int32 PageIndex;
+	};
+
+	TArray<FPageEvaluation, SceneRenderingAllocator> ParallelEvaluations;
+	TArray<FPageEvaluation, SceneRenderingAllocator> SerialEvaluations;
+
+	for (int32 EntryIndex = 0; EntryIndex < Data.PendingEntries.Num(); EntryIndex++)
+	{
+		const int32 Group = Batch.EntryGroups[EntryIndex];
+		if (Group == INDEX_NONE)
 		{
-			UE_LOG(LogRenderer, Error, TEXT("Failed to get primitive scene proxy"));
 			continue;
 		}
 
-		const FPrimitiveSceneInfo* PrimitiveSceneInfo = PrimitiveSceneProxy->GetPrimitiveSceneInfo();
-		if (!PrimitiveSceneInfo)
+		const FMaterialCacheResolvedPrimitive& Primitive = Primitives[Group];
+		const FMaterialCacheBlackboardPendingEntry& Entry = Data.PendingEntries[EntryIndex];
+		const int32 PageOffset = Batch.EntryPageOffsets[EntryIndex];
+
+		// Providers are optional, if none is supplied, just assume the primary material as a stack entry
+		if (!Primitive.Provider)
 		{
-			UE_LOG(LogRenderer, Error, TEXT("Failed to get primitive scene info"));
+			FMaterialCacheStackEntry StackEntry;
+			StackEntry.Material = GetMaterialCacheDefaultMaterial(Primitive.PrimitiveSceneProxy, Primitive.PrimitiveSceneInfo);
+
+			for (int32 PageIndex = 0; PageIndex < Entry.Pages.Num(); PageIndex++)
+			{
+				OutPageStacks[PageOffset + PageIndex].Stack.Add(StackEntry);
+			}
 			continue;
 		}
-		
-		FMaterialCachePrimitiveData* PrimitiveData = SceneExtension.GetPrimitiveData(Entry.Setup.PrimitiveComponentId);
-		if (!PrimitiveData)
+
+		TArray<FPageEvaluation, SceneRenderingAllocator>& Evaluations = (GMaterialCacheParallelStackEvaluation && Primitive.Provider->IsThreadSafe()) ? ParallelEvaluations : SerialEvaluations;
+		for (int32 PageIndex = 0; PageIndex < Entry.Pages.Num(); PageIndex++)
+		{
+			Evaluations.Add({ Primitive.Provider, &Entry.Pages[PageIndex].Page.UVRect, PageOffset + PageIndex });
+		}
+	}
+
+	// Pages are independent, each evaluation writes its own stack
+	ParallelFor(TEXT("MaterialCacheEvaluatePageStacks"), ParallelEvaluations.Num(), 8, [&ParallelEvaluations, OutPageStacks](int32 Index)
+	{
+		const FPageEvaluation& Evaluation = ParallelEvaluations[Index];
+		Evaluation.Provider->Evaluate(*Evaluation.UVRect, &OutPageStacks[Evaluation.PageIndex]);
+	});
+
+	for (const FPageEvaluation& Evaluation : SerialEvaluations)
+	{
+		Evaluation.Provider->Evaluate(*Evaluation.UVRect, &OutPageStacks[Evaluation.PageIndex]);
+	}
+}
+
+static void MaterialCacheAllocateAndBatchPages(FSceneRenderer* Renderer, FRDGBuilder& GraphBuilder, FMaterialCacheSceneExtension& SceneExtension, FMaterialCacheBlackboardData& Data)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(MaterialCacheAllocateAndBatchPages);
+
+	FMaterialCacheRenderData& RenderData = Data.RenderData;
+
+	// Resolve all primitives once, entries of unresolved primitives are skipped
+	TMap<FPrimitiveComponentId, bool, SceneRenderingSetAllocator> PrimitiveResolved;
+	TArray<FMaterialCacheResolvedPrimitive, SceneRenderingAllocator> Primitives;
+	TArray<FPrimitiveComponentId, SceneRenderingAllocator> EntryPrimitiveIds;
+	TArray<int32, SceneRenderingAllocator> EntryPageCounts;
+	EntryPrimitiveIds.Reserve(Data.PendingEntries.Num());
+	EntryPageCounts.Reserve(Data.PendingEntries.Num());
+
+	for (const FMaterialCacheBlackboardPendingEntry& Entry : Data.PendingEntries)
+	{
+		const FPrimitiveComponentId PrimitiveComponentId = Entry.Setup.PrimitiveComponentId;
+
+		bool* bResolved = PrimitiveResolved.Find(PrimitiveComponentId);
+		if (!bResolved)
+		{
+			FMaterialCacheResolvedPrimitive Primitive;
+			bResolved = &PrimitiveResolved.Add(PrimitiveComponentId, MaterialCacheResolvePrimitive(SceneExtension, PrimitiveComponentId, Primitive));
+			if (*bResolved)
+			{
+				// Groups are assigned in order of first appearance, matching the batch layout
+				Primitives.Add(Primitive);
+			}
+		}
+
+		EntryPrimitiveIds.Add(*bResolved ? PrimitiveComponentId : FPrimitiveComponentId());
+		EntryPageCounts.Add(Entry.Pages.Num());
+	}
+
+	FMaterialCachePageBatch Batch;
+	MaterialCacheBuildPageBatch(EntryPrimitiveIds, EntryPageCounts, Batch);
+	check(Batch.NumGroups == Primitives.Num());
+
+	// Allocate the a-buffer pages of each entry as a single contiguous run, including pages with empty stacks
+	RenderData.ABuffer.Pages.Reserve(RenderData.ABuffer.Pages.Num() + Batch.NumABufferPages);
+	for (int32 EntryIndex = 0; EntryIndex < Data.PendingEntries.Num(); EntryIndex++)
+	{
+		if (Batch.EntryGroups[EntryIndex] == INDEX_NONE)
 		{
-			UE_LOG(LogRenderer, Error, TEXT("Failed to get primitive data"));
 			continue;
 		}
 
-		// If caching is disabled, always rebuild
-		if (!GMaterialCacheComamndCaching)
+		FMaterialCacheBlackboardPendingEntry& Entry = Data.PendingEntries[EntryIndex];
+
+		const uint32 ABufferPageOffset = RenderData.ABuffer.Pages.Num();
+		check(ABufferPageOffset == Batch.EntryABufferPageOffsets[EntryIndex]);
+
+		RenderData.ABuffer.Pages.AddUninitialized(Entry.Pages.Num());
+		for (int32 PageIndex = 0; PageIndex < Entry.Pages.Num(); PageIndex++)
+		{
+			RenderData.ABuffer.Pages[ABufferPageOffset + PageIndex] = Entry.Pages[PageIndex].Page;
+			Entry.Pages[PageIndex].ABufferPageIndex = ABufferPageOffset + PageIndex;
+		}
+	}
+
+	// Evaluate all stacks up front, then deduplicate identical stacks within each primitive
+	{
+		TArray<FMaterialCacheStack, SceneRenderingAllocator> PageStacks;
+		PageStacks.SetNum(Batch.NumPages);
+		MaterialCacheEvaluatePageStacks(Data, Batch, Primitives, PageStacks);
+		MaterialCacheDeduplicatePageStacks(PageStacks, Batch);
+	}
+
+	// Select the render paths once per unique stack
+	TArray<int32, SceneRenderingAllocator> UniqueStackRenderPathOffsets;
+	TArray<EMaterialCacheRenderPath, SceneRenderingAllocator> UniqueStackRenderPaths;
+	UniqueStackRenderPathOffsets.SetNumUninitialized(Batch.UniqueStacks.Num());
+
+	for (int32 UniqueStackIndex = 0; UniqueStackIndex < Batch.UniqueStacks.Num(); UniqueStackIndex++)
+	{
+		const FMaterialCacheResolvedPrimitive& Primitive = Primitives[Batch.UniqueStackGroups[UniqueStackIndex]];
+
+		UniqueStackRenderPathOffsets[UniqueStackIndex] = UniqueStackRenderPaths.Num();
+		for (const FMaterialCacheStackEntry& StackEntry : Batch.UniqueStacks[UniqueStackIndex].Stack)
 		{
-			PrimitiveData->CachedCommands = {};
+			UniqueStackRenderPaths.Add(StackEntry.Material ? GetMaterialCacheRenderPath(Renderer, Primitive.PrimitiveSceneProxy, StackEntry) : EMaterialCacheRenderPath::Count);
 		}
 
-		UMaterialCacheStackProvider* Provider = PrimitiveData->Provider.StackProvider.Get();
+		if (Batch.UniqueStacks[UniqueStackIndex].Stack.Num() > RenderData.Layers.Num())
+		{
+			RenderData.Layers.SetNum(Batch.UniqueStacks[UniqueStackIndex].Stack.Num());
+		}
+	}
 
-		for (FMaterialCachePendingPageEntry& Page : Entry.Pages)
+	// Allocate the render path pages in entry order, the render path collections and nanite views depend on it
+	for (int32 EntryIndex = 0; EntryIndex < Data.PendingEntries.Num(); EntryIndex++)
+	{
+		const int32 Group = Batch.EntryGroups[EntryIndex];
+		if (Group == INDEX_NONE)
 		{
-			Page.ABufferPageIndex = AllocateMaterialCacheABufferPage(RenderData, Page.Page);
+			continue;
+		}
 
-			// Providers are optional, if none is supplied, just assume the primary material as a stack entry
-			FMaterialCacheStack Stack;
-			if (Provider)
-			{
-				Provider->Evaluate(Page.Page.UVRect, &Stack);
+		FMaterialCacheBlackboardPendingEntry& Entry = Data.PendingEntries[EntryIndex];
+		const FMaterialCacheResolvedPrimitive& Primitive = Primitives[Group];
 
-				// Do not produce pages for empty stacks
-				if (Stack.Stack.IsEmpty())
-				{
-					continue;
-				}
-			}
-			else
-			{
-				FMaterialCacheStackEntry StackEntry;
-				StackEntry.Material = GetMaterialCacheDefaultMaterial(PrimitiveSceneProxy, PrimitiveSceneInfo);
-				Stack.Stack.Add(StackEntry);
-			}
-			
-			if (Stack.Stack.Num() > RenderData.Layers.Num())
+		for (int32 PageIndex = 0; PageIndex < Entry.Pages.Num(); PageIndex++)
+		{
+			FMaterialCachePendingPageEntry& Page = Entry.Pages[PageIndex];
+
+			// Do not produce pages for empty stacks
+			const int32 UniqueStackIndex = Batch.PageStackIndices[Batch.EntryPageOffsets[EntryIndex] + PageIndex];
+			if (UniqueStackIndex == INDEX_NONE)
 			{
-				RenderData.Layers.SetNum(Stack.Stack.Num());
+				continue;
 			}
 
+			const FMaterialCacheStack& Stack = Batch.UniqueStacks[UniqueStackIndex];
+			const EMaterialCacheRenderPath* RenderPaths = &UniqueStackRenderPaths[UniqueStackRenderPathOffsets[UniqueStackIndex]];
+
 			uint32 PageAllocationSet = 0x0;
 
 			for (int32 StackIndex = 0; StackIndex < Stack.Stack.Num(); StackIndex++)
@@ -643,7 +798,7 @@ static void MaterialCacheAllocateAndBatchPages(FSceneRenderer* Renderer, FRDGBui
 
 				FMaterialCacheLayerRenderData& Layer = RenderData.Layers[StackIndex];
 
-				EMaterialCacheRenderPath RenderPath = GetMaterialCacheRenderPath(Renderer, PrimitiveSceneProxy, StackEntry);
+				const EMaterialCacheRenderPath RenderPath = RenderPaths[StackIndex];
 
 				const FMaterialCachePageAllocation RenderPathPageIndex = AllocateMaterialCacheRenderPathPage(RenderData, Page, EntryIndex, RenderPath, PageAllocationSet);
 				
@@ -653,13 +808,13 @@ static void MaterialCacheAllocateAndBatchPages(FSceneRenderer* Renderer, FRDGBui
 					checkNoEntry();
 					break;
 				case EMaterialCacheRenderPath::HardwareRaster:
-					MaterialCacheAllocateHardwareRasterPage(Renderer, Entry, Page, StackEntry, PrimitiveSceneProxy, PrimitiveSceneInfo, PrimitiveData, Layer.Hardware, RenderPathPageIndex);
+					MaterialCacheAllocateHardwareRasterPage(Renderer, Entry, Page, StackEntry, Primitive.PrimitiveSceneProxy, Primitive.PrimitiveSceneInfo, Primitive.PrimitiveData, Layer.Hardware, RenderPathPageIndex);
 					break;
 				case EMaterialCacheRenderPath::NaniteRaster:
-					MaterialCacheAllocateNaniteRasterPage(Renderer, GraphBuilder, Entry, Page, StackEntry, PrimitiveSceneProxy, PrimitiveSceneInfo, PrimitiveData, RenderData.Nanite, Layer.Nanite, RenderPathPageIndex);
+					MaterialCacheAllocateNaniteRasterPage(Renderer, GraphBuilder, Entry, Page, StackEntry, Primitive.PrimitiveSceneProxy, Primitive.PrimitiveSceneInfo, Primitive.PrimitiveData, RenderData.Nanite, Layer.Nanite, RenderPathPageIndex);
 					break;
 				case EMaterialCacheRenderPath::VertexInvariant:
-					MaterialCacheAllocateVertexInvariantPage(Renderer, GraphBuilder, Entry, Page, StackEntry, PrimitiveSceneProxy, PrimitiveSceneInfo, PrimitiveData, Layer.VertexInvariant, RenderPathPageIndex);
+					MaterialCacheAllocateVertexInvariantPage(Renderer, GraphBuilder, Entry, Page, StackEntry, Primitive.PrimitiveSceneProxy, Primitive.PrimitiveSceneInfo, Primitive.PrimitiveData, Layer.VertexInvariant, RenderPathPageIndex);
 					break;
 				}
 			}
@@ -1001,6 +1001,7 @@ FMeshDrawCommandPassSetupTaskContext::FMeshDrawCommandPassSetupTaskContext()
 	, VisibleMeshDrawCommandsNum(0)
 	, NewPassVisibleMeshDrawCommandsNum(0)
 	, MaxInstances(1)
+	, InstanceCullingSetupCacheEntry(nullptr)
 {
 }
 
@@ -1159,7 +1160,8 @@ public:
 					Context.Scene,
 					Context.MaxInstances, 
 					Context.VisibleMeshDrawCommandsNum, 
-					Context.NewPassVisibleMeshDrawCommandsNum);
+					Context.NewPassVisibleMeshDrawCommandsNum,
+					Context.InstanceCullingSetupCacheEntry);
 
 				CollectMeshDrawCommandPassStats(Context.MeshDrawCommands, Context.InstanceCullingContext);
 			}
@@ -1409,6 +1411,21 @@ void FParallelMeshDrawCommandPass::DispatchPassSetup(
 
 	TaskContext.InstanceCullingContext = MoveTemp(InstanceCullingContext); 
 
+	// Cross-frame reuse of the instance culling setup is only possible for passes of views with a persistent state.
+	TaskContext.InstanceCullingSetupCacheEntry = nullptr;
+	if (TaskContext.bUseGPUScene && PassType != EMeshPass::Num && View.ViewState != nullptr)
+	{
+		FInstanceCullingSetupCacheEntry& SetupCacheEntry = View.ViewState->InstanceCullingSetupCache.GetEntry(PassType);
+		if (FInstanceCullingSetupCache::IsEnabled())
+		{
+			TaskContext.InstanceCullingSetupCacheEntry = &SetupCacheEntry;
+		}
+		else
+		{
+			SetupCacheEntry.Invalidate();
+		}
+	}
+
 	// Setup translucency sort key update pass based on view.
 	TaskContext.TranslucencyPass = ETranslucencyPass::TPT_MAX;
 	TaskContext.TranslucentSortPolicy = View.TranslucentSortPolicy;
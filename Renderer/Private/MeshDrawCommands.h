@@ -106,6 +106,8 @@ public:
 	int32 MaxInstances;
 
 	FInstanceCullingContext InstanceCullingContext;
+	// Persistent (per view state & pass) cache of the instance culling setup, null if not used.
+	FInstanceCullingSetupCacheEntry* InstanceCullingSetupCacheEntry;
 };
 
 /**
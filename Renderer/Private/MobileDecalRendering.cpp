@@ -80,7 +80,7 @@ void RenderDeferredDecalsMobile(FRHICommandList& RHICmdList, const FScene& Scene
 
 	if (!Scene.Decals.IsEmpty())
 	{
-		VisibleDecals = DecalRendering::BuildVisibleDecalList(Scene.Decals, View);
+		VisibleDecals = DecalRendering::BuildVisibleDecalList(Scene, View);
 
 		// Build a list of decals that need to be rendered for this view
 		SortedDecals = DecalRendering::BuildRelevantDecalList(VisibleDecals, DecalRenderStage);
@@ -155,7 +155,7 @@ void FMobileSceneRenderer::RenderDBuffer(FRDGBuilder& GraphBuilder, FSceneTextur
 			continue;
 		}
 
-		FVisibleDecalList VisibleDecals = DecalRendering::BuildVisibleDecalList(Scene->Decals, View);
+		FVisibleDecalList VisibleDecals = DecalRendering::BuildVisibleDecalList(*Scene, View);
 		FRelevantDecalList SortedDecals = DecalRendering::BuildRelevantDecalList(VisibleDecals, EDecalRenderStage::BeforeBasePass);
 		FDeferredDecalPassTextures DecalPassTextures = GetDeferredDecalPassTextures(GraphBuilder, View, Scene->SubstrateSceneData, SceneTextures, &DBufferTextures, EDecalRenderStage::BeforeBasePass);
 		AddDeferredDecalPass(GraphBuilder, View, SortedDecals, DecalPassTextures, InstanceCullingManager, EDecalRenderStage::BeforeBasePass);
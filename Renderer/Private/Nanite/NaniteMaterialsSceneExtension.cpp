@@ -59,6 +59,19 @@ static TAutoConsoleVariable<float> CVarNaniteMaterialBufferDefragLowWaterMark(
 	ECVF_RenderThreadSafe
 );
 
+static TAutoConsoleVariable<int32> CVarNaniteMaterialBufferDefragMaxMoves(
+	TEXT("r.Nanite.MaterialBuffers.Defrag.MaxMovesPerFrame"),
+	256,
+	TEXT("Maximum number of primitive material data spans moved per frame when defragmenting the Nanite material data buffer.\n")
+	TEXT("0: Reallocate and re-upload all material data at once instead."),
+	ECVF_RenderThreadSafe
+);
+
+BEGIN_SHADER_PARAMETER_STRUCT(FNaniteMaterialBufferCopyParameters, )
+	RDG_BUFFER_ACCESS(SrcBuffer, ERHIAccess::CopySrc)
+	RDG_BUFFER_ACCESS(DstBuffer, ERHIAccess::CopyDest)
+END_SHADER_PARAMETER_STRUCT()
+
 BEGIN_SHADER_PARAMETER_STRUCT(FNaniteMaterialsParameters, RENDERER_API)
 	SHADER_PARAMETER(uint32, PrimitiveMaterialElementStride)
 	SHADER_PARAMETER_RDG_BUFFER_SRV(ByteAddressBuffer, PrimitiveMaterialData)
@@ -174,6 +187,7 @@ void FMaterialsSceneExtension::SetEnabled(bool bEnabled)
 			MaterialBuffers = nullptr;
 			MaterialBufferAllocator.Reset();
 			PrimitiveData.Reset();
+			PendingBufferMoves.Reset();
 		#if WITH_EDITOR
 			HitProxyIDAllocator.Reset();
 			HitProxyIDs.Reset();
@@ -198,6 +212,7 @@ void FMaterialsSceneExtension::FinishMaterialBufferUpload(
 	UE::Tasks::Wait(
 		MakeArrayView(
 			{
+				TaskHandles[FreeBufferSpaceTask],
 				TaskHandles[AllocMaterialBufferTask],
 				TaskHandles[UploadPrimitiveDataTask],
 				TaskHandles[UploadMaterialDataTask]
@@ -213,6 +228,9 @@ void FMaterialsSceneExtension::FinishMaterialBufferUpload(
 
 	RDG_GPU_MASK_SCOPE(GraphBuilder, FRHIGPUMask::All());
 
+	// Move the defragmented spans before the buffer is resized and before new data is scattered into the freed spans
+	ExecuteBufferMoves(GraphBuilder);
+
 	if (MaterialUploader.IsValid())
 	{
 		PrimitiveBuffer = MaterialUploader->PrimitiveDataUploader.ResizeAndUploadTo(
@@ -254,8 +272,10 @@ bool FMaterialsSceneExtension::ProcessBufferDefragmentation()
 	//
 	// NOTES:
 	//	* We only currently use the state of the material buffer's fragmentation to decide to defrag both buffers
-	//	* Rather than trying to minimize number of moves/uploads, we just realloc and re-upload everything. This
-	//	  could be implemented in a more efficient manner if the current method proves expensive.
+	//	* By default, a bounded number of spans is moved from the end of the buffer into holes every frame until usage
+	//	  is above the low water mark again. The material data is copied on the GPU and only the moved primitives' offsets
+	//	  are re-uploaded. A forced defrag, or one that can't move anything, reallocs and re-uploads everything.
+	//	* The hit proxy ID buffer is only repacked by a full defrag.
 
 	const bool bAllowDefrag = CVarNaniteMaterialBufferDefrag.GetValueOnRenderThread();
 	static const int32 MinMaterialBufferSizeDwords = CVarNaniteMaterialDataBufferMinSizeBytes.GetValueOnRenderThread() / 4;
@@ -282,6 +302,33 @@ bool FMaterialsSceneExtension::ProcessBufferDefragmentation()
 		return false;
 	}
 
+	const int32 MaxMovesPerFrame = CVarNaniteMaterialBufferDefragMaxMoves.GetValueOnRenderThread();
+	if (!bForceDefrag && MaxMovesPerFrame > 0)
+	{
+		TArray<FBufferSpan> Spans;
+		Spans.Reserve(PrimitiveData.Num());
+		for (auto It = PrimitiveData.CreateConstIterator(); It; ++It)
+		{
+			if (It->MaterialBufferOffset != INDEX_NONE)
+			{
+				Spans.Add({ It.GetIndex(), It->MaterialBufferOffset, It->MaterialBufferSizeDwords });
+			}
+		}
+
+		const int32 FirstMove = PendingBufferMoves.Num();
+		if (PlanBufferMoves(MaterialBufferAllocator, Spans, MaxMovesPerFrame, PendingBufferMoves) > 0)
+		{
+			for (int32 MoveIndex = FirstMove; MoveIndex < PendingBufferMoves.Num(); ++MoveIndex)
+			{
+				const FBufferMove& Move = PendingBufferMoves[MoveIndex];
+				PrimitiveData[Move.Index].MaterialBufferOffset = Move.DstOffset;
+			}
+			return false;
+		}
+
+		// The last span doesn't fit in any hole, fall back to a full defrag
+	}
+
 	MaterialBufferAllocator.Reset();
 #if WITH_EDITOR
 	HitProxyIDAllocator.Reset();
@@ -303,6 +350,106 @@ bool FMaterialsSceneExtension::ProcessBufferDefragmentation()
 	return true;
 }
 
+int32 FMaterialsSceneExtension::PlanBufferMoves(FSpanAllocator& Allocator, TArray<FBufferSpan>& Spans, int32 MaxMoves, TArray<FBufferMove>& OutMoves)
+{
+	// Visit the spans from the end of the buffer, only partially sorting them
+	auto HighestOffsetFirst = [](const FBufferSpan& A, const FBufferSpan& B) { return A.Offset > B.Offset; };
+	Spans.Heapify(HighestOffsetFirst);
+
+	int32 NumMoves = 0;
+	while (NumMoves < MaxMoves && Spans.Num() > 0)
+	{
+		FBufferSpan Span;
+		Spans.HeapPop(Span, HighestOffsetFirst, EAllowShrinking::No);
+		check(Span.NumDwords > 0);
+
+		// The source is still allocated, so the first fit is either a hole or the end of the buffer. Since the spans are
+		// visited in decreasing offset order, a destination below this source is also below the sources of all prior moves.
+		const int32 DstOffset = Allocator.Allocate(Span.NumDwords);
+		if (uint32(DstOffset) + Span.NumDwords > Span.Offset)
+		{
+			Allocator.Free(DstOffset, Span.NumDwords);
+			break;
+		}
+
+		Allocator.Free(Span.Offset, Span.NumDwords);
+		OutMoves.Add({ Span.Index, Span.Offset, uint32(DstOffset), Span.NumDwords });
+		++NumMoves;
+	}
+
+	// Shrink the allocator to the compacted size. The freed sources may be reallocated right away, which is fine as the
+	// moves are copied before any new data is uploaded.
+	Allocator.Consolidate();
+
+	return NumMoves;
+}
+
+void FMaterialsSceneExtension::ExecuteBufferMoves(FRDGBuilder& GraphBuilder)
+{
+	if (PendingBufferMoves.Num() == 0)
+	{
+		return;
+	}
+
+	FRDGBufferRef MaterialBuffer = MaterialBuffers->MaterialDataBuffer.Register(GraphBuilder);
+	if (MaterialBuffer == nullptr)
+	{
+		PendingBufferMoves.Reset();
+		return;
+	}
+
+	uint32 NumStagingDwords = 0;
+	for (const FBufferMove& Move : PendingBufferMoves)
+	{
+		NumStagingDwords += Move.NumDwords;
+	}
+
+	// Go through a staging buffer rather than copying the buffer onto itself
+	FRDGBufferRef StagingBuffer = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateByteAddressDesc(NumStagingDwords * 4u),
+		TEXT("Nanite.MaterialDataDefrag")
+	);
+
+	const auto& Moves = *GraphBuilder.AllocObject<TArray<FBufferMove>>(MoveTemp(PendingBufferMoves));
+	PendingBufferMoves.Reset();
+
+	FNaniteMaterialBufferCopyParameters* GatherParameters = GraphBuilder.AllocParameters<FNaniteMaterialBufferCopyParameters>();
+	GatherParameters->SrcBuffer = MaterialBuffer;
+	GatherParameters->DstBuffer = StagingBuffer;
+
+	GraphBuilder.AddPass(
+		RDG_EVENT_NAME("Nanite::MaterialDataDefrag (Gather %d spans)", Moves.Num()),
+		GatherParameters,
+		ERDGPassFlags::Copy,
+		[GatherParameters, &Moves](FRDGAsyncTask, FRHICommandList& RHICmdList)
+	{
+		uint32 StagingOffset = 0;
+		for (const FBufferMove& Move : Moves)
+		{
+			RHICmdList.CopyBufferRegion(GatherParameters->DstBuffer->GetRHI(), StagingOffset * 4u, GatherParameters->SrcBuffer->GetRHI(), Move.SrcOffset * 4u, Move.NumDwords * 4u);
+			StagingOffset += Move.NumDwords;
+		}
+	});
+
+	FNaniteMaterialBufferCopyParameters* ScatterParameters = GraphBuilder.AllocParameters<FNaniteMaterialBufferCopyParameters>();
+	ScatterParameters->SrcBuffer = StagingBuffer;
+	ScatterParameters->DstBuffer = MaterialBuffer;
+
+	GraphBuilder.AddPass(
+		RDG_EVENT_NAME("Nanite::MaterialDataDefrag (Scatter %d spans)", Moves.Num()),
+		ScatterParameters,
+		ERDGPassFlags::Copy,
+		[ScatterParameters, &Moves](FRDGAsyncTask, FRHICommandList& RHICmdList)
+	{
+		uint32 StagingOffset = 0;
+		for (const FBufferMove& Move : Moves)
+		{
+			RHICmdList.CopyBufferRegion(ScatterParameters->DstBuffer->GetRHI(), Move.DstOffset * 4u, ScatterParameters->SrcBuffer->GetRHI(), StagingOffset * 4u, Move.NumDwords * 4u);
+			StagingOffset += Move.NumDwords;
+		}
+	});
+}
+
 void FMaterialsSceneExtension::PostBuildNaniteShadingCommands(
 	FRDGBuilder& GraphBuilder,
 	const UE::Tasks::FTask& BuildDependency,
@@ -423,6 +570,15 @@ void FMaterialsSceneExtension::FUpdater::PreSceneUpdate(FRDGBuilder& GraphBuilde
 
 			bDefragging = SceneData->ProcessBufferDefragmentation();
 			bForceFullUpload |= bDefragging;
+
+			if (!bForceFullUpload)
+			{
+				// Moved primitives only need their offset re-uploaded, their material data is copied on the GPU
+				for (const FBufferMove& Move : SceneData->PendingBufferMoves)
+				{
+					DirtyPrimitiveList.Add(Move.Index);
+				}
+			}
 		},
 		UE::Tasks::ETaskPriority::Normal,
 		bEnableAsync
@@ -543,6 +699,14 @@ void FMaterialsSceneExtension::FUpdater::PostSceneUpdate(FRDGBuilder& GraphBuild
 #endif
 }
 
+void FMaterialsSceneExtension::FUpdater::AddMaterialDataUpdates(TConstArrayView<FPrimitiveSceneInfo*> SceneInfos)
+{
+	if (SceneData->IsEnabled())
+	{
+		MaterialDataUpdateList.Append(SceneInfos.GetData(), SceneInfos.Num());
+	}
+}
+
 void FMaterialsSceneExtension::FUpdater::PostCacheNaniteMaterialBins(
 	FRDGBuilder& GraphBuilder,
 	const TConstArrayView<FPrimitiveSceneInfo*>& SceneInfosWithStaticDrawListUpdate)
@@ -620,7 +784,7 @@ void FMaterialsSceneExtension::FUpdater::PostCacheNaniteMaterialBins(
 			}
 
 			// Only create a new uploader here if one of the two dependent upload tasks will use it
-			if (bForceFullUpload || DirtyPrimitiveList.Num() > 0 || MaterialUpdateList.Num() > 0)
+			if (bForceFullUpload || DirtyPrimitiveList.Num() > 0 || MaterialUpdateList.Num() > 0 || MaterialDataUpdateList.Num() > 0)
 			{
 				SceneData->MaterialUploader = MakeUnique<FUploader>();
 			}
@@ -754,6 +918,16 @@ void FMaterialsSceneExtension::FUpdater::PostCacheNaniteMaterialBins(
 						UploadMaterialData(SceneData->PrimitiveData[PersistentIndex]);
 					}
 				}
+
+				// Material slots patched in place, the allocation is unchanged
+				for (auto PrimitiveSceneInfo : MaterialDataUpdateList)
+				{
+					const int32 PersistentIndex = PrimitiveSceneInfo->GetPersistentIndex().Index;
+					if (SceneData->PrimitiveData.IsValidIndex(PersistentIndex) && SceneData->PrimitiveData[PersistentIndex].MaterialBufferSizeDwords > 0)
+					{
+						UploadMaterialData(SceneData->PrimitiveData[PersistentIndex]);
+					}
+				}
 			}
 		},
 		MakeArrayView({ SceneData->TaskHandles[AllocMaterialBufferTask] }),
@@ -38,10 +38,14 @@ public:
 			const TConstArrayView<FPrimitiveSceneInfo*>& SceneInfosWithStaticDrawListUpdate
 		);
 
+		/** Re-uploads the material data of primitives whose material slots were patched, e.g., by a raster bin compaction. Must be called before PostCacheNaniteMaterialBins. */
+		void AddMaterialDataUpdates(TConstArrayView<FPrimitiveSceneInfo*> SceneInfos);
+
 	private:
 		FMaterialsSceneExtension* SceneData = nullptr;
 		TConstArrayView<FPrimitiveSceneInfo*> AddedList;
 		TConstArrayView<FPrimitiveSceneInfo*> MaterialUpdateList;
+		TArray<FPrimitiveSceneInfo*, FSceneRenderingArrayAllocator> MaterialDataUpdateList;
 		TArray<int32, FSceneRenderingArrayAllocator> DirtyPrimitiveList;
 		const bool bEnableAsync = true;
 		bool bForceFullUpload = false;
@@ -81,6 +85,30 @@ public:
 		ENaniteMeshPass::Type MeshPass
 	);
 
+	/** Span of the material data buffer allocated to a primitive */
+	struct FBufferSpan
+	{
+		int32 Index;
+		uint32 Offset;
+		uint32 NumDwords;
+	};
+
+	/** Relocation of a primitive's material data, executed as a GPU buffer copy */
+	struct FBufferMove
+	{
+		int32 Index;
+		uint32 SrcOffset;
+		uint32 DstOffset;
+		uint32 NumDwords;
+	};
+
+	/**
+	 * Plans up to MaxMoves moves of the spans at the end of the buffer into holes below them, updating the allocator.
+	 * No destination overlaps the source of another move, so the copies can be executed in any order.
+	 * Reorders Spans. Returns the number of moves added to OutMoves.
+	 */
+	static int32 PlanBufferMoves(FSpanAllocator& Allocator, TArray<FBufferSpan>& Spans, int32 MaxMoves, TArray<FBufferMove>& OutMoves);
+
 private:
 	enum ETask : uint32
 	{
@@ -165,11 +193,13 @@ private:
 		FNaniteMaterialsParameters* OutParams = nullptr
 	);
 	bool ProcessBufferDefragmentation();
+	void ExecuteBufferMoves(FRDGBuilder& GraphBuilder);
 
 	FSpanAllocator MaterialBufferAllocator;
 	TSparseArray<FPrimitiveData> PrimitiveData;
 	TUniquePtr<FMaterialBuffers> MaterialBuffers;
 	TUniquePtr<FUploader> MaterialUploader;
+	TArray<FBufferMove> PendingBufferMoves;
 #if WITH_EDITOR
 	FSpanAllocator HitProxyIDAllocator;
 	TArray<uint32> HitProxyIDs;
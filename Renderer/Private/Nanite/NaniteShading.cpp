@@ -1927,6 +1927,10 @@ FNaniteRasterPipelines::~FNaniteRasterPipelines()
 
 	PipelineBins.Reset();
 	PerPixelEvalPipelineBins.Reset();
+	BinRasterIds.Reset();
+	PerPixelEvalBinRasterIds.Reset();
+	CustomPassRefCounts.Reset();
+	PerPixelEvalCustomPassRefCounts.Reset();
 	PipelineMap.Empty();
 }
 
@@ -1985,6 +1989,13 @@ uint16 FNaniteRasterPipelines::AllocateBin(bool bPerPixelEval)
 	if (BinIndex == INDEX_NONE)
 	{
 		BinIndex = BinUsageMask.Add(true);
+
+		// Keep the per bin state dense
+		TArray<int32>& BinIds = bPerPixelEval ? PerPixelEvalBinRasterIds : BinRasterIds;
+		TArray<uint32>& RefCounts = bPerPixelEval ? PerPixelEvalCustomPassRefCounts : CustomPassRefCounts;
+		BinIds.Add(INDEX_NONE);
+		RefCounts.Add(0u);
+		check(BinIds.Num() == BinUsageMask.Num() && RefCounts.Num() == BinUsageMask.Num());
 	}
 
 	check(int32(uint16(BinIndex)) == BinIndex && PipelineBins.Num() + PerPixelEvalPipelineBins.Num() <= int32(MAX_uint16));
@@ -1997,10 +2008,13 @@ void FNaniteRasterPipelines::ReleaseBin(uint16 BinIndex)
 	if (BinIndex < PipelineBins.Num())
 	{
 		PipelineBins[BinIndex] = false;
+		BinRasterIds[BinIndex] = INDEX_NONE;
 	}
 	else
 	{
-		PerPixelEvalPipelineBins[FNaniteRasterBinIndexTranslator::RevertBinIndex(BinIndex)] = false;
+		const uint16 ArrayIndex = FNaniteRasterBinIndexTranslator::RevertBinIndex(BinIndex);
+		PerPixelEvalPipelineBins[ArrayIndex] = false;
+		PerPixelEvalBinRasterIds[ArrayIndex] = INDEX_NONE;
 	}
 }
 
@@ -2019,6 +2033,72 @@ uint32 FNaniteRasterPipelines::GetBinCount() const
 	return GetRegularBinCount() + PerPixelEvalPipelineBins.FindLast(true) + 1;
 }
 
+uint32 FNaniteRasterPipelines::GetNumFreeBins() const
+{
+	return GetBinCount() - PipelineBins.CountSetBits() - PerPixelEvalPipelineBins.CountSetBits();
+}
+
+void FNaniteRasterPipelines::CompactBins(FNaniteRasterBinRemap& OutRemap)
+{
+	OutRemap = FNaniteRasterBinRemap();
+	OutRemap.RegularBinArraySize = PipelineBins.Num();
+
+	auto CompactBinSpace = [this, &OutRemap](TBitArray<>& BinUsageMask, TArray<int32>& BinIds, TArray<uint32>& RefCounts, TArray<uint16>& OutBins, bool bPerPixelEval)
+	{
+		auto ToBinIndex = [bPerPixelEval](int32 ArrayIndex)
+		{
+			return bPerPixelEval ? FNaniteRasterBinIndexTranslator::RevertBinIndex(uint16(ArrayIndex)) : uint16(ArrayIndex);
+		};
+
+		const int32 BinCount = BinUsageMask.FindLast(true) + 1;
+		OutBins.SetNumUninitialized(BinCount);
+		for (int32 ArrayIndex = 0; ArrayIndex < BinCount; ++ArrayIndex)
+		{
+			OutBins[ArrayIndex] = ToBinIndex(ArrayIndex);
+		}
+
+		// Move the highest bin into the lowest hole until they meet. Bins below the compacted count keep their index.
+		int32 DstIndex = 0;
+		int32 SrcIndex = BinCount - 1;
+		for (;;)
+		{
+			while (DstIndex < SrcIndex && BinUsageMask[DstIndex])
+			{
+				++DstIndex;
+			}
+			while (SrcIndex > DstIndex && !BinUsageMask[SrcIndex])
+			{
+				--SrcIndex;
+			}
+			if (DstIndex >= SrcIndex)
+			{
+				break;
+			}
+
+			// Fixed function bins are allocated first and never released, so they never have a hole below them
+			check(bPerPixelEval || SrcIndex > NANITE_FIXED_FUNCTION_BIN_MASK);
+
+			const uint16 NewBinIndex = ToBinIndex(DstIndex);
+			FNaniteRasterEntry& RasterEntry = PipelineMap.GetByElementId(FRasterId(BinIds[SrcIndex])).Value;
+			check(RasterEntry.BinIndex == ToBinIndex(SrcIndex));
+			RasterEntry.BinIndex = NewBinIndex;
+
+			BinUsageMask[DstIndex] = true;
+			BinUsageMask[SrcIndex] = false;
+			BinIds[DstIndex] = BinIds[SrcIndex];
+			BinIds[SrcIndex] = INDEX_NONE;
+			RefCounts[DstIndex] = RefCounts[SrcIndex];
+			RefCounts[SrcIndex] = 0u;
+
+			OutBins[SrcIndex] = NewBinIndex;
+			++OutRemap.NumRelocatedBins;
+		}
+	};
+
+	CompactBinSpace(PipelineBins, BinRasterIds, CustomPassRefCounts, OutRemap.RegularBins, false);
+	CompactBinSpace(PerPixelEvalPipelineBins, PerPixelEvalBinRasterIds, PerPixelEvalCustomPassRefCounts, OutRemap.PerPixelEvalBins, true);
+}
+
 FNaniteRasterBin FNaniteRasterPipelines::Register(const FNaniteRasterPipeline& InRasterPipeline)
 {
 	FNaniteRasterBin RasterBin;
@@ -2033,6 +2113,15 @@ FNaniteRasterBin FNaniteRasterPipelines::Register(const FNaniteRasterPipeline& I
 		// First reference
 		RasterEntry.RasterPipeline = InRasterPipeline;
 		RasterEntry.BinIndex = AllocateBin(InRasterPipeline.bPerPixelEval);
+
+		if (InRasterPipeline.bPerPixelEval)
+		{
+			PerPixelEvalBinRasterIds[FNaniteRasterBinIndexTranslator::RevertBinIndex(RasterEntry.BinIndex)] = RasterBinId.GetIndex();
+		}
+		else
+		{
+			BinRasterIds[RasterEntry.BinIndex] = RasterBinId.GetIndex();
+		}
 	}
 
 	++RasterEntry.ReferenceCount;
@@ -2052,7 +2141,7 @@ void FNaniteRasterPipelines::Unregister(const FNaniteRasterBin& InRasterBin)
 	--RasterEntry.ReferenceCount;
 	if (RasterEntry.ReferenceCount == 0)
 	{
-		checkf(!ShouldBinRenderInCustomPass(InRasterBin.BinIndex), TEXT("A raster bin has dangling references to Custom Pass on final release."));
+		checkf(!ShouldBinRenderInCustomPass(RasterEntry.BinIndex), TEXT("A raster bin has dangling references to Custom Pass on final release."));
 		ReleaseBin(RasterEntry.BinIndex);
 		PipelineMap.RemoveByElementId(RasterBinId);
 	}
@@ -2066,10 +2155,6 @@ void FNaniteRasterPipelines::RegisterBinForCustomPass(uint16 BinIndex)
 	TArray<uint32>& RefCounts = bPerPixelEval ? PerPixelEvalCustomPassRefCounts : CustomPassRefCounts;
 	const uint16 ArrayIndex = bPerPixelEval ? FNaniteRasterBinIndexTranslator::RevertBinIndex(BinIndex) : BinIndex;
 
-	if (RefCounts.Num() <= ArrayIndex)
-	{
-		RefCounts.AddZeroed(ArrayIndex - RefCounts.Num() + 1);
-	}
 	RefCounts[ArrayIndex]++;
 }
 
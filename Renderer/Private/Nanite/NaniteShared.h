@@ -682,6 +682,7 @@ public:
 
 private:
 	friend class FNaniteRasterPipelines;
+	friend class FNaniteRasterBinRemap;
 
 	uint32 RegularBinCount;
 
@@ -695,6 +696,42 @@ private:
 	}
 };
 
+/** Bin index relocations of a raster bin compaction, used to patch every holder of a relocated bin index. */
+class FNaniteRasterBinRemap
+{
+public:
+	inline bool IsEmpty() const
+	{
+		return NumRelocatedBins == 0;
+	}
+
+	inline int32 GetNumRelocatedBins() const
+	{
+		return NumRelocatedBins;
+	}
+
+	/** Returns the new index of the bin, or the same index if the bin wasn't relocated. */
+	uint16 Remap(uint16 BinIndex) const
+	{
+		if (BinIndex < RegularBinArraySize)
+		{
+			return RegularBins.IsValidIndex(BinIndex) ? RegularBins[BinIndex] : BinIndex;
+		}
+
+		const uint16 ArrayIndex = FNaniteRasterBinIndexTranslator::RevertBinIndex(BinIndex);
+		return PerPixelEvalBins.IsValidIndex(ArrayIndex) ? PerPixelEvalBins[ArrayIndex] : BinIndex;
+	}
+
+private:
+	friend class FNaniteRasterPipelines;
+
+	/** New bin index, indexed by the bin's position in its bin usage mask */
+	TArray<uint16> RegularBins;
+	TArray<uint16> PerPixelEvalBins;
+	int32 RegularBinArraySize = 0;
+	int32 NumRelocatedBins = 0;
+};
+
 class FNaniteRasterPipelines
 {
 public:
@@ -717,6 +754,16 @@ public:
 	uint32 GetRegularBinCount() const;
 	uint32 GetBinCount() const;
 
+	/** Number of unallocated bins below the highest allocated bins, which still count towards the bin count. */
+	uint32 GetNumFreeBins() const;
+
+	/**
+	 * Relocates the highest allocated bins into the lowest free bins, so the bin count equals the number of allocated bins.
+	 * Every holder of a bin index (registered FNaniteRasterBins, material slots, visibility references, etc.) must be
+	 * patched with OutRemap before the bins are used again.
+	 */
+	void CompactBins(FNaniteRasterBinRemap& OutRemap);
+
 	FNaniteRasterBin Register(const FNaniteRasterPipeline& InRasterPipeline);
 	void Unregister(const FNaniteRasterBin& InRasterBin);
 
@@ -741,8 +788,13 @@ public:
 private:
 	TBitArray<> PipelineBins;
 	TBitArray<> PerPixelEvalPipelineBins;
+
+	// Dense per bin state, indexed the same as the bin usage masks
+	TArray<int32> BinRasterIds;
+	TArray<int32> PerPixelEvalBinRasterIds;
 	TArray<uint32> CustomPassRefCounts;
 	TArray<uint32> PerPixelEvalCustomPassRefCounts;
+
 	FNaniteRasterPipelineMap PipelineMap;
 
 	struct FFixedFunctionBin
@@ -351,20 +351,11 @@ void FSkinningSceneExtension::PerformSkinning(
 			for (typename TSparseArray<FHeaderData>::TConstIterator It(HeaderData); It; ++It)
 			{
 				const FHeaderData& Header = *It;
-				int32 RangeIndex = 0;
 
-				for (; RangeIndex < Ranges.Num(); ++RangeIndex)
-				{
-					FSkinningTransformProvider::FProviderRange& Range = Ranges[RangeIndex];
-
-					if (Header.ProviderId == Range.Id)
-					{
-						++Range.Count;
-						break;
-					}
-				}
-
-				check(RangeIndex != Ranges.Num());
+				// Ranges are in provider order
+				const int32 RangeIndex = TransformProvider->FindProviderIndex(Header.ProviderId);
+				check(RangeIndex != INDEX_NONE);
+				++Ranges[RangeIndex].Count;
 
 				PrimitivesToRangeIndex[PrimitiveCount] = RangeIndex;
 				Primitives[PrimitiveCount] = Header.PrimitiveSceneInfo;
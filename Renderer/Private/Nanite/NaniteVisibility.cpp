@@ -434,4 +434,18 @@ void FNaniteVisibility::RemoveReferences(const FPrimitiveSceneInfo* SceneInfo)
 {
 	// Always remove references even when Nanite visibility is disabled, as the CVar could change state while a primitive is attached to the scene.
 	PrimitiveReferences.Remove(SceneInfo);
+}
+
+void FNaniteVisibility::RemapRasterBins(const FNaniteRasterBinRemap& Remap)
+{
+	check(!bCalledBegin);
+
+	for (auto& KeyValue : PrimitiveReferences)
+	{
+		for (FRasterBin& RasterBin : KeyValue.Value.RasterBins)
+		{
+			RasterBin.Primary = Remap.Remap(RasterBin.Primary);
+			RasterBin.Fallback = Remap.Remap(RasterBin.Fallback);
+		}
+	}
 }
\ No newline at end of file
@@ -131,6 +131,9 @@ public:
 
 	void RemoveReferences(const FPrimitiveSceneInfo* SceneInfo);
 
+	/** Patches the raster bin references after a raster bin compaction. Must not be called during a visibility frame. */
+	void RemapRasterBins(const FNaniteRasterBinRemap& Remap);
+
 private:
 	FPrimitiveReferences* FindOrAddPrimitiveReferences(const FPrimitiveSceneInfo* SceneInfo);
 
@@ -0,0 +1,56 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "RayTracingDynamicGeometryUpdateCache.h"
+
+#if RHI_RAYTRACING
+
+bool FRayTracingDynamicGeometryUpdateCache::ShouldSkipUpdate(const FRayTracingDynamicGeometryUpdateDesc& Desc, int64 GenerationID)
+{
+	check(Desc.Key != nullptr);
+
+	FEntry& Entry = Entries.FindOrAdd(Desc.Key);
+	Entry.LastSeenGenerationID = GenerationID;
+
+	if (Entry.bProcessed && Desc.bPreviousOutputValid && Entry.LayoutHash == Desc.LayoutHash && Entry.Fingerprint == Desc.Fingerprint)
+	{
+		return true;
+	}
+
+	Entry.Fingerprint = Desc.Fingerprint;
+	Entry.LayoutHash = Desc.LayoutHash;
+	Entry.bProcessed = true;
+	return false;
+}
+
+void FRayTracingDynamicGeometryUpdateCache::Invalidate(const void* Key)
+{
+	if (FEntry* Entry = Entries.Find(Key))
+	{
+		Entry->bProcessed = false;
+	}
+}
+
+FRWBuffer& FRayTracingDynamicGeometryUpdateCache::FindOrAddPersistentBuffer(const void* Key, int64 GenerationID)
+{
+	FEntry& Entry = Entries.FindOrAdd(Key);
+	Entry.LastSeenGenerationID = GenerationID;
+
+	if (!Entry.PersistentBuffer.IsValid())
+	{
+		Entry.PersistentBuffer = MakeUnique<FRWBuffer>();
+	}
+	return *Entry.PersistentBuffer;
+}
+
+void FRayTracingDynamicGeometryUpdateCache::GarbageCollect(int64 GenerationID, int32 Latency)
+{
+	for (auto It = Entries.CreateIterator(); It; ++It)
+	{
+		if (It.Value().LastSeenGenerationID + Latency <= GenerationID)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+#endif // RHI_RAYTRACING
@@ -0,0 +1,72 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "RHIDefinitions.h"
+
+#if RHI_RAYTRACING
+
+#include "CoreMinimal.h"
+#include "RHIUtilities.h"
+#include "RayTracingDynamicGeometryUpdateManager.h"
+
+/** Per frame description of a dynamic geometry update, only what is needed to decide if the update can be skipped. */
+struct FRayTracingDynamicGeometryUpdateDesc
+{
+	/** Identifies the geometry across frames. */
+	const void* Key = nullptr;
+
+	/** Inputs of the vertex deformation, as provided by the owner of the geometry. */
+	FRayTracingDynamicGeometryInputFingerprint Fingerprint;
+
+	/** Hash of everything else the deformed vertices and the BLAS depend on (buffers, vertex and triangle counts, mesh batches, transforms). */
+	uint32 LayoutHash = 0;
+
+	/** The vertices written by the last update are still resident in a persistent buffer of the right size, and the BLAS is valid without a pending build. */
+	bool bPreviousOutputValid = false;
+};
+
+/**
+ * Remembers the inputs of the last processed update of each dynamic geometry that provides an input fingerprint,
+ * such that the vertex deformation dispatch and the BLAS refit can be skipped while the inputs don't change.
+ * Also owns the persistent vertex buffers of these geometries, since the shared vertex buffers are overwritten every frame.
+ */
+class FRayTracingDynamicGeometryUpdateCache
+{
+public:
+	/**
+	 * Returns true when the update has the same fingerprint and layout as the last processed one and the previous output is still valid.
+	 * Otherwise the inputs are recorded as processed, the caller must then schedule the dispatch and the BLAS update/build.
+	 */
+	bool ShouldSkipUpdate(const FRayTracingDynamicGeometryUpdateDesc& Desc, int64 GenerationID);
+
+	/** Forget the processed inputs of a geometry, e.g. when its scheduled update was dropped. */
+	void Invalidate(const void* Key);
+
+	/** Persistent vertex buffer of the geometry, lazily initialized by the caller. */
+	FRWBuffer& FindOrAddPersistentBuffer(const void* Key, int64 GenerationID);
+
+	/** Release the entries (and vertex buffers) of geometries which have not been updated for Latency generations. */
+	void GarbageCollect(int64 GenerationID, int32 Latency);
+
+	void Empty()
+	{
+		Entries.Empty();
+	}
+
+	int32 Num() const { return Entries.Num(); }
+
+private:
+	struct FEntry
+	{
+		FRayTracingDynamicGeometryInputFingerprint Fingerprint;
+		uint32 LayoutHash = 0;
+		int64 LastSeenGenerationID = 0;
+		bool bProcessed = false;
+		TUniquePtr<FRWBuffer> PersistentBuffer;
+	};
+
+	TMap<const void*, FEntry> Entries;
+};
+
+#endif // RHI_RAYTRACING
@@ -1,6 +1,8 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "RayTracingDynamicGeometryUpdateManager.h"
+#include "RayTracingDynamicGeometryUpdateCache.h"
+#include "RayTracingDynamicVertexBufferAllocator.h"
 #include "MeshMaterialShader.h"
 #include "DataDrivenShaderPlatformInfo.h"
 #include "ScenePrivate.h"
@@ -20,6 +22,7 @@ DECLARE_GPU_STAT(RayTracingDynamicGeometry);
 DECLARE_DWORD_COUNTER_STAT(TEXT("Ray tracing dynamic build primitives"), STAT_RayTracingDynamicBuildPrimitives, STATGROUP_SceneRendering);
 DECLARE_DWORD_COUNTER_STAT(TEXT("Ray tracing dynamic update primitives"), STAT_RayTracingDynamicUpdatePrimitives, STATGROUP_SceneRendering);
 DECLARE_DWORD_COUNTER_STAT(TEXT("Ray tracing dynamic skipped primitives"), STAT_RayTracingDynamicSkippedPrimitives, STATGROUP_SceneRendering);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Ray tracing dynamic unchanged primitives"), STAT_RayTracingDynamicUnchangedPrimitives, STATGROUP_SceneRendering);
 
 static int32 GRTDynGeomSharedVertexBufferSizeInMB = 4;
 static FAutoConsoleVariableRef CVarRTDynGeomSharedVertexBufferSizeInMB(
@@ -37,6 +40,23 @@ static FAutoConsoleVariableRef CVarRTDynGeomSharedVertexBufferGarbageCollectLate
 	ECVF_RenderThreadSafe
 );
 
+static float GRTDynGeomSharedVertexBufferCompactionOccupancy = 0.5f;
+static FAutoConsoleVariableRef CVarRTDynGeomSharedVertexBufferCompactionOccupancy(
+	TEXT("r.RayTracing.DynamicGeometry.SharedVertexBufferCompactionOccupancy"),
+	GRTDynGeomSharedVertexBufferCompactionOccupancy,
+	TEXT("Shared vertex buffers with a smaller fraction of allocated bytes are compacted, by moving their allocations to other buffers (default 0.5)."),
+	ECVF_RenderThreadSafe
+);
+
+static int32 GRTDynGeomSkipUnchanged = 1;
+static FAutoConsoleVariableRef CVarRTDynGeomSkipUnchanged(
+	TEXT("r.RayTracing.DynamicGeometry.SkipUnchanged"),
+	GRTDynGeomSkipUnchanged,
+	TEXT("Skip the vertex update and BLAS refit of dynamic geometries whose input fingerprint (bone transforms, morph target weights, WPO material parameters) didn't change since the last processed update (default 1).\n")
+	TEXT("Only applies to geometries which provide a fingerprint, these get a persistent vertex buffer instead of the shared vertex buffers."),
+	ECVF_RenderThreadSafe
+);
+
 static TAutoConsoleVariable<int32> CVarRTDynGeomMaxUpdatePrimitivesPerFrame(
 	TEXT("r.RayTracing.DynamicGeometry.MaxUpdatePrimitivesPerFrame"),
 	-1,
@@ -231,6 +251,8 @@ IPSOCollector* CreateRayTracingDynamicGeometryPSOCollector(ERHIFeatureLevel::Typ
 FRegisterPSOCollectorCreateFunction RegisterRayTracingDynamicGeometryPSOCollector(&CreateRayTracingDynamicGeometryPSOCollector, EShadingPath::Deferred, RayTracingDynamicGeometryPSOCollectorName);
 
 FRayTracingDynamicGeometryUpdateManager::FRayTracingDynamicGeometryUpdateManager() 
+	: UpdateCache(MakeUnique<FRayTracingDynamicGeometryUpdateCache>())
+	, VertexBufferAllocator(MakeUnique<FRayTracingDynamicVertexBufferAllocator>(GRTDynGeomSharedVertexBufferSizeInMB * 1024 * 1024, RHI_RAW_VIEW_ALIGNMENT))
 {
 }
 
@@ -254,6 +276,11 @@ void FRayTracingDynamicGeometryUpdateManager::Clear()
 	DynamicGeometryBuilds.Empty(DynamicGeometryBuilds.Max());
 	DynamicGeometryUpdates.Empty(DynamicGeometryUpdates.Max());
 
+	{
+		FScopeLock Lock(&PendingInputFingerprintsCS);
+		PendingInputFingerprints.Reset();
+	}
+
 	ScratchBufferSize = 0;
 }
 
@@ -266,27 +293,57 @@ int64 FRayTracingDynamicGeometryUpdateManager::BeginUpdate()
 	check(DynamicGeometryBuilds.IsEmpty());
 	check(DynamicGeometryUpdates.IsEmpty());
 
-	// Vertex buffer data can be immediatly reused the next frame, because it's already 'consumed' for building the AccelerationStructure data
-	// Garbage collect unused buffers for n generations
-	for (int32 BufferIndex = 0; BufferIndex < VertexPositionBuffers.Num(); ++BufferIndex)
-	{
-		FVertexPositionBuffer* Buffer = VertexPositionBuffers[BufferIndex];
-		Buffer->UsedSize = 0;
-
-		if (Buffer->LastUsedGenerationID + GRTDynGeomSharedVertexBufferGarbageCollectLatency <= SharedBufferGenerationID)
-		{
-			VertexPositionBuffers.RemoveAtSwap(BufferIndex);
-			delete Buffer;
-			BufferIndex--;
-		}
-	}
+	// Persistent vertex buffers of geometries with input fingerprints use the same latency
+	UpdateCache->GarbageCollect(SharedBufferGenerationID, GRTDynGeomSharedVertexBufferGarbageCollectLatency);
 
 	// Increment generation ID used for validation
 	SharedBufferGenerationID++;
 
+	// Vertex buffer data can be immediatly reused the next frame, because it's already 'consumed' for building the AccelerationStructure data,
+	// so the blocks freed up to the previous generation are recycled. Empty buffers are garbage collected after n generations.
+	TArray<int32, TInlineAllocator<8>> ReleasedBuffers;
+	VertexBufferAllocator->SetReleaseLatency(GRTDynGeomSharedVertexBufferGarbageCollectLatency);
+	VertexBufferAllocator->SetCompactionOccupancy(GRTDynGeomSharedVertexBufferCompactionOccupancy);
+	VertexBufferAllocator->BeginGeneration(SharedBufferGenerationID, SharedBufferGenerationID - 1, ReleasedBuffers);
+
+	for (int32 BufferIndex : ReleasedBuffers)
+	{
+		delete VertexPositionBuffers[BufferIndex];
+		VertexPositionBuffers[BufferIndex] = nullptr;
+	}
+
 	return SharedBufferGenerationID;
 }
 
+void FRayTracingDynamicGeometryUpdateManager::SetDynamicGeometryInputFingerprint(const FRayTracingGeometry* Geometry, const FRayTracingDynamicGeometryInputFingerprint& Fingerprint)
+{
+	FScopeLock Lock(&PendingInputFingerprintsCS);
+	PendingInputFingerprints.Add(Geometry, Fingerprint);
+}
+
+static uint32 ComputeDynamicGeometryLayoutHash(const FRayTracingGeometry& Geometry, const FRayTracingDynamicGeometryUpdateParams& UpdateParams, uint32 PrimitiveId, uint32 NumVertices, uint32 VertexBufferSize)
+{
+	uint32 Hash = PointerHash(Geometry.GetRHI());
+	Hash = HashCombineFast(Hash, NumVertices);
+	Hash = HashCombineFast(Hash, VertexBufferSize);
+	Hash = HashCombineFast(Hash, UpdateParams.NumTriangles);
+	Hash = HashCombineFast(Hash, PrimitiveId);
+	Hash = HashCombineFast(Hash, UpdateParams.InstanceId);
+	Hash = HashCombineFast(Hash, (UpdateParams.bAlphaMasked ? 1u : 0u) | (UpdateParams.bApplyWorldPositionOffset ? 2u : 0u) | (UpdateParams.bUsingIndirectDraw ? 4u : 0u));
+	Hash = FCrc::MemCrc32(&UpdateParams.WorldToInstance, sizeof(UpdateParams.WorldToInstance), Hash);
+
+	for (const FMeshBatch& MeshBatch : UpdateParams.MeshBatches)
+	{
+		Hash = HashCombineFast(Hash, PointerHash(MeshBatch.VertexFactory));
+		Hash = HashCombineFast(Hash, PointerHash(MeshBatch.MaterialRenderProxy));
+		Hash = HashCombineFast(Hash, MeshBatch.Elements[0].MinVertexIndex);
+		Hash = HashCombineFast(Hash, MeshBatch.Elements[0].MaxVertexIndex);
+		Hash = HashCombineFast(Hash, MeshBatch.Elements[0].FirstIndex);
+	}
+
+	return Hash;
+}
+
 void FRayTracingDynamicGeometryUpdateManager::AddDynamicGeometryToUpdate(
 	FRHICommandListBase& RHICmdList,
 	const FScene* Scene,
@@ -313,6 +370,46 @@ void FRayTracingDynamicGeometryUpdateManager::AddDynamicGeometryToUpdate(
 	FRWBuffer* RWBuffer = UpdateParams.Buffer;
 	uint32 VertexBufferOffset = 0;
 	bool bUseSharedVertexBuffer = false;
+	bool bCachedInputs = false;
+
+	if (GRTDynGeomSkipUnchanged != 0 && !UpdateParams.MeshBatches.IsEmpty())
+	{
+		FRayTracingDynamicGeometryInputFingerprint InputFingerprint;
+		bool bHasInputFingerprint = false;
+		{
+			FScopeLock Lock(&PendingInputFingerprintsCS);
+			bHasInputFingerprint = PendingInputFingerprints.RemoveAndCopyValue(&Geometry, InputFingerprint);
+		}
+
+		if (bHasInputFingerprint)
+		{
+			// The shared vertex buffers are overwritten every frame, the previous output can only be reused from a persistent buffer
+			if (RWBuffer == nullptr)
+			{
+				RWBuffer = &UpdateCache->FindOrAddPersistentBuffer(&Geometry, SharedBufferGenerationID);
+			}
+
+			FRayTracingDynamicGeometryUpdateDesc UpdateDesc;
+			UpdateDesc.Key = &Geometry;
+			UpdateDesc.Fingerprint = InputFingerprint;
+			UpdateDesc.LayoutHash = ComputeDynamicGeometryLayoutHash(Geometry, UpdateParams, PrimitiveId, NumVertices, VertexBufferSize);
+			UpdateDesc.bPreviousOutputValid = RWBuffer->NumBytes == VertexBufferSize
+				&& Geometry.DynamicGeometrySharedBufferGenerationID == FRayTracingGeometry::NonSharedVertexBuffers
+				&& Geometry.IsValid()
+				&& !Geometry.IsEvicted()
+				&& !Geometry.GetRequiresBuild()
+				&& (UpdateParams.NumTriangles == 0 || Geometry.Initializer.TotalPrimitiveCount == UpdateParams.NumTriangles);
+
+			if (UpdateCache->ShouldSkipUpdate(UpdateDesc, SharedBufferGenerationID))
+			{
+				INC_DWORD_STAT_BY(STAT_RayTracingDynamicUnchangedPrimitives, Geometry.Initializer.TotalPrimitiveCount);
+				Geometry.SetRequiresUpdate(false);
+				return;
+			}
+
+			bCachedInputs = true;
+		}
+	}
 
 	if (ReferencedUniformBuffers.Num() == 0 || ReferencedUniformBuffers.Last() != View->ViewUniformBuffer)
 	{
@@ -330,7 +427,7 @@ void FRayTracingDynamicGeometryUpdateManager::AddDynamicGeometryToUpdate(
 		// If update params didn't provide a buffer then use a shared vertex position buffer
 		if (RWBuffer == nullptr)
 		{
-			RWBuffer = AllocateSharedBuffer(RHICmdList, VertexBufferSize, VertexBufferOffset);
+			RWBuffer = AllocateSharedBuffer(RHICmdList, &Geometry, VertexBufferSize, VertexBufferOffset);
 			bUseSharedVertexBuffer = true;
 		}
 		check(IsAligned(VertexBufferOffset, RHI_RAW_VIEW_ALIGNMENT));
@@ -396,6 +493,7 @@ void FRayTracingDynamicGeometryUpdateManager::AddDynamicGeometryToUpdate(
 		: EAccelerationStructureBuildMode::Update;
 
 	GeometryBuildParams.Geometry = UpdateParams.Geometry;
+	GeometryBuildParams.bCachedInputs = bCachedInputs;
 
 	if (bUseSharedVertexBuffer)
 	{
@@ -424,40 +522,27 @@ void FRayTracingDynamicGeometryUpdateManager::AddDynamicGeometryToUpdate(
 	}
 }
 
-FRWBuffer* FRayTracingDynamicGeometryUpdateManager::AllocateSharedBuffer(FRHICommandListBase& RHICmdList, uint32 VertexBufferSize, uint32& OutVertexBufferOffset)
+FRWBuffer* FRayTracingDynamicGeometryUpdateManager::AllocateSharedBuffer(FRHICommandListBase& RHICmdList, const FRayTracingGeometry* Geometry, uint32 VertexBufferSize, uint32& OutVertexBufferOffset)
 {
-	FVertexPositionBuffer* VertexPositionBuffer = nullptr;
-	for (FVertexPositionBuffer* Buffer : VertexPositionBuffers)
+	// Offsets are aligned to 16 (required for Raw SRV views)
+	const FRayTracingDynamicVertexBufferAllocator::FAllocation Allocation = VertexBufferAllocator->Allocate(Geometry, VertexBufferSize);
+
+	if (Allocation.BufferIndex >= VertexPositionBuffers.Num())
 	{
-		if (Buffer->RWBuffer.NumBytes >= (VertexBufferSize + Buffer->UsedSize))
-		{
-			VertexPositionBuffer = Buffer;
-			break;
-		}
+		VertexPositionBuffers.SetNumZeroed(Allocation.BufferIndex + 1);
 	}
 
 	// Allocate a new buffer?
+	FVertexPositionBuffer*& VertexPositionBuffer = VertexPositionBuffers[Allocation.BufferIndex];
 	if (VertexPositionBuffer == nullptr)
 	{
 		VertexPositionBuffer = new FVertexPositionBuffer;
-		VertexPositionBuffers.Add(VertexPositionBuffer);
-
-		static const uint32 VertexBufferCacheSize = GRTDynGeomSharedVertexBufferSizeInMB * 1024 * 1024;
-		uint32 AllocationSize = FMath::Max(VertexBufferCacheSize, VertexBufferSize);
 
+		const uint32 AllocationSize = VertexBufferAllocator->GetBufferSize(Allocation.BufferIndex);
 		VertexPositionBuffer->RWBuffer.Initialize(RHICmdList, TEXT("FRayTracingDynamicGeometryUpdateManager::RayTracingDynamicVertexBuffer"), sizeof(float), AllocationSize / sizeof(float), PF_R32_FLOAT, BUF_UnorderedAccess | BUF_ShaderResource);
-		VertexPositionBuffer->UsedSize = 0;
 	}
 
-	// Update the last used generation ID
-	VertexPositionBuffer->LastUsedGenerationID = SharedBufferGenerationID;
-
-	// Get the offset and update used size
-	OutVertexBufferOffset = VertexPositionBuffer->UsedSize;
-	VertexPositionBuffer->UsedSize += VertexBufferSize;
-
-	// Make sure vertex buffer offset is aligned to 16 (required for Raw SRV views)
-	VertexPositionBuffer->UsedSize = Align(VertexPositionBuffer->UsedSize, RHI_RAW_VIEW_ALIGNMENT);
+	OutVertexBufferOffset = Allocation.Offset;
 
 	return &VertexPositionBuffer->RWBuffer;
 }
@@ -707,14 +792,20 @@ void FRayTracingDynamicGeometryUpdateManager::ScheduleUpdates(bool bUseTracingFe
 			});
 	}	
 
-	for (const FRayTracingDynamicGeometryBuildParams& Update : DynamicGeometryUpdates)
+	int32 UpdateIndex = 0;
+	for (; UpdateIndex < DynamicGeometryUpdates.Num(); ++UpdateIndex)
 	{
+		const FRayTracingDynamicGeometryBuildParams& Update = DynamicGeometryUpdates[UpdateIndex];
 		FRHIRayTracingGeometry* RayTracingGeometry = Update.Geometry->GetRHI();
 		const uint32 TotalPrimitiveCount = Update.Geometry->Initializer.TotalPrimitiveCount;
 
 		if (bUseTracingFeedback && !GRayTracingGeometryManager->IsGeometryVisible(Update.Geometry->GetGeometryHandle()))
 		{
 			INC_DWORD_STAT_BY(STAT_RayTracingDynamicSkippedPrimitives, TotalPrimitiveCount);
+			if (Update.bCachedInputs)
+			{
+				UpdateCache->Invalidate(Update.Geometry);
+			}
 			continue;
 		}
 
@@ -758,10 +849,20 @@ void FRayTracingDynamicGeometryUpdateManager::ScheduleUpdates(bool bUseTracingFe
 
 		if (NumUpdatedPrimitives > MaxUpdatePrimitivesPerFrame)
 		{
+			++UpdateIndex;
 			break;
 		}
 	}
 
+	// Updates over budget are dropped, their inputs have not been processed
+	for (; UpdateIndex < DynamicGeometryUpdates.Num(); ++UpdateIndex)
+	{
+		if (DynamicGeometryUpdates[UpdateIndex].bCachedInputs)
+		{
+			UpdateCache->Invalidate(DynamicGeometryUpdates[UpdateIndex].Geometry);
+		}
+	}
+
 	INC_DWORD_STAT_BY(STAT_RayTracingDynamicUpdatePrimitives, NumUpdatedPrimitives);
 	INC_DWORD_STAT_BY(STAT_RayTracingDynamicBuildPrimitives, NumBuildPrimitives);
 
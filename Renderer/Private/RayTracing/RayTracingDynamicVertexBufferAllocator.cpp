@@ -0,0 +1,272 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "RayTracingDynamicVertexBufferAllocator.h"
+
+FRayTracingDynamicVertexBufferAllocator::FRayTracingDynamicVertexBufferAllocator(uint32 InBufferSize, uint32 InAlignment)
+	: BufferSize(Align(InBufferSize, InAlignment))
+	, Alignment(InAlignment)
+{
+	check(FMath::IsPowerOfTwo(Alignment));
+}
+
+int32 FRayTracingDynamicVertexBufferAllocator::GetSizeClass(uint32 Size) const
+{
+	const uint32 Units = FMath::Max(FMath::DivideAndRoundUp(Size, Alignment), 1u);
+	if (Units <= 4)
+	{
+		return int32(Units) - 1;
+	}
+
+	// 4 classes per power of two, at most 25% wasted
+	const uint32 Log2 = FMath::FloorLog2(Units - 1);
+	const uint32 Step = ((Units - 1) >> (Log2 - 2)) & 3u;
+	return int32(4 + (Log2 - 2) * 4 + Step);
+}
+
+uint32 FRayTracingDynamicVertexBufferAllocator::GetSizeClassUnits(int32 SizeClass)
+{
+	if (SizeClass < 4)
+	{
+		return uint32(SizeClass) + 1;
+	}
+
+	const uint32 Log2 = uint32(SizeClass - 4) / 4 + 2;
+	const uint32 Step = uint32(SizeClass - 4) % 4;
+	return (5 + Step) << (Log2 - 2);
+}
+
+FRayTracingDynamicVertexBufferAllocator::FAllocation FRayTracingDynamicVertexBufferAllocator::Allocate(const void* Key, uint32 Size)
+{
+	const int32 SizeClass = GetSizeClass(Size);
+	const uint32 BlockSize = GetSizeClassUnits(SizeClass) * Alignment;
+
+	FKeyAllocation& KeyAllocation = KeyAllocations.FindOrAdd(Key);
+	KeyAllocation.LastUsedGenerationID = CurrentGenerationID;
+
+	if (KeyAllocation.Allocation.IsValid())
+	{
+		if (KeyAllocation.Allocation.Size == BlockSize && !Buffers[KeyAllocation.Allocation.BufferIndex].bCompacting)
+		{
+			return KeyAllocation.Allocation;
+		}
+
+		// Could still be used by this generation if the key is allocated more than once
+		FreeBlock(KeyAllocation.Allocation, CurrentGenerationID);
+	}
+
+	KeyAllocation.Allocation = AllocateBlock(SizeClass);
+	return KeyAllocation.Allocation;
+}
+
+void FRayTracingDynamicVertexBufferAllocator::Free(const void* Key)
+{
+	FKeyAllocation KeyAllocation;
+	if (KeyAllocations.RemoveAndCopyValue(Key, KeyAllocation) && KeyAllocation.Allocation.IsValid())
+	{
+		FreeBlock(KeyAllocation.Allocation, CurrentGenerationID);
+	}
+}
+
+FRayTracingDynamicVertexBufferAllocator::FAllocation FRayTracingDynamicVertexBufferAllocator::AllocateBlock(int32 SizeClass)
+{
+	const uint32 BlockSize = GetSizeClassUnits(SizeClass) * Alignment;
+
+	FAllocation Allocation;
+	Allocation.Size = BlockSize;
+
+	if (SizeClass < FreeBlocks.Num() && !FreeBlocks[SizeClass].IsEmpty())
+	{
+		const FBlock Block = FreeBlocks[SizeClass].Pop(EAllowShrinking::No);
+		Allocation.BufferIndex = Block.BufferIndex;
+		Allocation.Offset = Block.Offset;
+	}
+	else
+	{
+		// Bump allocate from the first buffer with enough space left, there are only a few
+		for (int32 BufferIndex = 0; BufferIndex < Buffers.Num(); ++BufferIndex)
+		{
+			const FBuffer& Buffer = Buffers[BufferIndex];
+			if (!Buffer.bCompacting && Buffer.Size - Buffer.BumpOffset >= BlockSize)
+			{
+				Allocation.BufferIndex = BufferIndex;
+				break;
+			}
+		}
+
+		if (!Allocation.IsValid())
+		{
+			Allocation.BufferIndex = Buffers.IndexOfByPredicate([](const FBuffer& Buffer) { return Buffer.Size == 0; });
+			if (Allocation.BufferIndex == INDEX_NONE)
+			{
+				Allocation.BufferIndex = Buffers.AddDefaulted();
+			}
+			Buffers[Allocation.BufferIndex] = FBuffer();
+			Buffers[Allocation.BufferIndex].Size = FMath::Max(BufferSize, BlockSize);
+		}
+
+		FBuffer& Buffer = Buffers[Allocation.BufferIndex];
+		Allocation.Offset = Buffer.BumpOffset;
+		Buffer.BumpOffset += BlockSize;
+	}
+
+	FBuffer& Buffer = Buffers[Allocation.BufferIndex];
+	Buffer.LiveSize += BlockSize;
+	Buffer.LastUsedGenerationID = CurrentGenerationID;
+
+	return Allocation;
+}
+
+void FRayTracingDynamicVertexBufferAllocator::FreeBlock(const FAllocation& Allocation, int64 LastUsedGenerationID)
+{
+	FBuffer& Buffer = Buffers[Allocation.BufferIndex];
+	check(Buffer.LiveSize >= Allocation.Size);
+	Buffer.LiveSize -= Allocation.Size;
+	Buffer.NumPendingFrees++;
+	Buffer.LastUsedGenerationID = FMath::Max(Buffer.LastUsedGenerationID, LastUsedGenerationID);
+
+	PendingFrees.Add({ Allocation, LastUsedGenerationID });
+}
+
+void FRayTracingDynamicVertexBufferAllocator::RemoveFreeBlocks(int32 BufferIndex)
+{
+	for (TArray<FBlock>& Blocks : FreeBlocks)
+	{
+		Blocks.RemoveAllSwap([BufferIndex](const FBlock& Block) { return Block.BufferIndex == BufferIndex; }, EAllowShrinking::No);
+	}
+}
+
+void FRayTracingDynamicVertexBufferAllocator::BeginGeneration(int64 GenerationID, int64 CompletedGenerationID, TArray<int32>& OutReleasedBuffers)
+{
+	check(GenerationID > CurrentGenerationID);
+	CurrentGenerationID = GenerationID;
+
+	// Keys which were not allocated in the previous generation are gone (or not written anymore)
+	for (auto It = KeyAllocations.CreateIterator(); It; ++It)
+	{
+		const FKeyAllocation& KeyAllocation = It.Value();
+		if (KeyAllocation.LastUsedGenerationID < GenerationID - 1)
+		{
+			if (KeyAllocation.Allocation.IsValid())
+			{
+				FreeBlock(KeyAllocation.Allocation, KeyAllocation.LastUsedGenerationID);
+			}
+			It.RemoveCurrent();
+		}
+	}
+
+	// Recycle the blocks which are not used by the GPU anymore
+	for (int32 Index = 0; Index < PendingFrees.Num(); ++Index)
+	{
+		const FPendingFree& PendingFree = PendingFrees[Index];
+		if (PendingFree.GenerationID > CompletedGenerationID)
+		{
+			continue;
+		}
+
+		FBuffer& Buffer = Buffers[PendingFree.Allocation.BufferIndex];
+		Buffer.NumPendingFrees--;
+
+		// Blocks of compacted buffers are not reused, the buffer is drained
+		if (!Buffer.bCompacting)
+		{
+			const int32 SizeClass = GetSizeClass(PendingFree.Allocation.Size);
+			if (SizeClass >= FreeBlocks.Num())
+			{
+				FreeBlocks.SetNum(SizeClass + 1);
+			}
+			FreeBlocks[SizeClass].Add({ PendingFree.Allocation.BufferIndex, PendingFree.Allocation.Offset });
+		}
+
+		PendingFrees.RemoveAtSwap(Index, EAllowShrinking::No);
+		--Index;
+	}
+
+	int32 NumBuffers = 0;
+	uint64 LiveSize = 0;
+	bool bAnyCompacting = false;
+
+	for (int32 BufferIndex = 0; BufferIndex < Buffers.Num(); ++BufferIndex)
+	{
+		FBuffer& Buffer = Buffers[BufferIndex];
+		if (Buffer.Size == 0)
+		{
+			continue;
+		}
+
+		if (Buffer.LiveSize == 0 && Buffer.NumPendingFrees == 0)
+		{
+			// Empty, merge all free blocks back into the bump range
+			if (Buffer.BumpOffset > 0)
+			{
+				RemoveFreeBlocks(BufferIndex);
+				Buffer.BumpOffset = 0;
+			}
+
+			if (Buffer.bCompacting || Buffer.LastUsedGenerationID + ReleaseLatency <= GenerationID)
+			{
+				Buffer = FBuffer();
+				OutReleasedBuffers.Add(BufferIndex);
+				continue;
+			}
+		}
+
+		++NumBuffers;
+		LiveSize += Buffer.LiveSize;
+		bAnyCompacting |= Buffer.bCompacting;
+	}
+
+	// Compact one buffer at a time, the lowest occupancy one if the live bytes fit in the other buffers
+	if (!bAnyCompacting && NumBuffers > 1 && LiveSize <= uint64(NumBuffers - 1) * BufferSize)
+	{
+		int32 CompactBufferIndex = INDEX_NONE;
+		float MinOccupancy = CompactionOccupancy;
+
+		for (int32 BufferIndex = 0; BufferIndex < Buffers.Num(); ++BufferIndex)
+		{
+			const FBuffer& Buffer = Buffers[BufferIndex];
+			if (Buffer.Size == BufferSize && Buffer.LiveSize > 0)
+			{
+				const float Occupancy = float(Buffer.LiveSize) / float(Buffer.Size);
+				if (Occupancy < MinOccupancy)
+				{
+					MinOccupancy = Occupancy;
+					CompactBufferIndex = BufferIndex;
+				}
+			}
+		}
+
+		if (CompactBufferIndex != INDEX_NONE)
+		{
+			Buffers[CompactBufferIndex].bCompacting = true;
+			RemoveFreeBlocks(CompactBufferIndex);
+		}
+	}
+}
+
+void FRayTracingDynamicVertexBufferAllocator::Empty()
+{
+	Buffers.Empty();
+	FreeBlocks.Empty();
+	PendingFrees.Empty();
+	KeyAllocations.Empty();
+}
+
+uint64 FRayTracingDynamicVertexBufferAllocator::GetLiveSize() const
+{
+	uint64 LiveSize = 0;
+	for (const FBuffer& Buffer : Buffers)
+	{
+		LiveSize += Buffer.LiveSize;
+	}
+	return LiveSize;
+}
+
+uint64 FRayTracingDynamicVertexBufferAllocator::GetCapacity() const
+{
+	uint64 Capacity = 0;
+	for (const FBuffer& Buffer : Buffers)
+	{
+		Capacity += Buffer.Size;
+	}
+	return Capacity;
+}
@@ -0,0 +1,110 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Sub-allocator for the shared vertex position buffers of ray tracing dynamic geometry, only manages offsets (no RHI resources).
+ * Blocks are rounded up to size classes (4 per power of two) and recycled through per class free lists, carved from a small set of large buffers.
+ * Allocations persist per key (geometry) across generations while the size class is unchanged, keys that are not allocated during a generation are freed.
+ * Frees are deferred until the generation which last used the block is completed on the GPU.
+ * Buffers with low occupancy are compacted by relocating their allocations on the next request, since the vertices are rewritten every generation anyway.
+ */
+class FRayTracingDynamicVertexBufferAllocator
+{
+public:
+	struct FAllocation
+	{
+		int32 BufferIndex = INDEX_NONE;
+		uint32 Offset = 0;
+		uint32 Size = 0;
+
+		bool IsValid() const { return BufferIndex != INDEX_NONE; }
+	};
+
+	FRayTracingDynamicVertexBufferAllocator(uint32 InBufferSize, uint32 InAlignment);
+
+	/** Number of empty generations before an empty buffer is released. */
+	void SetReleaseLatency(int32 InReleaseLatency) { ReleaseLatency = InReleaseLatency; }
+
+	/** Buffers with a smaller fraction of live bytes are compacted, if the live bytes fit in the other buffers. */
+	void SetCompactionOccupancy(float InCompactionOccupancy) { CompactionOccupancy = InCompactionOccupancy; }
+
+	/**
+	 * Starts a new generation: frees the allocations of keys which were not allocated during the previous generation,
+	 * recycles the frees of generations up to CompletedGenerationID, and selects a buffer to compact.
+	 * Buffers that are released are added to OutReleasedBuffers, their index can be reused by a later allocation.
+	 */
+	void BeginGeneration(int64 GenerationID, int64 CompletedGenerationID, TArray<int32>& OutReleasedBuffers);
+
+	/**
+	 * Allocation for the key with at least Size bytes, same as the previous one while the size class is unchanged and its buffer is not compacted.
+	 * Allocates a new buffer (GetBufferSize) when nothing fits, sized to the block for blocks larger than the buffer size.
+	 */
+	FAllocation Allocate(const void* Key, uint32 Size);
+
+	/** Free the allocation of the key, deferred until the current generation is completed. */
+	void Free(const void* Key);
+
+	void Empty();
+
+	/** Allocated range, including released buffers (of size 0). */
+	int32 GetNumBuffers() const { return Buffers.Num(); }
+	uint32 GetBufferSize(int32 BufferIndex) const { return Buffers[BufferIndex].Size; }
+
+	int32 GetNumAllocations() const { return KeyAllocations.Num(); }
+	uint64 GetLiveSize() const;
+	uint64 GetCapacity() const;
+
+	/** Size of the blocks of the class which fits Size bytes. */
+	uint32 GetBlockSize(uint32 Size) const { return GetSizeClassUnits(GetSizeClass(Size)) * Alignment; }
+
+private:
+	struct FBlock
+	{
+		int32 BufferIndex;
+		uint32 Offset;
+	};
+
+	struct FBuffer
+	{
+		// 0 when released
+		uint32 Size = 0;
+		uint32 BumpOffset = 0;
+		uint32 LiveSize = 0;
+		int32 NumPendingFrees = 0;
+		int64 LastUsedGenerationID = 0;
+		bool bCompacting = false;
+	};
+
+	struct FKeyAllocation
+	{
+		FAllocation Allocation;
+		int64 LastUsedGenerationID = 0;
+	};
+
+	struct FPendingFree
+	{
+		FAllocation Allocation;
+		int64 GenerationID;
+	};
+
+	int32 GetSizeClass(uint32 Size) const;
+	static uint32 GetSizeClassUnits(int32 SizeClass);
+
+	FAllocation AllocateBlock(int32 SizeClass);
+	void FreeBlock(const FAllocation& Allocation, int64 LastUsedGenerationID);
+	void RemoveFreeBlocks(int32 BufferIndex);
+
+	uint32 BufferSize;
+	uint32 Alignment;
+	int32 ReleaseLatency = 30;
+	float CompactionOccupancy = 0.5f;
+	int64 CurrentGenerationID = 0;
+
+	TArray<FBuffer> Buffers;
+	TArray<TArray<FBlock>> FreeBlocks;
+	TArray<FPendingFree> PendingFrees;
+	TMap<const void*, FKeyAllocation> KeyAllocations;
+};
@@ -117,6 +117,7 @@
 #include "Shadows/ShadowScene.h"
 #include "VariableRateShadingImageManager.h"
 #include "Streaming/SimpleStreamableAssetManager.h"
+#include "ForwardLightDataCache.h"
 
 #if WITH_EDITOR
 #include "Rendering/StaticLightingSystemInterface.h"
@@ -177,6 +178,14 @@ static TAutoConsoleVariable<int32> CVarVisibilityLocalLightPrimitiveInteraction(
 	ECVF_Scalability | ECVF_RenderThreadSafe
 );
 
+static TAutoConsoleVariable<int32> CVarNaniteRasterBinCompactionMinFreeBins(
+	TEXT("r.Nanite.RasterBinCompaction.MinFreeBins"),
+	64,
+	TEXT("Number of free Nanite raster bins below the highest allocated bin at which the raster bins of a mesh pass are compacted.\n")
+	TEXT("Every per bin buffer and dispatch scales with the highest allocated bin. 0 disables compaction."),
+	ECVF_RenderThreadSafe
+);
+
 DECLARE_CYCLE_STAT(TEXT("DeferredShadingSceneRenderer MotionBlurStartFrame"), STAT_FDeferredShadingSceneRenderer_MotionBlurStartFrame, STATGROUP_SceneRendering);
 
 IMPLEMENT_GLOBAL_SHADER_PARAMETER_STRUCT(FDistanceCullFadeUniformShaderParameters, "PrimitiveFade");
@@ -393,6 +402,7 @@ void FSceneViewState::ReleaseRHI()
 	EyeAdaptationManager.SafeRelease(); 
 	SubstrateViewDebugData.SafeRelease();
 	OcclusionFeedback.ReleaseResource();
+	InstanceCullingSetupCache.Reset();
 PRAGMA_DISABLE_DEPRECATION_WARNINGS
 	bValidEyeAdaptationTexture = false;
 PRAGMA_ENABLE_DEPRECATION_WARNINGS
@@ -756,6 +766,75 @@ void FScene::ReloadNaniteFixedFunctionBins()
 	}
 }
 
+void FScene::CompactNaniteRasterBins(TArray<FPrimitiveSceneInfo*, FSceneRenderingArrayAllocator>& OutRemappedPrimitives)
+{
+	const int32 MinFreeBins = CVarNaniteRasterBinCompactionMinFreeBins.GetValueOnRenderThread();
+	if (MinFreeBins <= 0)
+	{
+		return;
+	}
+
+	FNaniteRasterBinRemap Remaps[ENaniteMeshPass::Num];
+	bool bAnyRemap = false;
+	for (int32 NanitePass = 0; NanitePass < ENaniteMeshPass::Num; ++NanitePass)
+	{
+		if (NaniteRasterPipelines[NanitePass].GetNumFreeBins() >= uint32(MinFreeBins))
+		{
+			NaniteRasterPipelines[NanitePass].CompactBins(Remaps[NanitePass]);
+			NaniteVisibility[NanitePass].RemapRasterBins(Remaps[NanitePass]);
+			bAnyRemap |= !Remaps[NanitePass].IsEmpty();
+		}
+	}
+
+	if (!bAnyRemap)
+	{
+		return;
+	}
+
+	SCOPED_NAMED_EVENT(FScene_CompactNaniteRasterBins, FColor::Emerald);
+
+	// Patch the primitives' registered bins (also used for custom pass registrations) and material slots in bulk
+	for (FPrimitiveSceneInfo* PrimitiveSceneInfo : Primitives)
+	{
+		bool bMaterialSlotsChanged = false;
+		for (int32 NanitePass = 0; NanitePass < ENaniteMeshPass::Num; ++NanitePass)
+		{
+			const FNaniteRasterBinRemap& Remap = Remaps[NanitePass];
+			if (Remap.IsEmpty())
+			{
+				continue;
+			}
+
+			for (FNaniteRasterBin& RasterBin : PrimitiveSceneInfo->NaniteRasterBins[NanitePass])
+			{
+				RasterBin.BinIndex = Remap.Remap(RasterBin.BinIndex);
+			}
+
+			for (FNaniteMaterialSlot& MaterialSlot : PrimitiveSceneInfo->NaniteMaterialSlots[NanitePass])
+			{
+				const uint16 RasterBin = Remap.Remap(MaterialSlot.RasterBin);
+				const uint16 FallbackRasterBin = Remap.Remap(MaterialSlot.FallbackRasterBin);
+				bMaterialSlotsChanged |= RasterBin != MaterialSlot.RasterBin || FallbackRasterBin != MaterialSlot.FallbackRasterBin;
+				MaterialSlot.RasterBin = RasterBin;
+				MaterialSlot.FallbackRasterBin = FallbackRasterBin;
+			}
+		}
+
+		if (bMaterialSlotsChanged)
+		{
+			OutRemappedPrimitives.Add(PrimitiveSceneInfo);
+		}
+	}
+
+	for (int32 NanitePass = 0; NanitePass < ENaniteMeshPass::Num; ++NanitePass)
+	{
+		if (!Remaps[NanitePass].IsEmpty())
+		{
+			UE_LOG(LogRenderer, Verbose, TEXT("Compacted Nanite raster bins of mesh pass %d: %d bins relocated, %u bins"), NanitePass, Remaps[NanitePass].GetNumRelocatedBins(), NaniteRasterPipelines[NanitePass].GetBinCount());
+		}
+	}
+}
+
 SIZE_T FScene::GetSizeBytes() const
 {
 	return sizeof(*this) 
@@ -1669,8 +1748,10 @@ void FScene::FinishUpdatePrimitiveTransform()
 
 		// Pass the collection and actual number of accumulated updates
 		ENQUEUE_RENDER_COMMAND(UpdateTransformCommand)(
-			[PrimitivesUpdates = MoveTemp(PrimitivesUpdates), NumPrimitiveUpdates](FRHICommandListBase&)
+			[this, PrimitivesUpdates = MoveTemp(PrimitivesUpdates), NumPrimitiveUpdates](FRHICommandListBase&)
 			{
+				PrimitiveUpdates.Reserve<FUpdateTransformCommand>(NumPrimitiveUpdates);
+
 				for (int32 Index = 0; Index < NumPrimitiveUpdates; ++Index)
 				{
 					const auto& UpdateParams = PrimitivesUpdates[Index];
@@ -1709,6 +1790,58 @@ void FScene::FinishUpdatePrimitiveTransform()
 	}
 }
 
+void FScene::BatchUpdatePrimitiveTransforms_RenderThread(
+	TConstArrayView<FPrimitiveSceneProxy*> Proxies,
+	TConstArrayView<FBoxSphereBounds> WorldBounds,
+	TConstArrayView<FBoxSphereBounds> LocalBounds,
+	TConstArrayView<FMatrix> LocalToWorlds,
+	TConstArrayView<FVector> AttachmentRootPositions,
+	TConstArrayView<TOptional<FTransform>> PreviousTransforms)
+{
+	SCOPED_NAMED_EVENT(FScene_BatchUpdatePrimitiveTransforms_RenderThread, FColor::Yellow);
+	check(IsInRenderingThread());
+
+	const int32 NumUpdates = Proxies.Num();
+	check(WorldBounds.Num() == NumUpdates && LocalBounds.Num() == NumUpdates && LocalToWorlds.Num() == NumUpdates && AttachmentRootPositions.Num() == NumUpdates);
+	check(PreviousTransforms.IsEmpty() || PreviousTransforms.Num() == NumUpdates);
+	const bool bHasPreviousTransforms = !PreviousTransforms.IsEmpty();
+
+	// One reservation for the whole batch, rather than growing the queue one command at a time
+	PrimitiveUpdates.Reserve<FUpdateTransformCommand>(NumUpdates);
+
+	for (int32 Index = 0; Index < NumUpdates; ++Index)
+	{
+		FPrimitiveSceneProxy* SceneProxy = Proxies[Index];
+		FPrimitiveSceneInfo* PrimitiveSceneInfo = SceneProxy->GetPrimitiveSceneInfo();
+#if VALIDATE_PRIMITIVE_PACKED_INDEX
+		ValidatePackedPrimitiveIndexForUpdate(PrimitiveSceneInfo, PrimitiveUpdates);
+#endif
+
+		PrimitiveUpdates.Enqueue(PrimitiveSceneInfo, FUpdateTransformCommand { .WorldBounds = WorldBounds[Index], .LocalBounds = LocalBounds[Index], .LocalToWorld = LocalToWorlds[Index], .AttachmentRootPosition = AttachmentRootPositions[Index] });
+
+		if (bHasPreviousTransforms && PreviousTransforms[Index].IsSet())
+		{
+			PrimitiveUpdates.Enqueue(PrimitiveSceneInfo, FUpdateOverridePreviousTransformData(PreviousTransforms[Index].GetValue().ToMatrixWithScale()));
+		}
+
+		if (FSimpleStreamableAssetManager::IsEnabled())
+		{
+			FSimpleStreamableAssetManager::Update(
+				FSimpleStreamableAssetManager::FUpdate
+				{
+					SceneProxy,
+					SceneProxy->SimpleStreamableAssetManagerIndex,
+					WorldBounds[Index],
+					SceneProxy->GetMinDrawDistance(),
+					SceneProxy->GetMaxDrawDistance(),
+					PrimitiveSceneInfo->LastRenderTime,
+					SceneProxy->IsForceMipStreaming()
+				}
+			);
+		}
+	}
+}
+
 void FScene::UpdatePrimitiveOcclusionBoundsSlack(UPrimitiveComponent* Primitive, float NewSlack)
 {
 	UpdatePrimitiveInternal(Primitive->GetSceneProxy(), FUpdateOcclusionBoundsSlacksData(NewSlack));
@@ -2391,20 +2524,19 @@ void FScene::AddOrRemoveDecal_RenderThread(FDeferredDecalProxy* Proxy, bool bAdd
 	if (bAdd)
 	{
 		Decals.Add(Proxy);
+		DecalSceneCache.Add(Proxy, Proxy->ComponentTrans);
 		InvalidatePathTracedOutput();
 	}
 	else
 	{
-		// can be optimized
-		for (int32 Index = 0; Index < Decals.Num(); ++Index)
+		const int32 Index = DecalSceneCache.FindIndex(Proxy);
+		if (Index != INDEX_NONE)
 		{
-			if (Decals[Index] == Proxy)
-			{
-				InvalidatePathTracedOutput();
-				Decals.RemoveAtSwap(Index, EAllowShrinking::No);
-				delete Proxy;
-				break;
-			}
+			check(Decals[Index] == Proxy);
+			InvalidatePathTracedOutput();
+			Decals.RemoveAtSwap(Index, EAllowShrinking::No);
+			DecalSceneCache.RemoveAtSwap(Index);
+			delete Proxy;
 		}
 	}
 }
@@ -2521,6 +2653,12 @@ void FScene::UpdateDecalTransform(UDecalComponent* Decal)
 				}
 				// Update the primitive's transform.
 				DecalSceneProxy->SetTransformIncludingDecalSize(ComponentToWorldIncludingDecalSize, Bounds);
+
+				const int32 DecalIndex = Scene->DecalSceneCache.FindIndex(DecalSceneProxy);
+				if (DecalIndex != INDEX_NONE)
+				{
+					Scene->DecalSceneCache.UpdateTransform(DecalIndex, DecalSceneProxy->ComponentTrans);
+				}
 			});
 	}
 }
@@ -2597,6 +2735,12 @@ void FScene::BatchUpdateDecals(TArray<FDeferredDecalUpdateParams>&& UpdateParams
 
 				DecalUpdate.DecalProxy->SetTransformIncludingDecalSize(DecalUpdate.Transform, DecalUpdate.Bounds);
 
+				const int32 DecalIndex = Scene->DecalSceneCache.FindIndex(DecalUpdate.DecalProxy);
+				if (DecalIndex != INDEX_NONE)
+				{
+					Scene->DecalSceneCache.UpdateTransform(DecalIndex, DecalUpdate.DecalProxy->ComponentTrans);
+				}
+
 				// When FadeDuration is intentionally set to 0 the user expects the decal to not fade automatically
 				if (DecalUpdate.FadeDuration == 0.0f)
 				{
@@ -4429,6 +4573,7 @@ void FScene::ApplyWorldOffset_RenderThread(FRHICommandListBase& RHICmdList, cons
 	for (auto It = Decals.CreateIterator(); It; ++It)
 	{
 		(*It)->ComponentTrans.AddToTranslation(InOffset);
+		DecalSceneCache.UpdateTransform(It.GetIndex(), (*It)->ComponentTrans);
 	}
 
 	// Wind sources
@@ -4853,6 +4998,10 @@ void FScene::UpdateLights(FRDGBuilder& GraphBuilder, FSceneExtensionsUpdaters& S
 	SceneExtensionsUpdaters.PostLightsUpdate(GraphBuilder, ChangeSetAlloc.PostUpdateChangeSet);
 	OnPostLightSceneInfoUpdate.Broadcast(GraphBuilder, ChangeSetAlloc.PostUpdateChangeSet);
 	GPUScene.OnPostLightSceneInfoUpdate(GraphBuilder, ChangeSetAlloc.PostUpdateChangeSet);
+	if (ForwardLightDataCache.IsValid())
+	{
+		ForwardLightDataCache->OnPostLightSceneInfoUpdate(ChangeSetAlloc.PostUpdateChangeSet);
+	}
 }
 
 template<class T>
@@ -5189,6 +5338,9 @@ void FScene::Update(FRDGBuilder& GraphBuilder, const FUpdateParameters& Paramete
 		GPUSkinCacheTask = GPUSkinCache->Dispatch(GraphBuilder, GPUSkinTasks.SkinCache, GPUSkinCachePipeline);
 	}
 
+	// Decals added or removed since the last update change the order the visible decals are emitted in
+	DecalSceneCache.UpdateBatchOrder(Decals);
+
 	UE::Tasks::FTask UpdateUniformExpressionsTask;
 	FMaterialRenderProxy::UpdateDeferredCachedUniformExpressions(GraphBuilder.RHICmdList, EnumHasAnyFlags(Parameters.AsyncOps, EUpdateAllPrimitiveSceneInfosAsyncOps::CacheMaterialUniformExpressions) ? &UpdateUniformExpressionsTask : nullptr);
 
@@ -6185,6 +6337,10 @@ void FScene::Update(FRDGBuilder& GraphBuilder, const FUpdateParameters& Paramete
 		}
 	}
 
+	// Compact the Nanite raster bins once the bins of re-cached primitives are released and before any new bin is registered
+	TArray<FPrimitiveSceneInfo*, FSceneRenderingArrayAllocator> NaniteRasterBinRemappedPrimitives;
+	CompactNaniteRasterBins(NaniteRasterBinRemappedPrimitives);
+
 	// LPI creation needs to launch after the static mesh update as it can call RequestStaticMeshUpdate() which modifies PrimitivesNeedingStaticMeshUpdate.
 	CreateLightPrimitiveInteractionsTask = GraphBuilder.AddSetupTask([this, &SceneInfosWithAddToScene]
 	{
@@ -6271,6 +6427,7 @@ void FScene::Update(FRDGBuilder& GraphBuilder, const FUpdateParameters& Paramete
 
 	if (auto NaniteMaterialsUpdater = SceneExtensionsUpdaters.GetUpdaterPtr<Nanite::FMaterialsSceneExtension::FUpdater>())
 	{
+		NaniteMaterialsUpdater->AddMaterialDataUpdates(NaniteRasterBinRemappedPrimitives);
 		NaniteMaterialsUpdater->PostCacheNaniteMaterialBins(GraphBuilder, SceneInfosWithStaticDrawListUpdate);
 	}
 	
@@ -122,6 +122,12 @@ static TAutoConsoleVariable<int32> CVarSceneCullingAsyncQuery(
 	TEXT("Enable/Disable async culling scene queries."),
 	ECVF_RenderThreadSafe);
 
+static TAutoConsoleVariable<bool> CVarSceneCullingHierarchicalConvexCulling(
+	TEXT("r.SceneCulling.HierarchicalConvexCulling"), 
+	false, 
+	TEXT("Cull large (non-sphere) culling volumes against the cells on the CPU, traversing the occupied blocks coarse to fine, instead of testing all chunks on the GPU."),
+	ECVF_RenderThreadSafe);
+
 static TAutoConsoleVariable<float> CVarSceneCullingMinCellSize(
 	TEXT("r.SceneCulling.MinCellSize"), 
 	4096.0f, 
@@ -486,97 +492,6 @@ inline FSceneCulling::FFootprint64 ToLevelRelative(const FSceneCulling::FFootpri
 	return Result;
 };
 
-#if 0
-void FSceneCulling::TestConvexVolume(const FConvexVolume& ViewCullVolume, const FVector3d &WorldToVolumeTranslation, TArray<FCellDraw, SceneRenderingAllocator>& OutCellDraws, uint32 ViewGroupId, uint32& OutNumInstanceGroups) const
-{
-	LLM_SCOPE_BYTAG(SceneCulling);
-
-	SCOPE_CYCLE_COUNTER(STAT_SceneCulling_Test_Convex);
-#if OLA_TODO
-	FSpatialHashNullDebugDrawer DebugDrawer;
-#endif
-
-	OutNumInstanceGroups += UncullableNumItemChunks;
-
-	for (auto It = SpatialHash.GetHashMap().begin(); It != SpatialHash.GetHashMap().end(); ++It)
-	{
-		const auto& BlockItem = *It;
-		int32 BlockIndex = It.GetElementId().GetIndex();
-		const FSpatialHash::FCellBlock& Block = BlockItem.Value;
-		FSpatialHash::FBlockLoc BlockLoc = BlockItem.Key;
-
-#if OLA_TODO
-		DebugDrawer.OnBlockBegin(BlockLoc);
-#endif
-
-		const double BlockLevelSize = SpatialHash.GetCellSize(BlockLoc.GetLevel());
-		FVector3d BlockBoundsCenter = FVector3d(BlockLoc.GetCoord()) * BlockLevelSize + BlockLevelSize * 0.5;
-		const double LevelCellSize = SpatialHash.GetCellSize(BlockLoc.GetLevel() - FSpatialHash::CellBlockDimLog2);
-		// Extend extent by half a cell size in all directions
-		FVector3d BlockBoundsExtent = FVector((BlockLevelSize + LevelCellSize) * 0.5);
-		FOutcode BlockCullResult = ViewCullVolume.GetBoxIntersectionOutcode(BlockBoundsCenter + WorldToVolumeTranslation, BlockBoundsExtent);
-
-		if (BlockCullResult.GetInside())
-		{
-			const bool bIsContained = !BlockCullResult.GetOutside();
-			if (bIsContained)
-			{
-				// TODO: collect this in a per-block summary so we don't need to hit cell headers in this path
-				OutNumInstanceGroups += Block.NumItemChunks;
-
-				// Fully inside, just append non-empty cells
-				int32 BitRangeEnd = Block.GridOffset + FSpatialHash::CellBlockSize;
-				for (TConstSetBitIterator<> BitIt(CellOccupancyMask, Block.GridOffset); BitIt && BitIt.GetIndex() < BitRangeEnd; ++BitIt)
-				{
-					uint32 CellId = uint32(BitIt.GetIndex());
-					OutCellDraws.Add(FCellDraw{ CellId, ViewGroupId });
-				}
-			}
-			else
-			{
-				FVector3d CellBoundsExtent = FVector3d(LevelCellSize);
-				FVector3d MinCellCenter = FVector3d(BlockLoc.GetCoord()) * BlockLevelSize + LevelCellSize * 0.5;
-
-				int32 BitRangeEnd = Block.GridOffset + FSpatialHash::CellBlockSize;
-				for (TConstSetBitIterator<> BitIt(CellOccupancyMask, Block.GridOffset); BitIt && BitIt.GetIndex() < BitRangeEnd; ++BitIt)
-				{
-					uint32 CellId = uint32(BitIt.GetIndex());
-					FInt8Vector3 CellCoord;
-					{
-						uint32 BlockCellIndex = CellId - Block.GridOffset;
-						CellCoord.X = BlockCellIndex & FSpatialHash::LocalCellCoordMask;
-						BlockCellIndex = BlockCellIndex >> FSpatialHash::CellBlockDimLog2;
-						CellCoord.Y = BlockCellIndex & FSpatialHash::LocalCellCoordMask;
-						BlockCellIndex = BlockCellIndex >> FSpatialHash::CellBlockDimLog2;
-						CellCoord.Z = BlockCellIndex;
-					}
-					// world-space double precision test, can equally translate to view local and do single precision test (with epsilons perhaps)
-					FVector3d CellCenter = FVector3d(CellCoord) * LevelCellSize + MinCellCenter;
-
-					// emit for intersecting cells
-					bool bCellIntersects = ViewCullVolume.IntersectBox(CellCenter, WorldToVolumeTranslation, CellBoundsExtent);
-					if (bCellIntersects)
-					{
-						FCellHeader CellHeader = UnpackCellHeader(CellHeaders[CellId]);
-						check(IsValidCell(CellHeader));
-
-						OutNumInstanceGroups += CellHeader.NumItemChunks;
-						OutCellDraws.Add(FCellDraw{ CellId, ViewGroupId });
-					}
-#if OLA_TODO
-					DebugDrawer.DrawCell(bCellIntersects && !bIsContained, bCellIntersects, CellCenter, CellBoundsExtent);
-#endif
-				}
-#if OLA_TODO
-				DebugDrawer.DrawBlock(bIsContained, BlockBounds);
-#endif
-			}
-		}
-	}
-}
-
-#endif
-
 bool FSceneCulling::IsSmallCullingVolume(const FCullingVolume& CullingVolume) const
 {
 	if (CullingVolume.Sphere.W > 0.0f)
@@ -604,6 +519,8 @@ void FSceneCulling::Empty()
 	CellHeaders.Empty();
 	CellOccupancyMask.Empty();
 	BlockLevelOccupancyMask.Empty();
+	BlockTree.Empty();
+	bBlockTreeValid = false;
 
 	CellBlockData.Empty();
 	UnCullablePrimitives.Empty();
@@ -1245,6 +1162,7 @@ public:
 		if (!bAlreadyInMap)
 		{
 			BUILDER_LOG("Allocated Block %d", BlockId.GetIndex());
+			bBlocksAddedOrRemoved = true;
 		}
 
 		return BlockId;
@@ -2412,6 +2330,7 @@ public:
 				}
 #endif
 				SpatialHashMap.RemoveByElementId(BlockIndex);
+				bBlocksAddedOrRemoved = true;
 				BlockData.WorldPos = FDFVector3{};
 				BlockData.LevelCellSize = 0.0f;
 			}
@@ -2436,11 +2355,39 @@ public:
 			}
 		}
 
-		// Mark used levels to be able to skip empty ones when querying. Could be skipped if no blocks were added/removed.
-		SceneCulling.BlockLevelOccupancyMask.Init(false, FSpatialHash::kMaxLevel);
-		for (const auto &Item : SpatialHashMap)
+		// Mark used levels to be able to skip empty ones when querying, only depends on the set of blocks.
+		if (bBlocksAddedOrRemoved)
+		{
+			SceneCulling.BlockLevelOccupancyMask.Init(false, FSpatialHash::kMaxLevel);
+			for (auto It = SpatialHashMap.begin(); It != SpatialHashMap.end(); ++It)
+			{
+				SceneCulling.BlockLevelOccupancyMask[(*It).Key.GetLevel()] = true;
+			}
+
+			SceneCulling.bBlockTreeValid = false;
+			bBlocksAddedOrRemoved = false;
+		}
+
+		// The block traversal tree is only used by hierarchical convex culling, (re)build it when the blocks changed or when it was turned on.
+		if (SceneCulling.bUseHierarchicalConvexCulling && !SceneCulling.bBlockTreeValid)
+		{
+			SC_SCOPED_NAMED_EVENT_DETAIL(SceneCulling_BuildBlockTree, FColor::Emerald);
+
+			TArray<FSceneCullingBlockTree::FBlockEntry, SceneRenderingAllocator> BlockEntries;
+			BlockEntries.Reserve(SpatialHashMap.Num());
+			for (auto It = SpatialHashMap.begin(); It != SpatialHashMap.end(); ++It)
+			{
+				const FBlockLoc BlockLoc = (*It).Key;
+				BlockEntries.Add(FSceneCullingBlockTree::FBlockEntry{ BlockLoc.GetCoord(), BlockLoc.GetLevel(), It.GetElementId().GetIndex() });
+			}
+
+			SceneCulling.BlockTree.Build(BlockEntries);
+			SceneCulling.bBlockTreeValid = true;
+		}
+		else if (!SceneCulling.bUseHierarchicalConvexCulling && SceneCulling.BlockTree.Num() > 0)
 		{
-			SceneCulling.BlockLevelOccupancyMask[Item.Key.GetLevel()] = true;
+			SceneCulling.BlockTree.Empty();
+			SceneCulling.bBlockTreeValid = false;
 		}
 		
 		// Note: this can be put into an own task as it can be waited on by the data upload.
@@ -2516,6 +2463,7 @@ public:
 
 	// Dirty state tracking for upload
 	int32 NumDirtyBlocks = 0;
+	bool bBlocksAddedOrRemoved = false;
 	TBitArray<SceneRenderingAllocator> DirtyBlocks;
 	TBitArray<SceneRenderingAllocator> DirtyChunks;
 	// Dirty tracking for explicit cell bounds
@@ -2656,6 +2604,7 @@ bool FSceneCulling::BeginUpdate(FRDGBuilder& GraphBuilder, bool bAnySceneUpdates
 	SmallFootprintCellSideThreshold = CVarSmallFootprintSideThreshold.GetValueOnRenderThread();
 	bUseAsyncUpdate = CVarSceneCullingAsyncUpdate.GetValueOnRenderThread() != 0;
 	bUseAsyncQuery = CVarSceneCullingAsyncQuery.GetValueOnRenderThread() != 0;
+	bUseHierarchicalConvexCulling = CVarSceneCullingHierarchicalConvexCulling.GetValueOnRenderThread();
 
 	if (bIsEnabled)
 	{
@@ -13,6 +13,7 @@
 
 #include "SceneCullingDefinitions.h"
 #include "HierarchicalSpatialHashGrid.h"
+#include "SceneCullingBlockTree.h"
 #include "InstanceDataSceneProxy.h"
 #include "SceneExtensions.h"
 
@@ -91,10 +92,19 @@ public:
 
 	void PublishStats();
 
-#if 0
-	// This implementation is not currently used (and the data structures have changed somewhat) but is kept for reference.
-	void TestConvexVolume(const FConvexVolume& ViewCullVolume, const FVector3d &WorldToVolumeTranslation, TArray<FCellDraw, SceneRenderingAllocator>& OutCellDraws, uint32 ViewGroupId, uint32& OutNumInstanceGroups) const;
-#endif
+	/**
+	 * Coarse-to-fine test of the convex volume against the occupied cells, calls ResultConsumer.OnCellOverlap(CellId) for each intersecting cell.
+	 * Returns the number of block tree region tests.
+	 */
+	template <typename ResultConsumerType>
+	int32 TestConvexVolume(const FCullingVolume& CullingVolume, ResultConsumerType& ResultConsumer) const;
+
+	/**
+	 * True if large culling volumes should be culled against the cells on the CPU (TestConvexVolume), rather than testing all chunks on the GPU.
+	 * False until the block tree has been built by an update after the feature was turned on.
+	 */
+	bool UseHierarchicalConvexCulling() const { return bUseHierarchicalConvexCulling && bBlockTreeValid; }
+
 	template <typename ResultConsumerType>
 	void TestSphere(const FSphere& Sphere, ResultConsumerType& ResultConsumer) const;
 
@@ -311,6 +321,9 @@ private:
 	TArray<FPackedCellHeader> CellHeaders;
 	TBitArray<> CellOccupancyMask;
 	TBitArray<> BlockLevelOccupancyMask;
+	// Coarse-to-fine traversal over the occupied blocks, only built while hierarchical convex culling is enabled, and rebuilt when blocks are added or removed.
+	FSceneCullingBlockTree BlockTree { FSpatialHash::CellBlockDimLog2 };
+	bool bBlockTreeValid = false;
 	// Bit marking each chunk ID as in use or not, complements the CellChunkIdAllocator.
 	TBitArray<> UsedChunkIdMask;
 
@@ -323,6 +336,7 @@ private:
 	bool bTestCellVsQueryBounds = true;
 	bool bUseAsyncUpdate = true;
 	bool bUseAsyncQuery = true;
+	bool bUseHierarchicalConvexCulling = false;
 	bool bPackedCellDataLocked = false;
 
 	inline uint32 AllocateChunk();
@@ -114,6 +114,52 @@ void FSceneCulling::TestSphere(const FSphere& Sphere, ResultConsumerType& Result
 	}
 }
 
+template <typename ResultConsumerType>
+int32 FSceneCulling::TestConvexVolume(const FCullingVolume& CullingVolume, ResultConsumerType& ResultConsumer) const
+{
+	const FSpatialHash::FSpatialHashMap &GlobalSpatialHash = SpatialHash.GetHashMap();
+
+	return BlockTree.Traverse(CullingVolume.ConvexVolume, CullingVolume.WorldToVolumeTranslation, [&](int32 BlockIndex, bool bFullyContained)
+	{
+		const auto& BlockItem = GlobalSpatialHash.GetByElementId(BlockIndex);
+		const FSpatialHash::FCellBlock& Block = BlockItem.Value;
+		const int32 BitRangeEnd = Block.GridOffset + FSpatialHash::CellBlockSize;
+
+		if (bFullyContained)
+		{
+			// Fully inside, just append non-empty cells
+			for (TConstSetBitIterator<> BitIt(CellOccupancyMask, Block.GridOffset); BitIt && BitIt.GetIndex() < BitRangeEnd; ++BitIt)
+			{
+				ResultConsumer.OnCellOverlap(uint32(BitIt.GetIndex()));
+			}
+			return;
+		}
+
+		// Test the cells relative to the block in single precision, the block world position is only used to translate the planes
+		const FBlockLoc BlockLoc = BlockItem.Key;
+		const FSceneCullingLocalConvexVolume LocalCullVolume(CullingVolume.ConvexVolume, BlockLoc.GetWorldPosition() + CullingVolume.WorldToVolumeTranslation);
+
+		const float LevelCellSize = float(SpatialHash.GetCellSize(BlockLoc.GetLevel() - FSpatialHash::CellBlockDimLog2));
+		// Extend extent by half a cell size in all directions
+		const FVector3f CellBoundsExtent(LevelCellSize);
+
+		for (TConstSetBitIterator<> BitIt(CellOccupancyMask, Block.GridOffset); BitIt && BitIt.GetIndex() < BitRangeEnd; ++BitIt)
+		{
+			const uint32 BlockCellIndex = uint32(BitIt.GetIndex() - Block.GridOffset);
+			const FVector3f CellCoord(
+				float(BlockCellIndex & FSpatialHash::LocalCellCoordMask),
+				float((BlockCellIndex >> FSpatialHash::CellBlockDimLog2) & FSpatialHash::LocalCellCoordMask),
+				float(BlockCellIndex >> (2 * FSpatialHash::CellBlockDimLog2)));
+			const FVector3f CellCenter = (CellCoord + 0.5f) * LevelCellSize;
+
+			if (LocalCullVolume.IntersectBox(CellCenter, CellBoundsExtent))
+			{
+				ResultConsumer.OnCellOverlap(uint32(BitIt.GetIndex()));
+			}
+		}
+	});
+}
+
 inline bool IsValidCell(const FCellHeader& CellHeader)
 {
 	return CellHeader.bIsValid;
@@ -0,0 +1,149 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "SceneCullingBlockTree.h"
+
+void FSceneCullingBlockTree::Build(TConstArrayView<FBlockEntry> Blocks)
+{
+	Nodes.Reset();
+
+	if (Blocks.IsEmpty())
+	{
+		return;
+	}
+
+	int32 MaxBlockLevel = MIN_int32;
+	for (const FBlockEntry& Block : Blocks)
+	{
+		MaxBlockLevel = FMath::Max(MaxBlockLevel, Block.Level);
+	}
+
+	auto ToLevel = [](const FIntVector3& Coord, int32 LevelDelta)
+	{
+		// Arithmetic shift, rounds towards negative infinity like the cell coordinates
+		return FIntVector3(Coord.X >> LevelDelta, Coord.Y >> LevelDelta, Coord.Z >> LevelDelta);
+	};
+
+	// Raise the root level until there are few enough roots to test them linearly, at 31 levels up all coordinates have collapsed to 0 / -1
+	int32 RootLevel = MaxBlockLevel;
+	{
+		TSet<FIntVector3> Roots;
+		for (; RootLevel < MaxBlockLevel + 31; ++RootLevel)
+		{
+			Roots.Reset();
+			for (const FBlockEntry& Block : Blocks)
+			{
+				Roots.Add(ToLevel(Block.Coord, FMath::Min(RootLevel - Block.Level, 31)));
+			}
+
+			if (Roots.Num() <= MaxRootNodes)
+			{
+				break;
+			}
+		}
+	}
+
+	struct FBuildNode
+	{
+		FIntVector3 Coord;
+		int32 Level;
+		int32 BlockId;
+		int32 FirstChild;
+		int32 NextSibling;
+	};
+
+	TArray<FBuildNode> BuildNodes;
+	TArray<int32> RootNodes;
+	TMap<FIntVector4, int32> NodeIndices;
+	BuildNodes.Reserve(Blocks.Num() * 2);
+	NodeIndices.Reserve(Blocks.Num() * 2);
+
+	auto FindOrAddNode = [&](const FIntVector3& Coord, int32 Level, bool& bOutIsNew)
+	{
+		int32& NodeIndex = NodeIndices.FindOrAdd(FIntVector4(Coord.X, Coord.Y, Coord.Z, Level), INDEX_NONE);
+		bOutIsNew = NodeIndex == INDEX_NONE;
+		if (bOutIsNew)
+		{
+			NodeIndex = BuildNodes.Add(FBuildNode{ Coord, Level, INDEX_NONE, INDEX_NONE, INDEX_NONE });
+			if (Level == RootLevel)
+			{
+				RootNodes.Add(NodeIndex);
+			}
+		}
+		return NodeIndex;
+	};
+
+	for (const FBlockEntry& Block : Blocks)
+	{
+		bool bIsNew = false;
+		int32 ChildIndex = FindOrAddNode(Block.Coord, Block.Level, bIsNew);
+		check(BuildNodes[ChildIndex].BlockId == INDEX_NONE);
+		BuildNodes[ChildIndex].BlockId = Block.BlockId;
+
+		// Link up to the first existing ancestor
+		for (int32 Level = Block.Level + 1; bIsNew && Level <= RootLevel; ++Level)
+		{
+			const int32 ParentIndex = FindOrAddNode(ToLevel(Block.Coord, FMath::Min(Level - Block.Level, 31)), Level, bIsNew);
+			BuildNodes[ChildIndex].NextSibling = BuildNodes[ParentIndex].FirstChild;
+			BuildNodes[ParentIndex].FirstChild = ChildIndex;
+			ChildIndex = ParentIndex;
+		}
+	}
+
+	// Flatten depth first, a negative stack entry closes the subtree of the node at ~Entry
+	Nodes.Reserve(BuildNodes.Num());
+	TArray<int32, TInlineAllocator<256>> Stack;
+	for (int32 RootIndex = RootNodes.Num() - 1; RootIndex >= 0; --RootIndex)
+	{
+		Stack.Push(RootNodes[RootIndex]);
+	}
+
+	while (!Stack.IsEmpty())
+	{
+		const int32 Entry = Stack.Pop(EAllowShrinking::No);
+		if (Entry < 0)
+		{
+			Nodes[~Entry].SubtreeEnd = Nodes.Num();
+			continue;
+		}
+
+		const FBuildNode& BuildNode = BuildNodes[Entry];
+		const int32 NodeIndex = Nodes.Add(FNode{ BuildNode.Coord, BuildNode.Level, INDEX_NONE, BuildNode.BlockId });
+		Stack.Push(~NodeIndex);
+
+		for (int32 ChildIndex = BuildNode.FirstChild; ChildIndex != INDEX_NONE; ChildIndex = BuildNodes[ChildIndex].NextSibling)
+		{
+			Stack.Push(ChildIndex);
+		}
+	}
+
+	check(Nodes.Num() == BuildNodes.Num());
+}
+
+FSceneCullingLocalConvexVolume::FSceneCullingLocalConvexVolume(const FConvexVolume& ConvexVolume, const FVector3d& LocalOrigin)
+{
+	const int32 NumPlanes = ConvexVolume.Planes.Num();
+	PermutedPlanes.SetNumUninitialized(Align(NumPlanes, 4));
+
+	for (int32 GroupIndex = 0; GroupIndex < NumPlanes; GroupIndex += 4)
+	{
+		float X[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float Y[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float Z[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float W[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+		for (int32 Index = 0; Index < 4 && GroupIndex + Index < NumPlanes; ++Index)
+		{
+			const FPlane& Plane = ConvexVolume.Planes[GroupIndex + Index];
+			X[Index] = float(Plane.X);
+			Y[Index] = float(Plane.Y);
+			Z[Index] = float(Plane.Z);
+			// Translate in double precision, only the local offsets are single precision
+			W[Index] = float(Plane.W - Plane.GetNormal().Dot(LocalOrigin));
+		}
+
+		PermutedPlanes[GroupIndex + 0] = VectorLoad(X);
+		PermutedPlanes[GroupIndex + 1] = VectorLoad(Y);
+		PermutedPlanes[GroupIndex + 2] = VectorLoad(Z);
+		PermutedPlanes[GroupIndex + 3] = VectorLoad(W);
+	}
+}
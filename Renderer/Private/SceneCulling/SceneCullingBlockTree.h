@@ -0,0 +1,162 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ConvexVolume.h"
+#include "Rendering/RenderingSpatialHash.h"
+
+/**
+ * Coarse-to-fine traversal structure over the occupied cell blocks of the scene culling spatial hash.
+ * Every block is linked to its ancestor regions (same coordinate shifted down, one level up each step) up to a root level that keeps the number of roots small.
+ * Nodes are stored in depth first order, such that a subtree is a contiguous node range that can be skipped or emitted in one go.
+ * Only depends on the set of blocks, so it only needs to be rebuilt when blocks are added or removed.
+ */
+class FSceneCullingBlockTree
+{
+public:
+	struct FBlockEntry
+	{
+		FIntVector3 Coord;
+		int32 Level;
+		int32 BlockId;
+	};
+
+	struct FNode
+	{
+		FIntVector3 Coord;
+		int32 Level;
+		// One past the last node in the subtree
+		int32 SubtreeEnd;
+		// Block with the same location as the node, or INDEX_NONE for a pure region node
+		int32 BlockId;
+	};
+
+	/** Max number of root nodes tested linearly, the root level is raised until the roots fit (or the coordinates collapse). */
+	static constexpr int32 MaxRootNodes = 64;
+
+	/** Blocks are padded by half a cell of the level CellBlockDimLog2 below their own, same as the cell looseness. */
+	FSceneCullingBlockTree(int32 InCellBlockDimLog2 = 3)
+		: CellBlockDimLog2(InCellBlockDimLog2)
+	{
+	}
+
+	void Build(TConstArrayView<FBlockEntry> Blocks);
+
+	void Empty()
+	{
+		Nodes.Empty();
+	}
+
+	int32 Num() const { return Nodes.Num(); }
+
+	const TArray<FNode>& GetNodes() const { return Nodes; }
+
+	/**
+	 * Loose bounds of the region of a node, conservative for all blocks in the subtree.
+	 */
+	inline void GetNodeBounds(const FNode& Node, FVector3d& OutCenter, FVector3d& OutExtent) const
+	{
+		const double RegionSize = RenderingSpatialHash::GetCellSize(Node.Level);
+		const double CellSize = RenderingSpatialHash::GetCellSize(Node.Level - CellBlockDimLog2);
+		OutCenter = (FVector3d(Node.Coord) + 0.5) * RegionSize;
+		OutExtent = FVector3d((RegionSize + CellSize) * 0.5);
+	}
+
+	/**
+	 * Test the regions against the convex volume coarse to fine, calls BlockFunction(BlockId, bFullyContained) for each block that is not culled.
+	 * Subtrees of regions that are outside are skipped and the blocks of regions that are fully contained are emitted without further tests.
+	 * Returns the number of region tests.
+	 */
+	template <typename BlockFunctionType>
+	int32 Traverse(const FConvexVolume& ConvexVolume, const FVector3d& WorldToVolumeTranslation, BlockFunctionType&& BlockFunction) const
+	{
+		int32 NumTests = 0;
+
+		for (int32 NodeIndex = 0; NodeIndex < Nodes.Num(); )
+		{
+			const FNode& Node = Nodes[NodeIndex];
+
+			FVector3d Center;
+			FVector3d Extent;
+			GetNodeBounds(Node, Center, Extent);
+
+			const FOutcode Outcode = ConvexVolume.GetBoxIntersectionOutcode(Center + WorldToVolumeTranslation, Extent);
+			++NumTests;
+
+			if (!Outcode.GetInside())
+			{
+				NodeIndex = Node.SubtreeEnd;
+			}
+			else if (!Outcode.GetOutside())
+			{
+				for (; NodeIndex < Node.SubtreeEnd; ++NodeIndex)
+				{
+					if (Nodes[NodeIndex].BlockId != INDEX_NONE)
+					{
+						BlockFunction(Nodes[NodeIndex].BlockId, true);
+					}
+				}
+			}
+			else
+			{
+				if (Node.BlockId != INDEX_NONE)
+				{
+					BlockFunction(Node.BlockId, false);
+				}
+				++NodeIndex;
+			}
+		}
+
+		return NumTests;
+	}
+
+private:
+	int32 CellBlockDimLog2;
+	TArray<FNode> Nodes;
+};
+
+/**
+ * Convex volume translated to a local origin (e.g., a block) and converted to single precision, for SIMD tests of many small boxes near that origin.
+ * Planes are permuted in groups of four, padded with planes that never cull.
+ */
+class FSceneCullingLocalConvexVolume
+{
+public:
+	/** LocalOrigin is in the space of the convex volume (i.e., world position plus the world to volume translation). */
+	FSceneCullingLocalConvexVolume(const FConvexVolume& ConvexVolume, const FVector3d& LocalOrigin);
+
+	/** Same as FConvexVolume::IntersectBox, with a local space box. */
+	inline bool IntersectBox(const FVector3f& Center, const FVector3f& Extent) const
+	{
+		const VectorRegister4Float OrigX = VectorSetFloat1(Center.X);
+		const VectorRegister4Float OrigY = VectorSetFloat1(Center.Y);
+		const VectorRegister4Float OrigZ = VectorSetFloat1(Center.Z);
+		const VectorRegister4Float AbsExtentX = VectorSetFloat1(FMath::Abs(Extent.X));
+		const VectorRegister4Float AbsExtentY = VectorSetFloat1(FMath::Abs(Extent.Y));
+		const VectorRegister4Float AbsExtentZ = VectorSetFloat1(FMath::Abs(Extent.Z));
+
+		for (int32 Index = 0; Index < PermutedPlanes.Num(); Index += 4)
+		{
+			const VectorRegister4Float PlanesX = PermutedPlanes[Index + 0];
+			const VectorRegister4Float PlanesY = PermutedPlanes[Index + 1];
+			const VectorRegister4Float PlanesZ = PermutedPlanes[Index + 2];
+			const VectorRegister4Float PlanesW = PermutedPlanes[Index + 3];
+
+			// Distance (x * x) + (y * y) + (z * z) - w
+			const VectorRegister4Float Distance = VectorSubtract(VectorMultiplyAdd(OrigZ, PlanesZ, VectorMultiplyAdd(OrigY, PlanesY, VectorMultiply(OrigX, PlanesX))), PlanesW);
+			// Push out FMath::Abs(x * x) + FMath::Abs(y * y) + FMath::Abs(z * z)
+			const VectorRegister4Float PushOut = VectorMultiplyAdd(AbsExtentZ, VectorAbs(PlanesZ), VectorMultiplyAdd(AbsExtentY, VectorAbs(PlanesY), VectorMultiply(AbsExtentX, VectorAbs(PlanesX))));
+
+			if (VectorAnyGreaterThan(Distance, PushOut))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+private:
+	TArray<VectorRegister4Float, TInlineAllocator<8>> PermutedPlanes;
+};
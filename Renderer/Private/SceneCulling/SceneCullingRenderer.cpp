@@ -269,28 +269,36 @@ void FSceneInstanceCullingQuery::ComputeResult()
 	for (uint32 ViewGroupId = 0; ViewGroupId < uint32(CullingJobs.Num()); ++ViewGroupId)
 	{
 		const FCullingJob& CullingJob = CullingJobs[ViewGroupId];
-		if (SceneCulling.IsSmallCullingVolume(CullingJob.CullingVolume))
+
+		struct FResultConsumer
 		{
-			struct FResultConsumer
-			{
-				FSceneInstanceCullResult* CullingResult;
-				uint32 ViewGroupId;
-				const TArray<FPackedCellHeader>& CellHeaders;
+			FSceneInstanceCullResult* CullingResult;
+			uint32 ViewGroupId;
+			const TArray<FPackedCellHeader>& CellHeaders;
 
-				void OnCellOverlap(uint32 CellId)
+			void OnCellOverlap(uint32 CellId)
+			{
+				FCellHeader CellHeader = UnpackCellHeader(CellHeaders[CellId]);
+				if (IsValidCell(CellHeader))
 				{
-					FCellHeader CellHeader = UnpackCellHeader(CellHeaders[CellId]);
-					if (IsValidCell(CellHeader))
-					{
-						CullingResult->CellChunkDraws.Add(FCellChunkDraw{ CellHeader.ItemChunksOffset, ViewGroupId }, CellHeader.NumItemChunks);
-					}
+					CullingResult->CellChunkDraws.Add(FCellChunkDraw{ CellHeader.ItemChunksOffset, ViewGroupId }, CellHeader.NumItemChunks);
 				}
-			};
+			}
+		};
 
+		if (SceneCulling.IsSmallCullingVolume(CullingJob.CullingVolume))
+		{
 			FResultConsumer ResultConsumer { CullingResult, ViewGroupId, SceneCulling.CellHeaders };
 
 			SceneCulling.TestSphere(CullingJob.CullingVolume.Sphere, ResultConsumer);
 		}
+		else if (SceneCulling.UseHierarchicalConvexCulling())
+		{
+			// Cull the occupied blocks coarse to fine, only the chunks of the intersecting cells are tested on the GPU
+			FResultConsumer ResultConsumer { CullingResult, ViewGroupId, SceneCulling.CellHeaders };
+
+			SceneCulling.TestConvexVolume(CullingJob.CullingVolume, ResultConsumer);
+		}
 		else 
 		{
 			// broad phase test, go wide over chunks will dispatch one thread per view group ID
@@ -329,7 +329,8 @@ SIZE_T FSceneViewState::GetSizeBytes() const
 	return sizeof(*this) 
 		+ ShadowOcclusionQuerySize
 		+ PrimitiveFadingStates.GetAllocatedSize()
-		+ Occlusion.PrimitiveOcclusionHistorySet.GetAllocatedSize();
+		+ Occlusion.PrimitiveOcclusionHistorySet.GetAllocatedSize()
+		+ InstanceCullingSetupCache.GetAllocatedSize();
 }
 
 class FOcclusionQueryIndexBuffer : public FIndexBuffer
@@ -49,6 +49,7 @@
 #include "StochasticLighting/StochasticLightingViewState.h"
 #include "VolumetricRenderTargetViewStateData.h"
 #include "TranslucentLightingViewState.h"
+#include "InstanceCulling/InstanceCullingSetupCache.h"
 #include "GPUScene.h"
 #include "DynamicBVH.h"
 #include "OIT/OIT.h"
@@ -61,6 +62,7 @@
 #include "Algo/RemoveIf.h"
 #include "UObject/Package.h"
 #include "LightFunctionAtlas.h"
+#include "DecalSceneCache.h"
 #include "SceneExtensions.h"
 #include "HeterogeneousVolumes/HeterogeneousVolumes.h"
 #include "ScenePrimitiveUpdates.h"
@@ -94,6 +96,7 @@ class FRuntimeVirtualTextureSceneProxy;
 class FLumenSceneData;
 class FVirtualShadowMapArrayCacheManager;
 class FDistanceFieldObjectBuffers;
+class FForwardLightDataCache;
 struct FHairStrandsInstance;
 struct FPathTracingState;
 class FSparseVolumeTextureViewerSceneProxy;
@@ -433,7 +436,7 @@ public:
 class FGlobalDistanceFieldCacheTypeState
 {
 public:
-	TArray<FBox> PrimitiveModifiedBounds;
+	FGlobalDistanceFieldModifiedBounds PrimitiveModifiedBounds;
 };
 
 class FGlobalDistanceFieldClipmapState
@@ -556,6 +559,52 @@ public:
 		return ForcedHiddenPrimitiveMap.IsValidIndex(PrimIndex);
 	}
 
+	/** Clear the bits set by the last update and size the maps to the scene primitives. The maps are only reallocated when the scene grows. */
+	void BeginUpdate(int32 NumPrimitives)
+	{
+		for (int32 PrimIndex : SetPrimitiveIndices)
+		{
+			PrimitiveFadingLODMap[PrimIndex] = false;
+			PrimitiveFadingOutLODMap[PrimIndex] = false;
+			ForcedVisiblePrimitiveMap[PrimIndex] = false;
+			ForcedHiddenPrimitiveMap[PrimIndex] = false;
+		}
+		SetPrimitiveIndices.Reset();
+
+		if (PrimitiveFadingLODMap.Num() != NumPrimitives)
+		{
+			PrimitiveFadingLODMap.SetNum(NumPrimitives, false);
+			PrimitiveFadingOutLODMap.SetNum(NumPrimitives, false);
+			ForcedVisiblePrimitiveMap.SetNum(NumPrimitives, false);
+			ForcedHiddenPrimitiveMap.SetNum(NumPrimitives, false);
+		}
+	}
+
+	void Reset()
+	{
+		PrimitiveFadingLODMap.Empty(0);
+		PrimitiveFadingOutLODMap.Empty(0);
+		ForcedVisiblePrimitiveMap.Empty(0);
+		ForcedHiddenPrimitiveMap.Empty(0);
+		SetPrimitiveIndices.Empty();
+	}
+
+	void SetNodeFading(const int32 PrimIndex, bool bIsFading, bool bIsFadingOut)
+	{
+		SetBit(PrimitiveFadingLODMap, PrimIndex, bIsFading);
+		SetBit(PrimitiveFadingOutLODMap, PrimIndex, bIsFadingOut);
+	}
+
+	void SetNodeForcedVisible(const int32 PrimIndex, bool bValue)
+	{
+		SetBit(ForcedVisiblePrimitiveMap, PrimIndex, bValue);
+	}
+
+	void SetNodeForcedHidden(const int32 PrimIndex, bool bValue)
+	{
+		SetBit(ForcedHiddenPrimitiveMap, PrimIndex, bValue);
+	}
+
 	TBitArray<>	PrimitiveFadingLODMap;
 	TBitArray<>	PrimitiveFadingOutLODMap;
 	TBitArray<>	ForcedVisiblePrimitiveMap;
@@ -563,6 +612,20 @@ public:
 	float		TemporalLODSyncTime;
 	float		FOVDistanceScaleSq;
 	uint16		UpdateCount;
+
+private:
+	void SetBit(TBitArray<>& Map, const int32 PrimIndex, bool bValue)
+	{
+		FBitReference Bit = Map[PrimIndex];
+		if (bValue && !Bit)
+		{
+			SetPrimitiveIndices.Add(PrimIndex);
+		}
+		Bit = bValue;
+	}
+
+	/** Primitives with bits set since BeginUpdate, the only bits to clear at the next update. */
+	TArray<int32> SetPrimitiveIndices;
 };
 
 /** HLOD scene node persistent fading and visibility state */
@@ -575,6 +638,9 @@ struct FHLODSceneNodeVisibilityState
 		, bIsFading(0)
 	{}
 
+	/** Node the state belongs to, node indices are reused when HLOD nodes are removed */
+	FPrimitiveComponentId NodeId;
+
 	/** Last updated FrameCount */
 	uint16 UpdateCount;
 
@@ -846,7 +912,8 @@ public:
 
 	/** HLOD persistent fading and visibility state */
 	FHLODVisibilityState HLODVisibilityState;
-	TMap<FPrimitiveComponentId, FHLODSceneNodeVisibilityState> HLODSceneNodeVisibilityStates;
+	/** Indexed by FLODSceneTree::FLODSceneNode::NodeIndex */
+	TArray<FHLODSceneNodeVisibilityState> HLODSceneNodeVisibilityStates;
 
 	/** The current frame PreExposure */
 	float PreExposure;
@@ -1011,6 +1078,9 @@ public:
 
 	FTranslucencyLightingViewState TranslucencyLighting;
 
+	// Instance culling setup of the mesh passes from previous frames, see r.InstanceCulling.SetupCache
+	FInstanceCullingSetupCache InstanceCullingSetupCache;
+
 	// Heterogeneous Volumes cached data stores
 	TRDGUniformBufferRef<FOrthoVoxelGridUniformBufferParameters> OrthoVoxelGridUniformBuffer = nullptr;
 	TRDGUniformBufferRef<FFrustumVoxelGridUniformBufferParameters> FrustumVoxelGridUniformBuffer = nullptr;
@@ -2071,6 +2141,77 @@ private:
 	TArray<int32, TInlineAllocator<4>> FreeBlocks;
 };
 
+/**
+ * Dirty slots of the distance field object buffers, one bit per slot plus a population count.
+ * Marking a slot is a bit test, and the upload walks the dirty slots in order so that adjacent slots are coalesced into ranges.
+ */
+class FDistanceFieldDirtyObjectSlots
+{
+public:
+	struct FRange
+	{
+		int32 Start;
+		int32 Count;
+	};
+
+	void MarkDirty(int32 Index)
+	{
+		if (Index >= DirtyBits.Num())
+		{
+			DirtyBits.Add(false, Index + 1 - DirtyBits.Num());
+		}
+
+		FBitReference DirtyBit = DirtyBits[Index];
+		if (!DirtyBit)
+		{
+			DirtyBit = true;
+			++NumDirty;
+		}
+	}
+
+	bool IsDirty(int32 Index) const
+	{
+		return Index < DirtyBits.Num() && DirtyBits[Index];
+	}
+
+	int32 Num() const
+	{
+		return NumDirty;
+	}
+
+	/**
+	 * Coalesce up to MaxUploads dirty slots, in slot order, into contiguous ranges and clear them.
+	 * Dirty slots at or past NumValidSlots (freed by removals) are cleared without being uploaded.
+	 * All valid slots are returned as a single range when the dirty density is at least FullUploadDensity (disabled if <= 0).
+	 * Returns the number of slots covered by OutRanges.
+	 */
+	int32 ExtractRanges(int32 NumValidSlots, int32 MaxUploads, float FullUploadDensity, TArray<FRange, SceneRenderingAllocator>& OutRanges);
+
+	void Reset()
+	{
+		DirtyBits.Reset();
+		NumDirty = 0;
+	}
+
+private:
+	TBitArray<> DirtyBits;
+	int32 NumDirty = 0;
+};
+
+/** Slot move of a bulk removal from the distance field object buffers, the object in slot From fills the removed slot To. */
+struct FDistanceFieldObjectMove
+{
+	int32 From;
+	int32 To;
+};
+
+/**
+ * Builds the moves compacting NumObjects slots after removing RemoveIndices (unique, sorted in place from largest to smallest).
+ * The resulting layout is the same as removing the slots one at a time with RemoveAtSwap from the largest to the smallest,
+ * but every surviving tail object is moved at most once and the moves don't depend on each other.
+ */
+void BuildDistanceFieldObjectCompaction(TArrayView<int32> RemoveIndices, int32 NumObjects, TArray<FDistanceFieldObjectMove, SceneRenderingAllocator>& OutMoves);
+
 struct FDistanceFieldReadRequest;
 struct FDistanceFieldAsyncUpdateParameters;
 
@@ -2105,7 +2246,7 @@ public:
 
 	bool HasPendingUploads() const
 	{
-		return IndicesToUpdateInObjectBuffers.Num() > 0;
+		return DirtyObjectSlots.Num() > 0;
 	}
 
 	bool HasPendingOperations() const
@@ -2160,11 +2301,8 @@ public:
 	FRDGScatterUploadBuffer UploadDistanceFieldDataBuffer;
 	FRDGScatterUploadBuffer UploadDistanceFieldBoundsBuffer;
 
-	// track indices that need to be updated using both an array and a set
-	// array is used for fast iteration and support ParallelFor
-	// set is used to prevent duplicate indices
-	TArray<int32> IndicesToUpdateInObjectBuffers;
-	TSet<int32> IndicesToUpdateInObjectBuffersSet;
+	// object buffer slots that need to be uploaded
+	FDistanceFieldDirtyObjectSlots DirtyObjectSlots;
 
 	TSet<FDistanceFieldAssetState, TFDistanceFieldAssetStateFuncs> AssetStateArray;
 	TRefCountPtr<FRDGPooledBuffer> AssetDataBuffer;
@@ -2634,8 +2772,12 @@ public:
 		/** The primitive. */
 		FPrimitiveSceneInfo* SceneInfo;
 
+		/** Index of the node visibility state in the view states. */
+		int32 NodeIndex;
+
 		FLODSceneNode()
 			: SceneInfo(nullptr)
+			, NodeIndex(INDEX_NONE)
 		{
 		}
 
@@ -2674,6 +2816,13 @@ private:
 	/** The LOD groups in the scene.  The map key is the current primitive who has children. */
 	TMap<FPrimitiveComponentId, FLODSceneNode> SceneNodes;
 
+	/** Node indices of the removed nodes, for reuse. */
+	TArray<int32> FreeNodeIndices;
+	int32 NumNodeIndices = 0;
+
+	/** Persistent state of the node in the view, reset when the node index was reused by another node. */
+	FHLODSceneNodeVisibilityState& GetNodeVisibility(FSceneViewState* ViewState, const FLODSceneNode& Node);
+
 	/** Recursive state updates */
 	void ApplyNodeFadingToChildren(FSceneViewState* ViewState, FLODSceneNode& Node, FHLODSceneNodeVisibilityState& NodeVisibility, const bool bIsFading, const bool bIsFadingOut);
 	void HideNodeChildren(FSceneViewState* ViewState, FLODSceneNode& Node);
@@ -3143,6 +3292,9 @@ public:
 	/** The decals in the scene. */
 	TArray<FDeferredDecalProxy*> Decals;
 
+	/** Culling data of the decals, index parallel with Decals. */
+	FDecalSceneCache DecalSceneCache;
+
 	/** Potential capsule shadow casters registered to the scene. */
 	TArray<FPrimitiveSceneInfo*> DynamicIndirectCasterPrimitives; 
 
@@ -3171,6 +3323,9 @@ public:
 	
 	FGPUScene GPUScene;
 
+	/** View independent forward light data of the lights, created on first use by the light grid. */
+	TPimplPtr<FForwardLightDataCache> ForwardLightDataCache;
+
 #if RHI_RAYTRACING
 	/** Persistently-allocated ray tracing scene data. */
 	FRayTracingScene RayTracingScene;
@@ -3477,6 +3632,9 @@ public:
 	virtual void RefreshNaniteRasterBins(FPrimitiveSceneInfo& PrimitiveSceneInfo) override;
 	virtual void ReloadNaniteFixedFunctionBins() override;
 
+	/** Compacts the Nanite raster bins of the mesh passes with too many free bins, patching every bin index held by the scene. Outputs the primitives with patched material slots. */
+	void CompactNaniteRasterBins(TArray<FPrimitiveSceneInfo*, FSceneRenderingArrayAllocator>& OutRemappedPrimitives);
+
 	FVirtualShadowMapArrayCacheManager* GetVirtualShadowMapCache();
 
 	FLumenSceneData* FindLumenSceneData(uint32 ViewKey, uint32 GPUIndex) const;
@@ -3878,6 +4036,19 @@ public:
 	/** Updates a primitive's transform, called on the rendering thread. */
 	void UpdatePrimitiveTransform_RenderThread(FPrimitiveSceneProxy* PrimitiveSceneProxy, const FBoxSphereBounds& WorldBounds, const FBoxSphereBounds& LocalBounds, const FMatrix& LocalToWorld, const FVector& OwnerPosition, const TOptional<FTransform>& PreviousTransform);
 
+	/**
+	 * Updates the transforms of many primitives produced on the rendering thread, e.g., by a state stream, reserving the update queue once for the batch.
+	 * The arrays are index parallel with Proxies, PreviousTransforms is either empty or index parallel too.
+	 * Unlike UpdatePrimitiveTransform, the proxies are never recreated: they must already be in the scene. Redundant updates are not skipped.
+	 */
+	void BatchUpdatePrimitiveTransforms_RenderThread(
+		TConstArrayView<FPrimitiveSceneProxy*> Proxies,
+		TConstArrayView<FBoxSphereBounds> WorldBounds,
+		TConstArrayView<FBoxSphereBounds> LocalBounds,
+		TConstArrayView<FMatrix> LocalToWorlds,
+		TConstArrayView<FVector> AttachmentRootPositions,
+		TConstArrayView<TOptional<FTransform>> PreviousTransforms = {});
+
 	/** Returns true if the scene requires the use of debug material permutations. */
 	bool RequiresDebugMaterials() const { return PersistentViewStateDebugFlags != 0; }
 
@@ -198,12 +198,7 @@ public:
 		int32 CommandSlot = GetOrAddCommandSlot(SceneInfo);
 		FUpdateCommand& Command = Commands[CommandSlot];
 
-		if (PayloadArrays[int32(PayloadType::Id)] == nullptr)
-		{
-			PayloadArrays[int32(PayloadType::Id)] = MakeUnique<TPayloadArray<PayloadType>>();
-		}
-		TPayloadArray<PayloadType>* Payloads = GetPayloadArray<PayloadType>();
-		check(Payloads != nullptr);
+		TPayloadArray<PayloadType>* Payloads = GetOrAddPayloadArray<PayloadType>();
 		int32 PrevPayloadOffset = Command.template GetPayloadOffset<PayloadType>();
 
 		// Update existing payload (maybe we want to disallow this?)
@@ -221,6 +216,25 @@ public:
 		}
 	}
 
+	/**
+	 * Reserve space for NumUpdates more commands with a PayloadType payload each, so that a batch of updates can be enqueued
+	 * without growing the command array, the command hash set and the payload array along the way.
+	 */
+	template <typename PayloadType>
+	void Reserve(int32 NumUpdates)
+	{
+#if DO_CHECK
+		check(RaceGuard == 0);
+#endif
+
+		Commands.Reserve(Commands.Num() + NumUpdates);
+		CommandSlots.Reserve(Commands.Num() + NumUpdates);
+
+		TPayloadArray<PayloadType>* Payloads = GetOrAddPayloadArray<PayloadType>();
+		Payloads->PayloadData.Reserve(Payloads->PayloadData.Num() + NumUpdates);
+		Payloads->CommandSlots.Reserve(Payloads->CommandSlots.Num() + NumUpdates);
+	}
+
 	/**
 	 * Retriev a pointer to the PayloadType data for the given command. Returs nullptr if no such data exists.
 	 */
@@ -567,6 +581,17 @@ private:
 		return static_cast<TPayloadArray<PayloadType>*>(PayloadArrays[int32(PayloadType::Id)].Get());
 	}
 	template <typename PayloadType>
+	TPayloadArray<PayloadType>* GetOrAddPayloadArray()
+	{
+		if (PayloadArrays[int32(PayloadType::Id)] == nullptr)
+		{
+			PayloadArrays[int32(PayloadType::Id)] = MakeUnique<TPayloadArray<PayloadType>>();
+		}
+		TPayloadArray<PayloadType>* Payloads = GetPayloadArray<PayloadType>();
+		check(Payloads != nullptr);
+		return Payloads;
+	}
+	template <typename PayloadType>
 	const TPayloadArray<PayloadType>* GetPayloadArray() const
 	{
 		return const_cast<TSceneUpdateCommandQueue*>(this)->GetPayloadArray<PayloadType>();
@@ -5912,6 +5912,7 @@ void FLODSceneTree::AddChildNode(const FPrimitiveComponentId ParentId, FPrimitiv
 		{
 			// Create parent SceneNode, assign correct SceneInfo
 			Parent = &SceneNodes.Add(ParentId, FLODSceneNode());
+			Parent->NodeIndex = FreeNodeIndices.IsEmpty() ? NumNodeIndices++ : FreeNodeIndices.Pop(EAllowShrinking::No);
 
 			int32 ParentIndex = Scene->PrimitiveComponentIds.Find(ParentId);
 			if (ParentIndex != INDEX_NONE)
@@ -5936,6 +5937,7 @@ void FLODSceneTree::RemoveChildNode(const FPrimitiveComponentId ParentId, FPrimi
 			// Delete from scene if no children remain
 			if (Parent->ChildrenSceneInfos.Num() == 0)
 			{
+				FreeNodeIndices.Add(Parent->NodeIndex);
 				SceneNodes.Remove(ParentId);
 			}
 		}
@@ -5965,13 +5967,10 @@ void FLODSceneTree::ClearVisibilityState(FViewInfo& View)
 
 		if(HLODState.IsValidPrimitiveIndex(0))
 		{
-			HLODState.PrimitiveFadingLODMap.Empty(0);
-			HLODState.PrimitiveFadingOutLODMap.Empty(0);
-			HLODState.ForcedVisiblePrimitiveMap.Empty(0);
-			HLODState.ForcedHiddenPrimitiveMap.Empty(0);
+			HLODState.Reset();
 		}
 
-		TMap<FPrimitiveComponentId, FHLODSceneNodeVisibilityState>& VisibilityStates = ViewState->HLODSceneNodeVisibilityStates;
+		TArray<FHLODSceneNodeVisibilityState>& VisibilityStates = ViewState->HLODSceneNodeVisibilityStates;
 
 		if(VisibilityStates.Num() > 0)
 		{
@@ -5993,14 +5992,13 @@ void FLODSceneTree::UpdateVisibilityStates(FViewInfo& View, UE::Tasks::FTaskEven
 #endif
 		QUICK_SCOPE_CYCLE_COUNTER(STAT_ViewVisibilityTime_HLODUpdate);
 
-		// Per-frame initialization
+		// Per-frame initialization, only the bits set by the last update are cleared
 		FHLODVisibilityState& HLODState = ViewState->HLODVisibilityState;
-		TMap<FPrimitiveComponentId, FHLODSceneNodeVisibilityState>& VisibilityStates = ViewState->HLODSceneNodeVisibilityStates;
+		HLODState.BeginUpdate(Scene->Primitives.Num());
+
+		// Sized for all the nodes up front, so that the node state references stay valid during the recursive updates
+		ViewState->HLODSceneNodeVisibilityStates.SetNum(NumNodeIndices, EAllowShrinking::No);
 
-		HLODState.PrimitiveFadingLODMap.Init(false, Scene->Primitives.Num());
-		HLODState.PrimitiveFadingOutLODMap.Init(false, Scene->Primitives.Num());
-		HLODState.ForcedVisiblePrimitiveMap.Init(false, Scene->Primitives.Num());
-		HLODState.ForcedHiddenPrimitiveMap.Init(false, Scene->Primitives.Num());
 		TArray<FPrimitiveViewRelevance, SceneRenderingAllocator>& RelevanceMap = View.PrimitiveViewRelevanceMap;
 
 		if (HLODState.PrimitiveFadingLODMap.Num() != Scene->Primitives.Num())
@@ -6045,7 +6043,7 @@ void FLODSceneTree::UpdateVisibilityStates(FViewInfo& View, UE::Tasks::FTaskEven
 				continue;
 			}
 
-			FHLODSceneNodeVisibilityState& NodeVisibility = VisibilityStates.FindOrAdd(SceneInfo->PrimitiveComponentId);
+			FHLODSceneNodeVisibilityState& NodeVisibility = GetNodeVisibility(ViewState, Node);
 			const TArray<FStaticMeshBatchRelevance>& NodeMeshRelevances = SceneInfo->StaticMeshRelevances;
 
 			// Ignore already updated nodes, or those that we can't work with
@@ -6135,26 +6133,24 @@ void FLODSceneTree::UpdateVisibilityStates(FViewInfo& View, UE::Tasks::FTaskEven
 				}
 			}
 
-			// NOTE: We update our children last as HideNodeChildren can add new visibility
-			// states, potentially invalidating our cached reference above, NodeVisibility
+			// NOTE: We update our children last as they override the states of the hierarchy below
 			if (NodeVisibility.bIsFading)
 			{
 				// Fade until state back in sync
-				HLODState.PrimitiveFadingLODMap[NodeIndex] = true;
-				HLODState.PrimitiveFadingOutLODMap[NodeIndex] = !NodeVisibility.bIsVisible;
-				HLODState.ForcedVisiblePrimitiveMap[NodeIndex] = true;
+				HLODState.SetNodeFading(NodeIndex, true, !NodeVisibility.bIsVisible);
+				HLODState.SetNodeForcedVisible(NodeIndex, true);
 				ApplyNodeFadingToChildren(ViewState, Node, NodeVisibility, true, !!NodeVisibility.bIsVisible);
 			}
 			else if (NodeVisibility.bIsVisible)
 			{
 				// If stable and visible, override hierarchy visibility
-				HLODState.ForcedVisiblePrimitiveMap[NodeIndex] = true;
+				HLODState.SetNodeForcedVisible(NodeIndex, true);
 				HideNodeChildren(ViewState, Node);
 			}
 			else
 			{
 				// Not visible and waiting for a transition to fade, keep HLOD hidden
-				HLODState.ForcedHiddenPrimitiveMap[NodeIndex] = true;
+				HLODState.SetNodeForcedHidden(NodeIndex, true);
 
 				// Also hide children when performing far culling
 				if (bFarCulled)
@@ -6183,6 +6179,17 @@ void FLODSceneTree::UpdateVisibilityStates(FViewInfo& View, UE::Tasks::FTaskEven
 	}
 }
 
+FHLODSceneNodeVisibilityState& FLODSceneTree::GetNodeVisibility(FSceneViewState* ViewState, const FLODSceneNode& Node)
+{
+	FHLODSceneNodeVisibilityState& NodeVisibility = ViewState->HLODSceneNodeVisibilityStates[Node.NodeIndex];
+	if (NodeVisibility.NodeId != Node.SceneInfo->PrimitiveComponentId)
+	{
+		NodeVisibility = FHLODSceneNodeVisibilityState();
+		NodeVisibility.NodeId = Node.SceneInfo->PrimitiveComponentId;
+	}
+	return NodeVisibility;
+}
+
 void FLODSceneTree::ApplyNodeFadingToChildren(FSceneViewState* ViewState, FLODSceneNode& Node, FHLODSceneNodeVisibilityState& NodeVisibility, const bool bIsFading, const bool bIsFadingOut)
 {
 	checkSlow(ViewState);
@@ -6207,13 +6214,12 @@ void FLODSceneTree::ApplyNodeFadingToChildren(FSceneViewState* ViewState, FLODSc
 				continue;
 			}
 		
-			HLODState.PrimitiveFadingLODMap[ChildIndex] = bIsFading;
-			HLODState.PrimitiveFadingOutLODMap[ChildIndex] = bIsFadingOut;
-			HLODState.ForcedHiddenPrimitiveMap[ChildIndex] = false;
+			HLODState.SetNodeFading(ChildIndex, bIsFading, bIsFadingOut);
+			HLODState.SetNodeForcedHidden(ChildIndex, false);
 
 			if (bIsFading)
 			{
-				HLODState.ForcedVisiblePrimitiveMap[ChildIndex] = true;
+				HLODState.SetNodeForcedVisible(ChildIndex, true);
 			}
 
 			// Fading only occurs at the adjacent hierarchy level, below should be hidden
@@ -6231,8 +6237,7 @@ void FLODSceneTree::HideNodeChildren(FSceneViewState* ViewState, FLODSceneNode&
 	if (Node.SceneInfo)
 	{
 		FHLODVisibilityState& HLODState = ViewState->HLODVisibilityState;
-		TMap<FPrimitiveComponentId, FHLODSceneNodeVisibilityState>& VisibilityStates = ViewState->HLODSceneNodeVisibilityStates;
-		FHLODSceneNodeVisibilityState& NodeVisibility = VisibilityStates.FindOrAdd(Node.SceneInfo->PrimitiveComponentId);
+		FHLODSceneNodeVisibilityState& NodeVisibility = GetNodeVisibility(ViewState, Node);
 
 		if (NodeVisibility.UpdateCount != HLODState.UpdateCount)
 		{
@@ -6253,10 +6258,10 @@ void FLODSceneTree::HideNodeChildren(FSceneViewState* ViewState, FLODSceneNode&
 					continue;
 				}
 
-				HLODState.ForcedHiddenPrimitiveMap[ChildIndex] = true;
+				HLODState.SetNodeForcedHidden(ChildIndex, true);
 				
 				// Clear the force visible flag in case the child was processed before it's parent
-				HLODState.ForcedVisiblePrimitiveMap[ChildIndex] = false;
+				HLODState.SetNodeForcedVisible(ChildIndex, false);
 
 				if (FLODSceneNode* ChildNode = SceneNodes.Find(Child->PrimitiveComponentId))
 				{
@@ -7,9 +7,11 @@
 #include "Animation/Skeleton.h"
 #include "AnimationRuntime.h"
 #include "AnimEncoding.h"
+#include "Async/ParallelFor.h"
 #include "ComponentRecreateRenderStateContext.h"
 #include "GlobalRenderResources.h"
 #include "GlobalShader.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
 #include "RenderGraphBuilder.h"
 #include "RenderGraphResources.h"
 #include "RenderGraphUtils.h"
@@ -43,6 +45,20 @@ static TAutoConsoleVariable<float> CVarAnimBankTimeScale(
 	ECVF_Scalability | ECVF_RenderThreadSafe
 );
 
+static TAutoConsoleVariable<bool> CVarAnimBankCPUParallel(
+	TEXT("r.AnimBank.CPU.Parallel"),
+	true,
+	TEXT("Whether to sample the animation bank records evaluated on the CPU in parallel."),
+	ECVF_RenderThreadSafe
+);
+
+static TAutoConsoleVariable<int32> CVarAnimBankCPUMinBatchSize(
+	TEXT("r.AnimBank.CPU.MinBatchSize"),
+	16,
+	TEXT("Minimum number of animation bank records sampled per CPU task."),
+	ECVF_RenderThreadSafe
+);
+
 static TAutoConsoleVariable<bool> CVarAnimBankGPU(
 	TEXT("r.AnimBank.GPU"),
 	true,
@@ -180,6 +196,8 @@ FAnimBankRecordHandle FAnimBankTransformProvider::RegisterBank(const FAnimBankDe
 		BankRecord.AssetMapping = BankData.Mapping; // TODO: Avoid copy
 
 		check(BankEntry.KeyCount == BankRecord.PositionKeys.Num() && BankEntry.KeyCount == BankRecord.RotationKeys.Num());
+
+		CPURecordSampler.AddRecord(BankRecord.RecordId, BankData.Mapping.BoneCount, BankRecord.PositionKeys.Num() > 0 && BankRecord.Playing);
 	}
 
 	++BankRecord.ReferenceCount;
@@ -197,11 +215,70 @@ void FAnimBankTransformProvider::UnregisterBank(const FAnimBankRecordHandle& Han
 
 	if (BankRecord.ReferenceCount == 0)
 	{
+		CPURecordSampler.RemoveRecord(BankRecord.RecordId);
 		BankAllocator.Free(BankRecord.KeyOffset, BankRecord.KeyCount);
 		BankRecordMap.RemoveByElementId(RecordId);
 	}
 }
 
+void FAnimBankTransformProvider::FCPURecordSampler::AddRecord(int32 RecordId, uint32 BoneCount, bool bEvaluated)
+{
+	if (RecordId >= IdToOffsetMapping.Num())
+	{
+		const int32 OldNum = IdToOffsetMapping.Num();
+		IdToOffsetMapping.SetNumUninitialized(RecordId + 1);
+		RecordSlots.SetNumUninitialized(RecordId + 1);
+		for (int32 Index = OldNum; Index <= RecordId; ++Index)
+		{
+			IdToOffsetMapping[Index] = ~uint32(0);
+			RecordSlots[Index] = INDEX_NONE;
+		}
+	}
+
+	check(RecordSlots[RecordId] == INDEX_NONE);
+	if (!bEvaluated)
+	{
+		// Never sampled, the scatter will use the reference pose
+		IdToOffsetMapping[RecordId] = ~uint32(0);
+		return;
+	}
+
+	FRecordState& State = Records.AddDefaulted_GetRef();
+	State.RecordId = RecordId;
+	State.BoneCount = BoneCount;
+	State.TransformOffset = uint32(TransformAllocator.Allocate(int32(BoneCount)));
+
+	RecordSlots[RecordId] = Records.Num() - 1;
+	IdToOffsetMapping[RecordId] = State.TransformOffset * sizeof(FCompressedBoneTransform);
+}
+
+void FAnimBankTransformProvider::FCPURecordSampler::RemoveRecord(int32 RecordId)
+{
+	const int32 Slot = RecordSlots[RecordId];
+	if (Slot != INDEX_NONE)
+	{
+		const FRecordState& State = Records[Slot];
+		TransformAllocator.Free(int32(State.TransformOffset), int32(State.BoneCount));
+
+		Records.RemoveAtSwap(Slot, EAllowShrinking::No);
+		if (Slot < Records.Num())
+		{
+			RecordSlots[Records[Slot].RecordId] = Slot;
+		}
+	}
+
+	RecordSlots[RecordId] = INDEX_NONE;
+	IdToOffsetMapping[RecordId] = ~uint32(0);
+}
+
+void FAnimBankTransformProvider::FCPURecordSampler::Invalidate()
+{
+	for (FRecordState& State : Records)
+	{
+		State.KeyIndex0 = INDEX_NONE;
+	}
+}
+
 struct FAnimBankGPUData
 {
 	TArray<uint32, SceneRenderingAllocator> IdToOffsetMapping;
@@ -218,18 +295,6 @@ struct FAnimBankGPUData
 	bool bValid = false;
 };
 
-struct FAnimBankCPUData
-{
-	TArray<uint32, SceneRenderingAllocator> IdToOffsetMapping;
-
-	FRDGBufferRef TransformBuffer = nullptr;
-
-	uint32 TransformCount = 0;
-	uint32 RecordCount = 0;
-
-	bool bValid = false;
-};
-
 static FAnimBankGPUData BuildAnimBankGPUData(const FAnimBankRecordMap& BankRecordMap, FRDGBuilder& GraphBuilder)
 {
 	const uint32 BonesPerGroup = FAnimBankEvaluateCS::BonesPerGroup;
@@ -422,62 +487,131 @@ static FAnimBankGPUData BuildAnimBankGPUData(const FAnimBankRecordMap& BankRecor
 	return BankData;
 }
 
-static FAnimBankCPUData BuildAnimBankCPUData(const FAnimBankRecordMap& BankRecordMap, FRDGBuilder& GraphBuilder)
+void FAnimBankTransformProvider::SampleAnimBankPose(
+	const FQuat4f* RotationKeys,
+	const FVector3f* PositionKeys,
+	const FQuat4f* InvGlobalRefPoseRotations,
+	const FVector3f* InvGlobalRefPosePositions,
+	uint32 BoneCount,
+	int32 KeyIndex0,
+	int32 KeyIndex1,
+	float Alpha,
+	FCompressedBoneTransform* OutTransforms
+)
 {
-	FAnimBankCPUData BankData{};
+	const FQuat4f* RotationKeys0	= RotationKeys + (KeyIndex0 * BoneCount);
+	const FQuat4f* RotationKeys1	= RotationKeys + (KeyIndex1 * BoneCount);
+	const FVector3f* PositionKeys0	= PositionKeys + (KeyIndex0 * BoneCount);
+	const FVector3f* PositionKeys1	= PositionKeys + (KeyIndex1 * BoneCount);
 
-	int32 MaxOffsetIndex = INDEX_NONE;
-
-	for (const auto& RecordPair : BankRecordMap)
+	for (uint32 TransformIndex = 0; TransformIndex < BoneCount; ++TransformIndex)
 	{
-		const FAnimBankRecord& BankRecord = RecordPair.Value;
-		check(BankRecord.PositionKeys.Num() == BankRecord.RotationKeys.Num());
+		const FTransform InvGlobalRefPoseXform = FTransform(FQuat(InvGlobalRefPoseRotations[TransformIndex]), FVector(InvGlobalRefPosePositions[TransformIndex]));
 
-		MaxOffsetIndex = FMath::Max<int32>(MaxOffsetIndex, BankRecord.RecordId);
+		FTransform MeshGlobalAnimPoseXform;
 
-		if (BankRecord.PositionKeys.Num() == 0 || !BankRecord.Playing)
+		if (Alpha <= 0.f)
 		{
-			continue;
+			MeshGlobalAnimPoseXform = FTransform(FQuat(RotationKeys0[TransformIndex]), FVector(PositionKeys0[TransformIndex]));
+			MeshGlobalAnimPoseXform.NormalizeRotation();
 		}
+		else if (Alpha >= 1.f)
+		{
+			MeshGlobalAnimPoseXform = FTransform(FQuat(RotationKeys1[TransformIndex]), FVector(PositionKeys1[TransformIndex]));
+			MeshGlobalAnimPoseXform.NormalizeRotation();
+		}
+		else
+		{
+			FTransform MeshGlobalXformA = FTransform(FQuat(RotationKeys0[TransformIndex]), FVector(PositionKeys0[TransformIndex]));
+			FTransform MeshGlobalXformB = FTransform(FQuat(RotationKeys1[TransformIndex]), FVector(PositionKeys1[TransformIndex]));
 
-		const FAnimBankData& AnimBankData = BankRecord.Desc.BankAsset->GetData();
-		const uint32 BoneCount = AnimBankData.Mapping.BoneCount;
+			// Ensure rotations are normalized
+			MeshGlobalXformA.NormalizeRotation();
+			MeshGlobalXformB.NormalizeRotation();
 
-		++BankData.RecordCount;
+			MeshGlobalAnimPoseXform.Blend(MeshGlobalXformA, MeshGlobalXformB, Alpha);
+			MeshGlobalAnimPoseXform.NormalizeRotation();
+		}
 
-		BankData.TransformCount += BoneCount;
-	}
+		MeshGlobalAnimPoseXform = InvGlobalRefPoseXform * MeshGlobalAnimPoseXform;
 
-	BankData.IdToOffsetMapping.SetNumZeroed(MaxOffsetIndex + 1);
+		FMatrix44f Transform = (FMatrix44f)MeshGlobalAnimPoseXform.ToMatrixNoScale();
 
-	for (auto& RecordPair : BankRecordMap)
-	{
-		const FAnimBankRecord& BankRecord = RecordPair.Value;
-		BankData.IdToOffsetMapping[BankRecord.RecordId] = ~uint32(0);
+		StoreCompressedBoneTransform(&OutTransforms[TransformIndex], Transform);
 	}
+}
 
-	BankData.bValid = BankData.RecordCount > 0;
-	if (BankData.bValid)
-	{
-		const bool bInterpolating = CVarAnimBankInterp.GetValueOnRenderThread();
+int32 FAnimBankTransformProvider::FCPURecordSampler::Update(TFunctionRef<FCPURecordPose(int32 RecordId)> GetPose, int32 MinBatchSize, EParallelForFlags Flags)
+{
+	TransformAllocator.Consolidate();
 
-		FCompressedBoneTransform* Transforms = GraphBuilder.AllocPODArray<FCompressedBoneTransform>(BankData.TransformCount);
+	// Records keep their transform range until removed, so the transforms of the records that are not resampled stay valid
+	Transforms.SetNumUninitialized(TransformAllocator.GetMaxSize(), EAllowShrinking::No);
 
-		uint32 TransformOffset = 0;
+	std::atomic<int32> NumSampled = 0;
 
-		for (const auto& RecordPair : BankRecordMap)
+	ParallelFor(TEXT("AnimBank.SampleCPU"), Records.Num(), MinBatchSize,
+		[this, &GetPose, &NumSampled](int32 Slot)
 		{
-			const FAnimBankRecord& BankRecord = RecordPair.Value;
-			if (BankRecord.PositionKeys.Num() == 0 || !BankRecord.Playing)
+			FRecordState& State = Records[Slot];
+			const FCPURecordPose Pose = GetPose(State.RecordId);
+
+			// Paused records, and records that land on the same keys as last update, keep their transforms
+			State.bSampled = Pose.KeyIndex0 != State.KeyIndex0 || Pose.KeyIndex1 != State.KeyIndex1 || Pose.Alpha != State.Alpha;
+			if (!State.bSampled)
 			{
-				continue;
+				return;
 			}
 
-			check(BankRecord.PositionKeys.Num() == BankRecord.RotationKeys.Num());
+			State.KeyIndex0 = Pose.KeyIndex0;
+			State.KeyIndex1 = Pose.KeyIndex1;
+			State.Alpha = Pose.Alpha;
+
+			SampleAnimBankPose(
+				Pose.RotationKeys,
+				Pose.PositionKeys,
+				Pose.InvGlobalRefPoseRotations,
+				Pose.InvGlobalRefPosePositions,
+				State.BoneCount,
+				Pose.KeyIndex0,
+				Pose.KeyIndex1,
+				Pose.Alpha,
+				Transforms.GetData() + State.TransformOffset
+			);
 
-			BankData.IdToOffsetMapping[BankRecord.RecordId] = (TransformOffset * sizeof(FCompressedBoneTransform));
+			NumSampled.fetch_add(1, std::memory_order_relaxed);
+		},
+		Flags
+	);
+
+	return NumSampled.load(std::memory_order_relaxed);
+}
+
+FRDGBufferRef FAnimBankTransformProvider::UpdateCPUBankTransforms(FRDGBuilder& GraphBuilder)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FAnimBankTransformProvider::UpdateCPUBankTransforms);
+
+	if (CPURecordSampler.IsEmpty())
+	{
+		return nullptr;
+	}
+
+	const bool bInterpolating = CVarAnimBankInterp.GetValueOnRenderThread();
+	if (bInterpolating != bCPUInterpolating)
+	{
+		// All poses need to be sampled again
+		CPURecordSampler.Invalidate();
+		bCPUInterpolating = bInterpolating;
+	}
+
+	const float SampleInterval = 1.0f / ANIM_BANK_SAMPLE_RATE;
+
+	const int32 NumSampled = CPURecordSampler.Update(
+		[this, bInterpolating, SampleInterval](int32 RecordId)
+		{
+			const FAnimBankRecord& BankRecord = BankRecordMap.GetByElementId(FAnimBankRecord::FRecordId(RecordId)).Value;
+			check(BankRecord.PositionKeys.Num() == BankRecord.RotationKeys.Num());
 
-			const float SampleInterval = 1.0f / ANIM_BANK_SAMPLE_RATE;
 			const float TrackLength = float(BankRecord.FrameCount - 1) * SampleInterval;
 
 			double Time = (double)FMath::Fmod(BankRecord.CurrentTime, TrackLength);
@@ -486,73 +620,41 @@ static FAnimBankCPUData BuildAnimBankCPUData(const FAnimBankRecordMap& BankRecor
 				Time += TrackLength;
 			}
 
-			int32 KeyIndex0, KeyIndex1;
-			float Alpha;
-			FAnimationRuntime::GetKeyIndicesFromTime(KeyIndex0, KeyIndex1, Alpha, Time, BankRecord.FrameCount, TrackLength);
+			FCPURecordPose Pose;
+			Pose.RotationKeys = BankRecord.RotationKeys.GetData();
+			Pose.PositionKeys = BankRecord.PositionKeys.GetData();
+			Pose.InvGlobalRefPoseRotations = BankRecord.AssetMapping.RotationKeys.GetData();
+			Pose.InvGlobalRefPosePositions = BankRecord.AssetMapping.PositionKeys.GetData();
+			FAnimationRuntime::GetKeyIndicesFromTime(Pose.KeyIndex0, Pose.KeyIndex1, Pose.Alpha, Time, BankRecord.FrameCount, TrackLength);
 
 			if (!bInterpolating)
 			{
 				// Forcing alpha to zero disables pose interpolation (interpolation method is "step")
-				Alpha = 0.0f;
+				Pose.Alpha = 0.0f;
 			}
 
-			const FAnimBankData& AnimBankData = BankRecord.Desc.BankAsset->GetData();
-			const uint32 BoneCount = AnimBankData.Mapping.BoneCount;
-
-			for (uint32 TransformIndex = 0; TransformIndex < BoneCount; ++TransformIndex)
-			{
-				const FTransform InvGlobalRefPoseXform = FTransform(FQuat(BankRecord.AssetMapping.RotationKeys[TransformIndex]), FVector(BankRecord.AssetMapping.PositionKeys[TransformIndex]));
-
-				FTransform MeshGlobalAnimPoseXform;
-
-				if (Alpha <= 0.f)
-				{
-					MeshGlobalAnimPoseXform = FTransform(FQuat(BankRecord.RotationKeys[(KeyIndex0 * BoneCount) + TransformIndex]), FVector(BankRecord.PositionKeys[(KeyIndex0 * BoneCount) + TransformIndex]));
-					MeshGlobalAnimPoseXform.NormalizeRotation();
-				}
-				else if (Alpha >= 1.f)
-				{
-					MeshGlobalAnimPoseXform = FTransform(FQuat(BankRecord.RotationKeys[(KeyIndex1 * BoneCount) + TransformIndex]), FVector(BankRecord.PositionKeys[(KeyIndex1 * BoneCount) + TransformIndex]));
-					MeshGlobalAnimPoseXform.NormalizeRotation();
-				}
-				else
-				{
-					FTransform MeshGlobalXformA = FTransform(FQuat(BankRecord.RotationKeys[(KeyIndex0 * BoneCount) + TransformIndex]), FVector(BankRecord.PositionKeys[(KeyIndex0 * BoneCount) + TransformIndex]));
-					FTransform MeshGlobalXformB = FTransform(FQuat(BankRecord.RotationKeys[(KeyIndex1 * BoneCount) + TransformIndex]), FVector(BankRecord.PositionKeys[(KeyIndex1 * BoneCount) + TransformIndex]));
-
-					// Ensure rotations are normalized
-					MeshGlobalXformA.NormalizeRotation();
-					MeshGlobalXformB.NormalizeRotation();
-
-					MeshGlobalAnimPoseXform.Blend(MeshGlobalXformA, MeshGlobalXformB, Alpha);
-					MeshGlobalAnimPoseXform.NormalizeRotation();
-				}
-
-				MeshGlobalAnimPoseXform = InvGlobalRefPoseXform * MeshGlobalAnimPoseXform;
-
-				FMatrix44f Transform = (FMatrix44f)MeshGlobalAnimPoseXform.ToMatrixNoScale();
+			return Pose;
+		},
+		CVarAnimBankCPUMinBatchSize.GetValueOnRenderThread(),
+		CVarAnimBankCPUParallel.GetValueOnRenderThread() ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread
+	);
 
-				StoreCompressedBoneTransform(&Transforms[TransformOffset], Transform);
-				++TransformOffset;
-			}
-		}
+	// Transform Buffer, records keep their range until removed so only the resampled ones need to be uploaded
+	const int32 NumTransforms = CPURecordSampler.GetTransforms().Num();
+	if (NumSampled == 0)
+	{
+		return CPUTransformBuffer.ResizeBufferIfNeeded(GraphBuilder, NumTransforms);
+	}
 
-		// Transform Buffer
+	TByteAddressBufferScatterUploader<FCompressedBoneTransform> TransformUploader;
+	CPURecordSampler.ForEachSampledRecord(
+		[&TransformUploader](uint32 TransformOffset, TConstArrayView<FCompressedBoneTransform> RecordTransforms)
 		{
-			const uint32 TransformSize = sizeof(FCompressedBoneTransform) * BankData.TransformCount;
-			BankData.TransformBuffer = CreateByteAddressBuffer(
-				GraphBuilder,
-				TEXT("AnimBank.Transforms"),
-				TransformSize,
-				Transforms,
-				TransformSize,
-				// The buffer data is allocated above on the RDG timeline
-				ERDGInitialDataFlags::NoCopy
-			);
+			TransformUploader.AddMultiple(RecordTransforms, TransformOffset);
 		}
-	}
+	);
 
-	return BankData;
+	return TransformUploader.ResizeAndUploadTo(GraphBuilder, CPUTransformBuffer, NumTransforms);
 }
 
 void FAnimBankTransformProvider::AdvanceAnimation(FSkinningTransformProvider::FProviderContext& Context)
@@ -735,10 +837,10 @@ void FAnimBankTransformProvider::ProvideCPUBankTransforms(FSkinningTransformProv
 	// the results to the GPU as input to the scatter.
 
 	FRDGBuilder& GraphBuilder = Context.GraphBuilder;
-	const FAnimBankCPUData BankData = BuildAnimBankCPUData(BankRecordMap, GraphBuilder);
+	FRDGBufferRef TransformBuffer = UpdateCPUBankTransforms(GraphBuilder);
 
 	// Scatter animation bank results
-	ScatterAnimation(Context, MakeConstArrayView(BankData.IdToOffsetMapping), BankData.TransformBuffer);
+	ScatterAnimation(Context, CPURecordSampler.GetIdToOffsetMapping(), TransformBuffer);
 }
 
 const FSkinningTransformProvider::FProviderId& GetAnimBankProviderId()
@@ -3,10 +3,12 @@
 #pragma once
 
 #include "Animation/AnimBank.h"
+#include "Async/ParallelFor.h"
 #include "Delegates/Delegate.h"
 #include "Delegates/DelegateCombinations.h"
 #include "RendererPrivateUtils.h"
 #include "SceneExtensions.h"
+#include "SkeletalRenderPublic.h"
 #include "SkinningTransformProvider.h"
 #include "SpanAllocator.h"
 
@@ -14,6 +16,104 @@ class FAnimBankTransformProvider : public ISceneExtension
 {
 	DECLARE_SCENE_EXTENSION(RENDERER_API, FAnimBankTransformProvider);
 
+public:
+	/**
+	 * Sample the pose of an anim bank sequence at the given keys on the CPU, writing BoneCount compressed transforms.
+	 * The keys are laid out frame major (FrameCount * BoneCount), the inverse global reference pose has BoneCount entries.
+	 * Alpha <= 0 samples KeyIndex0 only, Alpha >= 1 samples KeyIndex1 only, otherwise both are blended.
+	 */
+	static void SampleAnimBankPose(
+		const FQuat4f* RotationKeys,
+		const FVector3f* PositionKeys,
+		const FQuat4f* InvGlobalRefPoseRotations,
+		const FVector3f* InvGlobalRefPosePositions,
+		uint32 BoneCount,
+		int32 KeyIndex0,
+		int32 KeyIndex1,
+		float Alpha,
+		FCompressedBoneTransform* OutTransforms
+	);
+
+	/** Pose of a record to sample this update, see SampleAnimBankPose. */
+	struct FCPURecordPose
+	{
+		const FQuat4f* RotationKeys = nullptr;
+		const FVector3f* PositionKeys = nullptr;
+		const FQuat4f* InvGlobalRefPoseRotations = nullptr;
+		const FVector3f* InvGlobalRefPosePositions = nullptr;
+		int32 KeyIndex0 = 0;
+		int32 KeyIndex1 = 0;
+		float Alpha = 0.0f;
+	};
+
+	/**
+	 * Persistent transforms of the records evaluated on the CPU. Records keep their transform range and id -> offset entry
+	 * from AddRecord to RemoveRecord, and are only sampled again when their keys or alpha change. Doesn't depend on the scene.
+	 */
+	class FCPURecordSampler
+	{
+	public:
+		/** Records that are not evaluated are only given an id -> offset entry, so the scatter falls back to the reference pose. */
+		void AddRecord(int32 RecordId, uint32 BoneCount, bool bEvaluated);
+		void RemoveRecord(int32 RecordId);
+
+		/** Forces all records to be sampled on the next update. */
+		void Invalidate();
+
+		/** Samples the records whose pose changed since the last update, returns the number of records sampled. GetPose is called concurrently. */
+		int32 Update(TFunctionRef<FCPURecordPose(int32 RecordId)> GetPose, int32 MinBatchSize, EParallelForFlags Flags);
+
+		inline bool IsEmpty() const
+		{
+			return Records.IsEmpty();
+		}
+
+		/** Record id -> byte offset of the record transforms in GetTransforms, or ~0u if the record is not evaluated. */
+		inline TConstArrayView<uint32> GetIdToOffsetMapping() const
+		{
+			return IdToOffsetMapping;
+		}
+
+		inline TConstArrayView<FCompressedBoneTransform> GetTransforms() const
+		{
+			return Transforms;
+		}
+
+		/** Calls Func(TransformOffset, Transforms) for each record sampled by the last update, the offset is in elements of GetTransforms. */
+		template <typename FuncType>
+		void ForEachSampledRecord(FuncType&& Func) const
+		{
+			for (const FRecordState& State : Records)
+			{
+				if (State.bSampled)
+				{
+					Func(State.TransformOffset, TConstArrayView<FCompressedBoneTransform>(Transforms).Slice(int32(State.TransformOffset), int32(State.BoneCount)));
+				}
+			}
+		}
+
+	private:
+		struct FRecordState
+		{
+			int32 RecordId = INDEX_NONE;
+			uint32 TransformOffset = 0;
+			uint32 BoneCount = 0;
+			int32 KeyIndex0 = INDEX_NONE;
+			int32 KeyIndex1 = INDEX_NONE;
+			float Alpha = 0.0f;
+			bool bSampled = false;
+		};
+
+		/** Dense list of the evaluated records, only changed on add/remove. */
+		TArray<FRecordState> Records;
+		/** Record id -> index in Records, or INDEX_NONE. */
+		TArray<int32> RecordSlots;
+		TArray<uint32> IdToOffsetMapping;
+		/** Sampled transforms of all records, allocated with TransformAllocator. */
+		TArray<FCompressedBoneTransform> Transforms;
+		FSpanAllocator TransformAllocator;
+	};
+
 public:
 	using ISceneExtension::ISceneExtension;
 
@@ -37,9 +137,16 @@ private:
 	void ProvideGPUBankTransforms(FSkinningTransformProvider::FProviderContext& Context);
 	void ProvideCPUBankTransforms(FSkinningTransformProvider::FProviderContext& Context);
 
+	FRDGBufferRef UpdateCPUBankTransforms(FRDGBuilder& GraphBuilder);
+
 private:
 	FAnimBankRecordMap BankRecordMap;
 	FSpanAllocator BankAllocator;
+
+	FCPURecordSampler CPURecordSampler;
+	/** GPU copy of the CPU sampled transforms, only the records resampled each update are uploaded. */
+	TPersistentByteAddressBuffer<FCompressedBoneTransform> CPUTransformBuffer{ 1024, TEXT("AnimBank.Transforms") };
+	bool bCPUInterpolating = true;
 };
 
 RENDERER_API const FSkinningTransformProvider::FProviderId& GetAnimBankProviderId();
\ No newline at end of file
@@ -15,53 +15,75 @@ bool FSkinningTransformProvider::ShouldCreateExtension(FScene& InScene)
 
 void FSkinningTransformProvider::RegisterProvider(const FSkinningTransformProvider::FProviderId& Id, const FOnProvideTransforms& Delegate)
 {
-#if DO_CHECK
-	for (const FTransformProvider& ProviderCheck : Providers)
-	{
-		check(ProviderCheck.Id != Id);
-	}
-#endif
+	Registry.RegisterProvider(Id, Delegate);
+}
+
+void FSkinningTransformProvider::UnregisterProvider(const FSkinningTransformProvider::FProviderId& Id)
+{
+	Registry.UnregisterProvider(Id);
+}
 
+void FSkinningTransformProvider::FRegistry::RegisterProvider(const FSkinningTransformProvider::FProviderId& Id, const FOnProvideTransforms& Delegate)
+{
+	check(!ProviderIdToIndex.Contains(Id));
 	check(Delegate.IsBound());
+
+	ProviderIdToIndex.Add(Id, Providers.Num());
+
 	FTransformProvider& Provider = Providers.Emplace_GetRef();
 	Provider.Id = Id;
 	Provider.Delegate = Delegate;
 }
 
-void FSkinningTransformProvider::UnregisterProvider(const FSkinningTransformProvider::FProviderId& Id)
+void FSkinningTransformProvider::FRegistry::UnregisterProvider(const FSkinningTransformProvider::FProviderId& Id)
 {
-	for (int32 ProviderIndex = 0; ProviderIndex < Providers.Num(); ++ProviderIndex)
+	int32 ProviderIndex = INDEX_NONE;
+	if (!ProviderIdToIndex.RemoveAndCopyValue(Id, ProviderIndex))
 	{
-		const FTransformProvider& Provider = Providers[ProviderIndex];
-		if (Provider.Id == Id)
-		{
-			Providers.RemoveAtSwap(ProviderIndex);
-			return;
-		}
+		checkNoEntry(); // No provider found with this id - error!
+		return;
 	}
 
-	checkNoEntry(); // No provider found with this id - error!
+	Providers.RemoveAtSwap(ProviderIndex);
+	if (ProviderIndex < Providers.Num())
+	{
+		ProviderIdToIndex.FindChecked(Providers[ProviderIndex].Id) = ProviderIndex;
+	}
 }
 
-void FSkinningTransformProvider::Broadcast(const TConstArrayView<FProviderRange> Ranges, FProviderContext& Context)
+void FSkinningTransformProvider::FRegistry::Broadcast(const TConstArrayView<FProviderRange> Ranges, FProviderContext& Context) const
 {
+	TRACE_CPUPROFILER_EVENT_SCOPE(FSkinningTransformProvider::Broadcast);
+
 	const TConstArrayView<FUintVector2> IndirectionView = Context.Indirections;
 
-	for (const FTransformProvider& Provider : Providers)
+	// Bucket the ranges per provider, ranges built from GetProviderIds are already in provider order
+	TArray<int32, TInlineAllocator<8>> ProviderToRangeIndex;
+	ProviderToRangeIndex.Init(INDEX_NONE, Providers.Num());
+	for (int32 RangeIndex = 0; RangeIndex < Ranges.Num(); ++RangeIndex)
+	{
+		const FProviderId& RangeId = Ranges[RangeIndex].Id;
+		const int32 ProviderIndex = (RangeIndex < Providers.Num() && Providers[RangeIndex].Id == RangeId) ? RangeIndex : FindProviderIndex(RangeId);
+		if (ProviderIndex != INDEX_NONE && ProviderToRangeIndex[ProviderIndex] == INDEX_NONE)
+		{
+			ProviderToRangeIndex[ProviderIndex] = RangeIndex;
+		}
+	}
+
+	for (int32 ProviderIndex = 0; ProviderIndex < Providers.Num(); ++ProviderIndex)
 	{
-		for (const FProviderRange& Range : Ranges)
+		const int32 RangeIndex = ProviderToRangeIndex[ProviderIndex];
+		if (RangeIndex == INDEX_NONE || Ranges[RangeIndex].Count == 0)
 		{
-			if (Provider.Id == Range.Id)
-			{
-				if (Range.Count > 0)
-				{
-					Context.Indirections = MakeArrayView(IndirectionView.GetData() + Range.Offset, Range.Count);
-					Provider.Delegate.ExecuteIfBound(Context);
-				}
-				break;
-			}
+			continue;
 		}
+
+		const FProviderRange& Range = Ranges[RangeIndex];
+		Context.Indirections = MakeArrayView(IndirectionView.GetData() + Range.Offset, Range.Count);
+		Providers[ProviderIndex].Delegate.ExecuteIfBound(Context);
 	}
+
+	Context.Indirections = IndirectionView;
 }
 
 const FSkinningTransformProvider::FProviderId& GetRefPoseProviderId()
@@ -54,6 +54,58 @@ public:
 
 	DECLARE_DELEGATE_OneParam(FOnProvideTransforms, FProviderContext&);
 
+	/** The registered providers, with their ids interned to dense indices. Doesn't depend on the scene. */
+	class FRegistry
+	{
+	public:
+		void RegisterProvider(const FProviderId& Id, const FOnProvideTransforms& Delegate);
+		void UnregisterProvider(const FProviderId& Id);
+
+		/**
+		 * Execute the provider delegates for their range of the context's indirections.
+		 * Ranges are matched to providers by index when they are in provider order (see GetProviderIds), otherwise through the interned ids.
+		 */
+		void Broadcast(const TConstArrayView<FProviderRange> Ranges, FProviderContext& Context) const;
+
+		inline bool HasProviders() const
+		{
+			return !Providers.IsEmpty();
+		}
+
+		inline int32 GetNumProviders() const
+		{
+			return Providers.Num();
+		}
+
+		/** Returns the dense index of a registered provider (matching the order of GetProviderIds), or INDEX_NONE. Indices change on unregistration. */
+		inline int32 FindProviderIndex(const FProviderId& Id) const
+		{
+			const int32* ProviderIndex = ProviderIdToIndex.Find(Id);
+			return ProviderIndex ? *ProviderIndex : INDEX_NONE;
+		}
+
+		inline TArray<FProviderId> GetProviderIds() const
+		{
+			TArray<FProviderId> Ids;
+			Ids.Reserve(Providers.Num());
+			for (const FTransformProvider& Provider : Providers)
+			{
+				Ids.Add(Provider.Id);
+			}
+			return Ids;
+		}
+
+	private:
+		struct FTransformProvider
+		{
+			FProviderId Id;
+			FOnProvideTransforms Delegate;
+		};
+
+		TArray<FTransformProvider> Providers;
+		TMap<FProviderId, int32> ProviderIdToIndex;
+	};
+
 public:
 	using ISceneExtension::ISceneExtension;
 
@@ -62,32 +114,33 @@ public:
 	RENDERER_API void RegisterProvider(const FProviderId& Id, const FOnProvideTransforms& Delegate);
 	RENDERER_API void UnregisterProvider(const FProviderId& Id);
 
-	void Broadcast(const TConstArrayView<FProviderRange> Ranges, FProviderContext& Context);
+	void Broadcast(const TConstArrayView<FProviderRange> Ranges, FProviderContext& Context)
+	{
+		Registry.Broadcast(Ranges, Context);
+	}
 
 	inline bool HasProviders() const
 	{
-		return !Providers.IsEmpty();
+		return Registry.HasProviders();
 	}
 
-	inline TArray<FProviderId> GetProviderIds() const
+	inline int32 GetNumProviders() const
 	{
-		TArray<FProviderId> Ids;
-		Ids.Reserve(Providers.Num());
-		for (const FTransformProvider& Provider : Providers)
-		{
-			Ids.Add(Provider.Id);
-		}
-		return Ids;
+		return Registry.GetNumProviders();
 	}
 
-private:
-	struct FTransformProvider
+	inline int32 FindProviderIndex(const FProviderId& Id) const
 	{
-		FProviderId Id;
-		FOnProvideTransforms Delegate;
-	};
+		return Registry.FindProviderIndex(Id);
+	}
+
+	inline TArray<FProviderId> GetProviderIds() const
+	{
+		return Registry.GetProviderIds();
+	}
 
-	TArray<FTransformProvider> Providers;
+private:
+	FRegistry Registry;
 };
 
 RENDERER_API const FSkinningTransformProvider::FProviderId& GetRefPoseProviderId();
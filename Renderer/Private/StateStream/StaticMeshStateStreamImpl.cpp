@@ -1,6 +1,7 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "StaticMeshStateStreamImpl.h"
+#include "Containers/AllocatorFixedSizeFreeList.h"
 #include "ScenePrivate.h"
 #include "StateStreamCreator.h"
 #include "StaticMeshSceneProxy.h"
@@ -8,10 +9,148 @@
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void FStaticMeshObjectChangeList::AddCreated(FPrimitiveSceneDesc& Desc, bool bVisible)
+{
+	check(!ChangeIndices.Contains(&Desc));
+	ChangeIndices.Add(&Desc, Changes.Num());
+	Changes.Add({ &Desc, FTransform::Identity, true, false, bVisible, bVisible });
+}
+
+void FStaticMeshObjectChangeList::MarkDirty(FPrimitiveSceneDesc& Desc, const FTransform& Transform, bool bVisible, bool bSceneVisible)
+{
+	if (const int32* ChangeIndex = ChangeIndices.Find(&Desc))
+	{
+		FChange& Change = Changes[*ChangeIndex];
+		Change.Transform = Transform;
+		Change.bMoved = true;
+		Change.bVisible = bVisible;
+		return;
+	}
+
+	ChangeIndices.Add(&Desc, Changes.Num());
+	Changes.Add({ &Desc, Transform, false, true, bVisible, bSceneVisible });
+}
+
+bool FStaticMeshObjectChangeList::Remove(FPrimitiveSceneDesc& Desc)
+{
+	int32 ChangeIndex = INDEX_NONE;
+	if (ChangeIndices.RemoveAndCopyValue(&Desc, ChangeIndex))
+	{
+		FChange& Change = Changes[ChangeIndex];
+		Change.Desc = nullptr;
+		return Change.bCreated;
+	}
+	return false;
+}
+
+void FStaticMeshObjectChangeList::FFlushedChanges::Reset()
+{
+	Created.Reset();
+	MovedProxies.Reset();
+	MovedWorldBounds.Reset();
+	MovedLocalBounds.Reset();
+	MovedLocalToWorlds.Reset();
+	MovedAttachmentRootPositions.Reset();
+	Shown.Reset();
+	Hidden.Reset();
+}
+
+void FStaticMeshObjectChangeList::Flush(FFlushedChanges& Out)
+{
+	Out.Reset();
+
+	// Visibility changes of created objects, applied at the next flush
+	TArray<FChange, TInlineAllocator<16>> DeferredChanges;
+
+	for (FChange& Change : Changes)
+	{
+		FPrimitiveSceneDesc* Desc = Change.Desc;
+		if (!Desc)
+		{
+			continue;
+		}
+
+		if (Change.bMoved)
+		{
+			const FMatrix LocalToWorld = Change.Transform.ToMatrixWithScale();
+			if (Change.bCreated || !LocalToWorld.Equals(Desc->RenderMatrix, 0.0f))
+			{
+				Desc->RenderMatrix = LocalToWorld;
+				Desc->AttachmentRootPosition = Change.Transform.GetLocation();
+				Desc->Bounds = Desc->LocalBounds.TransformBy(Change.Transform);
+
+				// Created objects are added with their latest transform
+				if (!Change.bCreated)
+				{
+					Out.MovedProxies.Add(Desc->PrimitiveSceneData->SceneProxy);
+					Out.MovedWorldBounds.Add(Desc->Bounds);
+					Out.MovedLocalBounds.Add(Desc->LocalBounds);
+					Out.MovedLocalToWorlds.Add(Desc->RenderMatrix);
+					Out.MovedAttachmentRootPositions.Add(Desc->AttachmentRootPosition);
+				}
+			}
+		}
+
+		if (Change.bCreated)
+		{
+			Out.Created.Add(Desc);
+			if (Change.bVisible != Change.bSceneVisible)
+			{
+				DeferredChanges.Add({ Desc, Change.Transform, false, false, Change.bVisible, Change.bSceneVisible });
+			}
+		}
+		else if (Change.bVisible != Change.bSceneVisible)
+		{
+			(Change.bVisible ? Out.Shown : Out.Hidden).Add(Desc->PrimitiveSceneData->SceneProxy);
+		}
+	}
+
+	Changes.Reset();
+	ChangeIndices.Reset();
+
+	for (const FChange& Change : DeferredChanges)
+	{
+		ChangeIndices.Add(Change.Desc, Changes.Num());
+		Changes.Add(Change);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Fixed size pool allocator for FStaticMeshObjects, grown in slabs of 16KB
+ */
+#define STATIC_MESH_OBJECT_FREE_LIST_GROW_SIZE ( 16384 / sizeof(FStaticMeshObject) )
+static TAllocatorFixedSizeFreeList<sizeof(FStaticMeshObject), STATIC_MESH_OBJECT_FREE_LIST_GROW_SIZE> GStaticMeshObjectAllocator;
+static FCriticalSection GStaticMeshObjectAllocatorLock;
+
+void* FStaticMeshObject::operator new(size_t Size)
+{
+	// doesn't support derived classes with a different size
+	checkSlow(Size == sizeof(FStaticMeshObject));
+	FScopeLock Lock(&GStaticMeshObjectAllocatorLock);
+	return GStaticMeshObjectAllocator.Allocate();
+}
+
+void FStaticMeshObject::operator delete(void* RawMemory)
+{
+	FScopeLock Lock(&GStaticMeshObjectAllocatorLock);
+	GStaticMeshObjectAllocator.Free(RawMemory);
+}
+
 FStaticMeshObject::~FStaticMeshObject()
 {
-	FSceneInterface& Scene = PrimitiveSceneData.SceneProxy->GetScene();
-	Scene.RemovePrimitive(&PrimitiveSceneDesc);
+	if (bAddedToScene)
+	{
+		FSceneInterface& Scene = PrimitiveSceneData.SceneProxy->GetScene();
+		Scene.RemovePrimitive(&PrimitiveSceneDesc);
+	}
+	else
+	{
+		// Destroyed before the flush, the scene never took ownership of the proxy
+		delete PrimitiveSceneData.SceneProxy;
+		PrimitiveSceneData.SceneProxy = nullptr;
+	}
 
 	if (TransformObject)
 	{
@@ -23,7 +162,8 @@ FStaticMeshObject::~FStaticMeshObject()
 void FStaticMeshObject::OnTransformObjectDirty()
 {
 	FTransformObject::Info Info = TransformObject->GetInfo();
-	// TODO: Implement this to handle changing visibility and movement
+	Stream->Changes.MarkDirty(PrimitiveSceneDesc, Info.WorldTransform, Info.bVisible, bVisible);
+	bVisible = Info.bVisible;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -63,6 +203,7 @@ void FStaticMeshStateStreamImpl::Render_OnCreate(const FStaticMeshStaticState& S
 
 	FStaticMeshObject& Object = *new FStaticMeshObject();
 	Object.AddRef();
+	Object.Stream = this;
 
 	SetTransformObject(Object, Ds);
 
@@ -98,8 +239,11 @@ void FStaticMeshStateStreamImpl::Render_OnCreate(const FStaticMeshStaticState& S
 	#endif
 
 	Object.PrimitiveSceneData.SceneProxy = new FStaticMeshSceneProxy(Desc, false);
+	Object.bVisible = Info.bVisible;
+	Object.bAddedToScene = true;
 
-	Scene.AddPrimitive(&Object.PrimitiveSceneDesc);
+	// Added to the scene with the other objects created this frame, in Render_PostUpdate
+	Changes.AddCreated(Object.PrimitiveSceneDesc, Object.bVisible);
 
 	UserData = &Object;
 }
@@ -116,6 +260,10 @@ void FStaticMeshStateStreamImpl::Render_OnUpdate(const FStaticMeshStaticState& S
 	if (Ds.TransformModified())
 	{
 		SetTransformObject(Object, Ds);
+		if (Object.TransformObject)
+		{
+			Object.OnTransformObjectDirty();
+		}
 	}
 }
 
@@ -123,10 +271,54 @@ void FStaticMeshStateStreamImpl::Render_OnDestroy(const FStaticMeshStaticState&
 {
 	if (UserData)
 	{
+		if (Changes.Remove(UserData->PrimitiveSceneDesc))
+		{
+			UserData->bAddedToScene = false;
+		}
 		UserData->Release();
 	}
 }
 
+void FStaticMeshStateStreamImpl::Render_PostUpdate()
+{
+	TStateStream<FStaticMeshStateStreamSettings>::Render_PostUpdate();
+
+	if (Changes.IsEmpty())
+	{
+		return;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(FStaticMeshStateStreamImpl::Render_PostUpdate);
+
+	Changes.Flush(FlushedChanges);
+
+	FScene& RenderScene = static_cast<FScene&>(Scene);
+
+	if (!FlushedChanges.Created.IsEmpty())
+	{
+		RenderScene.BatchAddPrimitives(FlushedChanges.Created);
+	}
+
+	if (!FlushedChanges.MovedProxies.IsEmpty())
+	{
+		RenderScene.BatchUpdatePrimitiveTransforms_RenderThread(
+			FlushedChanges.MovedProxies,
+			FlushedChanges.MovedWorldBounds,
+			FlushedChanges.MovedLocalBounds,
+			FlushedChanges.MovedLocalToWorlds,
+			FlushedChanges.MovedAttachmentRootPositions);
+	}
+
+	if (!FlushedChanges.Shown.IsEmpty())
+	{
+		RenderScene.UpdatePrimitivesDrawnInGame_RenderThread(FlushedChanges.Shown, true);
+	}
+	if (!FlushedChanges.Hidden.IsEmpty())
+	{
+		RenderScene.UpdatePrimitivesDrawnInGame_RenderThread(FlushedChanges.Hidden, false);
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 STATESTREAM_CREATOR_INSTANCE_WITH_DEPENDENCY(FStaticMeshStateStreamImpl, TransformStateStreamId)
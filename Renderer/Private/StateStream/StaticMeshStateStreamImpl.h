@@ -10,20 +10,91 @@
 #define UE_API RENDERER_API
 
 class FSceneInterface;
+class FPrimitiveSceneProxy;
+class FStaticMeshStateStreamImpl;
 struct FPrimitiveSceneDesc;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Changes of the static mesh objects during a render update, flushed to the scene once per frame in Render_PostUpdate:
+ * created objects as one batch add, moved objects as one transform batch and visibility changes as one call per visibility.
+ * Objects are keyed by their scene desc, and collected once per frame however many times their transform object gets dirty.
+ */
+class FStaticMeshObjectChangeList
+{
+public:
+	/** Object created this frame, added to the scene at the flush. bVisible is the visibility its proxy was created with. */
+	UE_API void AddCreated(FPrimitiveSceneDesc& Desc, bool bVisible);
+
+	/** Latest transform and visibility of the object. bSceneVisible is the visibility of the object before this change. */
+	UE_API void MarkDirty(FPrimitiveSceneDesc& Desc, const FTransform& Transform, bool bVisible, bool bSceneVisible);
+
+	/** Drop the changes of a destroyed object. Returns true if the object was created this frame and isn't in the scene yet. */
+	UE_API bool Remove(FPrimitiveSceneDesc& Desc);
+
+	bool IsEmpty() const { return ChangeIndices.IsEmpty(); }
+
+	struct FFlushedChanges
+	{
+		TArray<FPrimitiveSceneDesc*> Created;
+
+		/** Moved objects, index parallel for FScene::BatchUpdatePrimitiveTransforms_RenderThread */
+		TArray<FPrimitiveSceneProxy*> MovedProxies;
+		TArray<FBoxSphereBounds> MovedWorldBounds;
+		TArray<FBoxSphereBounds> MovedLocalBounds;
+		TArray<FMatrix> MovedLocalToWorlds;
+		TArray<FVector> MovedAttachmentRootPositions;
+
+		TArray<FPrimitiveSceneProxy*> Shown;
+		TArray<FPrimitiveSceneProxy*> Hidden;
+
+		UE_API void Reset();
+	};
+
+	/**
+	 * Write the latest transforms to the scene descs and gather the changes for the scene. Out is reset first, so it can be reused across frames.
+	 * Visibility changes of objects created this frame are kept for the next flush, once they are in the scene.
+	 */
+	UE_API void Flush(FFlushedChanges& Out);
+
+private:
+	struct FChange
+	{
+		FPrimitiveSceneDesc* Desc;
+		FTransform Transform;
+		bool bCreated;
+		bool bMoved;
+		bool bVisible;
+		bool bSceneVisible;
+	};
+
+	/** Destroyed objects leave a null Desc behind, so that the other indices stay valid. */
+	TArray<FChange> Changes;
+	TMap<FPrimitiveSceneDesc*, int32> ChangeIndices;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 class FStaticMeshObject : public TRefCountingMixin<FStaticMeshObject>, public FTransformObjectListener
 {
 public:
+	/** Objects come from a fixed size free list, so that mass spawns don't go to the general allocator for each object */
+	void* operator new(size_t Size);
+	void operator delete(void* RawMemory);
 
 private:
 	virtual ~FStaticMeshObject();
 	virtual void OnTransformObjectDirty() override final;
 
+	FStaticMeshStateStreamImpl* Stream = nullptr;
 	TRefCountPtr<FTransformObject> TransformObject;
 
+	/** Visibility of the object, as last given to the change list */
+	bool bVisible = false;
+	/** False if the object was destroyed before the flush that would have added it to the scene */
+	bool bAddedToScene = false;
+
 	FCustomPrimitiveData CustomPrimitiveData;
 	FPrimitiveSceneInfoData	PrimitiveSceneData;
 	FPrimitiveSceneDesc PrimitiveSceneDesc;
@@ -50,8 +121,13 @@ private:
 	UE_API virtual void Render_OnCreate(const FStaticMeshStaticState& Ss, const FStaticMeshDynamicState& Ds, FStaticMeshObject*& UserData, bool IsDestroyedInSameFrame) override;
 	UE_API virtual void Render_OnUpdate(const FStaticMeshStaticState& Ss, const FStaticMeshDynamicState& Ds, FStaticMeshObject*& UserData) override;
 	UE_API virtual void Render_OnDestroy(const FStaticMeshStaticState& Ss, const FStaticMeshDynamicState& Ds, FStaticMeshObject*& UserData) override;
+	UE_API virtual void Render_PostUpdate() override;
 
 	FSceneInterface& Scene;
+	FStaticMeshObjectChangeList Changes;
+	FStaticMeshObjectChangeList::FFlushedChanges FlushedChanges;
+
+	friend class FStaticMeshObject;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
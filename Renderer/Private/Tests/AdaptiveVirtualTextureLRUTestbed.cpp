@@ -0,0 +1,488 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Containers/BinaryHeap.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "VT/AdaptiveVirtualTextureLRUPlanner.h"
+#include "VT/VirtualTextureAllocator.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAdaptiveVirtualTextureLRUTestbed, "System.Renderer.VirtualTexture.AdaptiveLRU", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace AdaptiveVirtualTextureLRUTestbed
+{
+
+using FPlanner = FAdaptiveVirtualTextureLRUPlanner;
+
+/** Feedback for a grid cell in a frame: marks its allocation as used, and asks for a higher level when bIsRequest is set. */
+struct FCellRequest
+{
+	uint32 GridIndex;
+	bool bIsRequest;
+};
+
+/** Recorded adaptive virtual texture feedback, the cell requests of each frame. */
+using FRequestStream = TArray<TArray<FCellRequest>>;
+
+struct FSimDesc
+{
+	const TCHAR* Name;
+	uint32 GridSize;
+	uint32 MaxSpaceSize;
+	uint32 MaxAdaptiveLevel;
+	uint32 AgeToFree;
+	int32 MaxAllocPerFrame;
+	int32 MaxFreePerFrame;
+	float ViewRadius;
+	float RequestRadius;
+	float Speed;
+};
+
+/** Camera wandering over a landscape: cells in view range are used, the ones close to the camera request more resolution. */
+static FRequestStream GenerateFlythrough(FRandomStream& Random, const FSimDesc& Desc, int32 NumFrames)
+{
+	FRequestStream Stream;
+	FVector2f Position(Desc.GridSize * 0.5f, Desc.GridSize * 0.5f);
+	FVector2f Direction(1.0f, 0.0f);
+
+	for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+	{
+		// Turn slowly and bounce on the edges
+		const float Angle = Random.FRandRange(-0.1f, 0.1f);
+		Direction = FVector2f(
+			Direction.X * FMath::Cos(Angle) - Direction.Y * FMath::Sin(Angle),
+			Direction.X * FMath::Sin(Angle) + Direction.Y * FMath::Cos(Angle));
+		Position += Direction * Desc.Speed;
+
+		for (int32 Axis = 0; Axis < 2; ++Axis)
+		{
+			if (Position[Axis] < 0.0f || Position[Axis] >= (float)Desc.GridSize)
+			{
+				Direction[Axis] = -Direction[Axis];
+				Position[Axis] = FMath::Clamp(Position[Axis], 0.0f, Desc.GridSize - 1.0f);
+			}
+		}
+
+		TArray<FCellRequest>& Requests = Stream.AddDefaulted_GetRef();
+		const int32 MinX = FMath::Max(FMath::FloorToInt32(Position.X - Desc.ViewRadius), 0);
+		const int32 MinY = FMath::Max(FMath::FloorToInt32(Position.Y - Desc.ViewRadius), 0);
+		const int32 MaxX = FMath::Min(FMath::CeilToInt32(Position.X + Desc.ViewRadius), (int32)Desc.GridSize - 1);
+		const int32 MaxY = FMath::Min(FMath::CeilToInt32(Position.Y + Desc.ViewRadius), (int32)Desc.GridSize - 1);
+
+		for (int32 Y = MinY; Y <= MaxY; ++Y)
+		{
+			for (int32 X = MinX; X <= MaxX; ++X)
+			{
+				const float Distance = FVector2f::Distance(FVector2f(X + 0.5f, Y + 0.5f), Position);
+				if (Distance <= Desc.ViewRadius)
+				{
+					Requests.Add({ Y * Desc.GridSize + X, Distance <= Desc.RequestRadius });
+				}
+			}
+		}
+	}
+
+	return Stream;
+}
+
+/** Allocation keys are never dereferenced by the allocator, only used for the hash table and Free(). */
+static FAllocatedVirtualTexture* GetKey(uint32 Id)
+{
+	return reinterpret_cast<FAllocatedVirtualTexture*>(UPTRINT(Id + 1) * 16u);
+}
+
+struct FSimResult
+{
+	int32 NumGrows = 0;
+	/** Reallocations to a lower level, each one remaps the pages of the allocation. */
+	int32 NumDowngrades = 0;
+	int32 NumFrees = 0;
+	/** Planned levels that didn't fit in the page table. */
+	int32 NumFallbacks = 0;
+	/** Alloc() failures after TryAlloc() succeeded. */
+	int32 NumFailedAllocs = 0;
+	/** Plans with an allocation more than once, or not lowering its level. */
+	int32 NumInvalidPlans = 0;
+	int32 NumFramesOverTarget = 0;
+	uint64 FreeCycles = 0;
+};
+
+/**
+ * Replays the allocation logic of FAdaptiveVirtualTexture::UpdateAllocations() on a page table allocator, without the virtual texture system.
+ * Downgraded and freed allocations release their address space at the end of the frame, like the deferred destroy of the allocated virtual textures.
+ */
+class FAdaptiveSim
+{
+public:
+	FAdaptiveSim(const FSimDesc& InDesc, bool bInBatched, uint32 Seed)
+		: Desc(InDesc)
+		, bBatched(bInBatched)
+		, Random(Seed)
+		, Allocator(2)
+	{
+		Allocator.Initialize(Desc.MaxSpaceSize);
+		TargetPages = Desc.MaxSpaceSize * Desc.MaxSpaceSize * 75 / 100;
+		GridSlots.Init(INDEX_NONE, Desc.GridSize * Desc.GridSize);
+
+		// Persistent low mips
+		Allocator.Alloc(GetKey(NextId++), Desc.GridSize, Desc.GridSize, FMath::CeilLogTwo(Desc.GridSize));
+	}
+
+	void RunFrame(uint32 Frame, TConstArrayView<FCellRequest> Requests)
+	{
+		// QueuePackedAllocationRequests()
+		TArray<uint32> RequestsToMap;
+		for (const FCellRequest& Request : Requests)
+		{
+			const int32 SlotIndex = GridSlots[Request.GridIndex];
+			if (SlotIndex == INDEX_NONE)
+			{
+				if (Request.bIsRequest)
+				{
+					RequestsToMap.Add(Request.GridIndex);
+				}
+			}
+			else if (Slots[SlotIndex].FrameAllocated + 3 <= Frame)
+			{
+				const FSlot& Slot = Slots[SlotIndex];
+				LRUHeap.Update((Frame << 4) | Slot.Level, SlotIndex);
+				if (Request.bIsRequest && Slot.Level < Desc.MaxAdaptiveLevel)
+				{
+					RequestsToMap.Add(Request.GridIndex);
+				}
+			}
+		}
+
+		// UpdateAllocations()
+		const uint64 Time0 = FPlatformTime::Cycles64();
+		const int32 NumToFree = FMath::Min(NumAllocated, Desc.MaxFreePerFrame);
+		if (RequestsToMap.Num() == 0)
+		{
+			if (bBatched)
+			{
+				FreeLRUBatched(Frame, Desc.AgeToFree, 0, NumToFree);
+			}
+			else
+			{
+				bool bFreeSuccess = true;
+				for (int32 FreeCount = 0; bFreeSuccess && FreeCount < NumToFree; FreeCount++)
+				{
+					bFreeSuccess = FreeLRU(Frame, Desc.AgeToFree);
+				}
+			}
+		}
+		else
+		{
+			const uint32 FrameAgeToFree = 15;
+			if (bBatched)
+			{
+				if (Allocator.GetNumAllocatedPages() > TargetPages)
+				{
+					FreeLRUBatched(Frame, FrameAgeToFree, Allocator.GetNumAllocatedPages() - TargetPages, NumToFree);
+				}
+			}
+			else
+			{
+				bool bFreeSuccess = true;
+				for (int32 FreeCount = 0; bFreeSuccess && FreeCount < NumToFree && Allocator.GetNumAllocatedPages() > TargetPages; FreeCount++)
+				{
+					bFreeSuccess = FreeLRU(Frame, FrameAgeToFree);
+				}
+			}
+		}
+		Result.FreeCycles += FPlatformTime::Cycles64() - Time0;
+
+		for (int32 AllocCount = 0; AllocCount < Desc.MaxAllocPerFrame && RequestsToMap.Num(); AllocCount++)
+		{
+			const int32 RequestIndex = Random.RandHelper(RequestsToMap.Num());
+			Grow(RequestsToMap[RequestIndex], Frame);
+			RequestsToMap.RemoveAtSwap(RequestIndex, EAllowShrinking::No);
+		}
+
+		// DestroyPendingVirtualTextures()
+		for (uint32 Id : PendingFrees)
+		{
+			Allocator.Free(GetKey(Id));
+		}
+		PendingFrees.Reset();
+
+		if (Allocator.GetNumAllocatedPages() > TargetPages)
+		{
+			Result.NumFramesOverTarget++;
+		}
+	}
+
+	FSimResult Result;
+
+private:
+	struct FSlot
+	{
+		uint32 GridIndex = 0;
+		uint32 Level = 0;
+		uint32 Id = 0;
+		uint32 FrameAllocated = 0;
+	};
+
+	bool Reallocate(int32 SlotIndex, uint32 NewLevel, uint32 LastFrameUsed, uint32 Frame)
+	{
+		const uint32 Id = NextId++;
+		if (Allocator.Alloc(GetKey(Id), 1u << NewLevel, 1u << NewLevel, NewLevel) == ~0u)
+		{
+			++Result.NumFailedAllocs;
+			return false;
+		}
+
+		FSlot& Slot = Slots[SlotIndex];
+		PendingFrees.Add(Slot.Id);
+		Slot.Id = Id;
+		Slot.Level = NewLevel;
+		Slot.FrameAllocated = Frame;
+		LRUHeap.Update((LastFrameUsed << 4) | NewLevel, SlotIndex);
+		return true;
+	}
+
+	void Free(int32 SlotIndex)
+	{
+		FSlot& Slot = Slots[SlotIndex];
+		PendingFrees.Add(Slot.Id);
+		GridSlots[Slot.GridIndex] = INDEX_NONE;
+		Slot = FSlot();
+		FreeSlots.Add(SlotIndex);
+		--NumAllocated;
+		++Result.NumFrees;
+	}
+
+	void Grow(uint32 GridIndex, uint32 Frame)
+	{
+		const int32 SlotIndex = GridSlots[GridIndex];
+		const uint32 CurrentLevel = SlotIndex != INDEX_NONE ? Slots[SlotIndex].Level : 0;
+		const uint32 NewLevel = FMath::Min(CurrentLevel + 3u, Desc.MaxAdaptiveLevel);
+		if (!Allocator.TryAlloc(NewLevel))
+		{
+			return;
+		}
+
+		++Result.NumGrows;
+
+		if (SlotIndex != INDEX_NONE)
+		{
+			Reallocate(SlotIndex, NewLevel, Frame, Frame);
+			return;
+		}
+
+		const uint32 Id = NextId++;
+		if (Allocator.Alloc(GetKey(Id), 1u << NewLevel, 1u << NewLevel, NewLevel) == ~0u)
+		{
+			++Result.NumFailedAllocs;
+			return;
+		}
+
+		const int32 NewSlotIndex = FreeSlots.Num() > 0 ? FreeSlots.Pop(EAllowShrinking::No) : Slots.AddDefaulted();
+		Slots[NewSlotIndex] = { GridIndex, NewLevel, Id, Frame };
+		GridSlots[GridIndex] = NewSlotIndex;
+		LRUHeap.Add((Frame << 4) | NewLevel, NewSlotIndex);
+		++NumAllocated;
+	}
+
+	/** Same as FAdaptiveVirtualTexture::FreeLRU(). */
+	bool FreeLRU(uint32 Frame, uint32 FrameAgeToFree)
+	{
+		const uint32 SlotIndex = LRUHeap.Top();
+		const uint32 LastFrameUsed = LRUHeap.GetKey(SlotIndex) >> 4;
+		if (LastFrameUsed + FrameAgeToFree > Frame)
+		{
+			return false;
+		}
+
+		int32 NewLevel = Slots[SlotIndex].Level - 1;
+		while (NewLevel > 0 && !Allocator.TryAlloc(NewLevel))
+		{
+			--NewLevel;
+		}
+
+		if (NewLevel < 1)
+		{
+			LRUHeap.Pop();
+			Free(SlotIndex);
+		}
+		else if (Reallocate(SlotIndex, NewLevel, LastFrameUsed, Frame))
+		{
+			++Result.NumDowngrades;
+		}
+
+		return true;
+	}
+
+	/** Same as FAdaptiveVirtualTexture::FreeLRUBatched(). */
+	void FreeLRUBatched(uint32 Frame, uint32 FrameAgeToFree, uint64 PagesToRelease, int32 MaxDowngrades)
+	{
+		TArray<FPlanner::FCandidate> Candidates;
+		for (int32 SlotIndex = 0; SlotIndex < Slots.Num(); ++SlotIndex)
+		{
+			if (Slots[SlotIndex].Level > 0)
+			{
+				const uint32 LastFrameUsed = LRUHeap.GetKey(SlotIndex) >> 4;
+				if (LastFrameUsed + FrameAgeToFree <= Frame)
+				{
+					Candidates.Add({ (uint32)SlotIndex, Slots[SlotIndex].Level, LastFrameUsed });
+				}
+			}
+		}
+
+		if (Candidates.Num() == 0)
+		{
+			return;
+		}
+
+		TArray<uint32> NumFreeBlocks;
+		Allocator.GetNumFreeBlocks(NumFreeBlocks);
+
+		TArray<FPlanner::FDowngrade> Downgrades;
+		FPlanner::Plan(Candidates, NumFreeBlocks, PagesToRelease, MaxDowngrades, Downgrades);
+
+		TSet<uint32> Planned;
+		for (const FPlanner::FDowngrade& Downgrade : Downgrades)
+		{
+			bool bAlreadyPlanned = false;
+			Planned.Add(Downgrade.AllocationIndex, &bAlreadyPlanned);
+			if (bAlreadyPlanned || Downgrade.NewLevel >= Slots[Downgrade.AllocationIndex].Level || Downgrades.Num() > MaxDowngrades)
+			{
+				++Result.NumInvalidPlans;
+				return;
+			}
+		}
+
+		for (const FPlanner::FDowngrade& Downgrade : Downgrades)
+		{
+			int32 NewLevel = Downgrade.NewLevel;
+			if (NewLevel > 0 && !Allocator.TryAlloc(NewLevel))
+			{
+				++Result.NumFallbacks;
+				while (NewLevel > 0 && !Allocator.TryAlloc(NewLevel))
+				{
+					--NewLevel;
+				}
+			}
+
+			if (NewLevel < 1)
+			{
+				LRUHeap.Remove(Downgrade.AllocationIndex);
+				Free(Downgrade.AllocationIndex);
+			}
+			else if (Reallocate(Downgrade.AllocationIndex, NewLevel, Downgrade.LastFrameUsed, Frame))
+			{
+				++Result.NumDowngrades;
+			}
+		}
+	}
+
+	FSimDesc Desc;
+	bool bBatched;
+	FRandomStream Random;
+	FVirtualTextureAllocator Allocator;
+	uint32 TargetPages = 0;
+	uint32 NextId = 0;
+	int32 NumAllocated = 0;
+
+	TArray<FSlot> Slots;
+	TArray<int32> FreeSlots;
+	TArray<int32> GridSlots;
+	FBinaryHeap<uint32, uint32> LRUHeap;
+	TArray<uint32> PendingFrees;
+};
+
+static FSimResult Replay(const FSimDesc& Desc, const FRequestStream& Stream, bool bBatched)
+{
+	// Requests are skipped for allocations of the last few frames, start late enough to not wrap
+	const uint32 FirstFrame = 1000;
+
+	FAdaptiveSim Sim(Desc, bBatched, 0xada7);
+	for (int32 FrameIndex = 0; FrameIndex < Stream.Num(); ++FrameIndex)
+	{
+		Sim.RunFrame(FirstFrame + FrameIndex, Stream[FrameIndex]);
+	}
+	return Sim.Result;
+}
+
+struct FExpectedDowngrade
+{
+	uint32 AllocationIndex;
+	uint32 NewLevel;
+};
+
+static bool PlanEquals(TArray<FPlanner::FCandidate> Candidates, const TArray<uint32>& NumFreeBlocks, uint64 PagesToRelease, const TArray<FExpectedDowngrade>& Expected)
+{
+	TArray<FPlanner::FDowngrade> Downgrades;
+	FPlanner::Plan(Candidates, NumFreeBlocks, PagesToRelease, 8, Downgrades);
+
+	if (Downgrades.Num() != Expected.Num())
+	{
+		return false;
+	}
+
+	for (int32 Index = 0; Index < Downgrades.Num(); ++Index)
+	{
+		if (Downgrades[Index].AllocationIndex != Expected[Index].AllocationIndex || Downgrades[Index].NewLevel != Expected[Index].NewLevel)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+} // AdaptiveVirtualTextureLRUTestbed
+
+bool FAdaptiveVirtualTextureLRUTestbed::RunTest(const FString& Parameters)
+{
+	using namespace AdaptiveVirtualTextureLRUTestbed;
+
+	// Page pressure in an empty 256x256 page table: lowered directly to the level that releases enough, instead of 6 -> 5 -> 4 -> 3
+	TestTrue(TEXT("Pressure downgrade goes directly to the target level"),
+		PlanEquals({ { 0, 6, 1 } }, { 0, 0, 0, 0, 0, 0, 0, 0, 1 }, 4096 - 64, { { 0u, 3u } }));
+
+	// Single free 16x16 block: the oldest allocation gets it, the other one doesn't fit any level and is freed first
+	TestTrue(TEXT("Oldest allocation gets the space, the others are freed"),
+		PlanEquals({ { 1, 6, 2 }, { 0, 6, 1 } }, { 0, 0, 0, 0, 1 }, 0, { { 1u, 0u }, { 0u, 4u } }));
+
+	// Larger levels are placed first, so that smaller ones don't split the blocks they need
+	TestTrue(TEXT("Reallocations are ordered from the largest level down"),
+		PlanEquals({ { 0, 2, 1 }, { 1, 3, 1 } }, { 0, 0, 0, 1 }, 0, { { 1u, 2u }, { 0u, 1u } }));
+
+	const FSimDesc SimDescs[] =
+	{
+		// Name						Grid	Space	Level	Age		Alloc	Free	View	Request	Speed
+		{ TEXT("Open landscape"),	64,		256,	6,		120,	2,		8,		10.0f,	3.0f,	0.05f },
+		{ TEXT("Fast flythrough"),	128,	512,	6,		60,		4,		16,		12.0f,	4.0f,	0.25f },
+		{ TEXT("Low pressure"),		64,		1024,	6,		120,	2,		4,		8.0f,	2.0f,	0.05f },
+	};
+
+	FRandomStream Random(0xa17);
+
+	for (const FSimDesc& Desc : SimDescs)
+	{
+		const FRequestStream Stream = GenerateFlythrough(Random, Desc, 4000);
+
+		const FSimResult Legacy = Replay(Desc, Stream, false);
+		const FSimResult Batched = Replay(Desc, Stream, true);
+
+		TestEqual(FString::Printf(TEXT("%s: planned levels fit in the page table"), Desc.Name), Batched.NumFallbacks, 0);
+		TestEqual(FString::Printf(TEXT("%s: plans are valid"), Desc.Name), Batched.NumInvalidPlans, 0);
+		TestEqual(FString::Printf(TEXT("%s: no failed allocations"), Desc.Name), Batched.NumFailedAllocs + Legacy.NumFailedAllocs, 0);
+
+		AddInfo(FString::Printf(TEXT("%s: %d grows, %d downgrades (legacy %d), %d frees (legacy %d), %d frames over target (legacy %d), %.2fms (legacy %.2fms)"),
+			Desc.Name,
+			Batched.NumGrows,
+			Batched.NumDowngrades, Legacy.NumDowngrades,
+			Batched.NumFrees, Legacy.NumFrees,
+			Batched.NumFramesOverTarget, Legacy.NumFramesOverTarget,
+			FPlatformTime::ToMilliseconds64(Batched.FreeCycles),
+			FPlatformTime::ToMilliseconds64(Legacy.FreeCycles)));
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
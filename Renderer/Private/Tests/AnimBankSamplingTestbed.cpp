@@ -0,0 +1,379 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Async/ParallelFor.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "Skinning/AnimBankTransformProvider.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FAnimBankSamplingTestbed, "System.Renderer.AnimBank.CPUSampling", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace AnimBankSamplingTestbed
+{
+
+struct FSyntheticBank
+{
+	TArray<FQuat4f> RotationKeys;
+	TArray<FVector3f> PositionKeys;
+	TArray<FQuat4f> RefRotations;
+	TArray<FVector3f> RefPositions;
+};
+
+static FQuat4f RandomRotation(FRandomStream& Random)
+{
+	FQuat4f Rotation(Random.FRandRange(-1.0f, 1.0f), Random.FRandRange(-1.0f, 1.0f), Random.FRandRange(-1.0f, 1.0f), Random.FRandRange(-1.0f, 1.0f));
+	Rotation.Normalize();
+	return Rotation;
+}
+
+static FVector3f RandomPosition(FRandomStream& Random)
+{
+	return FVector3f(Random.FRandRange(-100.0f, 100.0f), Random.FRandRange(-100.0f, 100.0f), Random.FRandRange(-100.0f, 100.0f));
+}
+
+static FSyntheticBank MakeSyntheticBank(FRandomStream& Random, uint32 BoneCount, uint32 FrameCount)
+{
+	FSyntheticBank Bank;
+	Bank.RotationKeys.SetNumUninitialized(BoneCount * FrameCount);
+	Bank.PositionKeys.SetNumUninitialized(BoneCount * FrameCount);
+	Bank.RefRotations.SetNumUninitialized(BoneCount);
+	Bank.RefPositions.SetNumUninitialized(BoneCount);
+
+	for (uint32 KeyIndex = 0; KeyIndex < BoneCount * FrameCount; ++KeyIndex)
+	{
+		Bank.RotationKeys[KeyIndex] = RandomRotation(Random);
+		Bank.PositionKeys[KeyIndex] = RandomPosition(Random);
+	}
+
+	for (uint32 BoneIndex = 0; BoneIndex < BoneCount; ++BoneIndex)
+	{
+		Bank.RefRotations[BoneIndex] = RandomRotation(Random);
+		Bank.RefPositions[BoneIndex] = RandomPosition(Random);
+	}
+
+	return Bank;
+}
+
+/** Stand in for the record map of the provider: each record plays one of the banks, at its own time. */
+struct FSyntheticRecords
+{
+	const TArray<FSyntheticBank>& Banks;
+	uint32 BoneCount = 0;
+	uint32 FrameCount = 0;
+	TArray<int32> BankIndices;
+	TArray<float> Times;
+
+	FAnimBankTransformProvider::FCPURecordPose GetPose(int32 RecordId) const
+	{
+		const FSyntheticBank& Bank = Banks[BankIndices[RecordId]];
+
+		FAnimBankTransformProvider::FCPURecordPose Pose;
+		Pose.RotationKeys = Bank.RotationKeys.GetData();
+		Pose.PositionKeys = Bank.PositionKeys.GetData();
+		Pose.InvGlobalRefPoseRotations = Bank.RefRotations.GetData();
+		Pose.InvGlobalRefPosePositions = Bank.RefPositions.GetData();
+
+		const float RecordTime = FMath::Fmod(Times[RecordId], float(FrameCount - 1));
+		Pose.KeyIndex0 = FMath::FloorToInt32(RecordTime);
+		Pose.KeyIndex1 = FMath::Min<int32>(Pose.KeyIndex0 + 1, int32(FrameCount) - 1);
+		Pose.Alpha = RecordTime - float(Pose.KeyIndex0);
+		return Pose;
+	}
+};
+
+static int32 UpdateSampler(FAnimBankTransformProvider::FCPURecordSampler& Sampler, const FSyntheticRecords& Records, EParallelForFlags Flags)
+{
+	return Sampler.Update([&Records](int32 RecordId) { return Records.GetPose(RecordId); }, 16, Flags);
+}
+
+static TConstArrayView<FCompressedBoneTransform> GetRecordTransforms(const FAnimBankTransformProvider::FCPURecordSampler& Sampler, int32 RecordId, uint32 BoneCount)
+{
+	const uint32 Offset = Sampler.GetIdToOffsetMapping()[RecordId];
+	check(Offset != ~uint32(0));
+	return Sampler.GetTransforms().Slice(int32(Offset / sizeof(FCompressedBoneTransform)), int32(BoneCount));
+}
+
+static bool AreTransformsEqual(TConstArrayView<FCompressedBoneTransform> A, TConstArrayView<FCompressedBoneTransform> B)
+{
+	return A.Num() == B.Num() && FMemory::Memcmp(A.GetData(), B.GetData(), A.Num() * sizeof(FCompressedBoneTransform)) == 0;
+}
+
+/** Mirrors the provider upload: only the ranges of the records sampled by the last update are copied to the persistent buffer. */
+static void UploadSampledRecords(const FAnimBankTransformProvider::FCPURecordSampler& Sampler, TArray<FCompressedBoneTransform>& UploadedTransforms)
+{
+	if (UploadedTransforms.Num() < Sampler.GetTransforms().Num())
+	{
+		UploadedTransforms.SetNumZeroed(Sampler.GetTransforms().Num());
+	}
+
+	Sampler.ForEachSampledRecord(
+		[&UploadedTransforms](uint32 TransformOffset, TConstArrayView<FCompressedBoneTransform> RecordTransforms)
+		{
+			FMemory::Memcpy(&UploadedTransforms[TransformOffset], RecordTransforms.GetData(), RecordTransforms.Num() * sizeof(FCompressedBoneTransform));
+		}
+	);
+}
+
+/** The uploaded transforms of every evaluated record match the sampled ones. */
+static bool AreUploadedTransformsValid(const FAnimBankTransformProvider::FCPURecordSampler& Sampler, const TBitArray<>& LiveRecords, uint32 BoneCount, TConstArrayView<FCompressedBoneTransform> UploadedTransforms)
+{
+	const TConstArrayView<uint32> IdToOffsetMapping = Sampler.GetIdToOffsetMapping();
+	for (int32 RecordId = 0; RecordId < IdToOffsetMapping.Num(); ++RecordId)
+	{
+		if (RecordId < LiveRecords.Num() && LiveRecords[RecordId])
+		{
+			const int32 TransformOffset = int32(IdToOffsetMapping[RecordId] / sizeof(FCompressedBoneTransform));
+			if (!AreTransformsEqual(GetRecordTransforms(Sampler, RecordId, BoneCount), UploadedTransforms.Slice(TransformOffset, int32(BoneCount))))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/** The evaluated records have a transform range and disjoint ranges, the others map to ~0u. */
+static bool IsIdToOffsetMappingValid(const FAnimBankTransformProvider::FCPURecordSampler& Sampler, const TBitArray<>& LiveRecords, uint32 BoneCount)
+{
+	const TConstArrayView<uint32> IdToOffsetMapping = Sampler.GetIdToOffsetMapping();
+
+	TBitArray<> UsedTransforms(false, Sampler.GetTransforms().Num());
+	for (int32 RecordId = 0; RecordId < IdToOffsetMapping.Num(); ++RecordId)
+	{
+		const bool bLive = RecordId < LiveRecords.Num() && LiveRecords[RecordId];
+		if (!bLive)
+		{
+			if (IdToOffsetMapping[RecordId] != ~uint32(0))
+			{
+				return false;
+			}
+			continue;
+		}
+
+		const uint32 TransformOffset = IdToOffsetMapping[RecordId] / sizeof(FCompressedBoneTransform);
+		if (IdToOffsetMapping[RecordId] == ~uint32(0) || TransformOffset + BoneCount > uint32(UsedTransforms.Num()))
+		{
+			return false;
+		}
+
+		for (uint32 TransformIndex = TransformOffset; TransformIndex < TransformOffset + BoneCount; ++TransformIndex)
+		{
+			if (UsedTransforms[TransformIndex])
+			{
+				return false;
+			}
+			UsedTransforms[TransformIndex] = true;
+		}
+	}
+	return true;
+}
+
+} // AnimBankSamplingTestbed
+
+bool FAnimBankSamplingTestbed::RunTest(const FString& Parameters)
+{
+	using namespace AnimBankSamplingTestbed;
+
+	const int32 NumBanks = 16;
+	const int32 NumRecords = 4096;
+	const uint32 BoneCount = 80;
+	const uint32 FrameCount = 64;
+	const uint32 NumIterations = 8;
+
+	FRandomStream Random(0x5eed);
+
+	TArray<FSyntheticBank> Banks;
+	for (int32 BankIndex = 0; BankIndex < NumBanks; ++BankIndex)
+	{
+		Banks.Add(MakeSyntheticBank(Random, BoneCount, FrameCount));
+	}
+
+	FSyntheticRecords Records{ Banks, BoneCount, FrameCount };
+	Records.BankIndices.SetNumUninitialized(NumRecords);
+	Records.Times.SetNumUninitialized(NumRecords);
+
+	FAnimBankTransformProvider::FCPURecordSampler SerialSampler;
+	FAnimBankTransformProvider::FCPURecordSampler ParallelSampler;
+	TBitArray<> LiveRecords(true, NumRecords);
+
+	for (int32 RecordId = 0; RecordId < NumRecords; ++RecordId)
+	{
+		Records.BankIndices[RecordId] = RecordId % NumBanks;
+		// Offset each record in time so that the records do not all sample the same keys
+		Records.Times[RecordId] = float(RecordId) * 0.37f;
+
+		SerialSampler.AddRecord(RecordId, BoneCount, true);
+		ParallelSampler.AddRecord(RecordId, BoneCount, true);
+	}
+
+	// Serial vs parallel sampling of all the records
+	uint64 SerialCycles = 0;
+	uint64 ParallelCycles = 0;
+	bool bParallelMatches = true;
+	bool bAllSampled = true;
+
+	for (uint32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+	{
+		SerialSampler.Invalidate();
+		ParallelSampler.Invalidate();
+
+		const uint64 Time0 = FPlatformTime::Cycles64();
+		const int32 NumSerialSampled = UpdateSampler(SerialSampler, Records, EParallelForFlags::ForceSingleThread);
+		const uint64 Time1 = FPlatformTime::Cycles64();
+		const int32 NumParallelSampled = UpdateSampler(ParallelSampler, Records, EParallelForFlags::None);
+		const uint64 Time2 = FPlatformTime::Cycles64();
+
+		SerialCycles += Time1 - Time0;
+		ParallelCycles += Time2 - Time1;
+
+		bAllSampled &= NumSerialSampled == NumRecords && NumParallelSampled == NumRecords;
+		bParallelMatches &= AreTransformsEqual(SerialSampler.GetTransforms(), ParallelSampler.GetTransforms());
+
+		for (float& Time : Records.Times)
+		{
+			Time += 1.25f;
+		}
+	}
+
+	TestTrue(TEXT("Invalidated records are all sampled"), bAllSampled);
+	TestTrue(TEXT("Parallel sampling matches serial sampling"), bParallelMatches);
+
+	// The last update sampled every record, so the upload covers the whole buffer
+	TArray<FCompressedBoneTransform> UploadedTransforms;
+	UploadSampledRecords(ParallelSampler, UploadedTransforms);
+
+	// Unchanged records are not sampled again and keep their transforms
+	TArray<FCompressedBoneTransform> PreviousTransforms(ParallelSampler.GetTransforms());
+	TestEqual(TEXT("Records with unchanged poses are not sampled"), UpdateSampler(ParallelSampler, Records, EParallelForFlags::None), 0);
+	int32 NumUploadedRecords = 0;
+	ParallelSampler.ForEachSampledRecord([&NumUploadedRecords](uint32, TConstArrayView<FCompressedBoneTransform>) { ++NumUploadedRecords; });
+	TestEqual(TEXT("Records with unchanged poses are not uploaded"), NumUploadedRecords, 0);
+	TestTrue(TEXT("Records with unchanged poses keep their transforms"), AreTransformsEqual(PreviousTransforms, ParallelSampler.GetTransforms()));
+
+	// Only advance one record out of three, the others are paused
+	int32 NumPlaying = 0;
+	for (int32 RecordId = 0; RecordId < NumRecords; ++RecordId)
+	{
+		if ((RecordId % 3) == 0)
+		{
+			Records.Times[RecordId] += 1.25f;
+			++NumPlaying;
+		}
+	}
+
+	TestEqual(TEXT("Only the playing records are sampled"), UpdateSampler(ParallelSampler, Records, EParallelForFlags::None), NumPlaying);
+	UploadSampledRecords(ParallelSampler, UploadedTransforms);
+	TestTrue(TEXT("Uploading the playing records keeps the uploaded transforms up to date"), AreUploadedTransformsValid(ParallelSampler, LiveRecords, BoneCount, UploadedTransforms));
+
+	bool bPausedKept = true;
+	for (int32 RecordId = 0; RecordId < NumRecords; ++RecordId)
+	{
+		if ((RecordId % 3) != 0)
+		{
+			const uint32 TransformOffset = ParallelSampler.GetIdToOffsetMapping()[RecordId] / sizeof(FCompressedBoneTransform);
+			bPausedKept &= AreTransformsEqual(GetRecordTransforms(ParallelSampler, RecordId, BoneCount), MakeConstArrayView(PreviousTransforms).Slice(int32(TransformOffset), int32(BoneCount)));
+		}
+	}
+	TestTrue(TEXT("Paused records keep their transforms"), bPausedKept);
+
+	// Register/unregister churn: the remaining records keep their id -> offset entry and are not sampled again
+	bool bOffsetsStable = true;
+	bool bMappingValid = true;
+	bool bOnlyAddedSampled = true;
+	bool bAddedMatchReference = true;
+	bool bUploadValid = true;
+	TArray<int32> FreeRecordIds;
+
+	for (int32 Frame = 0; Frame < 64; ++Frame)
+	{
+		TArray<uint32> PreviousOffsets(ParallelSampler.GetIdToOffsetMapping());
+
+		const int32 NumRemoves = Random.RandRange(0, 128);
+		for (int32 RemoveIndex = 0; RemoveIndex < NumRemoves; ++RemoveIndex)
+		{
+			const int32 RecordId = Random.RandRange(0, LiveRecords.Num() - 1);
+			if (LiveRecords[RecordId])
+			{
+				ParallelSampler.RemoveRecord(RecordId);
+				LiveRecords[RecordId] = false;
+				FreeRecordIds.Add(RecordId);
+			}
+		}
+
+		// Records are recycled like the ids of the record map, some of them are not evaluated
+		TArray<int32> AddedRecordIds;
+		int32 NumEvaluatedAdds = 0;
+		const int32 NumAdds = Random.RandRange(0, 128);
+		for (int32 AddIndex = 0; AddIndex < NumAdds; ++AddIndex)
+		{
+			int32 RecordId = INDEX_NONE;
+			if (!FreeRecordIds.IsEmpty() && Random.FRand() < 0.75f)
+			{
+				RecordId = FreeRecordIds.Pop(EAllowShrinking::No);
+			}
+			else
+			{
+				RecordId = Records.BankIndices.Num();
+				Records.BankIndices.Add(Random.RandRange(0, NumBanks - 1));
+				Records.Times.Add(Random.FRandRange(0.0f, float(FrameCount)));
+				LiveRecords.Add(false);
+			}
+
+			const bool bEvaluated = Random.FRand() < 0.9f;
+			ParallelSampler.AddRecord(RecordId, BoneCount, bEvaluated);
+			if (bEvaluated)
+			{
+				LiveRecords[RecordId] = true;
+				AddedRecordIds.Add(RecordId);
+				++NumEvaluatedAdds;
+			}
+			else
+			{
+				// Not evaluated records are only given an id -> offset entry, and are unregistered like the others
+				ParallelSampler.RemoveRecord(RecordId);
+				FreeRecordIds.Add(RecordId);
+			}
+		}
+
+		for (int32 RecordId = 0; RecordId < PreviousOffsets.Num(); ++RecordId)
+		{
+			if (LiveRecords[RecordId] && PreviousOffsets[RecordId] != ~uint32(0) && !AddedRecordIds.Contains(RecordId))
+			{
+				bOffsetsStable &= ParallelSampler.GetIdToOffsetMapping()[RecordId] == PreviousOffsets[RecordId];
+			}
+		}
+
+		bOnlyAddedSampled &= UpdateSampler(ParallelSampler, Records, EParallelForFlags::None) == NumEvaluatedAdds;
+		bMappingValid &= IsIdToOffsetMappingValid(ParallelSampler, LiveRecords, BoneCount);
+
+		UploadSampledRecords(ParallelSampler, UploadedTransforms);
+		bUploadValid &= AreUploadedTransformsValid(ParallelSampler, LiveRecords, BoneCount, UploadedTransforms);
+
+		for (const int32 RecordId : AddedRecordIds)
+		{
+			const FAnimBankTransformProvider::FCPURecordPose Pose = Records.GetPose(RecordId);
+
+			TArray<FCompressedBoneTransform> ReferenceTransforms;
+			ReferenceTransforms.SetNumUninitialized(BoneCount);
+			FAnimBankTransformProvider::SampleAnimBankPose(Pose.RotationKeys, Pose.PositionKeys, Pose.InvGlobalRefPoseRotations, Pose.InvGlobalRefPosePositions, BoneCount, Pose.KeyIndex0, Pose.KeyIndex1, Pose.Alpha, ReferenceTransforms.GetData());
+			bAddedMatchReference &= AreTransformsEqual(GetRecordTransforms(ParallelSampler, RecordId, BoneCount), ReferenceTransforms);
+		}
+	}
+
+	TestTrue(TEXT("Id to offset mapping is stable across register/unregister churn"), bOffsetsStable);
+	TestTrue(TEXT("Id to offset mapping only maps the evaluated records, to disjoint ranges"), bMappingValid);
+	TestTrue(TEXT("Only the added records are sampled after churn"), bOnlyAddedSampled);
+	TestTrue(TEXT("Added records are sampled at their pose"), bAddedMatchReference);
+	TestTrue(TEXT("Uploading the sampled records keeps the uploaded transforms up to date across churn"), bUploadValid);
+
+	AddInfo(FString::Printf(TEXT("AnimBank CPU sampling, %d records x %u bones: serial %.3fms, parallel %.3fms (per update)"),
+		NumRecords, BoneCount,
+		FPlatformTime::ToMilliseconds64(SerialCycles) / NumIterations,
+		FPlatformTime::ToMilliseconds64(ParallelCycles) / NumIterations));
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
@@ -0,0 +1,357 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "DecalSceneCache.h"
+#include "DecalRenderingShared.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDecalSceneCacheTestbed, "System.Renderer.Decals.SceneCache", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace DecalSceneCacheTestbed
+{
+
+static const FDeferredDecalProxy* MakeProxy(int32 Index)
+{
+	return reinterpret_cast<const FDeferredDecalProxy*>(UPTRINT(Index + 1) * 16);
+}
+
+static FTransform MakeRandomTransform(FRandomStream& Random)
+{
+	const FQuat Rotation = FRotator(Random.FRandRange(-180.0f, 180.0f), Random.FRandRange(-180.0f, 180.0f), Random.FRandRange(-180.0f, 180.0f)).Quaternion();
+	const FVector Translation(Random.FRandRange(-20000.0f, 20000.0f), Random.FRandRange(-20000.0f, 20000.0f), Random.FRandRange(-2000.0f, 2000.0f));
+
+	// Mostly flat decals like bullet holes and grime, some projected volumes
+	const bool bFlat = Random.FRand() < 0.8f;
+	const FVector Scale(bFlat ? Random.FRandRange(1.0f, 8.0f) : Random.FRandRange(50.0f, 500.0f), Random.FRandRange(10.0f, 200.0f), Random.FRandRange(10.0f, 200.0f));
+
+	return FTransform(Rotation, Translation, Scale);
+}
+
+/** Frustum looking down +X from the origin, with a 90 degree FOV and a far plane. Points are outside when PlaneDot > 0, same as the view frustum. */
+static FConvexVolume MakeFrustum(float FarDistance)
+{
+	FConvexVolume Frustum;
+	Frustum.Planes.Add(FPlane(FVector(-1.0f, 1.0f, 0.0f).GetSafeNormal(), 0.0f));
+	Frustum.Planes.Add(FPlane(FVector(-1.0f, -1.0f, 0.0f).GetSafeNormal(), 0.0f));
+	Frustum.Planes.Add(FPlane(FVector(-1.0f, 0.0f, 1.0f).GetSafeNormal(), 0.0f));
+	Frustum.Planes.Add(FPlane(FVector(-1.0f, 0.0f, -1.0f).GetSafeNormal(), 0.0f));
+	Frustum.Planes.Add(FPlane(FVector(1.0f, 0.0f, 0.0f), FarDistance));
+	Frustum.Init();
+	return Frustum;
+}
+
+/** Reference culling data, as the per view decal setup computed it for every decal. */
+struct FReferenceCullingData
+{
+	FVector Origin;
+	float ConservativeRadius;
+	float MaxAxisScale;
+	FVector Corners[8];
+};
+
+static FReferenceCullingData ComputeReferenceCullingData(const FTransform& ComponentTrans)
+{
+	const FMatrix ComponentToWorldMatrix = ComponentTrans.ToMatrixWithScale();
+
+	FReferenceCullingData Data;
+	Data.Origin = ComponentToWorldMatrix.GetOrigin();
+	Data.ConservativeRadius = FMath::Sqrt(
+		ComponentToWorldMatrix.GetScaledAxis(EAxis::X).SizeSquared() +
+		ComponentToWorldMatrix.GetScaledAxis(EAxis::Y).SizeSquared() +
+		ComponentToWorldMatrix.GetScaledAxis(EAxis::Z).SizeSquared());
+	Data.MaxAxisScale = ComponentToWorldMatrix.GetMaximumAxisScale();
+
+	for (int32 CornerIndex = 0; CornerIndex < 8; ++CornerIndex)
+	{
+		const FVector LocalCorner((CornerIndex & 1) ? 1.0 : -1.0, (CornerIndex & 2) ? 1.0 : -1.0, (CornerIndex & 4) ? 1.0 : -1.0);
+		Data.Corners[CornerIndex] = ComponentToWorldMatrix.TransformPosition(LocalCorner);
+	}
+	return Data;
+}
+
+static bool AreAllCornersOutsideAPlane(const FConvexVolume& Frustum, const FReferenceCullingData& Data)
+{
+	for (const FPlane& Plane : Frustum.Planes)
+	{
+		bool bAllOutside = true;
+		for (const FVector& Corner : Data.Corners)
+		{
+			bAllOutside &= Plane.PlaneDot(Corner) > 0.0;
+		}
+		if (bAllOutside)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/** Sort inputs of a relevant decal, the fields DecalRendering::SortDecalList looks at. */
+struct FSortableDecal
+{
+	uint32 SortOrder;
+	FDecalBlendDesc BlendDesc;
+	const FMaterialRenderProxy* MaterialProxy;
+	uintptr_t Component;
+};
+
+/** Reference sort, same comparator as DecalRendering::SortDecalList. */
+static void ReferenceSort(TArray<const FSortableDecal*>& Decals)
+{
+	Decals.Sort([](const FSortableDecal& A, const FSortableDecal& B)
+	{
+		if (B.SortOrder != A.SortOrder)
+		{
+			return A.SortOrder < B.SortOrder;
+		}
+		if (B.BlendDesc.bWriteNormal != A.BlendDesc.bWriteNormal)
+		{
+			return B.BlendDesc.bWriteNormal < A.BlendDesc.bWriteNormal;
+		}
+		if (B.BlendDesc.Packed != A.BlendDesc.Packed)
+		{
+			return (int32)B.BlendDesc.Packed < (int32)A.BlendDesc.Packed;
+		}
+		if (B.MaterialProxy != A.MaterialProxy)
+		{
+			return B.MaterialProxy < A.MaterialProxy;
+		}
+		return B.Component < A.Component;
+	});
+}
+
+/** Sort in batch order as FDecalSceneCache::UpdateBatchOrder, then stable radix sort on the key as DecalRendering::BuildRelevantDecalList. */
+static void BatchOrderRadixSort(TArray<const FSortableDecal*>& Decals)
+{
+	Decals.Sort([](const FSortableDecal& A, const FSortableDecal& B)
+	{
+		if (B.MaterialProxy != A.MaterialProxy)
+		{
+			return B.MaterialProxy < A.MaterialProxy;
+		}
+		return B.Component < A.Component;
+	});
+
+	struct FSortEntry
+	{
+		uint64 Key;
+		const FSortableDecal* Decal;
+	};
+
+	TArray<FSortEntry> SortEntries;
+	for (const FSortableDecal* Decal : Decals)
+	{
+		SortEntries.Add({ DecalRendering::GetSortKey(Decal->SortOrder, Decal->BlendDesc), Decal });
+	}
+
+	TArray<FSortEntry> SortedEntries;
+	SortedEntries.SetNumUninitialized(SortEntries.Num());
+	RadixSort32(SortedEntries.GetData(), SortEntries.GetData(), SortEntries.Num(), [](const FSortEntry& Entry) { return uint32(Entry.Key); });
+	RadixSort32(SortEntries.GetData(), SortedEntries.GetData(), SortedEntries.Num(), [](const FSortEntry& Entry) { return uint32(Entry.Key >> 32); });
+
+	for (int32 Index = 0; Index < SortEntries.Num(); ++Index)
+	{
+		Decals[Index] = SortEntries[Index].Decal;
+	}
+}
+
+} // DecalSceneCacheTestbed
+
+bool FDecalSceneCacheTestbed::RunTest(const FString& Parameters)
+{
+	using namespace DecalSceneCacheTestbed;
+
+	const int32 NumDecals = 20000;
+	FRandomStream Random(0x44434C53);
+
+	TArray<FTransform> Transforms;
+	TArray<const FDeferredDecalProxy*> Proxies;
+	FDecalSceneCache DecalSceneCache;
+	for (int32 Index = 0; Index < NumDecals; ++Index)
+	{
+		Transforms.Add(MakeRandomTransform(Random));
+		Proxies.Add(MakeProxy(Index));
+		DecalSceneCache.Add(Proxies.Last(), Transforms.Last());
+	}
+
+	// Remove and move some decals, the cache stays index parallel with the transforms
+	for (int32 Iteration = 0; Iteration < 1000; ++Iteration)
+	{
+		const int32 Index = Random.RandRange(0, Transforms.Num() - 1);
+		if (Iteration & 1)
+		{
+			Transforms[Index] = MakeRandomTransform(Random);
+			DecalSceneCache.UpdateTransform(Index, Transforms[Index]);
+		}
+		else
+		{
+			Transforms.RemoveAtSwap(Index);
+			Proxies.RemoveAtSwap(Index);
+			DecalSceneCache.RemoveAtSwap(Index);
+		}
+	}
+	TestEqual(TEXT("Decal count"), DecalSceneCache.Num(), Transforms.Num());
+
+	bool bIndicesMatch = true;
+	for (int32 Index = 0; Index < Proxies.Num(); ++Index)
+	{
+		bIndicesMatch &= DecalSceneCache.FindIndex(Proxies[Index]) == Index;
+	}
+	TestTrue(TEXT("Decal indices follow the removals"), bIndicesMatch);
+	TestEqual(TEXT("Decal not in the scene isn't found"), DecalSceneCache.FindIndex(MakeProxy(NumDecals)), int32(INDEX_NONE));
+
+	TArray<FReferenceCullingData> ReferenceData;
+	bool bCullingDataMatches = true;
+	for (int32 Index = 0; Index < Transforms.Num(); ++Index)
+	{
+		const FReferenceCullingData& Data = ReferenceData.Add_GetRef(ComputeReferenceCullingData(Transforms[Index]));
+		bCullingDataMatches &= DecalSceneCache.GetOrigin(Index) == Data.Origin;
+		bCullingDataMatches &= DecalSceneCache.GetConservativeRadius(Index) == Data.ConservativeRadius;
+		bCullingDataMatches &= DecalSceneCache.GetMaxAxisScale(Index) == Data.MaxAxisScale;
+	}
+	TestTrue(TEXT("Cached culling data is the same as the per view data"), bCullingDataMatches);
+
+	const FConvexVolume Frustum = MakeFrustum(15000.0f);
+
+	// Sphere culling gives the same decals as the per view sphere test, the oriented box only removes decals that are fully outside a plane
+	{
+		FSceneBitArray SphereVisible;
+		FSceneBitArray BoxVisible;
+		DecalSceneCache.Cull(Frustum, nullptr, false, SphereVisible);
+		DecalSceneCache.Cull(Frustum, nullptr, true, BoxVisible);
+
+		bool bSphereMatches = true;
+		bool bBoxMatches = true;
+		int32 NumSphereVisible = 0;
+		int32 NumBoxVisible = 0;
+
+		for (int32 Index = 0; Index < Transforms.Num(); ++Index)
+		{
+			const FReferenceCullingData& Data = ReferenceData[Index];
+			const bool bReferenceSphereVisible = Data.ConservativeRadius >= SMALL_NUMBER && Frustum.IntersectSphere(Data.Origin, Data.ConservativeRadius);
+			const bool bReferenceBoxVisible = bReferenceSphereVisible && !AreAllCornersOutsideAPlane(Frustum, Data);
+
+			bSphereMatches &= SphereVisible[Index] == bReferenceSphereVisible;
+			bBoxMatches &= BoxVisible[Index] == bReferenceBoxVisible;
+			NumSphereVisible += SphereVisible[Index] ? 1 : 0;
+			NumBoxVisible += BoxVisible[Index] ? 1 : 0;
+		}
+
+		TestTrue(TEXT("Sphere culling matches the per view sphere test"), bSphereMatches);
+		TestTrue(TEXT("Oriented box culling removes exactly the decals fully outside a plane"), bBoxMatches);
+		AddInfo(FString::Printf(TEXT("%d decals: %d visible with sphere culling, %d with oriented box culling"), Transforms.Num(), NumSphereVisible, NumBoxVisible));
+	}
+
+	// Instanced stereo view: visible in either frustum
+	{
+		FConvexVolume OffsetFrustum = MakeFrustum(15000.0f);
+		const FVector Offset(0.0f, 5000.0f, 0.0f);
+		for (FPlane& Plane : OffsetFrustum.Planes)
+		{
+			Plane = FPlane(Plane.GetNormal(), Plane.W + FVector::DotProduct(Plane.GetNormal(), Offset));
+		}
+		OffsetFrustum.Init();
+
+		FSceneBitArray FirstVisible;
+		FSceneBitArray SecondVisible;
+		FSceneBitArray BothVisible;
+		DecalSceneCache.Cull(Frustum, nullptr, true, FirstVisible);
+		DecalSceneCache.Cull(OffsetFrustum, nullptr, true, SecondVisible);
+		DecalSceneCache.Cull(Frustum, &OffsetFrustum, true, BothVisible);
+
+		bool bUnionMatches = true;
+		for (int32 Index = 0; Index < Transforms.Num(); ++Index)
+		{
+			bUnionMatches &= BothVisible[Index] == (FirstVisible[Index] || SecondVisible[Index]);
+		}
+		TestTrue(TEXT("Instanced view culling is the union of both views"), bUnionMatches);
+	}
+
+	// Sort: batch order and radix sort on the key give the same list as the comparison sort
+	{
+		TArray<const FMaterialRenderProxy*> Materials;
+		for (int32 Index = 0; Index < 24; ++Index)
+		{
+			Materials.Add(reinterpret_cast<const FMaterialRenderProxy*>(UPTRINT(Random.RandRange(1, 1 << 20)) * 16));
+		}
+
+		TArray<FSortableDecal> SortableDecals;
+		for (int32 Index = 0; Index < Transforms.Num(); ++Index)
+		{
+			FSortableDecal& Decal = SortableDecals.AddDefaulted_GetRef();
+
+			// Mostly the default sort order, and a few negative ones which compare as large unsigned values
+			const int32 SortOrder = Random.FRand() < 0.8f ? 0 : Random.RandRange(-4, 4);
+			Decal.SortOrder = uint32(SortOrder);
+			Decal.BlendDesc.BlendMode = Random.RandRange(0, 4);
+			Decal.BlendDesc.RenderStageMask = Random.RandRange(1, 255);
+			Decal.BlendDesc.bWriteBaseColor = Random.RandRange(0, 1);
+			Decal.BlendDesc.bWriteNormal = Random.RandRange(0, 1);
+			Decal.BlendDesc.bWriteRoughnessSpecularMetallic = Random.RandRange(0, 1);
+			Decal.BlendDesc.bWriteEmissive = Random.RandRange(0, 1);
+			Decal.MaterialProxy = Materials[Random.RandRange(0, Materials.Num() - 1)];
+			Decal.Component = UPTRINT(Index + 1) * 64;
+		}
+
+		TArray<const FSortableDecal*> ReferenceList;
+		for (const FSortableDecal& Decal : SortableDecals)
+		{
+			ReferenceList.Add(&Decal);
+		}
+		TArray<const FSortableDecal*> RadixList = ReferenceList;
+
+		const uint64 Time0 = FPlatformTime::Cycles64();
+		ReferenceSort(ReferenceList);
+		const uint64 Time1 = FPlatformTime::Cycles64();
+		BatchOrderRadixSort(RadixList);
+		const uint64 Time2 = FPlatformTime::Cycles64();
+
+		TestTrue(TEXT("Radix sorted list matches the comparison sorted list"), RadixList == ReferenceList);
+		AddInfo(FString::Printf(TEXT("Sort %d decals: comparison %.3fms, batch order and radix %.3fms (the batch order is only sorted when decals are added or removed)"),
+			ReferenceList.Num(),
+			FPlatformTime::ToMilliseconds64(Time1 - Time0),
+			FPlatformTime::ToMilliseconds64(Time2 - Time1)));
+	}
+
+	// Benchmark: per view matrix rebuild and sphere test of every decal, against the cached culling data
+	{
+		const int32 NumIterations = 16;
+		int32 NumReferenceVisible = 0;
+		int32 NumCachedVisible = 0;
+
+		const uint64 Time0 = FPlatformTime::Cycles64();
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			for (const FTransform& Transform : Transforms)
+			{
+				const FMatrix ComponentToWorldMatrix = Transform.ToMatrixWithScale();
+				const float ConservativeRadius = FMath::Sqrt(
+					ComponentToWorldMatrix.GetScaledAxis(EAxis::X).SizeSquared() +
+					ComponentToWorldMatrix.GetScaledAxis(EAxis::Y).SizeSquared() +
+					ComponentToWorldMatrix.GetScaledAxis(EAxis::Z).SizeSquared());
+				NumReferenceVisible += (ConservativeRadius >= SMALL_NUMBER && Frustum.IntersectSphere(ComponentToWorldMatrix.GetOrigin(), ConservativeRadius)) ? 1 : 0;
+			}
+		}
+		const uint64 Time1 = FPlatformTime::Cycles64();
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			FSceneBitArray Visible;
+			DecalSceneCache.Cull(Frustum, nullptr, true, Visible);
+			NumCachedVisible += Visible.CountSetBits();
+		}
+		const uint64 Time2 = FPlatformTime::Cycles64();
+
+		TestTrue(TEXT("Oriented box culling doesn't add decals"), NumCachedVisible <= NumReferenceVisible);
+		AddInfo(FString::Printf(TEXT("Cull %d decals: per view matrices and spheres %.3fms, cached spheres and oriented boxes %.3fms (per view)"),
+			Transforms.Num(),
+			FPlatformTime::ToMilliseconds64(Time1 - Time0) / NumIterations,
+			FPlatformTime::ToMilliseconds64(Time2 - Time1) / NumIterations));
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
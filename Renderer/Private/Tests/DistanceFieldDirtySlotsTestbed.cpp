@@ -0,0 +1,192 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "ScenePrivate.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDistanceFieldDirtySlotsTestbed, "System.Renderer.DistanceFields.DirtyObjectSlots", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace DistanceFieldDirtySlotsTestbed
+{
+
+/** Previous tracking (array for iteration, set against duplicates), as a reference. */
+struct FLegacyDirtySlots
+{
+	TArray<int32> Indices;
+	TSet<int32> IndicesSet;
+
+	void MarkDirty(int32 Index)
+	{
+		if (!IndicesSet.Contains(Index))
+		{
+			Indices.Add(Index);
+			IndicesSet.Add(Index);
+		}
+	}
+
+	void Extract(int32 NumValidSlots, TArray<int32>& OutIndices)
+	{
+		OutIndices.Reset();
+		for (int32 Index : Indices)
+		{
+			if (Index < NumValidSlots)
+			{
+				OutIndices.Add(Index);
+			}
+		}
+		Indices.Reset();
+		IndicesSet.Reset();
+	}
+};
+
+/** Synthetic spawn / despawn churn on a compacted object buffer, same slot reuse as RemoveDistanceFieldInstance (swap with the last slot). */
+struct FChurn
+{
+	int32 NumSlots = 0;
+
+	template<typename MarkFunctionType>
+	void Tick(FRandomStream& Random, int32 NumRemoves, int32 NumAdds, int32 NumUpdates, MarkFunctionType&& MarkDirty)
+	{
+		for (int32 RemoveIndex = 0; RemoveIndex < NumRemoves && NumSlots > 0; ++RemoveIndex)
+		{
+			--NumSlots;
+			MarkDirty(Random.RandRange(0, NumSlots));
+		}
+
+		for (int32 AddIndex = 0; AddIndex < NumAdds; ++AddIndex)
+		{
+			MarkDirty(NumSlots++);
+		}
+
+		for (int32 UpdateIndex = 0; UpdateIndex < NumUpdates && NumSlots > 0; ++UpdateIndex)
+		{
+			MarkDirty(Random.RandRange(0, NumSlots - 1));
+		}
+	}
+};
+
+static void ExpandRanges(const TArray<FDistanceFieldDirtyObjectSlots::FRange, SceneRenderingAllocator>& Ranges, TArray<int32>& OutIndices)
+{
+	OutIndices.Reset();
+	for (const FDistanceFieldDirtyObjectSlots::FRange& Range : Ranges)
+	{
+		for (int32 Index = Range.Start; Index < Range.Start + Range.Count; ++Index)
+		{
+			OutIndices.Add(Index);
+		}
+	}
+}
+
+} // DistanceFieldDirtySlotsTestbed
+
+bool FDistanceFieldDirtySlotsTestbed::RunTest(const FString& Parameters)
+{
+	using namespace DistanceFieldDirtySlotsTestbed;
+
+	// Upload limit, the remaining slots stay dirty for the next extraction
+	{
+		FDistanceFieldDirtyObjectSlots DirtySlots;
+		for (int32 Index : { 9, 3, 4, 5, 20, 3, 40 })
+		{
+			DirtySlots.MarkDirty(Index);
+		}
+		TestEqual(TEXT("Duplicates are counted once"), DirtySlots.Num(), 6);
+
+		TArray<FDistanceFieldDirtyObjectSlots::FRange, SceneRenderingAllocator> Ranges;
+		TestEqual(TEXT("Limited extraction"), DirtySlots.ExtractRanges(30, 4, 0.0f, Ranges), 4);
+		TestTrue(TEXT("Adjacent slots are coalesced"), Ranges.Num() == 2 && Ranges[0].Start == 3 && Ranges[0].Count == 3 && Ranges[1].Start == 9 && Ranges[1].Count == 1);
+		TestTrue(TEXT("Remaining slots stay dirty"), DirtySlots.IsDirty(20) && DirtySlots.IsDirty(40) && !DirtySlots.IsDirty(3));
+
+		TestEqual(TEXT("Freed slots are not uploaded"), DirtySlots.ExtractRanges(30, 4, 0.0f, Ranges), 1);
+		TestEqual(TEXT("Everything extracted"), DirtySlots.Num(), 0);
+
+		DirtySlots.MarkDirty(1);
+		DirtySlots.MarkDirty(6);
+		TestEqual(TEXT("Full upload above the density threshold"), DirtySlots.ExtractRanges(8, 100, 0.25f, Ranges), 8);
+		TestTrue(TEXT("Full upload is a single range"), Ranges.Num() == 1 && Ranges[0].Start == 0 && Ranges[0].Count == 8 && DirtySlots.Num() == 0);
+	}
+
+	struct FChurnDesc
+	{
+		const TCHAR* Name;
+		int32 InitialSlots;
+		int32 NumRemoves;
+		int32 NumAdds;
+		int32 NumUpdates;
+	};
+	const FChurnDesc ChurnDescs[] =
+	{
+		{ TEXT("Mass spawn"),		0,			0,		100000,	0 },
+		{ TEXT("Steady churn"),		200000,		2000,	2000,	500 },
+		{ TEXT("Mass despawn"),		200000,		50000,	0,		0 },
+		{ TEXT("Sparse updates"),	500000,		0,		0,		1000 },
+	};
+
+	const int32 NumFrames = 16;
+	for (const FChurnDesc& Desc : ChurnDescs)
+	{
+		FRandomStream Random(0xdf5);
+		FChurn Churn;
+		Churn.NumSlots = Desc.InitialSlots;
+
+		FDistanceFieldDirtyObjectSlots DirtySlots;
+		FLegacyDirtySlots LegacyDirtySlots;
+
+		TArray<int32> MarkedIndices;
+		TArray<int32> Indices;
+		TArray<int32> LegacyIndices;
+		TArray<FDistanceFieldDirtyObjectSlots::FRange, SceneRenderingAllocator> Ranges;
+
+		uint64 Cycles = 0;
+		uint64 LegacyCycles = 0;
+		int64 NumUploads = 0;
+		int64 NumRanges = 0;
+		bool bMatches = true;
+
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			MarkedIndices.Reset();
+			Churn.Tick(Random, Desc.NumRemoves, Desc.NumAdds, Desc.NumUpdates, [&MarkedIndices](int32 Index) { MarkedIndices.Add(Index); });
+
+			const uint64 Time0 = FPlatformTime::Cycles64();
+			for (int32 Index : MarkedIndices)
+			{
+				LegacyDirtySlots.MarkDirty(Index);
+			}
+			LegacyDirtySlots.Extract(Churn.NumSlots, LegacyIndices);
+
+			const uint64 Time1 = FPlatformTime::Cycles64();
+			for (int32 Index : MarkedIndices)
+			{
+				DirtySlots.MarkDirty(Index);
+			}
+			NumUploads += DirtySlots.ExtractRanges(Churn.NumSlots, MAX_int32, 0.0f, Ranges);
+			const uint64 Time2 = FPlatformTime::Cycles64();
+
+			LegacyCycles += Time1 - Time0;
+			Cycles += Time2 - Time1;
+			NumRanges += Ranges.Num();
+
+			// Same slots, in slot order
+			ExpandRanges(Ranges, Indices);
+			LegacyIndices.Sort();
+			bMatches &= Indices == LegacyIndices && DirtySlots.Num() == 0;
+		}
+
+		TestTrue(FString::Printf(TEXT("%s: uploads the same slots as the reference"), Desc.Name), bMatches);
+
+		AddInfo(FString::Printf(TEXT("%s: %.1f uploads in %.1f ranges per frame, bitset %.3fms, array+set %.3fms (per frame)"),
+			Desc.Name,
+			double(NumUploads) / NumFrames,
+			double(NumRanges) / NumFrames,
+			FPlatformTime::ToMilliseconds64(Cycles) / NumFrames,
+			FPlatformTime::ToMilliseconds64(LegacyCycles) / NumFrames));
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
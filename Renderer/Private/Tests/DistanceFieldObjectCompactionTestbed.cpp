@@ -0,0 +1,145 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "ScenePrivate.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDistanceFieldObjectCompactionTestbed, "System.Renderer.DistanceFields.ObjectCompaction", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace DistanceFieldObjectCompactionTestbed
+{
+
+/** Previous removal (one RemoveAtSwap per instance, from the largest slot to the smallest), as a reference. */
+static void RemoveReference(TArray<int32>& Mapping, TArray<int32>& BackPointers, TArray<int32> RemoveIndices)
+{
+	RemoveIndices.Sort(TGreater<int32>());
+
+	for (int32 RemoveIndex : RemoveIndices)
+	{
+		const int32 MoveFromIndex = Mapping.Num() - 1;
+		if (RemoveIndex < MoveFromIndex)
+		{
+			BackPointers[Mapping[MoveFromIndex]] = RemoveIndex;
+		}
+		BackPointers[Mapping[RemoveIndex]] = INDEX_NONE;
+
+		Mapping.RemoveAtSwap(RemoveIndex, EAllowShrinking::No);
+	}
+}
+
+static void RemoveBulk(TArray<int32>& Mapping, TArray<int32>& BackPointers, TArray<int32> RemoveIndices, TArray<int32>& OutDirtySlots)
+{
+	for (int32 RemoveIndex : RemoveIndices)
+	{
+		BackPointers[Mapping[RemoveIndex]] = INDEX_NONE;
+	}
+
+	TArray<FDistanceFieldObjectMove, SceneRenderingAllocator> Moves;
+	BuildDistanceFieldObjectCompaction(RemoveIndices, Mapping.Num(), Moves);
+
+	OutDirtySlots.Reset();
+	for (const FDistanceFieldObjectMove& Move : Moves)
+	{
+		BackPointers[Mapping[Move.From]] = Move.To;
+		Mapping[Move.To] = Mapping[Move.From];
+		OutDirtySlots.Add(Move.To);
+	}
+
+	Mapping.SetNum(Mapping.Num() - RemoveIndices.Num(), EAllowShrinking::No);
+}
+
+} // DistanceFieldObjectCompactionTestbed
+
+bool FDistanceFieldObjectCompactionTestbed::RunTest(const FString& Parameters)
+{
+	using namespace DistanceFieldObjectCompactionTestbed;
+
+	// Fixed layout, removed tail slots are skipped and tail objects moved into removed tail slots are moved again
+	{
+		TArray<int32> RemoveIndices = { 1, 7, 8 };
+		TArray<FDistanceFieldObjectMove, SceneRenderingAllocator> Moves;
+		BuildDistanceFieldObjectCompaction(RemoveIndices, 10, Moves);
+
+		TestTrue(TEXT("Remove indices are sorted"), RemoveIndices == TArray<int32>({ 8, 7, 1 }));
+		TestTrue(TEXT("Single move from the last surviving object"), Moves.Num() == 1 && Moves[0].From == 9 && Moves[0].To == 1);
+	}
+
+	// Random removals, the final mapping and back pointers must match the reference
+	struct FRemoveDesc
+	{
+		const TCHAR* Name;
+		int32 NumObjects;
+		float RemoveFraction;
+	};
+	const FRemoveDesc RemoveDescs[] =
+	{
+		{ TEXT("Few removes"),			100000,		0.001f },
+		{ TEXT("Streaming unload"),		200000,		0.25f },
+		{ TEXT("Level unload"),			200000,		0.9f },
+		{ TEXT("Remove all"),			50000,		1.0f },
+	};
+
+	FRandomStream Random(0x60df);
+	for (const FRemoveDesc& Desc : RemoveDescs)
+	{
+		bool bMatches = true;
+		uint64 Cycles = 0;
+		uint64 ReferenceCycles = 0;
+
+		for (int32 Iteration = 0; Iteration < 8; ++Iteration)
+		{
+			const int32 NumObjects = Random.RandRange(Desc.NumObjects / 2, Desc.NumObjects);
+
+			TArray<int32> Mapping;
+			for (int32 ObjectIndex = 0; ObjectIndex < NumObjects; ++ObjectIndex)
+			{
+				Mapping.Add(ObjectIndex);
+			}
+
+			// Unique random slots, in removal order
+			TArray<int32> Shuffled = Mapping;
+			for (int32 Index = Shuffled.Num() - 1; Index > 0; --Index)
+			{
+				Shuffled.Swap(Index, Random.RandRange(0, Index));
+			}
+			const TArray<int32> RemoveIndices(Shuffled.GetData(), FMath::Min(NumObjects, FMath::CeilToInt32(NumObjects * Desc.RemoveFraction)));
+
+			TArray<int32> ReferenceMapping = Mapping;
+			TArray<int32> ReferenceBackPointers = Mapping;
+			TArray<int32> BackPointers = Mapping;
+			TArray<int32> DirtySlots;
+
+			const uint64 Time0 = FPlatformTime::Cycles64();
+			RemoveReference(ReferenceMapping, ReferenceBackPointers, RemoveIndices);
+			const uint64 Time1 = FPlatformTime::Cycles64();
+			RemoveBulk(Mapping, BackPointers, RemoveIndices, DirtySlots);
+			const uint64 Time2 = FPlatformTime::Cycles64();
+
+			ReferenceCycles += Time1 - Time0;
+			Cycles += Time2 - Time1;
+
+			bMatches &= Mapping == ReferenceMapping && BackPointers == ReferenceBackPointers;
+
+			// Every moved object lands in a removed slot below the new object count
+			TSet<int32> RemovedSlots(RemoveIndices);
+			for (int32 DirtySlot : DirtySlots)
+			{
+				bMatches &= DirtySlot < Mapping.Num() && RemovedSlots.Contains(DirtySlot);
+			}
+		}
+
+		TestTrue(FString::Printf(TEXT("%s: same mapping as the reference"), Desc.Name), bMatches);
+
+		AddInfo(FString::Printf(TEXT("%s: bulk %.3fms, one by one %.3fms (per removal batch)"),
+			Desc.Name,
+			FPlatformTime::ToMilliseconds64(Cycles) / 8,
+			FPlatformTime::ToMilliseconds64(ReferenceCycles) / 8));
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
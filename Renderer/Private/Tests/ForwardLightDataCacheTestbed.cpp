@@ -0,0 +1,345 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Async/ParallelFor.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "ForwardLightDataCache.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FForwardLightDataCacheTestbed, "System.Renderer.LightGrid.ForwardLightDataCache", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace ForwardLightDataCacheTestbed
+{
+
+/** Reference packing, as ComputeLightGrid did it before the cache, for every light of every view. */
+static uint32 ReferencePackRG16(float In0, float In1)
+{
+	return uint32(FFloat16(In0).Encoded) | (uint32(FFloat16(In1).Encoded) << 16);
+}
+
+static uint32 ReferencePackRGB10(float In0, float In1, float In2)
+{
+	return
+		(uint32(FMath::Clamp(In0 * 1023u, 0u, 1023u))      )|
+		(uint32(FMath::Clamp(In1 * 1023u, 0u, 1023u)) << 10)|
+		(uint32(FMath::Clamp(In2 * 1023u, 0u, 1023u)) << 20);
+}
+
+static FVector2f ReferencePackLightColor(const FVector3f& LightColor)
+{
+	FVector3f LightColorDir;
+	float LightColorLength;
+	LightColor.ToDirectionAndLength(LightColorDir, LightColorLength);
+
+	FVector2f LightColorPacked;
+	uint32 LightColorDirPacked =
+		((static_cast<uint32>(LightColorDir.X * 0x3FF) & 0x3FF) <<  0) |
+		((static_cast<uint32>(LightColorDir.Y * 0x3FF) & 0x3FF) << 10) |
+		((static_cast<uint32>(LightColorDir.Z * 0x3FF) & 0x3FF) << 20);
+
+	LightColorPacked.X = LightColorLength / 0x3FF;
+	*(uint32*)(&LightColorPacked.Y) = LightColorDirPacked;
+
+	return LightColorPacked;
+}
+
+static uint32 ReferencePackVirtualShadowMapIdAndPrevLocalLightIndex(int32 VirtualShadowMapId, int32 PrevLocalLightIndex)
+{
+	uint32 VSMPacked = VirtualShadowMapId < 0 ? 0 : uint32(VirtualShadowMapId + 1);
+	uint32 PrevPacked = PrevLocalLightIndex < 0 ? 0 : uint32(PrevLocalLightIndex + 1);
+	return (VSMPacked << 16) | (PrevPacked & 0xFFFF);
+}
+
+static void ReferencePackLightData(
+	FForwardLightData& Out,
+	const FVector& PreViewTranslation,
+	const FLightRenderParameters& LightParameters,
+	const uint32 LightSceneInfoExtraDataPacked,
+	const int32 LightSceneId,
+	const int32 VirtualShadowMapId,
+	const int32 PrevLocalLightIndex,
+	const float VolumetricScatteringIntensity)
+{
+	const FVector3f LightTranslatedWorldPosition(PreViewTranslation + LightParameters.WorldPosition);
+
+	const uint32 PackedW = ReferencePackRG16(LightParameters.SourceLength, VolumetricScatteringIntensity);
+	const uint32 PackedZ = ReferencePackRG16(LightParameters.SourceRadius, LightParameters.SoftSourceRadius);
+
+	uint32 RectPackedX = ReferencePackRG16(LightParameters.RectLightAtlasUVOffset.X, LightParameters.RectLightAtlasUVOffset.Y);
+	uint32 RectPackedY = ReferencePackRG16(LightParameters.RectLightAtlasUVScale.X, LightParameters.RectLightAtlasUVScale.Y);
+	uint32 RectPackedZ = 0;
+	RectPackedZ |= FFloat16(LightParameters.RectLightBarnLength).Encoded;
+	RectPackedZ |= uint32(FMath::Clamp(LightParameters.RectLightBarnCosAngle,  0.f, 1.0f) * 0x3FF) << 16;
+	RectPackedZ |= uint32(FMath::Clamp(LightParameters.RectLightAtlasMaxLevel, 0.f, 63.f)) << 26;
+
+	const uint32 SpecularScale_DiffuseScale_IESData = ReferencePackRGB10(LightParameters.SpecularScale, LightParameters.DiffuseScale, (LightParameters.IESAtlasIndex + 1) * (1.f / 1023.f));
+
+	const FVector2f LightColorPacked = ReferencePackLightColor(FVector3f(LightParameters.Color));
+
+	const uint32 VirtualShadowMapIdAndPrevLocalLightIndex = ReferencePackVirtualShadowMapIdAndPrevLocalLightIndex(VirtualShadowMapId, PrevLocalLightIndex);
+
+	Out.LightPositionAndInvRadius							= FVector4f(LightTranslatedWorldPosition, LightParameters.InvRadius);
+	Out.LightColorAndIdAndFalloffExponent					= FVector4f(LightColorPacked.X, LightColorPacked.Y, LightSceneId, LightParameters.FalloffExponent);
+	Out.LightDirectionAndSceneInfoExtraDataPacked			= FVector4f(LightParameters.Direction, FMath::AsFloat(LightSceneInfoExtraDataPacked));
+	Out.SpotAnglesAndSourceRadiusPacked						= FVector4f(LightParameters.SpotAngles.X, LightParameters.SpotAngles.Y, FMath::AsFloat(PackedZ), FMath::AsFloat(PackedW));
+	Out.LightTangentAndIESDataAndSpecularScale				= FVector4f(LightParameters.Tangent, FMath::AsFloat(SpecularScale_DiffuseScale_IESData));
+	Out.RectDataAndVirtualShadowMapIdOrPrevLocalLightIndex	= FVector4f(FMath::AsFloat(RectPackedX), FMath::AsFloat(RectPackedY), FMath::AsFloat(RectPackedZ), FMath::AsFloat(VirtualShadowMapIdAndPrevLocalLightIndex));
+}
+
+/** Mocked light, stands in for the light scene info and its proxy. */
+struct FMockLight
+{
+	FLightRenderParameters LightParameters;
+	uint32 LightSceneInfoExtraDataPacked = 0;
+	float IndirectLightingScale = 1.0f;
+	float VolumetricScatteringIntensity = 1.0f;
+};
+
+/** Per view state of a light. */
+struct FMockLightView
+{
+	float LightFade = 1.0f;
+	int32 VirtualShadowMapId = INDEX_NONE;
+	int32 PrevForwardLightIndex = INDEX_NONE;
+	bool bDisableVolumetricScattering = false;
+};
+
+struct FMockView
+{
+	FVector PreViewTranslation;
+	float Exposure = 1.0f;
+	bool bIsReflectionCapture = false;
+	TArray<FMockLightView> Lights;
+};
+
+static FMockLight MakeLight(FRandomStream& Random)
+{
+	FMockLight Light;
+	FLightRenderParameters& Parameters = Light.LightParameters;
+
+	Parameters.WorldPosition = FVector(Random.FRandRange(-1.0e6, 1.0e6), Random.FRandRange(-1.0e6, 1.0e6), Random.FRandRange(-1.0e4, 1.0e5));
+	Parameters.InvRadius = 1.0f / Random.FRandRange(10.0f, 5000.0f);
+	Parameters.Color = FLinearColor(Random.FRandRange(0.0f, 100.0f), Random.FRandRange(0.0f, 100.0f), Random.FRandRange(0.0f, 100.0f));
+	Parameters.FalloffExponent = Random.RandRange(0, 1) ? 0.0f : Random.FRandRange(1.0f, 16.0f);
+	Parameters.Direction = FVector3f(Random.GetUnitVector());
+	Parameters.Tangent = FVector3f(Random.GetUnitVector());
+	Parameters.SpotAngles = FVector2f(Random.FRandRange(-1.0f, 1.0f), Random.FRandRange(0.0f, 10.0f));
+	Parameters.SpecularScale = Random.FRand();
+	Parameters.DiffuseScale = Random.FRand();
+	Parameters.SourceRadius = Random.FRandRange(0.0f, 100.0f);
+	Parameters.SoftSourceRadius = Random.FRandRange(0.0f, 100.0f);
+	Parameters.SourceLength = Random.FRandRange(0.0f, 500.0f);
+	Parameters.RectLightBarnCosAngle = Random.FRand();
+	Parameters.RectLightBarnLength = Random.RandRange(0, 1) ? -2.0f : Random.FRandRange(0.0f, 100.0f);
+	Parameters.RectLightAtlasUVOffset = FVector2f(Random.FRand(), Random.FRand());
+	Parameters.RectLightAtlasUVScale = FVector2f(Random.FRand(), Random.FRand());
+	Parameters.RectLightAtlasMaxLevel = float(Random.RandRange(0, 12));
+	Parameters.IESAtlasIndex = float(Random.RandRange(-1, 200));
+	Parameters.InverseExposureBlend = Random.FRand();
+
+	Light.LightSceneInfoExtraDataPacked = Random.GetUnsignedInt();
+	Light.IndirectLightingScale = Random.FRandRange(0.0f, 4.0f);
+	Light.VolumetricScatteringIntensity = Random.FRandRange(0.0f, 4.0f);
+	return Light;
+}
+
+static FMockView MakeView(FRandomStream& Random, int32 NumLights)
+{
+	FMockView View;
+	View.PreViewTranslation = FVector(Random.FRandRange(-1.0e6, 1.0e6), Random.FRandRange(-1.0e6, 1.0e6), Random.FRandRange(-1.0e5, 1.0e5));
+	View.Exposure = Random.FRandRange(0.01f, 10.0f);
+	View.bIsReflectionCapture = Random.RandRange(0, 3) == 0;
+
+	View.Lights.SetNum(NumLights);
+	for (FMockLightView& LightView : View.Lights)
+	{
+		LightView.LightFade = Random.FRand();
+		LightView.VirtualShadowMapId = Random.RandRange(-1, 1000);
+		LightView.PrevForwardLightIndex = Random.RandRange(-1, NumLights);
+		LightView.bDisableVolumetricScattering = Random.RandRange(0, 7) == 0;
+	}
+	return View;
+}
+
+/** Scaled color of a light in a view, in the order ComputeLightGrid applies the scales. */
+static FLinearColor GetViewLightColor(const FMockLight& Light, const FMockView& View, const FMockLightView& LightView)
+{
+	FLightRenderParameters LightParameters = Light.LightParameters;
+	if (View.bIsReflectionCapture)
+	{
+		LightParameters.Color *= Light.IndirectLightingScale;
+	}
+	LightParameters.Color *= LightView.LightFade;
+	LightParameters.Color *= LightParameters.GetLightExposureScale(View.Exposure);
+	return LightParameters.Color;
+}
+
+static void PackReference(const TArray<FMockLight>& Lights, const FMockView& View, TArray<FForwardLightData>& OutData)
+{
+	OutData.SetNumZeroed(Lights.Num());
+	for (int32 LightIndex = 0; LightIndex < Lights.Num(); ++LightIndex)
+	{
+		const FMockLight& Light = Lights[LightIndex];
+		const FMockLightView& LightView = View.Lights[LightIndex];
+
+		FLightRenderParameters LightParameters = Light.LightParameters;
+		LightParameters.Color = GetViewLightColor(Light, View, LightView);
+
+		const float VolumetricScatteringIntensity = LightView.bDisableVolumetricScattering ? 0.0f : Light.VolumetricScatteringIntensity;
+
+		ReferencePackLightData(OutData[LightIndex], View.PreViewTranslation, LightParameters, Light.LightSceneInfoExtraDataPacked, LightIndex, LightView.VirtualShadowMapId, LightView.PrevForwardLightIndex, VolumetricScatteringIntensity);
+	}
+}
+
+static void BuildEntries(const TArray<FMockLight>& Lights, TArray<FForwardLightDataCache::FEntry>& OutEntries)
+{
+	OutEntries.SetNum(Lights.Num());
+	for (int32 LightIndex = 0; LightIndex < Lights.Num(); ++LightIndex)
+	{
+		const FMockLight& Light = Lights[LightIndex];
+		FForwardLightDataCache::FEntry& Entry = OutEntries[LightIndex];
+
+		Entry.LightParameters = Light.LightParameters;
+		Entry.LightSceneInfoExtraDataPacked = Light.LightSceneInfoExtraDataPacked;
+		Entry.PackedW = ReferencePackRG16(Light.LightParameters.SourceLength, Light.VolumetricScatteringIntensity);
+		Entry.PackedWNoVolumetricScattering = ReferencePackRG16(Light.LightParameters.SourceLength, 0.0f);
+		Entry.bValid = true;
+		FForwardLightDataCache::PackViewIndependent(Entry.PackedData, Entry.LightParameters, Entry.LightSceneInfoExtraDataPacked, LightIndex);
+	}
+}
+
+static void PackCached(const TArray<FMockLight>& Lights, const TArray<FForwardLightDataCache::FEntry>& Entries, const FMockView& View, TArray<FForwardLightData>& OutData)
+{
+	TArray<FLinearColor> LightColors;
+	LightColors.SetNumUninitialized(Lights.Num());
+	for (int32 LightIndex = 0; LightIndex < Lights.Num(); ++LightIndex)
+	{
+		LightColors[LightIndex] = GetViewLightColor(Lights[LightIndex], View, View.Lights[LightIndex]);
+	}
+
+	OutData.SetNumZeroed(Lights.Num());
+	ParallelFor(TEXT("ForwardLightDataCacheTestbed"), Lights.Num(), 64, [&](int32 LightIndex)
+	{
+		const FForwardLightDataCache::FEntry& Entry = Entries[LightIndex];
+		const FMockLightView& LightView = View.Lights[LightIndex];
+
+		FForwardLightData& LightData = OutData[LightIndex];
+		LightData = Entry.PackedData;
+
+		FForwardLightDataCache::PatchViewDependent(
+			LightData,
+			View.PreViewTranslation,
+			Entry.LightParameters.WorldPosition,
+			LightColors[LightIndex],
+			LightView.bDisableVolumetricScattering ? Entry.PackedWNoVolumetricScattering : Entry.PackedW,
+			LightView.VirtualShadowMapId,
+			LightView.PrevForwardLightIndex);
+	});
+}
+
+static int32 CountMismatches(const TArray<FForwardLightData>& A, const TArray<FForwardLightData>& B)
+{
+	if (A.Num() != B.Num())
+	{
+		return FMath::Max(A.Num(), B.Num());
+	}
+
+	int32 NumMismatches = 0;
+	for (int32 Index = 0; Index < A.Num(); ++Index)
+	{
+		NumMismatches += FMemory::Memcmp(&A[Index], &B[Index], sizeof(FForwardLightData)) != 0 ? 1 : 0;
+	}
+	return NumMismatches;
+}
+
+} // ForwardLightDataCacheTestbed
+
+bool FForwardLightDataCacheTestbed::RunTest(const FString& Parameters)
+{
+	using namespace ForwardLightDataCacheTestbed;
+
+	const int32 NumLights = 4096;
+	const int32 NumViews = 4;
+	const int32 NumFrames = 8;
+
+	FRandomStream Random(0x4C494748);
+
+	TArray<FMockLight> Lights;
+	for (int32 LightIndex = 0; LightIndex < NumLights; ++LightIndex)
+	{
+		Lights.Add(MakeLight(Random));
+	}
+
+	TArray<FForwardLightDataCache::FEntry> Entries;
+	BuildEntries(Lights, Entries);
+
+	TArray<FForwardLightData> ReferenceData;
+	TArray<FForwardLightData> CachedData;
+	int32 NumMismatches = 0;
+	uint64 ReferenceCycles = 0;
+	uint64 CachedCycles = 0;
+
+	for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+	{
+		// Lights updated between frames: the cache rebuilds them, as after a light scene update or an atlas slot change
+		for (int32 Update = 0; Update < NumLights / 16; ++Update)
+		{
+			const int32 LightIndex = Random.RandRange(0, NumLights - 1);
+			Lights[LightIndex] = MakeLight(Random);
+		}
+		BuildEntries(Lights, Entries);
+
+		for (int32 ViewIndex = 0; ViewIndex < NumViews; ++ViewIndex)
+		{
+			const FMockView View = MakeView(Random, NumLights);
+
+			const uint64 Time0 = FPlatformTime::Cycles64();
+			PackReference(Lights, View, ReferenceData);
+			const uint64 Time1 = FPlatformTime::Cycles64();
+			PackCached(Lights, Entries, View, CachedData);
+			const uint64 Time2 = FPlatformTime::Cycles64();
+
+			ReferenceCycles += Time1 - Time0;
+			CachedCycles += Time2 - Time1;
+
+			NumMismatches += CountMismatches(ReferenceData, CachedData);
+		}
+	}
+
+	TestEqual(TEXT("Cached forward light data matches the per view packing"), NumMismatches, 0);
+
+	// Edge cases: black lights, no volumetric scattering and INDEX_NONE ids
+	{
+		TArray<FMockLight> EdgeLights;
+		EdgeLights.Add(MakeLight(Random));
+		EdgeLights.Last().LightParameters.Color = FLinearColor::Black;
+		EdgeLights.Add(MakeLight(Random));
+		EdgeLights.Last().VolumetricScatteringIntensity = 0.0f;
+		EdgeLights.Last().LightParameters.IESAtlasIndex = INDEX_NONE;
+
+		TArray<FForwardLightDataCache::FEntry> EdgeEntries;
+		BuildEntries(EdgeLights, EdgeEntries);
+
+		FMockView View = MakeView(Random, EdgeLights.Num());
+		for (FMockLightView& LightView : View.Lights)
+		{
+			LightView.VirtualShadowMapId = INDEX_NONE;
+			LightView.PrevForwardLightIndex = INDEX_NONE;
+		}
+
+		PackReference(EdgeLights, View, ReferenceData);
+		PackCached(EdgeLights, EdgeEntries, View, CachedData);
+		TestEqual(TEXT("Edge cases match the per view packing"), CountMismatches(ReferenceData, CachedData), 0);
+	}
+
+	AddInfo(FString::Printf(TEXT("%d lights, %d views, %d frames: per view packing %.2fms, cached %.2fms"),
+		NumLights, NumViews, NumFrames,
+		FPlatformTime::ToMilliseconds64(ReferenceCycles),
+		FPlatformTime::ToMilliseconds64(CachedCycles)));
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
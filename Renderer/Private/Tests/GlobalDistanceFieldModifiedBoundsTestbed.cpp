@@ -0,0 +1,222 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "GlobalDistanceField.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGlobalDistanceFieldModifiedBoundsTestbed, "System.Renderer.GlobalDistanceField.ModifiedBounds", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace GlobalDistanceFieldModifiedBoundsTestbed
+{
+
+static const double PageSize = 100.0;
+static const double InfluenceRadius = 50.0;
+static const FBox ClipmapBounds(FVector(-1600.0), FVector(1600.0));
+
+static FBox RandomBox(FRandomStream& Random, const FVector& Center, double Spread, double MaxExtent)
+{
+	const FVector BoxCenter = Center + FVector(Random.FRandRange(-Spread, Spread), Random.FRandRange(-Spread, Spread), Random.FRandRange(-Spread, Spread));
+	const FVector BoxExtent(Random.FRandRange(1.0, MaxExtent), Random.FRandRange(1.0, MaxExtent), Random.FRandRange(1.0, MaxExtent));
+	return FBox(BoxCenter - BoxExtent, BoxCenter + BoxExtent);
+}
+
+/** Returns true if every sample point of the box (clamped to the clipmap) is inside one of the update bounds. */
+static bool IsCovered(const FBox& Box, const TArray<FBox>& UpdateBounds)
+{
+	const FBox ClampedBox(
+		FVector::Max(FVector::Min(Box.Min, ClipmapBounds.Max), ClipmapBounds.Min),
+		FVector::Max(FVector::Min(Box.Max, ClipmapBounds.Max), ClipmapBounds.Min));
+
+	const int32 NumSamples = 4;
+	for (int32 Z = 0; Z <= NumSamples; ++Z)
+	{
+		for (int32 Y = 0; Y <= NumSamples; ++Y)
+		{
+			for (int32 X = 0; X <= NumSamples; ++X)
+			{
+				const FVector Point = ClampedBox.Min + (ClampedBox.Max - ClampedBox.Min) * FVector(X, Y, Z) / NumSamples;
+
+				bool bPointCovered = false;
+				for (const FBox& Bounds : UpdateBounds)
+				{
+					bPointCovered |= Bounds.ExpandBy(KINDA_SMALL_NUMBER).IsInsideOrOn(Point);
+				}
+
+				if (!bPointCovered)
+				{
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+static bool AreDisjointAndInside(const TArray<FBox>& UpdateBounds)
+{
+	for (int32 IndexA = 0; IndexA < UpdateBounds.Num(); ++IndexA)
+	{
+		if (!ClipmapBounds.ExpandBy(KINDA_SMALL_NUMBER).IsInside(UpdateBounds[IndexA]))
+		{
+			return false;
+		}
+
+		for (int32 IndexB = IndexA + 1; IndexB < UpdateBounds.Num(); ++IndexB)
+		{
+			// Boxes may share faces, but not volume
+			const FBox Overlap = UpdateBounds[IndexA].Overlap(UpdateBounds[IndexB]);
+			if (Overlap.IsValid && Overlap.GetVolume() > KINDA_SMALL_NUMBER)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+} // GlobalDistanceFieldModifiedBoundsTestbed
+
+bool FGlobalDistanceFieldModifiedBoundsTestbed::RunTest(const FString& Parameters)
+{
+	using namespace GlobalDistanceFieldModifiedBoundsTestbed;
+
+	// Repeated modifications of the same region are deduplicated
+	{
+		FGlobalDistanceFieldModifiedBounds ModifiedBounds;
+		TArray<FBox> Events;
+		for (int32 EventIndex = 0; EventIndex < 500; ++EventIndex)
+		{
+			Events.Add(FBox(FVector(210.0, 10.0, -90.0), FVector(290.0, 190.0, -10.0)));
+		}
+		ModifiedBounds.Add(Events, PageSize);
+
+		TArray<FBox> UpdateBounds;
+		TestEqual(TEXT("Duplicates are merged on arrival"), ModifiedBounds.Num(), 1);
+		TestTrue(TEXT("Duplicates fit the budget"), ModifiedBounds.BuildUpdateBounds(ClipmapBounds, InfluenceRadius, 1024, UpdateBounds));
+		TestTrue(TEXT("Snapped to the page grid"), UpdateBounds.Num() == 1 && UpdateBounds[0].Equals(FBox(FVector(200.0, 0.0, -100.0), FVector(300.0, 200.0, 0.0))));
+	}
+
+	// Far away modifications are culled, modifications within the influence radius are clamped to the clipmap
+	{
+		FGlobalDistanceFieldModifiedBounds ModifiedBounds;
+		const FBox Events[] =
+		{
+			FBox(FVector(5000.0), FVector(5100.0)),
+			FBox(FVector(1610.0, 0.0, 0.0), FVector(1620.0, 10.0, 10.0)),
+		};
+		ModifiedBounds.Add(Events, PageSize);
+
+		TArray<FBox> UpdateBounds;
+		TestTrue(TEXT("Culling fits the budget"), ModifiedBounds.BuildUpdateBounds(ClipmapBounds, InfluenceRadius, 1024, UpdateBounds));
+		TestTrue(TEXT("Only the modification within the influence radius is kept"), UpdateBounds.Num() == 1 && UpdateBounds[0].Equals(FBox(FVector(1500.0, 0.0, 0.0), FVector(1600.0, 100.0, 100.0))));
+	}
+
+	// Page size changes can't be merged
+	{
+		FGlobalDistanceFieldModifiedBounds ModifiedBounds;
+		const FBox Events[] = { FBox(FVector(0.0), FVector(10.0)) };
+		ModifiedBounds.Add(Events, PageSize);
+		ModifiedBounds.Add(Events, PageSize * 2.0);
+
+		TArray<FBox> UpdateBounds;
+		TestFalse(TEXT("Page size change requires a full update"), ModifiedBounds.BuildUpdateBounds(ClipmapBounds, InfluenceRadius, 1024, UpdateBounds));
+
+		ModifiedBounds.Reset();
+		ModifiedBounds.Add(Events, PageSize * 2.0);
+		TestTrue(TEXT("Reset clears the overflow"), ModifiedBounds.BuildUpdateBounds(ClipmapBounds, InfluenceRadius, 1024, UpdateBounds) && UpdateBounds.Num() == 1);
+	}
+
+	// A checkerboard of pages can't be merged, and exceeds a small budget
+	{
+		FGlobalDistanceFieldModifiedBounds ModifiedBounds;
+		TArray<FBox> Events;
+		for (int32 X = 0; X < 8; ++X)
+		{
+			for (int32 Y = 0; Y < 8; ++Y)
+			{
+				if ((X + Y) & 1)
+				{
+					Events.Add(FBox(FVector(X * PageSize + 10.0, Y * PageSize + 10.0, 10.0), FVector(X * PageSize + 90.0, Y * PageSize + 90.0, 90.0)));
+				}
+			}
+		}
+		ModifiedBounds.Add(Events, PageSize);
+
+		TArray<FBox> UpdateBounds;
+		TestFalse(TEXT("Over budget requires a full update"), ModifiedBounds.BuildUpdateBounds(ClipmapBounds, InfluenceRadius, 16, UpdateBounds));
+		TestTrue(TEXT("Within budget"), ModifiedBounds.BuildUpdateBounds(ClipmapBounds, InfluenceRadius, 32, UpdateBounds) && UpdateBounds.Num() == 32);
+	}
+
+	// Synthetic event streams, the update bounds must cover every relevant modification
+	struct FStreamDesc
+	{
+		const TCHAR* Name;
+		int32 NumClusters;
+		int32 NumEventsPerCluster;
+		double ClusterSpread;
+		double MaxExtent;
+	};
+	const FStreamDesc StreamDescs[] =
+	{
+		{ TEXT("Destruction"),		4,		2000,	150.0,	40.0 },
+		{ TEXT("Scattered debris"),	200,	20,		50.0,	20.0 },
+		{ TEXT("Large movers"),		16,		8,		300.0,	400.0 },
+	};
+
+	FRandomStream Random(0x6df);
+	for (const FStreamDesc& Desc : StreamDescs)
+	{
+		FGlobalDistanceFieldModifiedBounds ModifiedBounds;
+		TArray<FBox> Events;
+
+		// Events arrive over a few frames
+		const int32 NumFrames = 4;
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			TArray<FBox> FrameEvents;
+			for (int32 ClusterIndex = 0; ClusterIndex < Desc.NumClusters; ++ClusterIndex)
+			{
+				FRandomStream ClusterRandom(ClusterIndex * 7919);
+				const FVector ClusterCenter(ClusterRandom.FRandRange(-2000.0, 2000.0), ClusterRandom.FRandRange(-2000.0, 2000.0), ClusterRandom.FRandRange(-2000.0, 2000.0));
+
+				for (int32 EventIndex = 0; EventIndex < Desc.NumEventsPerCluster / NumFrames; ++EventIndex)
+				{
+					FrameEvents.Add(RandomBox(Random, ClusterCenter, Desc.ClusterSpread, Desc.MaxExtent));
+				}
+			}
+			ModifiedBounds.Add(FrameEvents, PageSize);
+			Events.Append(FrameEvents);
+		}
+
+		TArray<FBox> UpdateBounds;
+		const bool bFitsBudget = ModifiedBounds.BuildUpdateBounds(ClipmapBounds, InfluenceRadius, MAX_int32, UpdateBounds);
+
+		int32 NumCulledEvents = 0;
+		bool bCovered = true;
+		for (const FBox& Event : Events)
+		{
+			if (Event.ComputeSquaredDistanceToBox(ClipmapBounds) < InfluenceRadius * InfluenceRadius)
+			{
+				++NumCulledEvents;
+				bCovered &= IsCovered(Event, UpdateBounds);
+			}
+		}
+
+		TestTrue(FString::Printf(TEXT("%s: unlimited budget always fits"), Desc.Name), bFitsBudget);
+		TestTrue(FString::Printf(TEXT("%s: update bounds cover all modifications"), Desc.Name), bCovered);
+		TestTrue(FString::Printf(TEXT("%s: update bounds are disjoint and inside the clipmap"), Desc.Name), AreDisjointAndInside(UpdateBounds));
+		TestTrue(FString::Printf(TEXT("%s: no more update bounds than modifications"), Desc.Name), UpdateBounds.Num() <= NumCulledEvents);
+
+		AddInfo(FString::Printf(TEXT("%s: %d modifications in the clipmap (%d snapped) merged into %d update bounds"),
+			Desc.Name, NumCulledEvents, ModifiedBounds.Num(), UpdateBounds.Num()));
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
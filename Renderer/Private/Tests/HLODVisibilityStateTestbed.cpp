@@ -0,0 +1,283 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "ScenePrivate.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHLODVisibilityStateTestbed, "System.Renderer.HLOD.VisibilityState", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace HLODVisibilityStateTestbed
+{
+
+/** Reference state, as FLODSceneTree::UpdateVisibilityStates did it before: the maps are re-initialized on every update. */
+struct FReferenceState
+{
+	TBitArray<> PrimitiveFadingLODMap;
+	TBitArray<> PrimitiveFadingOutLODMap;
+	TBitArray<> ForcedVisiblePrimitiveMap;
+	TBitArray<> ForcedHiddenPrimitiveMap;
+
+	void BeginUpdate(int32 NumPrimitives)
+	{
+		PrimitiveFadingLODMap.Init(false, NumPrimitives);
+		PrimitiveFadingOutLODMap.Init(false, NumPrimitives);
+		ForcedVisiblePrimitiveMap.Init(false, NumPrimitives);
+		ForcedHiddenPrimitiveMap.Init(false, NumPrimitives);
+	}
+
+	void SetNodeFading(int32 PrimIndex, bool bIsFading, bool bIsFadingOut)
+	{
+		PrimitiveFadingLODMap[PrimIndex] = bIsFading;
+		PrimitiveFadingOutLODMap[PrimIndex] = bIsFadingOut;
+	}
+
+	void SetNodeForcedVisible(int32 PrimIndex, bool bValue)
+	{
+		ForcedVisiblePrimitiveMap[PrimIndex] = bValue;
+	}
+
+	void SetNodeForcedHidden(int32 PrimIndex, bool bValue)
+	{
+		ForcedHiddenPrimitiveMap[PrimIndex] = bValue;
+	}
+};
+
+/** Synthetic HLOD tree in primitive index space. Nodes can be children of other nodes. */
+struct FSyntheticNode
+{
+	int32 PrimIndex;
+	TArray<int32> ChildPrimIndices;
+	TArray<int32> ChildNodes;
+};
+
+enum class ENodeOutcome
+{
+	Fading,
+	Visible,
+	Hidden,
+	FarCulled,
+};
+
+/** Same writes as FLODSceneTree::UpdateVisibilityStates, ApplyNodeFadingToChildren and HideNodeChildren. */
+template<typename StateType>
+struct TSyntheticUpdate
+{
+	StateType& State;
+	TConstArrayView<FSyntheticNode> Nodes;
+	TBitArray<> UpdatedNodes;
+
+	void HideNodeChildren(int32 NodeIndex)
+	{
+		if (UpdatedNodes[NodeIndex])
+		{
+			return;
+		}
+		UpdatedNodes[NodeIndex] = true;
+
+		const FSyntheticNode& Node = Nodes[NodeIndex];
+		for (int32 ChildIndex = 0; ChildIndex < Node.ChildPrimIndices.Num(); ++ChildIndex)
+		{
+			State.SetNodeForcedHidden(Node.ChildPrimIndices[ChildIndex], true);
+			State.SetNodeForcedVisible(Node.ChildPrimIndices[ChildIndex], false);
+			if (Node.ChildNodes[ChildIndex] != INDEX_NONE)
+			{
+				HideNodeChildren(Node.ChildNodes[ChildIndex]);
+			}
+		}
+	}
+
+	void ApplyNodeFadingToChildren(int32 NodeIndex, bool bIsFading, bool bIsFadingOut)
+	{
+		UpdatedNodes[NodeIndex] = true;
+
+		const FSyntheticNode& Node = Nodes[NodeIndex];
+		for (int32 ChildIndex = 0; ChildIndex < Node.ChildPrimIndices.Num(); ++ChildIndex)
+		{
+			State.SetNodeFading(Node.ChildPrimIndices[ChildIndex], bIsFading, bIsFadingOut);
+			State.SetNodeForcedHidden(Node.ChildPrimIndices[ChildIndex], false);
+			if (bIsFading)
+			{
+				State.SetNodeForcedVisible(Node.ChildPrimIndices[ChildIndex], true);
+			}
+			if (Node.ChildNodes[ChildIndex] != INDEX_NONE)
+			{
+				HideNodeChildren(Node.ChildNodes[ChildIndex]);
+			}
+		}
+	}
+
+	void Run(int32 NumPrimitives, TConstArrayView<ENodeOutcome> Outcomes, TConstArrayView<bool> FadingOut)
+	{
+		State.BeginUpdate(NumPrimitives);
+		UpdatedNodes.Init(false, Nodes.Num());
+
+		for (int32 NodeIndex = 0; NodeIndex < Nodes.Num(); ++NodeIndex)
+		{
+			if (UpdatedNodes[NodeIndex])
+			{
+				continue;
+			}
+
+			const int32 PrimIndex = Nodes[NodeIndex].PrimIndex;
+			switch (Outcomes[NodeIndex])
+			{
+			case ENodeOutcome::Fading:
+				State.SetNodeFading(PrimIndex, true, FadingOut[NodeIndex]);
+				State.SetNodeForcedVisible(PrimIndex, true);
+				ApplyNodeFadingToChildren(NodeIndex, true, !FadingOut[NodeIndex]);
+				break;
+			case ENodeOutcome::Visible:
+				State.SetNodeForcedVisible(PrimIndex, true);
+				HideNodeChildren(NodeIndex);
+				break;
+			case ENodeOutcome::Hidden:
+				State.SetNodeForcedHidden(PrimIndex, true);
+				break;
+			case ENodeOutcome::FarCulled:
+				State.SetNodeForcedHidden(PrimIndex, true);
+				HideNodeChildren(NodeIndex);
+				break;
+			}
+		}
+	}
+};
+
+static TArray<FSyntheticNode> MakeTree(FRandomStream& Random, int32 NumPrimitives, int32 NumNodes, int32 NumChildrenPerNode)
+{
+	TArray<FSyntheticNode> Nodes;
+	for (int32 NodeIndex = 0; NodeIndex < NumNodes; ++NodeIndex)
+	{
+		FSyntheticNode& Node = Nodes.AddDefaulted_GetRef();
+		Node.PrimIndex = Random.RandRange(0, NumPrimitives - 1);
+		for (int32 ChildIndex = 0; ChildIndex < NumChildrenPerNode; ++ChildIndex)
+		{
+			Node.ChildPrimIndices.Add(Random.RandRange(0, NumPrimitives - 1));
+			Node.ChildNodes.Add(INDEX_NONE);
+		}
+	}
+
+	// Second level of the hierarchy: some children are nodes of their own
+	for (int32 NodeIndex = 0; NodeIndex < NumNodes; ++NodeIndex)
+	{
+		FSyntheticNode& Node = Nodes[NodeIndex];
+		for (int32 ChildIndex = 0; ChildIndex < Node.ChildPrimIndices.Num(); ++ChildIndex)
+		{
+			const int32 ChildNodeIndex = Random.RandRange(0, NumNodes - 1);
+			if (ChildNodeIndex > NodeIndex && Random.FRand() < 0.1f)
+			{
+				Node.ChildPrimIndices[ChildIndex] = Nodes[ChildNodeIndex].PrimIndex;
+				Node.ChildNodes[ChildIndex] = ChildNodeIndex;
+			}
+		}
+	}
+
+	return Nodes;
+}
+
+static bool MapsMatch(const FReferenceState& Reference, const FHLODVisibilityState& State)
+{
+	return Reference.PrimitiveFadingLODMap == State.PrimitiveFadingLODMap
+		&& Reference.PrimitiveFadingOutLODMap == State.PrimitiveFadingOutLODMap
+		&& Reference.ForcedVisiblePrimitiveMap == State.ForcedVisiblePrimitiveMap
+		&& Reference.ForcedHiddenPrimitiveMap == State.ForcedHiddenPrimitiveMap;
+}
+
+} // HLODVisibilityStateTestbed
+
+bool FHLODVisibilityStateTestbed::RunTest(const FString& Parameters)
+{
+	using namespace HLODVisibilityStateTestbed;
+
+	FRandomStream Random(0x484C4F44);
+
+	// Random outcomes over frames, with the scene growing and shrinking
+	{
+		int32 NumPrimitives = 4096;
+		TArray<FSyntheticNode> Nodes = MakeTree(Random, NumPrimitives / 2, 64, 16);
+
+		FReferenceState Reference;
+		FHLODVisibilityState State;
+		bool bMatches = true;
+
+		for (int32 Frame = 0; Frame < 256; ++Frame)
+		{
+			if (Frame % 32 == 31)
+			{
+				NumPrimitives = Random.RandRange(NumPrimitives / 2, NumPrimitives * 2);
+			}
+			if (Frame % 64 == 63)
+			{
+				Nodes = MakeTree(Random, FMath::Min(NumPrimitives, 2048), 64, 16);
+			}
+
+			TArray<ENodeOutcome> Outcomes;
+			TArray<bool> FadingOut;
+			for (int32 NodeIndex = 0; NodeIndex < Nodes.Num(); ++NodeIndex)
+			{
+				Outcomes.Add(ENodeOutcome(Random.RandRange(0, 3)));
+				FadingOut.Add(Random.FRand() < 0.5f);
+			}
+
+			TSyntheticUpdate<FReferenceState>{ Reference, Nodes }.Run(NumPrimitives, Outcomes, FadingOut);
+			TSyntheticUpdate<FHLODVisibilityState>{ State, Nodes }.Run(NumPrimitives, Outcomes, FadingOut);
+			bMatches &= MapsMatch(Reference, State);
+		}
+		TestTrue(TEXT("Persistent maps match the maps initialized on every update"), bMatches);
+
+		State.Reset();
+		Reference.BeginUpdate(0);
+		TestTrue(TEXT("Reset empties the maps"), MapsMatch(Reference, State));
+
+		TArray<ENodeOutcome> Outcomes;
+		Outcomes.Init(ENodeOutcome::FarCulled, Nodes.Num());
+		TArray<bool> FadingOut;
+		FadingOut.Init(false, Nodes.Num());
+		TSyntheticUpdate<FReferenceState>{ Reference, Nodes }.Run(NumPrimitives, Outcomes, FadingOut);
+		TSyntheticUpdate<FHLODVisibilityState>{ State, Nodes }.Run(NumPrimitives, Outcomes, FadingOut);
+		TestTrue(TEXT("Persistent maps match after a reset"), MapsMatch(Reference, State));
+	}
+
+	// Benchmark: large scene with few HLOD nodes
+	{
+		const int32 NumPrimitives = 300000;
+		const int32 NumIterations = 64;
+		TArray<FSyntheticNode> Nodes = MakeTree(Random, NumPrimitives, 32, 64);
+
+		TArray<ENodeOutcome> Outcomes;
+		TArray<bool> FadingOut;
+		for (int32 NodeIndex = 0; NodeIndex < Nodes.Num(); ++NodeIndex)
+		{
+			Outcomes.Add(ENodeOutcome(Random.RandRange(0, 3)));
+			FadingOut.Add(Random.FRand() < 0.5f);
+		}
+
+		FReferenceState Reference;
+		FHLODVisibilityState State;
+
+		const uint64 Time0 = FPlatformTime::Cycles64();
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			TSyntheticUpdate<FReferenceState>{ Reference, Nodes }.Run(NumPrimitives, Outcomes, FadingOut);
+		}
+		const uint64 Time1 = FPlatformTime::Cycles64();
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			TSyntheticUpdate<FHLODVisibilityState>{ State, Nodes }.Run(NumPrimitives, Outcomes, FadingOut);
+		}
+		const uint64 Time2 = FPlatformTime::Cycles64();
+
+		TestTrue(TEXT("Benchmark maps match"), MapsMatch(Reference, State));
+		AddInfo(FString::Printf(TEXT("HLOD visibility maps, %d primitives, %d nodes: initialized %.3fms, persistent %.3fms (per update)"),
+			NumPrimitives,
+			Nodes.Num(),
+			FPlatformTime::ToMilliseconds64(Time1 - Time0) / NumIterations,
+			FPlatformTime::ToMilliseconds64(Time2 - Time1) / NumIterations));
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
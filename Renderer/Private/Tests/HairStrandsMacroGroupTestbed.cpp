@@ -0,0 +1,290 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "HairStrands/HairStrandsData.h"
+#include "HairStrands/HairStrandsMacroGroup.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHairStrandsMacroGroupTestbed, "System.Renderer.HairStrands.MacroGroupClustering", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace HairStrandsMacroGroupTestbed
+{
+
+/** Synthetic groom layout: characters with a few grooms (hair, eyebrows, beard, ...) each, walking around. */
+struct FGroomLayout
+{
+	TArray<FVector> CharacterPositions;
+	TArray<FVector> CharacterVelocities;
+	TArray<FVector> GroomOffsets;
+	TArray<FVector> GroomExtents;
+	int32 GroomsPerCharacter = 0;
+
+	void Init(FRandomStream& Random, int32 CharacterCount, int32 InGroomsPerCharacter, float AreaSize, float Speed)
+	{
+		GroomsPerCharacter = InGroomsPerCharacter;
+		for (int32 CharacterIndex = 0; CharacterIndex < CharacterCount; ++CharacterIndex)
+		{
+			CharacterPositions.Add(FVector(Random.FRandRange(-AreaSize, AreaSize), Random.FRandRange(-AreaSize, AreaSize), 170.0));
+			CharacterVelocities.Add(FVector(Random.FRandRange(-Speed, Speed), Random.FRandRange(-Speed, Speed), 0.0));
+			for (int32 GroomIndex = 0; GroomIndex < GroomsPerCharacter; ++GroomIndex)
+			{
+				GroomOffsets.Add(FVector(Random.FRandRange(-10.0f, 10.0f), Random.FRandRange(-10.0f, 10.0f), Random.FRandRange(-15.0f, 5.0f)));
+				GroomExtents.Add(FVector(Random.FRandRange(2.0f, 15.0f), Random.FRandRange(2.0f, 15.0f), Random.FRandRange(2.0f, 20.0f)));
+			}
+		}
+	}
+
+	void Tick()
+	{
+		for (int32 CharacterIndex = 0; CharacterIndex < CharacterPositions.Num(); ++CharacterIndex)
+		{
+			CharacterPositions[CharacterIndex] += CharacterVelocities[CharacterIndex];
+		}
+	}
+
+	void GetBounds(TArray<FBoxSphereBounds, SceneRenderingAllocator>& OutBounds, TArray<uint64, SceneRenderingAllocator>& OutKeys) const
+	{
+		OutBounds.Reset();
+		OutKeys.Reset();
+		for (int32 GroomIndex = 0; GroomIndex < GroomOffsets.Num(); ++GroomIndex)
+		{
+			const FVector Center = CharacterPositions[GroomIndex / GroomsPerCharacter] + GroomOffsets[GroomIndex];
+			OutBounds.Add(FBoxSphereBounds(FBox(Center - GroomExtents[GroomIndex], Center + GroomExtents[GroomIndex])));
+			OutKeys.Add(uint64(GroomIndex));
+		}
+	}
+};
+
+static double GetTotalVolume(const TArray<FBoxSphereBounds, SceneRenderingAllocator>& GroupBounds)
+{
+	double Volume = 0;
+	for (const FBoxSphereBounds& Bounds : GroupBounds)
+	{
+		Volume += Bounds.GetBox().GetVolume();
+	}
+	return Volume;
+}
+
+/** Previous greedy assignment (first intersecting group, or closest group once the budget is reached), as a reference score. */
+static double GetGreedyTotalVolume(const TArray<FBoxSphereBounds, SceneRenderingAllocator>& PrimitiveBounds, uint32 MaxGroupCount)
+{
+	TArray<FBoxSphereBounds, SceneRenderingAllocator> GroupBounds;
+	for (const FBoxSphereBounds& PrimitiveBound : PrimitiveBounds)
+	{
+		bool bFound = false;
+		double MinDistance = DBL_MAX;
+		int32 ClosestGroup = INDEX_NONE;
+		for (int32 GroupIndex = 0; GroupIndex < GroupBounds.Num(); ++GroupIndex)
+		{
+			const FSphere MacroSphere = GroupBounds[GroupIndex].GetSphere();
+			const FSphere PrimSphere = PrimitiveBound.GetSphere();
+			const double DistCenters = (MacroSphere.Center - PrimSphere.Center).Size();
+			const double AccumRadius = FMath::Max(0.0, MacroSphere.W + PrimSphere.W);
+			if (DistCenters <= AccumRadius)
+			{
+				GroupBounds[GroupIndex] = Union(GroupBounds[GroupIndex], PrimitiveBound);
+				bFound = true;
+				break;
+			}
+			if (DistCenters - AccumRadius < MinDistance)
+			{
+				MinDistance = DistCenters - AccumRadius;
+				ClosestGroup = GroupIndex;
+			}
+		}
+
+		if (!bFound)
+		{
+			if (uint32(GroupBounds.Num()) == MaxGroupCount)
+			{
+				GroupBounds[ClosestGroup] = Union(GroupBounds[ClosestGroup], PrimitiveBound);
+			}
+			else
+			{
+				GroupBounds.Add(PrimitiveBound);
+			}
+		}
+	}
+	return GetTotalVolume(GroupBounds);
+}
+
+static TArray<FBox> GetMemberBoxes(const TArray<FBoxSphereBounds, SceneRenderingAllocator>& PrimitiveBounds, const TArray<uint32, SceneRenderingAllocator>& GroupIndices, uint32 GroupCount)
+{
+	TArray<FBox> Boxes;
+	Boxes.Init(FBox(ForceInit), GroupCount);
+	for (int32 PrimitiveIndex = 0; PrimitiveIndex < PrimitiveBounds.Num(); ++PrimitiveIndex)
+	{
+		if (GroupIndices[PrimitiveIndex] < GroupCount)
+		{
+			Boxes[GroupIndices[PrimitiveIndex]] += PrimitiveBounds[PrimitiveIndex].GetBox();
+		}
+	}
+	return Boxes;
+}
+
+static TArray<FBox> GetGroupBoxes(const TArray<FBoxSphereBounds, SceneRenderingAllocator>& GroupBounds)
+{
+	TArray<FBox> Boxes;
+	for (const FBoxSphereBounds& Bounds : GroupBounds)
+	{
+		Boxes.Add(Bounds.GetBox());
+	}
+	return Boxes;
+}
+
+static bool AreBoxesEqual(const TArray<FBox>& A, const TArray<FBox>& B)
+{
+	if (A.Num() != B.Num())
+	{
+		return false;
+	}
+	for (int32 Index = 0; Index < A.Num(); ++Index)
+	{
+		if (!A[Index].Min.Equals(B[Index].Min, 1.0e-3) || !A[Index].Max.Equals(B[Index].Max, 1.0e-3))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+struct FScore
+{
+	double TotalVolume = 0;
+	double GreedyTotalVolume = 0;
+	uint32 ChangedAssignments = 0;
+	uint32 Assignments = 0;
+	bool bValid = true;
+	bool bTight = true;
+};
+
+/** Two characters starting side by side and walking apart, their grooms have to end up in separate groups. */
+static bool DoesGroupSplit(int32 FrameCount, bool bUseHistory)
+{
+	FGroomLayout Layout;
+	Layout.GroomsPerCharacter = 1;
+	Layout.CharacterPositions = { FVector(-5.0, 0.0, 170.0), FVector(5.0, 0.0, 170.0) };
+	Layout.CharacterVelocities = { FVector(-2.0, 0.0, 0.0), FVector(2.0, 0.0, 0.0) };
+	Layout.GroomOffsets = { FVector::ZeroVector, FVector::ZeroVector };
+	Layout.GroomExtents = { FVector(10.0), FVector(10.0) };
+
+	FHairStrandsMacroGroupHistory History;
+	TArray<FBoxSphereBounds, SceneRenderingAllocator> PrimitiveBounds;
+	TArray<uint64, SceneRenderingAllocator> PrimitiveKeys;
+	TArray<uint32, SceneRenderingAllocator> GroupIndices;
+	TArray<FBoxSphereBounds, SceneRenderingAllocator> GroupBounds;
+
+	bool bStartsMerged = false;
+	for (int32 Frame = 0; Frame < FrameCount; ++Frame)
+	{
+		Layout.GetBounds(PrimitiveBounds, PrimitiveKeys);
+		HairStrands::ClusterMacroGroups(PrimitiveBounds, PrimitiveKeys, FHairStrandsMacroGroupData::MaxMacroGroupCount, bUseHistory ? &History : nullptr, GroupIndices, GroupBounds);
+		bStartsMerged |= Frame == 0 && GroupIndices[0] == GroupIndices[1];
+		Layout.Tick();
+	}
+	return bStartsMerged && GroupIndices[0] != GroupIndices[1];
+}
+
+static FScore RunLayout(FGroomLayout Layout, int32 FrameCount, bool bUseHistory)
+{
+	const uint32 MaxGroupCount = FHairStrandsMacroGroupData::MaxMacroGroupCount;
+
+	FScore Score;
+	FHairStrandsMacroGroupHistory History;
+	TArray<FBoxSphereBounds, SceneRenderingAllocator> PrimitiveBounds;
+	TArray<uint64, SceneRenderingAllocator> PrimitiveKeys;
+	TArray<uint32, SceneRenderingAllocator> GroupIndices;
+	TArray<uint32, SceneRenderingAllocator> PreviousGroupIndices;
+	TArray<FBoxSphereBounds, SceneRenderingAllocator> GroupBounds;
+
+	for (int32 Frame = 0; Frame < FrameCount; ++Frame)
+	{
+		Layout.GetBounds(PrimitiveBounds, PrimitiveKeys);
+
+		const uint32 GroupCount = HairStrands::ClusterMacroGroups(PrimitiveBounds, PrimitiveKeys, MaxGroupCount, bUseHistory ? &History : nullptr, GroupIndices, GroupBounds);
+
+		// Every primitive must be fully enclosed by its group, and the group budget respected
+		Score.bValid &= GroupCount <= MaxGroupCount && GroupCount == uint32(GroupBounds.Num());
+		for (int32 PrimitiveIndex = 0; PrimitiveIndex < PrimitiveBounds.Num(); ++PrimitiveIndex)
+		{
+			Score.bValid &= GroupIndices[PrimitiveIndex] < GroupCount && GroupBounds[GroupIndices[PrimitiveIndex]].GetBox().ExpandBy(KINDA_SMALL_NUMBER).IsInside(PrimitiveBounds[PrimitiveIndex].GetBox());
+		}
+
+		// Group bounds are the union of this frame's members, nothing is carried over from the previous frames
+		Score.bTight &= AreBoxesEqual(GetMemberBoxes(PrimitiveBounds, GroupIndices, GroupCount), GetGroupBoxes(GroupBounds));
+
+		Score.TotalVolume += GetTotalVolume(GroupBounds);
+		Score.GreedyTotalVolume += GetGreedyTotalVolume(PrimitiveBounds, MaxGroupCount);
+		if (Frame > 0)
+		{
+			for (int32 PrimitiveIndex = 0; PrimitiveIndex < PrimitiveBounds.Num(); ++PrimitiveIndex)
+			{
+				Score.ChangedAssignments += GroupIndices[PrimitiveIndex] != PreviousGroupIndices[PrimitiveIndex] ? 1u : 0u;
+				++Score.Assignments;
+			}
+		}
+		PreviousGroupIndices = GroupIndices;
+
+		Layout.Tick();
+	}
+
+	return Score;
+}
+
+} // HairStrandsMacroGroupTestbed
+
+bool FHairStrandsMacroGroupTestbed::RunTest(const FString& Parameters)
+{
+	using namespace HairStrandsMacroGroupTestbed;
+
+	struct FLayoutDesc
+	{
+		const TCHAR* Name;
+		int32 CharacterCount;
+		int32 GroomsPerCharacter;
+		float AreaSize;
+		float Speed;
+	};
+	const FLayoutDesc LayoutDescs[] =
+	{
+		{ TEXT("Static crowd"),		48, 4, 1000.0f,	0.0f },
+		{ TEXT("Walking crowd"),	48, 4, 1000.0f,	2.0f },
+		{ TEXT("Dense crowd"),		128, 3, 500.0f,	3.0f },
+		{ TEXT("Few characters"),	6, 5, 2000.0f,	4.0f },
+	};
+
+	const int32 FrameCount = 60;
+	FRandomStream Random(0xba1d);
+	for (const FLayoutDesc& Desc : LayoutDescs)
+	{
+		FGroomLayout Layout;
+		Layout.Init(Random, Desc.CharacterCount, Desc.GroomsPerCharacter, Desc.AreaSize, Desc.Speed);
+
+		const FScore Stable = RunLayout(Layout, FrameCount, true);
+		const FScore Unstable = RunLayout(Layout, FrameCount, false);
+
+		TestTrue(FString::Printf(TEXT("%s: groups enclose their primitives within budget"), Desc.Name), Stable.bValid && Unstable.bValid);
+		TestTrue(FString::Printf(TEXT("%s: group bounds are the union of their members"), Desc.Name), Stable.bTight && Unstable.bTight);
+		TestTrue(FString::Printf(TEXT("%s: history doesn't change the group volume"), Desc.Name), FMath::IsNearlyEqual(Stable.TotalVolume, Unstable.TotalVolume, Unstable.TotalVolume * 1.0e-9));
+		if (Desc.Speed == 0.0f)
+		{
+			TestEqual(FString::Printf(TEXT("%s: no churn on a static layout"), Desc.Name), Stable.ChangedAssignments, 0u);
+		}
+
+		AddInfo(FString::Printf(TEXT("%s: volume %.3g (greedy %.3g), churn %.2f%% (without history %.2f%%)"),
+			Desc.Name,
+			Stable.TotalVolume / FrameCount,
+			Stable.GreedyTotalVolume / FrameCount,
+			Stable.Assignments ? 100.0 * Stable.ChangedAssignments / Stable.Assignments : 0.0,
+			Unstable.Assignments ? 100.0 * Unstable.ChangedAssignments / Unstable.Assignments : 0.0));
+	}
+
+	TestTrue(TEXT("Groups split when their primitives move apart"), DoesGroupSplit(FrameCount, true) && DoesGroupSplit(FrameCount, false));
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
@@ -0,0 +1,257 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "RHI.h"
+#include "InstanceCulling/InstanceCullingManager.h"
+#include "InstanceCulling/InstanceCullingMergedContext.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FInstanceCullingMergeBatchesTestbed, "System.Renderer.InstanceCulling.MergeBatches", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace InstanceCullingMergeBatchesTestbed
+{
+
+static constexpr int32 NumBins = 4;
+
+/** Fill a context the same way FInstanceCullingContext::SetupDrawCommands does, with random draws. */
+static TUniquePtr<FInstanceCullingContext> MakeContext(FRandomStream& Random, EShaderPlatform ShaderPlatform)
+{
+	TArray<int32, TInlineAllocator<4>> ViewIds;
+	const int32 NumViews = Random.RandRange(1, 4);
+	for (int32 ViewIndex = 0; ViewIndex < NumViews; ++ViewIndex)
+	{
+		ViewIds.Add(Random.RandRange(0, 15));
+	}
+
+	TUniquePtr<FInstanceCullingContext> Context = MakeUnique<FInstanceCullingContext>(TEXT("MergeBatchesTestbed"), ShaderPlatform, nullptr, ViewIds, TRefCountPtr<IPooledRenderTarget>());
+	for (uint32 Mode = 0U; Mode < uint32(EBatchProcessingMode::Num); ++Mode)
+	{
+		Context->LoadBalancers[Mode] = new FInstanceProcessingGPULoadBalancer();
+	}
+
+	const int32 NumCommands = Random.RandRange(1, 256);
+	Context->ResetCommands(NumCommands);
+	for (int32 CommandIndex = 0; CommandIndex < NumCommands; ++CommandIndex)
+	{
+		Context->IndirectArgs.Add(FRHIDrawIndexedIndirectParameters{ uint32(Random.RandRange(3, 3000)), 0U, uint32(Random.RandRange(0, 1 << 16)), Random.RandRange(0, 1 << 16), 0U });
+		Context->DrawCommandDescs.Add(Random.GetUnsignedInt());
+
+		const uint32 InstanceIdOffset = Context->GetInstanceIdNumElements();
+		Context->InstanceIdOffsets.Add(InstanceIdOffset);
+
+		const uint32 NumInstances = Random.FRand() < 0.5f ? 1U : uint32(Random.RandRange(2, 300));
+		const bool bPreserveInstanceOrder = Random.FRand() < 0.25f;
+		FInstanceCullingContext::EInstanceFlags InstanceFlags = bPreserveInstanceOrder ? FInstanceCullingContext::EInstanceFlags::PreserveInstanceOrder : FInstanceCullingContext::EInstanceFlags::None;
+		if (Random.FRand() < 0.25f)
+		{
+			InstanceFlags |= FInstanceCullingContext::EInstanceFlags::DynamicInstanceDataOffset;
+		}
+		Context->AddInstancesToDrawCommand(CommandIndex, Random.RandRange(0, 1 << 20), 0U, NumInstances, InstanceFlags);
+
+		if (bPreserveInstanceOrder)
+		{
+			const uint32 NumContextViews = Context->ViewIds.Num();
+			const uint32 CompactionDataIndex = uint32(Context->DrawCommandCompactionData.Num());
+			Context->DrawCommandCompactionData.Emplace(NumInstances, NumContextViews, uint32(Context->CompactionBlockDataIndices.Num()), CommandIndex, Context->NumCompactionInstances, InstanceIdOffset);
+			const uint32 NumCompactionBlocks = FMath::DivideAndRoundUp(NumInstances, FInstanceCullingContext::CompactionBlockNumInstances);
+			for (uint32 Block = 0U; Block < NumCompactionBlocks; ++Block)
+			{
+				Context->CompactionBlockDataIndices.Add(CompactionDataIndex);
+			}
+			Context->NumCompactionInstances += NumInstances * NumContextViews;
+		}
+	}
+
+	Context->SetDynamicPrimitiveInstanceOffsets(Random.RandRange(0, 1 << 16), Random.RandRange(0, 1024));
+	return Context;
+}
+
+/** Output of the reference merge, the serial append-and-rebase that FInstanceCullingMergedContext::MergeBatches must reproduce. */
+struct FReferenceMerge
+{
+	TArray<int32> ViewIds;
+	TArray<FRHIDrawIndexedIndirectParameters> IndirectArgs;
+	TArray<uint32> DrawCommandDescs;
+	TArray<FInstanceCullingContext::FPayloadData> PayloadData;
+	TArray<uint32> InstanceIdOffsets;
+	TArray<FInstanceCullingContext::FCompactionData> DrawCommandCompactionData;
+	TArray<uint32> CompactionBlockDataIndices;
+	TArray<TInstanceCullingLoadBalancer<>> LoadBalancers;
+	TArray<TArray<uint32>> BatchInds;
+	TArray<FInstanceCullingMergedContext::FContextBatchInfoPacked> BatchInfos;
+	TArray<uint32> InstanceDataByteOffsets;
+	TArray<uint32> IndirectArgsByteOffsets;
+};
+
+static void ReferenceMerge(TConstArrayView<FInstanceCullingMergedContext::FBatchItem> Batches, FReferenceMerge& Out)
+{
+	Out.LoadBalancers.SetNum(NumBins);
+	Out.BatchInds.SetNum(NumBins);
+
+	uint32 InstanceIdBufferOffset = 0U;
+	uint32 InstanceDataByteOffset = 0U;
+	uint32 CompactionInstanceOffset = 0U;
+
+	for (const FInstanceCullingMergedContext::FBatchItem& BatchItem : Batches)
+	{
+		const FInstanceCullingContext& Context = *BatchItem.Context;
+		const uint32 BatchInfoIndex = uint32(Out.BatchInfos.Num());
+		FInstanceCullingMergedContext::FContextBatchInfoPacked& BatchInfo = Out.BatchInfos.AddDefaulted_GetRef();
+
+		BatchInfo.IndirectArgsOffset = Out.IndirectArgs.Num();
+		Out.IndirectArgs.Append(Context.IndirectArgs.GetData(), Context.IndirectArgs.Num());
+		Out.DrawCommandDescs.Append(Context.DrawCommandDescs.GetData(), Context.DrawCommandDescs.Num());
+
+		BatchInfo.PayloadDataOffset = Out.PayloadData.Num();
+		Out.PayloadData.Append(Context.PayloadData.GetData(), Context.PayloadData.Num());
+
+		for (uint32 InstanceIdOffset : Context.InstanceIdOffsets)
+		{
+			Out.InstanceIdOffsets.Add(InstanceIdOffset + InstanceIdBufferOffset);
+		}
+
+		BatchInfo.ViewIdsOffset = Out.ViewIds.Num();
+		BatchInfo.NumViewIds_bAllowOcclusionCulling = (uint32(Context.ViewIds.Num()) << 1u) | (Context.PrevHZB.IsValid() ? 1u : 0u);
+		Out.ViewIds.Append(Context.ViewIds.GetData(), Context.ViewIds.Num());
+
+		BatchInfo.DynamicInstanceIdOffset = Context.DynamicInstanceIdOffset;
+		BatchInfo.DynamicInstanceIdMax = Context.DynamicInstanceIdOffset + Context.DynamicInstanceIdNum;
+
+		for (uint32 Mode = 0U; Mode < uint32(EBatchProcessingMode::Num); ++Mode)
+		{
+			const int32 BinIndex = EBatchProcessingMode(Mode) == EBatchProcessingMode::UnCulled ? 0 : BatchItem.GenericBinIndex;
+
+			FInstanceProcessingGPULoadBalancer* LoadBalancer = Context.LoadBalancers[Mode];
+			LoadBalancer->FinalizeBatches();
+
+			BatchInfo.ItemDataOffset[Mode] = Out.LoadBalancers[BinIndex].GetItems().Num();
+			Out.LoadBalancers[BinIndex].AppendData(*LoadBalancer);
+			for (int32 Index = 0; Index < LoadBalancer->GetBatches().Num(); ++Index)
+			{
+				Out.BatchInds[BinIndex].Add(BatchInfoIndex);
+			}
+		}
+
+		Out.InstanceDataByteOffsets.Add(InstanceDataByteOffset);
+		Out.IndirectArgsByteOffsets.Add(BatchInfo.IndirectArgsOffset * FInstanceCullingContext::IndirectArgsNumWords * sizeof(uint32));
+
+		BatchInfo.InstanceDataWriteOffset = InstanceIdBufferOffset;
+
+		BatchInfo.CompactionDataOffset = Out.DrawCommandCompactionData.Num();
+		const uint32 CompactionBlockOffset = Out.CompactionBlockDataIndices.Num();
+		for (FInstanceCullingContext::FCompactionData CompactionData : Context.DrawCommandCompactionData)
+		{
+			CompactionData.BlockOffset += CompactionBlockOffset;
+			CompactionData.IndirectArgsIndex += BatchInfo.IndirectArgsOffset;
+			CompactionData.SrcInstanceIdOffset += CompactionInstanceOffset;
+			CompactionData.DestInstanceIdOffset += BatchInfo.InstanceDataWriteOffset;
+			Out.DrawCommandCompactionData.Add(CompactionData);
+		}
+		for (uint32 CompactionDataIndex : Context.CompactionBlockDataIndices)
+		{
+			Out.CompactionBlockDataIndices.Add(CompactionDataIndex + BatchInfo.CompactionDataOffset);
+		}
+		CompactionInstanceOffset += Context.NumCompactionInstances;
+
+		InstanceIdBufferOffset += Context.GetInstanceIdNumElements();
+		InstanceDataByteOffset += Context.StepInstanceDataOffsetBytes(Context.InstanceIdOffsets.Num());
+	}
+}
+
+/** Bitwise comparison, all the merged element types are plain packed uint32s. */
+template <typename ArrayTypeA, typename ArrayTypeB>
+static bool AreArraysEqual(const ArrayTypeA& A, const ArrayTypeB& B)
+{
+	static_assert(sizeof(typename ArrayTypeA::ElementType) == sizeof(typename ArrayTypeB::ElementType), "Mismatched element types");
+	return A.Num() == B.Num() && (A.Num() == 0 || FMemory::Memcmp(A.GetData(), B.GetData(), A.Num() * sizeof(typename ArrayTypeA::ElementType)) == 0);
+}
+
+template <typename AllocatorTypeA, typename AllocatorTypeB>
+static bool AreLoadBalancersEqual(const TInstanceCullingLoadBalancer<AllocatorTypeA>& A, const TInstanceCullingLoadBalancer<AllocatorTypeB>& B)
+{
+	return A.GetTotalNumInstances() == B.GetTotalNumInstances()
+		&& AreArraysEqual(A.GetBatches(), B.GetBatches())
+		&& AreArraysEqual(A.GetItems(), B.GetItems());
+}
+
+} // InstanceCullingMergeBatchesTestbed
+
+bool FInstanceCullingMergeBatchesTestbed::RunTest(const FString& Parameters)
+{
+	using namespace InstanceCullingMergeBatchesTestbed;
+
+	FRandomStream Random(0x494D4247);
+
+	const EShaderPlatform ShaderPlatform = GMaxRHIShaderPlatform;
+
+	bool bMergedDataMatches = true;
+	bool bLoadBalancersMatch = true;
+	bool bBatchInfosMatch = true;
+	bool bDrawParamsMatch = true;
+	uint64 ReferenceCycles = 0;
+	uint64 MergeCycles = 0;
+	int32 TotalContexts = 0;
+
+	for (int32 NumContexts : { 1, 7, 64, 1024, 4096 })
+	{
+		TArray<TUniquePtr<FInstanceCullingContext>> Contexts;
+		TArray<FInstanceCullingDrawParams> DrawParams;
+		DrawParams.SetNum(NumContexts);
+
+		FInstanceCullingMergedContext MergedContext(ShaderPlatform, false, NumBins);
+		for (int32 ContextIndex = 0; ContextIndex < NumContexts; ++ContextIndex)
+		{
+			FInstanceCullingContext* Context = Contexts.Add_GetRef(MakeContext(Random, ShaderPlatform)).Get();
+			MergedContext.Batches.Add(FInstanceCullingMergedContext::FBatchItem{ Context, &DrawParams[ContextIndex], Random.RandRange(FInstanceCullingMergedContext::FirstGenericBinIndex, NumBins - 1) });
+		}
+		TotalContexts += NumContexts;
+
+		FReferenceMerge Reference;
+		const uint64 Time0 = FPlatformTime::Cycles64();
+		ReferenceMerge(MergedContext.Batches, Reference);
+		const uint64 Time1 = FPlatformTime::Cycles64();
+		MergedContext.MergeBatches();
+		const uint64 Time2 = FPlatformTime::Cycles64();
+		ReferenceCycles += Time1 - Time0;
+		MergeCycles += Time2 - Time1;
+
+		bMergedDataMatches &= AreArraysEqual(MergedContext.ViewIds, Reference.ViewIds);
+		bMergedDataMatches &= AreArraysEqual(MergedContext.IndirectArgs, Reference.IndirectArgs);
+		bMergedDataMatches &= AreArraysEqual(MergedContext.DrawCommandDescs, Reference.DrawCommandDescs);
+		bMergedDataMatches &= AreArraysEqual(MergedContext.PayloadData, Reference.PayloadData);
+		bMergedDataMatches &= AreArraysEqual(MergedContext.InstanceIdOffsets, Reference.InstanceIdOffsets);
+		bMergedDataMatches &= AreArraysEqual(MergedContext.DrawCommandCompactionData, Reference.DrawCommandCompactionData);
+		bMergedDataMatches &= AreArraysEqual(MergedContext.CompactionBlockDataIndices, Reference.CompactionBlockDataIndices);
+
+		for (int32 BinIndex = 0; BinIndex < NumBins; ++BinIndex)
+		{
+			bLoadBalancersMatch &= AreLoadBalancersEqual(MergedContext.LoadBalancers[BinIndex], Reference.LoadBalancers[BinIndex]);
+			bLoadBalancersMatch &= AreArraysEqual(MergedContext.BatchInds[BinIndex], Reference.BatchInds[BinIndex]);
+		}
+
+		bBatchInfosMatch &= AreArraysEqual(MergedContext.BatchInfos, Reference.BatchInfos);
+
+		for (int32 ContextIndex = 0; ContextIndex < NumContexts; ++ContextIndex)
+		{
+			bDrawParamsMatch &= DrawParams[ContextIndex].InstanceDataByteOffset == Reference.InstanceDataByteOffsets[ContextIndex];
+			bDrawParamsMatch &= DrawParams[ContextIndex].IndirectArgsByteOffset == Reference.IndirectArgsByteOffsets[ContextIndex];
+		}
+	}
+
+	TestTrue(TEXT("Merged draw, payload, view and compaction data match the serial merge"), bMergedDataMatches);
+	TestTrue(TEXT("Merged load balancer bins and batch indices match the serial merge"), bLoadBalancersMatch);
+	TestTrue(TEXT("Batch infos match the serial merge"), bBatchInfosMatch);
+	TestTrue(TEXT("Draw parameter offsets match the serial merge"), bDrawParamsMatch);
+
+	AddInfo(FString::Printf(TEXT("%d contexts: serial reference %.2fms, MergeBatches %.2fms"),
+		TotalContexts,
+		FPlatformTime::ToMilliseconds64(ReferenceCycles),
+		FPlatformTime::ToMilliseconds64(MergeCycles)));
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
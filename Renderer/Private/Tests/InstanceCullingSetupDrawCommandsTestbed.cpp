@@ -0,0 +1,233 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "RHI.h"
+#include "RenderingThread.h"
+#include "InstanceCulling/InstanceCullingManager.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FInstanceCullingSetupDrawCommandsTestbed, "System.Renderer.InstanceCulling.SetupDrawCommands", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace InstanceCullingSetupDrawCommandsTestbed
+{
+
+/** Instance runs shared by the visible commands using a run array, as inclusive [Start, End] pairs. */
+static const uint32 InstanceRuns[] = { 0, 3, 8, 8, 12, 63, 100, 227 };
+
+/** A pass worth of sorted visible mesh draw commands, with runs of identical state buckets that get dynamically instanced. */
+struct FPass
+{
+	TArray<FMeshDrawCommand> MeshDrawCommands;
+	FMeshCommandOneFrameArray VisibleMeshDrawCommands;
+};
+
+static void BuildPass(FRandomStream& Random, int32 NumMeshDrawCommands, int32 NumVisibleMeshDrawCommands, FPass& Pass)
+{
+	Pass.MeshDrawCommands.SetNum(NumMeshDrawCommands);
+	for (FMeshDrawCommand& MeshDrawCommand : Pass.MeshDrawCommands)
+	{
+		MeshDrawCommand.PrimitiveType = Random.FRand() < 0.9f ? PT_TriangleList : PT_TriangleStrip;
+		MeshDrawCommand.NumPrimitives = uint32(Random.RandRange(1, 4096));
+		MeshDrawCommand.FirstIndex = uint32(Random.RandRange(0, 1 << 16));
+		MeshDrawCommand.VertexParams.BaseVertexIndex = uint32(Random.RandRange(0, 1 << 16));
+		MeshDrawCommand.NumInstances = Random.FRand() < 0.8f ? 1U : uint32(Random.RandRange(2, 64));
+	}
+
+	Pass.VisibleMeshDrawCommands.Reset(NumVisibleMeshDrawCommands);
+	int32 StateBucketId = 0;
+	while (Pass.VisibleMeshDrawCommands.Num() < NumVisibleMeshDrawCommands)
+	{
+		const int32 MeshDrawCommandIndex = Random.RandRange(0, NumMeshDrawCommands - 1);
+		const FMeshDrawCommand& MeshDrawCommand = Pass.MeshDrawCommands[MeshDrawCommandIndex];
+
+		// Commands without a state bucket are never merged, the others come in runs of a few hundred at most so some straddle the chunks
+		const bool bInStateBucket = Random.FRand() < 0.75f;
+		const int32 RunLength = bInStateBucket ? FMath::Min(Random.RandRange(1, 300), NumVisibleMeshDrawCommands - Pass.VisibleMeshDrawCommands.Num()) : 1;
+
+		EFVisibleMeshDrawCommandFlags Flags = EFVisibleMeshDrawCommandFlags::HasPrimitiveIdStreamIndex;
+		if (Random.FRand() < 0.1f)
+		{
+			EnumAddFlags(Flags, EFVisibleMeshDrawCommandFlags::MaterialUsesWorldPositionOffset);
+		}
+		if (Random.FRand() < 0.05f)
+		{
+			EnumAddFlags(Flags, EFVisibleMeshDrawCommandFlags::ForceInstanceCulling);
+		}
+		if (Random.FRand() < 0.1f)
+		{
+			EnumAddFlags(Flags, EFVisibleMeshDrawCommandFlags::PreserveInstanceOrder);
+		}
+		const bool bUseRuns = Random.FRand() < 0.05f;
+
+		FMeshDrawCommandCullingPayload CullingPayload;
+		CullingPayload.LodIndex = uint32(Random.RandRange(0, 7));
+
+		for (int32 RunIndex = 0; RunIndex < RunLength; ++RunIndex)
+		{
+			FMeshDrawCommandPrimitiveIdInfo PrimitiveIdInfo(Random.RandRange(0, 1 << 16), FPersistentPrimitiveIndex{ Random.RandRange(0, 1 << 16) }, Random.RandRange(0, 1 << 20));
+			PrimitiveIdInfo.bIsDynamicPrimitive = Random.FRand() < 0.1f;
+
+			FVisibleMeshDrawCommand& VisibleMeshDrawCommand = Pass.VisibleMeshDrawCommands.AddDefaulted_GetRef();
+			VisibleMeshDrawCommand.Setup(
+				&MeshDrawCommand,
+				PrimitiveIdInfo,
+				bInStateBucket ? StateBucketId : -1,
+				FM_Solid,
+				CM_CW,
+				Flags,
+				FMeshDrawCommandSortKey::Default,
+				CullingPayload,
+				EMeshDrawCommandCullingPayloadFlags::Default,
+				bUseRuns ? InstanceRuns : nullptr,
+				bUseRuns ? int32(UE_ARRAY_COUNT(InstanceRuns) / 2) : 0);
+		}
+		++StateBucketId;
+	}
+}
+
+struct FSetupResult
+{
+	TUniquePtr<FInstanceCullingContext> Context;
+	FMeshCommandOneFrameArray VisibleMeshDrawCommands;
+	int32 MaxInstances = 0;
+	int32 VisibleMeshDrawCommandsNum = 0;
+	int32 NewPassVisibleMeshDrawCommandsNum = 0;
+	uint64 Cycles = 0;
+};
+
+static void RunSetup(const FPass& Pass, TConstArrayView<int32> ViewIds, int32 Parallel, FSetupResult& Result)
+{
+	IConsoleVariable* CVarParallel = IConsoleManager::Get().FindConsoleVariable(TEXT("r.InstanceCulling.ParallelSetupDrawCommands"));
+	const int32 PreviousParallel = CVarParallel->GetInt();
+	CVarParallel->Set(Parallel, ECVF_SetByCode);
+	// The setting is render thread safe, so make sure the new value is visible before running the setup here
+	FlushRenderingCommands();
+
+	Result.Context = MakeUnique<FInstanceCullingContext>(TEXT("SetupDrawCommandsTestbed"), GMaxRHIShaderPlatform, nullptr, ViewIds, TRefCountPtr<IPooledRenderTarget>());
+	Result.VisibleMeshDrawCommands = Pass.VisibleMeshDrawCommands;
+
+	const uint64 Time0 = FPlatformTime::Cycles64();
+	Result.Context->SetupDrawCommands(Result.VisibleMeshDrawCommands, true, nullptr, Result.MaxInstances, Result.VisibleMeshDrawCommandsNum, Result.NewPassVisibleMeshDrawCommandsNum);
+	Result.Cycles = FPlatformTime::Cycles64() - Time0;
+
+	for (FInstanceProcessingGPULoadBalancer* LoadBalancer : Result.Context->LoadBalancers)
+	{
+		LoadBalancer->FinalizeBatches();
+	}
+
+	CVarParallel->Set(PreviousParallel, ECVF_SetByCode);
+	FlushRenderingCommands();
+}
+
+/** Bitwise comparison, all the compared element types are plain packed integers. */
+template <typename ArrayTypeA, typename ArrayTypeB>
+static bool AreArraysEqual(const ArrayTypeA& A, const ArrayTypeB& B)
+{
+	static_assert(sizeof(typename ArrayTypeA::ElementType) == sizeof(typename ArrayTypeB::ElementType), "Mismatched element types");
+	return A.Num() == B.Num() && (A.Num() == 0 || FMemory::Memcmp(A.GetData(), B.GetData(), A.Num() * sizeof(typename ArrayTypeA::ElementType)) == 0);
+}
+
+static bool AreContextsEqual(const FInstanceCullingContext& A, const FInstanceCullingContext& B)
+{
+	bool bEqual = A.TotalInstances == B.TotalInstances
+		&& A.NumCompactionInstances == B.NumCompactionInstances
+		&& AreArraysEqual(A.MeshDrawCommandInfos, B.MeshDrawCommandInfos)
+		&& AreArraysEqual(A.IndirectArgs, B.IndirectArgs)
+		&& AreArraysEqual(A.DrawCommandDescs, B.DrawCommandDescs)
+		&& AreArraysEqual(A.PayloadData, B.PayloadData)
+		&& AreArraysEqual(A.InstanceIdOffsets, B.InstanceIdOffsets)
+		&& AreArraysEqual(A.DrawCommandCompactionData, B.DrawCommandCompactionData)
+		&& AreArraysEqual(A.CompactionBlockDataIndices, B.CompactionBlockDataIndices);
+
+	for (uint32 Mode = 0U; Mode < uint32(EBatchProcessingMode::Num); ++Mode)
+	{
+		const FInstanceProcessingGPULoadBalancer& LoadBalancerA = *A.LoadBalancers[Mode];
+		const FInstanceProcessingGPULoadBalancer& LoadBalancerB = *B.LoadBalancers[Mode];
+		bEqual &= LoadBalancerA.GetTotalNumInstances() == LoadBalancerB.GetTotalNumInstances()
+			&& AreArraysEqual(LoadBalancerA.GetBatches(), LoadBalancerB.GetBatches())
+			&& AreArraysEqual(LoadBalancerA.GetItems(), LoadBalancerB.GetItems());
+	}
+	return bEqual;
+}
+
+static bool AreRetainedCommandsEqual(const FMeshCommandOneFrameArray& A, const FMeshCommandOneFrameArray& B)
+{
+	if (A.Num() != B.Num())
+	{
+		return false;
+	}
+	for (int32 Index = 0; Index < A.Num(); ++Index)
+	{
+		if (A[Index].MeshDrawCommand != B[Index].MeshDrawCommand
+			|| A[Index].StateBucketId != B[Index].StateBucketId
+			|| A[Index].PrimitiveIdInfo.InstanceSceneDataOffset != B[Index].PrimitiveIdInfo.InstanceSceneDataOffset)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+} // InstanceCullingSetupDrawCommandsTestbed
+
+bool FInstanceCullingSetupDrawCommandsTestbed::RunTest(const FString& Parameters)
+{
+	using namespace InstanceCullingSetupDrawCommandsTestbed;
+
+	FRandomStream Random(0x49435344);
+
+	IConsoleVariable* CVarChunkSize = IConsoleManager::Get().FindConsoleVariable(TEXT("r.InstanceCulling.ParallelSetupDrawCommands.ChunkSize"));
+	const int32 ChunkSize = CVarChunkSize->GetInt();
+
+	if (PlatformGPUSceneUsesUniformBufferView(GMaxRHIShaderPlatform))
+	{
+		AddInfo(TEXT("The shader platform uses uniform buffer views, SetupDrawCommands always takes the serial path"));
+	}
+
+	const int32 SingleView[] = { 0 };
+	const int32 MultiView[] = { 0, 1, 2, 3 };
+
+	bool bContextsMatch = true;
+	bool bRetainedCommandsMatch = true;
+	bool bStatsMatch = true;
+
+	// Below, at and well above the two chunk threshold of the parallel path
+	for (int32 NumVisibleMeshDrawCommands : { ChunkSize, 2 * ChunkSize + 1, 64 * ChunkSize })
+	{
+		for (TConstArrayView<int32> ViewIds : { TConstArrayView<int32>(SingleView), TConstArrayView<int32>(MultiView) })
+		{
+			FPass Pass;
+			BuildPass(Random, 4096, NumVisibleMeshDrawCommands, Pass);
+
+			FSetupResult Serial;
+			FSetupResult Parallel;
+			RunSetup(Pass, ViewIds, 0, Serial);
+			RunSetup(Pass, ViewIds, 1, Parallel);
+
+			bContextsMatch &= AreContextsEqual(*Serial.Context, *Parallel.Context);
+			bRetainedCommandsMatch &= AreRetainedCommandsEqual(Serial.VisibleMeshDrawCommands, Parallel.VisibleMeshDrawCommands);
+			bStatsMatch &= Serial.MaxInstances == Parallel.MaxInstances
+				&& Serial.VisibleMeshDrawCommandsNum == Parallel.VisibleMeshDrawCommandsNum
+				&& Serial.NewPassVisibleMeshDrawCommandsNum == Parallel.NewPassVisibleMeshDrawCommandsNum;
+
+			AddInfo(FString::Printf(TEXT("%d commands, %d views -> %d draws, %u instances: serial %.2fms, parallel %.2fms"),
+				NumVisibleMeshDrawCommands,
+				ViewIds.Num(),
+				Serial.NewPassVisibleMeshDrawCommandsNum,
+				Serial.Context->TotalInstances,
+				FPlatformTime::ToMilliseconds64(Serial.Cycles),
+				FPlatformTime::ToMilliseconds64(Parallel.Cycles)));
+		}
+	}
+
+	TestTrue(TEXT("Parallel setup produces the same draws, instances, payloads and compaction data as the serial setup"), bContextsMatch);
+	TestTrue(TEXT("Parallel setup retains the same visible mesh draw commands as the serial setup"), bRetainedCommandsMatch);
+	TestTrue(TEXT("Parallel setup reports the same instancing stats as the serial setup"), bStatsMatch);
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
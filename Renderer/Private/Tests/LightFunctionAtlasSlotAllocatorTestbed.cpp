@@ -0,0 +1,296 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "LightFunctionAtlas.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLightFunctionAtlasSlotAllocatorTestbed, "System.Renderer.LightFunctionAtlas.SlotAllocator", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace LightFunctionAtlasSlotAllocatorTestbed
+{
+
+using namespace LightFunctionAtlas;
+
+static FLightFunctionSlotContent MakeContent(uint32 MaterialId, uint32 ParameterHash = 0, bool bTimeVarying = false)
+{
+	FLightFunctionSlotContent Content;
+	Content.LFMaterialUniqueID = MaterialId;
+	Content.LightFunctionMaterial = reinterpret_cast<const FMaterialRenderProxy*>(UPTRINT(MaterialId) * 16);
+	Content.ParameterHash = ParameterHash;
+	Content.bTimeVarying = bTimeVarying;
+	return Content;
+}
+
+/** Result of an allocation pass over requests in priority order, as FLightFunctionAtlas::AllocateAtlasSlots de-duplicates them. */
+struct FPassResult
+{
+	TMap<uint32, int32> MaterialToSlot;
+	TArray<uint32> Rejected;
+	int32 NumDirty = 0;
+};
+
+static FPassResult RunPass(FLightFunctionAtlasSlotAllocator& Allocator, TConstArrayView<FLightFunctionSlotContent> Requests, double Time)
+{
+	FPassResult Result;
+	Allocator.BeginAllocation(Time);
+
+	for (const FLightFunctionSlotContent& Content : Requests)
+	{
+		if (Result.MaterialToSlot.Contains(Content.LFMaterialUniqueID) || Result.Rejected.Contains(Content.LFMaterialUniqueID))
+		{
+			continue;
+		}
+		if (uint32(Result.MaterialToSlot.Num()) >= Allocator.GetSlotCount())
+		{
+			Result.Rejected.Add(Content.LFMaterialUniqueID);
+			continue;
+		}
+
+		const int32 SlotIndex = Allocator.RequestSlot(Content);
+		if (SlotIndex == INDEX_NONE)
+		{
+			Result.Rejected.Add(Content.LFMaterialUniqueID);
+			continue;
+		}
+		Result.MaterialToSlot.Add(Content.LFMaterialUniqueID, SlotIndex);
+	}
+
+	for (const TPair<uint32, int32>& Pair : Result.MaterialToSlot)
+	{
+		Result.NumDirty += Allocator.IsSlotDirty(Pair.Value) ? 1 : 0;
+	}
+	Allocator.MarkRequestedSlotsRendered();
+	return Result;
+}
+
+/** Every requested material has its own slot. */
+static bool HasUniqueSlots(const FPassResult& Result)
+{
+	TSet<int32> UsedSlots;
+	for (const TPair<uint32, int32>& Pair : Result.MaterialToSlot)
+	{
+		bool bAlreadyInSet = false;
+		UsedSlots.Add(Pair.Value, &bAlreadyInSet);
+		if (bAlreadyInSet)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+} // LightFunctionAtlasSlotAllocatorTestbed
+
+bool FLightFunctionAtlasSlotAllocatorTestbed::RunTest(const FString& Parameters)
+{
+	using namespace LightFunctionAtlasSlotAllocatorTestbed;
+
+	const uint32 SlotCount = 16;
+
+	// Slots don't move when the priority order jitters, and static content is only rendered once
+	{
+		FLightFunctionAtlasSlotAllocator Allocator;
+		Allocator.Reset(SlotCount);
+
+		TArray<FLightFunctionSlotContent> Requests;
+		for (uint32 MaterialId = 1; MaterialId <= 12; ++MaterialId)
+		{
+			Requests.Add(MakeContent(MaterialId));
+		}
+
+		FRandomStream Random(0x4C46);
+		const FPassResult First = RunPass(Allocator, Requests, 0.0);
+		TestEqual(TEXT("Jitter: all slots rendered on the first pass"), First.NumDirty, Requests.Num());
+
+		bool bStable = true;
+		int32 NumDirty = 0;
+		for (int32 Frame = 1; Frame < 64; ++Frame)
+		{
+			// Swap a few neighbours, like lights at similar distance to the views
+			for (int32 Swap = 0; Swap < 4; ++Swap)
+			{
+				const int32 Index = Random.RandRange(0, Requests.Num() - 2);
+				Requests.Swap(Index, Index + 1);
+			}
+
+			const FPassResult Result = RunPass(Allocator, Requests, double(Frame));
+			bStable &= Result.MaterialToSlot.OrderIndependentCompareEqual(First.MaterialToSlot);
+			NumDirty += Result.NumDirty;
+		}
+		TestTrue(TEXT("Jitter: slots are stable"), bStable);
+		TestEqual(TEXT("Jitter: static slots are not rendered again"), NumDirty, 0);
+	}
+
+	// Dirty detection: content changes, time varying content and lost atlas content
+	{
+		FLightFunctionAtlasSlotAllocator Allocator;
+		Allocator.Reset(SlotCount);
+
+		TArray<FLightFunctionSlotContent> Requests = { MakeContent(1), MakeContent(2), MakeContent(3, 0, true) };
+		RunPass(Allocator, Requests, 0.0);
+
+		TestEqual(TEXT("Dirty: nothing changed at the same time"), RunPass(Allocator, Requests, 0.0).NumDirty, 0);
+		TestEqual(TEXT("Dirty: time varying slot rendered when time changes"), RunPass(Allocator, Requests, 1.0).NumDirty, 1);
+		TestEqual(TEXT("Dirty: nothing rendered while the world is paused"), RunPass(Allocator, Requests, 1.0).NumDirty + RunPass(Allocator, Requests, 1.0).NumDirty, 0);
+
+		Requests[1].ParameterHash = 42;
+		const FPassResult Changed = RunPass(Allocator, Requests, 1.0);
+		TestEqual(TEXT("Dirty: changed parameters are rendered"), Changed.NumDirty, 1);
+		TestTrue(TEXT("Dirty: changed parameters keep their slot"), Changed.MaterialToSlot[2] == RunPass(Allocator, Requests, 1.0).MaterialToSlot[2]);
+
+		Allocator.BeginAllocation(1.0);
+		for (const FLightFunctionSlotContent& Content : Requests)
+		{
+			Allocator.RequestSlot(Content);
+		}
+		Allocator.MarkRequestedSlotsDirty();
+		int32 NumDirtyAfterLoss = 0;
+		for (const FLightFunctionSlotContent& Content : Requests)
+		{
+			NumDirtyAfterLoss += Allocator.IsSlotDirty(Allocator.RequestSlot(Content)) ? 1 : 0;
+		}
+		Allocator.MarkRequestedSlotsRendered();
+		TestEqual(TEXT("Dirty: all requested slots rendered when the atlas is lost"), NumDirtyAfterLoss, Requests.Num());
+	}
+
+	// Parameter change: a MID parameter updates the material uniform buffer in place, the proxy and shader map stay the same
+	{
+		const FMaterialRenderProxy* MaterialProxy = reinterpret_cast<const FMaterialRenderProxy*>(UPTRINT(1) * 16);
+		const FMaterialShaderMap* ShaderMap = reinterpret_cast<const FMaterialShaderMap*>(UPTRINT(2) * 16);
+
+		TArray<uint8> ParameterData;
+		ParameterData.SetNumZeroed(64);
+		const FVector4f VectorParameter(1.0f, 0.5f, 0.25f, 1.0f);
+		FMemory::Memcpy(&ParameterData[16], &VectorParameter, sizeof(VectorParameter));
+		const uint32 Hash = HashLightFunctionParameters(MaterialProxy, ShaderMap, ParameterData);
+		TestEqual(TEXT("Parameters: same values give the same hash"), HashLightFunctionParameters(MaterialProxy, ShaderMap, ParameterData), Hash);
+
+		FLightFunctionAtlasSlotAllocator Allocator;
+		Allocator.Reset(SlotCount);
+		TArray<FLightFunctionSlotContent> Requests = { MakeContent(1, Hash) };
+		RunPass(Allocator, Requests, 0.0);
+
+		// Scalar parameter changes
+		ParameterData[16] ^= 0x01;
+		Requests[0].ParameterHash = HashLightFunctionParameters(MaterialProxy, ShaderMap, ParameterData);
+		TestNotEqual(TEXT("Parameters: changed value changes the hash"), Requests[0].ParameterHash, Hash);
+		TestEqual(TEXT("Parameters: changed value renders the slot"), RunPass(Allocator, Requests, 0.0).NumDirty, 1);
+		TestEqual(TEXT("Parameters: unchanged value doesn't render the slot again"), RunPass(Allocator, Requests, 0.0).NumDirty, 0);
+
+		// Texture parameter changes, the texture reference is part of the uniform buffer content
+		UPTRINT TextureReference = 0x1230;
+		FMemory::Memcpy(&ParameterData[48], &TextureReference, sizeof(TextureReference));
+		Requests[0].ParameterHash = HashLightFunctionParameters(MaterialProxy, ShaderMap, ParameterData);
+		TestEqual(TEXT("Parameters: changed texture renders the slot"), RunPass(Allocator, Requests, 0.0).NumDirty, 1);
+	}
+
+	// Time dependence: a material animated by a Time node has unchanged parameters, it is rendered again as the world time advances unless static materials are opted in
+	{
+		TestTrue(TEXT("Time: materials are time varying by default"), IsLightFunctionTimeVarying(false, false));
+		TestFalse(TEXT("Time: opted in static materials are not time varying"), IsLightFunctionTimeVarying(false, true));
+		TestTrue(TEXT("Time: parameter collections are always time varying"), IsLightFunctionTimeVarying(true, true));
+
+		const uint32 Hash = 0x1234;
+		FLightFunctionAtlasSlotAllocator TimeDependentAllocator;
+		FLightFunctionAtlasSlotAllocator StaticAllocator;
+		TimeDependentAllocator.Reset(SlotCount);
+		StaticAllocator.Reset(SlotCount);
+
+		const TArray<FLightFunctionSlotContent> TimeDependentRequests = { MakeContent(1, Hash, IsLightFunctionTimeVarying(false, false)) };
+		const TArray<FLightFunctionSlotContent> StaticRequests = { MakeContent(1, Hash, IsLightFunctionTimeVarying(false, true)) };
+		RunPass(TimeDependentAllocator, TimeDependentRequests, 0.0);
+		RunPass(StaticAllocator, StaticRequests, 0.0);
+
+		const int32 NumFrames = 8;
+		int32 NumTimeDependentRendered = 0;
+		int32 NumStaticRendered = 0;
+		for (int32 Frame = 1; Frame <= NumFrames; ++Frame)
+		{
+			const double Time = double(Frame) / 30.0;
+			NumTimeDependentRendered += RunPass(TimeDependentAllocator, TimeDependentRequests, Time).NumDirty;
+			NumStaticRendered += RunPass(StaticAllocator, StaticRequests, Time).NumDirty;
+		}
+
+		TestEqual(TEXT("Time: time dependent material with unchanged parameters is rendered every frame"), NumTimeDependentRendered, NumFrames);
+		TestEqual(TEXT("Time: time dependent material is not rendered while the world is paused"), RunPass(TimeDependentAllocator, TimeDependentRequests, double(NumFrames) / 30.0).NumDirty, 0);
+		TestEqual(TEXT("Time: opted in static material with unchanged parameters is not rendered again"), NumStaticRendered, 0);
+	}
+
+	// Hysteresis: a material that is not requested for a while keeps its slot and content until the slot is needed
+	{
+		FLightFunctionAtlasSlotAllocator Allocator;
+		Allocator.Reset(4);
+
+		TArray<FLightFunctionSlotContent> Requests = { MakeContent(1), MakeContent(2), MakeContent(3), MakeContent(4) };
+		const FPassResult First = RunPass(Allocator, Requests, 0.0);
+
+		// Material 4 goes out of range for a few frames
+		TArray<FLightFunctionSlotContent> Partial = { MakeContent(1), MakeContent(2), MakeContent(3) };
+		RunPass(Allocator, Partial, 0.0);
+		RunPass(Allocator, Partial, 0.0);
+		const FPassResult Back = RunPass(Allocator, Requests, 0.0);
+		TestEqual(TEXT("Hysteresis: returning material keeps its slot"), Back.MaterialToSlot[4], First.MaterialToSlot[4]);
+		TestEqual(TEXT("Hysteresis: returning material is not rendered again"), Back.NumDirty, 0);
+
+		// A new material takes the least recently requested slot, material 2 here
+		RunPass(Allocator, { MakeContent(1), MakeContent(3), MakeContent(4) }, 0.0);
+		const FPassResult Evicted = RunPass(Allocator, { MakeContent(1), MakeContent(3), MakeContent(4), MakeContent(5) }, 0.0);
+		TestEqual(TEXT("Hysteresis: new material takes the least recently requested slot"), Evicted.MaterialToSlot[5], First.MaterialToSlot[2]);
+		TestEqual(TEXT("Hysteresis: only the new material is rendered"), Evicted.NumDirty, 1);
+	}
+
+	// Over capacity: the highest priority materials get a slot, as without persistent slots
+	{
+		FLightFunctionAtlasSlotAllocator Allocator;
+		Allocator.Reset(SlotCount);
+
+		FRandomStream Random(0x534C4F54);
+		bool bPriorityMatches = true;
+		bool bUniqueSlots = true;
+		int32 NumRendered = 0;
+		int32 NumRenderedWithoutPersistentSlots = 0;
+
+		for (int32 Frame = 0; Frame < 256; ++Frame)
+		{
+			TArray<FLightFunctionSlotContent> Requests;
+			const int32 NumRequests = Random.RandRange(1, 48);
+			for (int32 Index = 0; Index < NumRequests; ++Index)
+			{
+				Requests.Add(MakeContent(uint32(Random.RandRange(1, 32))));
+			}
+
+			const FPassResult Result = RunPass(Allocator, Requests, 0.0);
+			bUniqueSlots &= HasUniqueSlots(Result);
+			NumRendered += Result.NumDirty;
+			NumRenderedWithoutPersistentSlots += Result.MaterialToSlot.Num();
+
+			// Reference: the first SlotCount distinct materials in priority order
+			TArray<uint32> Expected;
+			for (const FLightFunctionSlotContent& Content : Requests)
+			{
+				if (uint32(Expected.Num()) < SlotCount)
+				{
+					Expected.AddUnique(Content.LFMaterialUniqueID);
+				}
+			}
+			bPriorityMatches &= Expected.Num() == Result.MaterialToSlot.Num();
+			for (uint32 MaterialId : Expected)
+			{
+				bPriorityMatches &= Result.MaterialToSlot.Contains(MaterialId);
+			}
+		}
+
+		TestTrue(TEXT("Capacity: each material has its own slot"), bUniqueSlots);
+		TestTrue(TEXT("Capacity: same materials get a slot as without persistent slots"), bPriorityMatches);
+		TestTrue(TEXT("Capacity: fewer slots rendered than without persistent slots"), NumRendered < NumRenderedWithoutPersistentSlots);
+
+		AddInfo(FString::Printf(TEXT("Random requests over capacity: %d slots rendered, %d without persistent slots"), NumRendered, NumRenderedWithoutPersistentSlots));
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
@@ -0,0 +1,186 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "MaterialCache/MaterialCachePageBatch.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMaterialCachePageBatchTestbed, "System.Renderer.MaterialCache.PageBatch", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace MaterialCachePageBatchTestbed
+{
+
+static FPrimitiveComponentId MakePrimitiveId(uint32 Value)
+{
+	FPrimitiveComponentId Id;
+	Id.PrimIDValue = Value;
+	return Id;
+}
+
+/** Materials are only hashed and compared, never dereferenced */
+static FMaterialCacheStack MakeStack(std::initializer_list<UPTRINT> Materials)
+{
+	FMaterialCacheStack Stack;
+	for (UPTRINT Material : Materials)
+	{
+		Stack.Stack.Add({ reinterpret_cast<const FMaterialRenderProxy*>(Material) });
+	}
+	return Stack;
+}
+
+struct FRandomBatch
+{
+	TArray<FPrimitiveComponentId> EntryPrimitiveIds;
+	TArray<int32> EntryPageCounts;
+	TArray<FMaterialCacheStack> PageStacks;
+};
+
+static FRandomBatch MakeRandomBatch(FRandomStream& Random, int32 NumEntries, int32 NumPrimitives, int32 NumMaterials)
+{
+	FRandomBatch Batch;
+	for (int32 EntryIndex = 0; EntryIndex < NumEntries; EntryIndex++)
+	{
+		// Zero is an invalid id, i.e. a skipped entry
+		Batch.EntryPrimitiveIds.Add(MakePrimitiveId(Random.RandRange(0, NumPrimitives)));
+		Batch.EntryPageCounts.Add(Random.RandRange(0, 6));
+
+		for (int32 PageIndex = 0; PageIndex < Batch.EntryPageCounts.Last(); PageIndex++)
+		{
+			FMaterialCacheStack& Stack = Batch.PageStacks.AddDefaulted_GetRef();
+			for (int32 StackIndex = Random.RandRange(0, 3); StackIndex > 0; StackIndex--)
+			{
+				Stack.Stack.Add({ reinterpret_cast<const FMaterialRenderProxy*>(UPTRINT(0x100 * (1 + Random.RandRange(0, NumMaterials - 1)))) });
+			}
+		}
+	}
+	return Batch;
+}
+
+static bool AreBatchesEqual(const FMaterialCachePageBatch& A, const FMaterialCachePageBatch& B)
+{
+	if (A.EntryGroups != B.EntryGroups ||
+		A.EntryPageOffsets != B.EntryPageOffsets ||
+		A.EntryABufferPageOffsets != B.EntryABufferPageOffsets ||
+		A.PageStackIndices != B.PageStackIndices ||
+		A.UniqueStackGroups != B.UniqueStackGroups ||
+		A.UniqueStacks.Num() != B.UniqueStacks.Num())
+	{
+		return false;
+	}
+
+	for (int32 UniqueStackIndex = 0; UniqueStackIndex < A.UniqueStacks.Num(); UniqueStackIndex++)
+	{
+		if (!AreMaterialCacheStacksEqual(A.UniqueStacks[UniqueStackIndex], B.UniqueStacks[UniqueStackIndex]))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+} // MaterialCachePageBatchTestbed
+
+bool FMaterialCachePageBatchTestbed::RunTest(const FString& Parameters)
+{
+	using namespace MaterialCachePageBatchTestbed;
+
+	// Fixed layout, primitives interleaved across entries, one skipped entry
+	{
+		const FPrimitiveComponentId EntryPrimitiveIds[] = { MakePrimitiveId(7), MakePrimitiveId(3), FPrimitiveComponentId(), MakePrimitiveId(7) };
+		const int32 EntryPageCounts[] = { 2, 1, 2, 3 };
+
+		TArray<FMaterialCacheStack> PageStacks;
+		PageStacks.Add(MakeStack({ 0x100, 0x200 }));	// Primitive 7
+		PageStacks.Add(MakeStack({ }));					// Primitive 7, empty
+		PageStacks.Add(MakeStack({ 0x100, 0x200 }));	// Primitive 3, same stack as primitive 7 but a different group
+		PageStacks.Add(MakeStack({ 0x100 }));			// Skipped
+		PageStacks.Add(MakeStack({ 0x100 }));			// Skipped
+		PageStacks.Add(MakeStack({ 0x200, 0x100 }));	// Primitive 7, different order
+		PageStacks.Add(MakeStack({ 0x100, 0x200 }));	// Primitive 7, same as the first page
+		PageStacks.Add(MakeStack({ 0x200, 0x100 }));	// Primitive 7
+
+		FMaterialCachePageBatch Batch;
+		MaterialCacheBuildPageBatch(EntryPrimitiveIds, EntryPageCounts, Batch);
+		MaterialCacheDeduplicatePageStacks(PageStacks, Batch);
+
+		TestEqual(TEXT("Group count"), Batch.NumGroups, 2);
+		TestTrue(TEXT("Entry groups"), Batch.EntryGroups == TArray<int32>({ 0, 1, INDEX_NONE, 0 }));
+		TestTrue(TEXT("Entry page offsets"), Batch.EntryPageOffsets == TArray<int32>({ 0, 2, 3, 5 }));
+		TestTrue(TEXT("A-buffer runs"), Batch.EntryABufferPageOffsets == TArray<uint32>({ 0u, 2u, UINT32_MAX, 3u }));
+		TestEqual(TEXT("A-buffer page count"), Batch.NumABufferPages, 6u);
+		TestTrue(TEXT("Page stacks"), Batch.PageStackIndices == TArray<int32>({ 0, INDEX_NONE, 1, INDEX_NONE, INDEX_NONE, 2, 0, 2 }));
+		TestTrue(TEXT("Unique stack groups"), Batch.UniqueStackGroups == TArray<int32>({ 0, 1, 0 }));
+		TestTrue(TEXT("Unique stacks keep their order"), AreMaterialCacheStacksEqual(Batch.UniqueStacks[2], MakeStack({ 0x200, 0x100 })));
+	}
+
+	// Random layouts, checks the invariants and that the layout only depends on the inputs
+	FRandomStream Random(0x3a7c);
+	for (int32 Iteration = 0; Iteration < 32; Iteration++)
+	{
+		const FRandomBatch Input = MakeRandomBatch(Random, Random.RandRange(1, 200), Random.RandRange(1, 16), Random.RandRange(1, 6));
+
+		FMaterialCachePageBatch Batches[2];
+		for (FMaterialCachePageBatch& Batch : Batches)
+		{
+			TArray<FMaterialCacheStack> PageStacks = Input.PageStacks;
+			MaterialCacheBuildPageBatch(Input.EntryPrimitiveIds, Input.EntryPageCounts, Batch);
+			MaterialCacheDeduplicatePageStacks(PageStacks, Batch);
+		}
+
+		const FMaterialCachePageBatch& Batch = Batches[0];
+		TestTrue(TEXT("Layout is deterministic"), AreBatchesEqual(Batches[0], Batches[1]));
+
+		bool bValid = true;
+		uint32 ExpectedABufferOffset = 0;
+		TMap<uint32, int32> PrimitiveGroups;
+		for (int32 EntryIndex = 0; EntryIndex < Input.EntryPrimitiveIds.Num(); EntryIndex++)
+		{
+			const int32 Group = Batch.EntryGroups[EntryIndex];
+			if (!Input.EntryPrimitiveIds[EntryIndex].IsValid())
+			{
+				bValid &= Group == INDEX_NONE;
+				continue;
+			}
+
+			// Groups are assigned in order of first appearance, a-buffer runs are contiguous and in entry order
+			const int32& ExpectedGroup = PrimitiveGroups.FindOrAdd(Input.EntryPrimitiveIds[EntryIndex].PrimIDValue, PrimitiveGroups.Num());
+			bValid &= Group == ExpectedGroup;
+			bValid &= Batch.EntryABufferPageOffsets[EntryIndex] == ExpectedABufferOffset;
+			ExpectedABufferOffset += Input.EntryPageCounts[EntryIndex];
+
+			for (int32 PageIndex = 0; PageIndex < Input.EntryPageCounts[EntryIndex]; PageIndex++)
+			{
+				const int32 FlatPageIndex = Batch.EntryPageOffsets[EntryIndex] + PageIndex;
+				const FMaterialCacheStack& Stack = Input.PageStacks[FlatPageIndex];
+				const int32 UniqueStackIndex = Batch.PageStackIndices[FlatPageIndex];
+				if (Stack.Stack.IsEmpty())
+				{
+					bValid &= UniqueStackIndex == INDEX_NONE;
+				}
+				else
+				{
+					bValid &= Batch.UniqueStackGroups[UniqueStackIndex] == Group && AreMaterialCacheStacksEqual(Batch.UniqueStacks[UniqueStackIndex], Stack);
+				}
+			}
+		}
+
+		// No duplicates within a group
+		for (int32 A = 0; A < Batch.UniqueStacks.Num(); A++)
+		{
+			for (int32 B = A + 1; B < Batch.UniqueStacks.Num(); B++)
+			{
+				bValid &= Batch.UniqueStackGroups[A] != Batch.UniqueStackGroups[B] || !AreMaterialCacheStacksEqual(Batch.UniqueStacks[A], Batch.UniqueStacks[B]);
+			}
+		}
+
+		bValid &= Batch.NumABufferPages == ExpectedABufferOffset && Batch.NumGroups == PrimitiveGroups.Num();
+		TestTrue(FString::Printf(TEXT("Random layout %d is valid"), Iteration), bValid);
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
@@ -0,0 +1,241 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "Nanite/NaniteMaterialsSceneExtension.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNaniteMaterialBufferDefragTestbed, "System.Renderer.Nanite.MaterialBufferDefrag", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace NaniteMaterialBufferDefragTestbed
+{
+
+using FBufferSpan = Nanite::FMaterialsSceneExtension::FBufferSpan;
+using FBufferMove = Nanite::FMaterialsSceneExtension::FBufferMove;
+
+static constexpr uint32 FreedValue = 0xDEADBEEFu;
+
+/** CPU stand in for the material data buffer, each primitive's span is filled with its index. */
+struct FSimulatedBuffer
+{
+	FSpanAllocator Allocator;
+	TSparseArray<FBufferSpan> Spans;
+	TArray<uint32> Data;
+
+	void Add(int32 NumDwords)
+	{
+		const int32 Index = Spans.Add({ INDEX_NONE, 0, uint32(NumDwords) });
+		FBufferSpan& Span = Spans[Index];
+		Span.Index = Index;
+		Span.Offset = Allocator.Allocate(NumDwords);
+		while (Data.Num() < Allocator.GetMaxSize())
+		{
+			Data.Add(FreedValue);
+		}
+		for (uint32 Dword = 0; Dword < Span.NumDwords; ++Dword)
+		{
+			Data[Span.Offset + Dword] = uint32(Index);
+		}
+	}
+
+	void Remove(int32 Index)
+	{
+		const FBufferSpan& Span = Spans[Index];
+		Allocator.Free(Span.Offset, Span.NumDwords);
+		for (uint32 Dword = 0; Dword < Span.NumDwords; ++Dword)
+		{
+			Data[Span.Offset + Dword] = FreedValue;
+		}
+		Spans.RemoveAt(Index);
+	}
+
+	int32 RandomLiveIndex(FRandomStream& Random) const
+	{
+		for (;;)
+		{
+			const int32 Index = Random.RandRange(0, Spans.GetMaxIndex() - 1);
+			if (Spans.IsValidIndex(Index))
+			{
+				return Index;
+			}
+		}
+	}
+
+	/** Same copies as FMaterialsSceneExtension::ExecuteBufferMoves, through a staging buffer. */
+	void ExecuteMoves(TConstArrayView<FBufferMove> Moves)
+	{
+		TArray<uint32> Staging;
+		for (const FBufferMove& Move : Moves)
+		{
+			Staging.Append(&Data[Move.SrcOffset], Move.NumDwords);
+		}
+		uint32 StagingOffset = 0;
+		for (const FBufferMove& Move : Moves)
+		{
+			FMemory::Memcpy(&Data[Move.DstOffset], &Staging[StagingOffset], Move.NumDwords * sizeof(uint32));
+			StagingOffset += Move.NumDwords;
+			Spans[Move.Index].Offset = Move.DstOffset;
+		}
+	}
+
+	bool IsIntact() const
+	{
+		for (const FBufferSpan& Span : Spans)
+		{
+			for (uint32 Dword = 0; Dword < Span.NumDwords; ++Dword)
+			{
+				if (Data[Span.Offset + Dword] != uint32(Span.Index))
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	int32 GetUsedSize() const
+	{
+		int32 UsedSize = 0;
+		for (const FBufferSpan& Span : Spans)
+		{
+			UsedSize += Span.NumDwords;
+		}
+		return UsedSize;
+	}
+};
+
+/** Same trigger as FMaterialsSceneExtension::ProcessBufferDefragmentation. */
+static bool NeedsDefrag(const FSpanAllocator& Allocator, int32 MinSizeDwords, float LowWaterMarkRatio)
+{
+	const int32 EffectiveMaxSize = FMath::RoundUpToPowerOfTwo(Allocator.GetMaxSize());
+	const int32 LowWaterMark = uint32(EffectiveMaxSize * LowWaterMarkRatio);
+	return EffectiveMaxSize > MinSizeDwords && Allocator.GetSparselyAllocatedSize() <= LowWaterMark;
+}
+
+static int32 RandomSpanSize(FRandomStream& Random)
+{
+	// Even sizes, as the material data is scattered in pairs of dwords
+	return 2 * Random.RandRange(1, 48);
+}
+
+/** Checks the moves of a frame: into holes below their source, and no copy writes a range another copy reads. */
+static bool MovesAreValid(TConstArrayView<FBufferMove> Moves, int32 BufferSize)
+{
+	TBitArray<> Sources(false, BufferSize);
+	for (const FBufferMove& Move : Moves)
+	{
+		if (Move.DstOffset + Move.NumDwords > Move.SrcOffset)
+		{
+			return false;
+		}
+		Sources.SetRange(Move.SrcOffset, Move.NumDwords, true);
+	}
+
+	TBitArray<> Destinations(false, BufferSize);
+	for (const FBufferMove& Move : Moves)
+	{
+		for (uint32 Dword = 0; Dword < Move.NumDwords; ++Dword)
+		{
+			if (Sources[Move.DstOffset + Dword] || Destinations[Move.DstOffset + Dword])
+			{
+				return false;
+			}
+		}
+		Destinations.SetRange(Move.DstOffset, Move.NumDwords, true);
+	}
+	return true;
+}
+
+} // NaniteMaterialBufferDefragTestbed
+
+bool FNaniteMaterialBufferDefragTestbed::RunTest(const FString& Parameters)
+{
+	using namespace NaniteMaterialBufferDefragTestbed;
+
+	FRandomStream Random(0x44465247);
+
+	const int32 MinSizeDwords = 1024;
+	const float LowWaterMarkRatio = 0.375f;
+	const int32 MaxMovesPerFrame = 256;
+
+	FSimulatedBuffer Buffer;
+
+	bool bMovesValid = true;
+	bool bWithinBudget = true;
+	bool bIntact = true;
+	bool bAllocatorMatches = true;
+	int32 NumDefragFrames = 0;
+	int32 NumStalledFrames = 0;
+	int32 PeakMovedDwords = 0;
+	int32 PeakFullUploadDwords = 0;
+
+	// Streaming world: levels loaded, then mostly unloaded, with primitives added and removed every frame
+	for (int32 Frame = 0; Frame < 512; ++Frame)
+	{
+		const int32 NumAdds = Frame < 32 ? 2048 : Random.RandRange(0, 32);
+		for (int32 AddIndex = 0; AddIndex < NumAdds; ++AddIndex)
+		{
+			Buffer.Add(RandomSpanSize(Random));
+		}
+
+		const int32 NumRemoves = (Frame % 128) == 64 ? Buffer.Spans.Num() * 3 / 4 : Random.RandRange(0, FMath::Min(32, Buffer.Spans.Num()));
+		for (int32 RemoveIndex = 0; RemoveIndex < NumRemoves; ++RemoveIndex)
+		{
+			Buffer.Remove(Buffer.RandomLiveIndex(Random));
+		}
+
+		Buffer.Allocator.Consolidate();
+		if (NeedsDefrag(Buffer.Allocator, MinSizeDwords, LowWaterMarkRatio))
+		{
+			++NumDefragFrames;
+
+			TArray<FBufferSpan> Spans;
+			for (const FBufferSpan& Span : Buffer.Spans)
+			{
+				Spans.Add(Span);
+			}
+
+			const int32 BufferSize = Buffer.Data.Num();
+			TArray<FBufferMove> Moves;
+			const int32 NumMoves = Nanite::FMaterialsSceneExtension::PlanBufferMoves(Buffer.Allocator, Spans, MaxMovesPerFrame, Moves);
+			NumStalledFrames += NumMoves == 0 ? 1 : 0;
+
+			bWithinBudget &= NumMoves == Moves.Num() && NumMoves <= MaxMovesPerFrame;
+			bMovesValid &= MovesAreValid(Moves, BufferSize);
+			Buffer.ExecuteMoves(Moves);
+
+			int32 MovedDwords = 0;
+			for (const FBufferMove& Move : Moves)
+			{
+				MovedDwords += Move.NumDwords;
+			}
+			PeakMovedDwords = FMath::Max(PeakMovedDwords, MovedDwords);
+			PeakFullUploadDwords = FMath::Max(PeakFullUploadDwords, Buffer.GetUsedSize());
+		}
+
+		bIntact &= Buffer.IsIntact();
+		bAllocatorMatches &= Buffer.Allocator.GetSparselyAllocatedSize() == Buffer.GetUsedSize();
+		bAllocatorMatches &= Buffer.Allocator.GetMaxSize() <= Buffer.Data.Num();
+	}
+
+	TestTrue(TEXT("Defrag was triggered"), NumDefragFrames > 0);
+	TestTrue(TEXT("Moves stay within the per frame budget"), bWithinBudget);
+	TestTrue(TEXT("Moves go into holes below their source without overlapping other moves"), bMovesValid);
+	TestTrue(TEXT("Material data is intact after the moves"), bIntact);
+	TestTrue(TEXT("Allocator matches the live spans"), bAllocatorMatches);
+	TestTrue(TEXT("Defrag makes progress"), NumStalledFrames < NumDefragFrames);
+	TestFalse(TEXT("Buffer is compacted above the low water mark"), NeedsDefrag(Buffer.Allocator, MinSizeDwords, LowWaterMarkRatio));
+	TestTrue(TEXT("Peak copy size is below a full re-upload"), PeakMovedDwords < PeakFullUploadDwords);
+
+	AddInfo(FString::Printf(TEXT("%d defrag frames (%d without moves): peak %d dwords moved per frame, full re-upload %d dwords"),
+		NumDefragFrames,
+		NumStalledFrames,
+		PeakMovedDwords,
+		PeakFullUploadDwords));
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
@@ -0,0 +1,200 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "Nanite/NaniteShared.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNaniteRasterBinCompactionTestbed, "System.Renderer.Nanite.RasterBinCompaction", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace NaniteRasterBinCompactionTestbed
+{
+
+static constexpr int32 NumFixedFunctionBins = NANITE_FIXED_FUNCTION_BIN_MASK + 1;
+
+/** Stand in for a primitive's registered bin (FPrimitiveSceneInfo::NaniteRasterBins), with an optional custom pass registration. */
+struct FBinHolder
+{
+	FNaniteRasterPipeline Pipeline;
+	FNaniteRasterBin RasterBin;
+	bool bCustomPass = false;
+};
+
+static FNaniteRasterPipeline MakePipeline(int32 MaterialIndex, bool bPerPixelEval)
+{
+	FNaniteRasterPipeline Pipeline;
+	Pipeline.RasterMaterial = reinterpret_cast<const FMaterialRenderProxy*>(UPTRINT(MaterialIndex + 1) * 16);
+	Pipeline.bPerPixelEval = bPerPixelEval;
+	Pipeline.bWPOEnabled = (MaterialIndex & 1) != 0;
+	return Pipeline;
+}
+
+/** Register/unregister churn, as primitives with many different materials stream in and out. */
+struct FChurn
+{
+	FNaniteRasterPipelines& RasterPipelines;
+	TArray<FBinHolder>& Holders;
+
+	void Add(FRandomStream& Random, int32 NumMaterials)
+	{
+		const int32 MaterialIndex = Random.RandRange(0, NumMaterials - 1);
+		FBinHolder& Holder = Holders.AddDefaulted_GetRef();
+		Holder.Pipeline = MakePipeline(MaterialIndex, (MaterialIndex % 5) == 0);
+		Holder.RasterBin = RasterPipelines.Register(Holder.Pipeline);
+		Holder.bCustomPass = Random.FRand() < 0.2f;
+		if (Holder.bCustomPass)
+		{
+			RasterPipelines.RegisterBinForCustomPass(Holder.RasterBin.BinIndex);
+		}
+	}
+
+	void Remove(int32 HolderIndex)
+	{
+		const FBinHolder& Holder = Holders[HolderIndex];
+		if (Holder.bCustomPass)
+		{
+			RasterPipelines.UnregisterBinForCustomPass(Holder.RasterBin.BinIndex);
+		}
+		RasterPipelines.Unregister(Holder.RasterBin);
+		Holders.RemoveAtSwap(HolderIndex, EAllowShrinking::No);
+	}
+};
+
+/** Minimal bin count: one bin per distinct pipeline, plus the fixed function bins. */
+static uint32 GetMinimalBinCount(TConstArrayView<FBinHolder> Holders)
+{
+	TSet<uint16> RegularBins;
+	TSet<uint16> PerPixelEvalBins;
+	for (const FBinHolder& Holder : Holders)
+	{
+		(Holder.Pipeline.bPerPixelEval ? PerPixelEvalBins : RegularBins).Add(Holder.RasterBin.BinIndex);
+	}
+	return NumFixedFunctionBins + RegularBins.Num() + PerPixelEvalBins.Num();
+}
+
+/** Every holder's bin is allocated, owned by its pipeline and keeps its custom pass registration. */
+static bool HoldersMatch(const FNaniteRasterPipelines& RasterPipelines, TConstArrayView<FBinHolder> Holders)
+{
+	for (const FBinHolder& Holder : Holders)
+	{
+		const FNaniteRasterEntry* RasterEntry = RasterPipelines.GetRasterPipelineMap().Find(Holder.Pipeline);
+		if (RasterEntry == nullptr
+			|| RasterEntry->BinIndex != Holder.RasterBin.BinIndex
+			|| !RasterPipelines.IsBinAllocated(Holder.RasterBin.BinIndex)
+			|| (Holder.bCustomPass && !RasterPipelines.ShouldBinRenderInCustomPass(Holder.RasterBin.BinIndex)))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+} // NaniteRasterBinCompactionTestbed
+
+bool FNaniteRasterBinCompactionTestbed::RunTest(const FString& Parameters)
+{
+	using namespace NaniteRasterBinCompactionTestbed;
+
+	FRandomStream Random(0x52424E43);
+
+	const int32 NumMaterials = 2048;
+	const uint32 MinFreeBins = 16;
+
+	// Reference: the same churn without compaction
+	FNaniteRasterPipelines ReferencePipelines;
+	TArray<FBinHolder> ReferenceHolders;
+	FChurn ReferenceChurn{ ReferencePipelines, ReferenceHolders };
+
+	FNaniteRasterPipelines RasterPipelines;
+	TArray<FBinHolder> Holders;
+	FChurn Churn{ RasterPipelines, Holders };
+
+	bool bMinimal = true;
+	bool bStable = true;
+	bool bPatched = true;
+	bool bFixedFunctionBinsKept = true;
+	int32 NumCompactions = 0;
+	int32 NumRelocatedBins = 0;
+
+	for (int32 Frame = 0; Frame < 256; ++Frame)
+	{
+		// Streaming in a level with many materials, then unloading most of it
+		const int32 NumAdds = (Frame % 64) == 0 ? 4096 : Random.RandRange(0, 64);
+		const int32 NumRemoves = (Frame % 64) == 32 ? Holders.Num() * 7 / 8 : Random.RandRange(0, FMath::Min(64, Holders.Num()));
+
+		const int32 Seed = Random.GetCurrentSeed();
+		for (FChurn* ChurnPtr : { &ReferenceChurn, &Churn })
+		{
+			FRandomStream ChurnRandom(Seed);
+			for (int32 AddIndex = 0; AddIndex < NumAdds; ++AddIndex)
+			{
+				ChurnPtr->Add(ChurnRandom, NumMaterials);
+			}
+			for (int32 RemoveIndex = 0; RemoveIndex < NumRemoves; ++RemoveIndex)
+			{
+				ChurnPtr->Remove(ChurnRandom.RandRange(0, ChurnPtr->Holders.Num() - 1));
+			}
+		}
+		Random.GetUnsignedInt();
+
+		// Same decision as FScene::CompactNaniteRasterBins
+		if (RasterPipelines.GetNumFreeBins() >= MinFreeBins)
+		{
+			FNaniteRasterBinRemap Remap;
+			RasterPipelines.CompactBins(Remap);
+			for (FBinHolder& Holder : Holders)
+			{
+				Holder.RasterBin.BinIndex = Remap.Remap(Holder.RasterBin.BinIndex);
+			}
+			for (uint16 BinIndex = 0; BinIndex < NumFixedFunctionBins; ++BinIndex)
+			{
+				bFixedFunctionBinsKept &= Remap.Remap(BinIndex) == BinIndex;
+			}
+			++NumCompactions;
+			NumRelocatedBins += Remap.GetNumRelocatedBins();
+
+			bMinimal &= RasterPipelines.GetNumFreeBins() == 0;
+			bMinimal &= RasterPipelines.GetBinCount() == GetMinimalBinCount(Holders);
+			bPatched &= HoldersMatch(RasterPipelines, Holders);
+
+			// Compacting again doesn't move anything
+			FNaniteRasterBinRemap SecondRemap;
+			RasterPipelines.CompactBins(SecondRemap);
+			bStable &= SecondRemap.IsEmpty();
+		}
+
+		bPatched &= HoldersMatch(RasterPipelines, Holders);
+		bMinimal &= RasterPipelines.GetNumFreeBins() < MinFreeBins;
+		bMinimal &= RasterPipelines.GetBinCount() <= ReferencePipelines.GetBinCount();
+	}
+
+	TestTrue(TEXT("Compaction was triggered"), NumCompactions > 0);
+	TestTrue(TEXT("Bin count is minimal after compaction"), bMinimal);
+	TestTrue(TEXT("Compaction is stable"), bStable);
+	TestTrue(TEXT("Registered bins and custom pass registrations are patched"), bPatched);
+	TestTrue(TEXT("Fixed function bins are never relocated"), bFixedFunctionBinsKept);
+
+	AddInfo(FString::Printf(TEXT("%d compactions, %d bins relocated: %u bins compacted, %u bins without compaction, %u minimal"),
+		NumCompactions,
+		NumRelocatedBins,
+		RasterPipelines.GetBinCount(),
+		ReferencePipelines.GetBinCount(),
+		GetMinimalBinCount(Holders)));
+
+	// Release everything, which checks that no custom pass registration dangles
+	while (Holders.Num() > 0)
+	{
+		Churn.Remove(Holders.Num() - 1);
+	}
+	while (ReferenceHolders.Num() > 0)
+	{
+		ReferenceChurn.Remove(ReferenceHolders.Num() - 1);
+	}
+	TestEqual(TEXT("Only the fixed function bins are left"), RasterPipelines.GetBinCount(), uint32(NumFixedFunctionBins));
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
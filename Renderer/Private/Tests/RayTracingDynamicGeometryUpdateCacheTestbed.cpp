@@ -0,0 +1,203 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "RayTracing/RayTracingDynamicGeometryUpdateCache.h"
+
+#if (WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR) && RHI_RAYTRACING
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRayTracingDynamicGeometryUpdateCacheTestbed, "System.Renderer.RayTracing.DynamicGeometryUpdateCache", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace RayTracingDynamicGeometryUpdateCacheTestbed
+{
+
+/** Mocked dynamic geometry, stands in for the update params and the ray tracing geometry state. */
+struct FMockGeometry
+{
+	FRayTracingDynamicGeometryInputFingerprint Fingerprint;
+	uint32 LayoutHash = 1;
+	bool bOutputResident = false;
+	bool bBLASValid = false;
+
+	// Contents of the vertex buffer and the BLAS, as the fingerprint they were computed from
+	FRayTracingDynamicGeometryInputFingerprint OutputFingerprint;
+	uint32 OutputLayoutHash = 0;
+
+	int32 NumDispatches = 0;
+};
+
+/** Mirrors the scheduling in FRayTracingDynamicGeometryUpdateManager: skip, or dispatch and refit unless the update is dropped. */
+static void UpdateGeometry(FRayTracingDynamicGeometryUpdateCache& Cache, FMockGeometry& Geometry, int64 GenerationID, bool bDropped)
+{
+	FRayTracingDynamicGeometryUpdateDesc Desc;
+	Desc.Key = &Geometry;
+	Desc.Fingerprint = Geometry.Fingerprint;
+	Desc.LayoutHash = Geometry.LayoutHash;
+	Desc.bPreviousOutputValid = Geometry.bOutputResident && Geometry.bBLASValid;
+
+	if (Cache.ShouldSkipUpdate(Desc, GenerationID))
+	{
+		return;
+	}
+
+	if (bDropped)
+	{
+		Cache.Invalidate(&Geometry);
+		return;
+	}
+
+	++Geometry.NumDispatches;
+	Geometry.bOutputResident = true;
+	Geometry.bBLASValid = true;
+	Geometry.OutputFingerprint = Geometry.Fingerprint;
+	Geometry.OutputLayoutHash = Geometry.LayoutHash;
+}
+
+/** The output is correct when the vertex buffer and BLAS have been computed from the current inputs. */
+static bool IsOutputCurrent(const FMockGeometry& Geometry)
+{
+	return Geometry.bOutputResident && Geometry.bBLASValid && Geometry.OutputFingerprint == Geometry.Fingerprint && Geometry.OutputLayoutHash == Geometry.LayoutHash;
+}
+
+} // RayTracingDynamicGeometryUpdateCacheTestbed
+
+bool FRayTracingDynamicGeometryUpdateCacheTestbed::RunTest(const FString& Parameters)
+{
+	using namespace RayTracingDynamicGeometryUpdateCacheTestbed;
+
+	// Idle geometry is only processed once, any input or layout change is processed again
+	{
+		FRayTracingDynamicGeometryUpdateCache Cache;
+		FMockGeometry Geometry;
+
+		for (int64 GenerationID = 1; GenerationID <= 10; ++GenerationID)
+		{
+			UpdateGeometry(Cache, Geometry, GenerationID, false);
+		}
+		TestEqual(TEXT("Idle geometry is dispatched once"), Geometry.NumDispatches, 1);
+
+		Geometry.Fingerprint.BoneTransformRevision++;
+		UpdateGeometry(Cache, Geometry, 11, false);
+		Geometry.Fingerprint.MorphTargetWeightsHash = 0x1234;
+		UpdateGeometry(Cache, Geometry, 12, false);
+		Geometry.Fingerprint.MaterialParametersHash = 0x5678;
+		UpdateGeometry(Cache, Geometry, 13, false);
+		Geometry.LayoutHash = 2;
+		UpdateGeometry(Cache, Geometry, 14, false);
+		TestEqual(TEXT("Each input or layout change is dispatched"), Geometry.NumDispatches, 5);
+
+		// Lost output (e.g. evicted BLAS or resized buffer) is recomputed even with unchanged inputs
+		Geometry.bBLASValid = false;
+		UpdateGeometry(Cache, Geometry, 15, false);
+		TestEqual(TEXT("Invalid previous output is dispatched"), Geometry.NumDispatches, 6);
+		TestTrue(TEXT("Output is current"), IsOutputCurrent(Geometry));
+	}
+
+	// A dropped update must not be recorded, even if the inputs return to the dropped values
+	{
+		FRayTracingDynamicGeometryUpdateCache Cache;
+		FMockGeometry Geometry;
+
+		UpdateGeometry(Cache, Geometry, 1, false);
+		Geometry.Fingerprint.BoneTransformRevision = 7;
+		UpdateGeometry(Cache, Geometry, 2, true);
+		UpdateGeometry(Cache, Geometry, 3, false);
+		TestEqual(TEXT("Dropped update is dispatched again"), Geometry.NumDispatches, 2);
+		TestTrue(TEXT("Output is current after a dropped update"), IsOutputCurrent(Geometry));
+	}
+
+	// Persistent buffers and entries are released after the latency
+	{
+		FRayTracingDynamicGeometryUpdateCache Cache;
+		FMockGeometry Geometries[2];
+
+		FRWBuffer& Buffer = Cache.FindOrAddPersistentBuffer(&Geometries[0], 1);
+		TestTrue(TEXT("Persistent buffer is stable"), &Buffer == &Cache.FindOrAddPersistentBuffer(&Geometries[0], 1));
+		UpdateGeometry(Cache, Geometries[0], 1, false);
+		UpdateGeometry(Cache, Geometries[1], 1, false);
+
+		for (int64 GenerationID = 2; GenerationID <= 5; ++GenerationID)
+		{
+			UpdateGeometry(Cache, Geometries[1], GenerationID, false);
+			Cache.GarbageCollect(GenerationID, 3);
+		}
+		TestEqual(TEXT("Unused entry is released"), Cache.Num(), 1);
+
+		// A released entry is processed again, the owner lost its persistent output with it
+		Geometries[0].bOutputResident = false;
+		UpdateGeometry(Cache, Geometries[0], 6, false);
+		TestEqual(TEXT("Released geometry is dispatched again"), Geometries[0].NumDispatches, 2);
+	}
+
+	// Crowd of skinned meshes where most are idle: the output must always be current, and idle ones must not be dispatched
+	{
+		FRandomStream Random(0x5c1d);
+		FRayTracingDynamicGeometryUpdateCache Cache;
+
+		const int32 NumGeometries = 2000;
+		const int32 NumFrames = 200;
+		TArray<FMockGeometry> Geometries;
+		Geometries.SetNum(NumGeometries);
+
+		bool bAllCurrent = true;
+		int32 NumChanges = 0;
+		int32 NumDropped = 0;
+		uint64 Cycles = 0;
+
+		for (int64 GenerationID = 1; GenerationID <= NumFrames; ++GenerationID)
+		{
+			for (FMockGeometry& Geometry : Geometries)
+			{
+				// 10% animated, the rest mostly idle with occasional pose changes, eviction and toggles back to a previous pose
+				const float Rand = Random.GetFraction();
+				if (&Geometry - Geometries.GetData() < NumGeometries / 10 || Rand < 0.02f)
+				{
+					Geometry.Fingerprint.BoneTransformRevision++;
+					++NumChanges;
+				}
+				else if (Rand < 0.03f)
+				{
+					Geometry.Fingerprint.MaterialParametersHash ^= 1;
+					++NumChanges;
+				}
+				else if (Rand < 0.035f)
+				{
+					Geometry.bBLASValid = false;
+				}
+
+				// Budget drops updates
+				const bool bDropped = Random.GetFraction() < 0.05f;
+				NumDropped += bDropped ? 1 : 0;
+
+				const uint64 Time0 = FPlatformTime::Cycles64();
+				UpdateGeometry(Cache, Geometry, GenerationID, bDropped);
+				Cycles += FPlatformTime::Cycles64() - Time0;
+
+				bAllCurrent &= bDropped || IsOutputCurrent(Geometry);
+			}
+		}
+
+		int32 NumDispatches = 0;
+		for (const FMockGeometry& Geometry : Geometries)
+		{
+			NumDispatches += Geometry.NumDispatches;
+		}
+
+		TestTrue(TEXT("Output is current whenever the update was not dropped"), bAllCurrent);
+		TestTrue(TEXT("Most idle updates are skipped"), NumDispatches < NumGeometries * NumFrames / 4);
+
+		AddInfo(FString::Printf(TEXT("Crowd: %d geometries, %d frames, %d input changes, %d dropped, %d dispatches instead of %d (%.3fms per frame for the cache)"),
+			NumGeometries,
+			NumFrames,
+			NumChanges,
+			NumDropped,
+			NumDispatches,
+			NumGeometries * NumFrames,
+			FPlatformTime::ToMilliseconds64(Cycles) / NumFrames));
+	}
+
+	return true;
+}
+
+#endif // (WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR) && RHI_RAYTRACING
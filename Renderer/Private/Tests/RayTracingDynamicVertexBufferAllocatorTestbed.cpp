@@ -0,0 +1,262 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "RayTracing/RayTracingDynamicVertexBufferAllocator.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRayTracingDynamicVertexBufferAllocatorTestbed, "System.Renderer.RayTracing.DynamicVertexBufferAllocator", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace RayTracingDynamicVertexBufferAllocatorTestbed
+{
+
+static const uint32 BufferSize = 4 * 1024 * 1024;
+static const uint32 Alignment = 16;
+static const int32 ReleaseLatency = 30;
+
+using FAllocation = FRayTracingDynamicVertexBufferAllocator::FAllocation;
+
+/** Previous allocation (first fit bump allocation, all buffers reset every generation), as a reference. */
+class FReferenceAllocator
+{
+public:
+	void BeginGeneration(int64 GenerationID)
+	{
+		CurrentGenerationID = GenerationID;
+		for (int32 BufferIndex = 0; BufferIndex < Buffers.Num(); ++BufferIndex)
+		{
+			Buffers[BufferIndex].UsedSize = 0;
+			if (Buffers[BufferIndex].LastUsedGenerationID + ReleaseLatency <= GenerationID)
+			{
+				Buffers.RemoveAtSwap(BufferIndex);
+				--BufferIndex;
+			}
+		}
+	}
+
+	void Allocate(uint32 Size)
+	{
+		FBuffer* Buffer = Buffers.FindByPredicate([Size](const FBuffer& Buffer) { return Buffer.Size >= Size + Buffer.UsedSize; });
+		if (Buffer == nullptr)
+		{
+			Buffer = &Buffers.AddDefaulted_GetRef();
+			Buffer->Size = FMath::Max(BufferSize, Size);
+		}
+		Buffer->LastUsedGenerationID = CurrentGenerationID;
+		Buffer->UsedSize = Align(Buffer->UsedSize + Size, Alignment);
+	}
+
+	uint64 GetCapacity() const
+	{
+		uint64 Capacity = 0;
+		for (const FBuffer& Buffer : Buffers)
+		{
+			Capacity += Buffer.Size;
+		}
+		return Capacity;
+	}
+
+private:
+	struct FBuffer
+	{
+		uint32 Size = 0;
+		uint32 UsedSize = 0;
+		int64 LastUsedGenerationID = 0;
+	};
+
+	TArray<FBuffer> Buffers;
+	int64 CurrentGenerationID = 0;
+};
+
+static bool Overlaps(const FAllocation& A, const FAllocation& B)
+{
+	return A.BufferIndex == B.BufferIndex && A.Offset < B.Offset + B.Size && B.Offset < A.Offset + A.Size;
+}
+
+/** Allocations of one generation must not overlap, nor overlap the blocks of the previous generation that were not recycled yet. */
+static bool AreDisjoint(TArray<FAllocation> Allocations)
+{
+	Allocations.Sort([](const FAllocation& A, const FAllocation& B)
+	{
+		return A.BufferIndex != B.BufferIndex ? A.BufferIndex < B.BufferIndex : A.Offset < B.Offset;
+	});
+
+	for (int32 Index = 1; Index < Allocations.Num(); ++Index)
+	{
+		if (Overlaps(Allocations[Index - 1], Allocations[Index]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+} // RayTracingDynamicVertexBufferAllocatorTestbed
+
+bool FRayTracingDynamicVertexBufferAllocatorTestbed::RunTest(const FString& Parameters)
+{
+	using namespace RayTracingDynamicVertexBufferAllocatorTestbed;
+
+	// Size classes: aligned, large enough and at most 25% wasted
+	{
+		FRayTracingDynamicVertexBufferAllocator Allocator(BufferSize, Alignment);
+
+		bool bValid = true;
+		for (uint32 Size = 1; Size < 1024 * 1024; Size += 1 + Size / 64)
+		{
+			const uint32 BlockSize = Allocator.GetBlockSize(Size);
+			bValid &= IsAligned(BlockSize, Alignment) && BlockSize >= Size && BlockSize <= FMath::Max(Align(Size, Alignment) * 5 / 4, 4 * Alignment);
+		}
+		TestTrue(TEXT("Size classes"), bValid);
+	}
+
+	// Allocations persist while the size class is unchanged, frees are deferred until the generation is completed
+	{
+		FRayTracingDynamicVertexBufferAllocator Allocator(BufferSize, Alignment);
+		TArray<int32> ReleasedBuffers;
+		int32 Keys[3];
+
+		Allocator.BeginGeneration(1, 0, ReleasedBuffers);
+		const FAllocation A0 = Allocator.Allocate(&Keys[0], 1000 * 12);
+		const FAllocation B0 = Allocator.Allocate(&Keys[1], 1000 * 12);
+		TestTrue(TEXT("Disjoint"), !Overlaps(A0, B0));
+
+		Allocator.BeginGeneration(2, 1, ReleasedBuffers);
+		const FAllocation A1 = Allocator.Allocate(&Keys[0], 1000 * 12);
+		const FAllocation B1 = Allocator.Allocate(&Keys[1], 1001 * 12);
+		TestTrue(TEXT("Same size keeps the allocation"), A1.BufferIndex == A0.BufferIndex && A1.Offset == A0.Offset);
+		TestTrue(TEXT("Same size class keeps the allocation"), B1.BufferIndex == B0.BufferIndex && B1.Offset == B0.Offset);
+
+		// Key 1 grows out of its class, its block may still be read by this generation
+		const FAllocation B2 = Allocator.Allocate(&Keys[1], 4000 * 12);
+		const FAllocation C2 = Allocator.Allocate(&Keys[2], 1000 * 12);
+		TestTrue(TEXT("Freed block is not reused in the same generation"), !Overlaps(C2, B0) && !Overlaps(C2, B2) && !Overlaps(C2, A1));
+
+		// Key 2 is not allocated during generation 3, so it is freed at the start of generation 4 and recycled once 3 is completed
+		Allocator.BeginGeneration(3, 2, ReleasedBuffers);
+		Allocator.Allocate(&Keys[0], 1000 * 12);
+		Allocator.Allocate(&Keys[1], 4000 * 12);
+		Allocator.BeginGeneration(4, 3, ReleasedBuffers);
+		TestEqual(TEXT("Unused key is freed"), Allocator.GetNumAllocations(), 2);
+		TestEqual(TEXT("Live size"), Allocator.GetLiveSize(), uint64(Allocator.GetBlockSize(1000 * 12) + Allocator.GetBlockSize(4000 * 12)));
+
+		// Blocks larger than the buffer size get their own buffer, released once empty for the latency
+		int32 LargeKey;
+		const FAllocation Large = Allocator.Allocate(&LargeKey, BufferSize + 1);
+		TestTrue(TEXT("Large allocation fits its buffer"), Allocator.GetBufferSize(Large.BufferIndex) >= Large.Size && Large.Offset == 0);
+
+		int64 GenerationID = 5;
+		for (; GenerationID < 5 + ReleaseLatency + 2; ++GenerationID)
+		{
+			Allocator.BeginGeneration(GenerationID, GenerationID - 1, ReleasedBuffers);
+			Allocator.Allocate(&Keys[0], 1000 * 12);
+		}
+		TestTrue(TEXT("Empty buffer is released"), ReleasedBuffers.Contains(Large.BufferIndex));
+		TestEqual(TEXT("Capacity after release"), Allocator.GetCapacity(), uint64(BufferSize));
+	}
+
+	// Skinned characters streaming in and out: compare to the previous allocation
+	{
+		FRandomStream Random(0x7e47);
+		FRayTracingDynamicVertexBufferAllocator Allocator(BufferSize, Alignment);
+		Allocator.SetReleaseLatency(ReleaseLatency);
+		FReferenceAllocator ReferenceAllocator;
+
+		const int32 MaxGeometries = 1500;
+		TArray<uint32> Sizes;
+		Sizes.SetNumZeroed(MaxGeometries);
+
+		TArray<int32> ReleasedBuffers;
+		TArray<FAllocation> PreviousAllocations;
+		TArray<FAllocation> Allocations;
+		TArray<FAllocation> CheckAllocations;
+		bool bDisjoint = true;
+		bool bWithinBuffers = true;
+		int32 NumMoves = 0;
+		int32 NumAllocations = 0;
+		uint64 PeakCapacity = 0;
+		uint64 ReferencePeakCapacity = 0;
+		uint64 LowLoadCapacity = 0;
+		uint64 LowLoadLiveSize = 0;
+		uint64 Cycles = 0;
+		uint64 ReferenceCycles = 0;
+
+		// Ends 300 generations into a quiet phase
+		const int32 NumGenerations = 1900;
+		for (int64 GenerationID = 1; GenerationID <= NumGenerations; ++GenerationID)
+		{
+			// Alternate between crowded and quiet phases
+			const int32 NumGeometries = ((GenerationID / 400) & 1) ? MaxGeometries : MaxGeometries / 5;
+
+			ReleasedBuffers.Reset();
+			const uint64 Time0 = FPlatformTime::Cycles64();
+			Allocator.BeginGeneration(GenerationID, GenerationID - 1, ReleasedBuffers);
+			const uint64 Time1 = FPlatformTime::Cycles64();
+			ReferenceAllocator.BeginGeneration(GenerationID);
+			Cycles += Time1 - Time0;
+			ReferenceCycles += FPlatformTime::Cycles64() - Time1;
+
+			Allocations.Reset();
+			for (int32 Index = 0; Index < NumGeometries; ++Index)
+			{
+				if (Sizes[Index] == 0 || Random.GetFraction() < 0.01f)
+				{
+					Sizes[Index] = uint32(Random.RandRange(100, 40000)) * 12;
+				}
+
+				const uint64 Time2 = FPlatformTime::Cycles64();
+				const FAllocation Allocation = Allocator.Allocate(&Sizes[Index], Sizes[Index]);
+				const uint64 Time3 = FPlatformTime::Cycles64();
+				ReferenceAllocator.Allocate(Sizes[Index]);
+				Cycles += Time3 - Time2;
+				ReferenceCycles += FPlatformTime::Cycles64() - Time3;
+
+				bWithinBuffers &= Allocation.Size >= Sizes[Index] && Allocation.Offset + Allocation.Size <= Allocator.GetBufferSize(Allocation.BufferIndex);
+				NumMoves += Index < PreviousAllocations.Num() && (PreviousAllocations[Index].BufferIndex != Allocation.BufferIndex || PreviousAllocations[Index].Offset != Allocation.Offset) ? 1 : 0;
+				Allocations.Add(Allocation);
+			}
+			NumAllocations += NumGeometries;
+
+			bDisjoint &= AreDisjoint(Allocations);
+
+			// Previous generation blocks are only recycled once it is completed, so they must not overlap blocks of other keys either
+			CheckAllocations = Allocations;
+			for (int32 Index = NumGeometries; Index < PreviousAllocations.Num(); ++Index)
+			{
+				CheckAllocations.Add(PreviousAllocations[Index]);
+			}
+			bDisjoint &= AreDisjoint(CheckAllocations);
+
+			PeakCapacity = FMath::Max(PeakCapacity, Allocator.GetCapacity());
+			ReferencePeakCapacity = FMath::Max(ReferencePeakCapacity, ReferenceAllocator.GetCapacity());
+
+			if (GenerationID == NumGenerations)
+			{
+				LowLoadCapacity = Allocator.GetCapacity();
+				LowLoadLiveSize = Allocator.GetLiveSize();
+			}
+
+			PreviousAllocations = Allocations;
+		}
+
+		TestTrue(TEXT("Allocations are disjoint"), bDisjoint);
+		TestTrue(TEXT("Allocations are within their buffers"), bWithinBuffers);
+		TestTrue(TEXT("Buffers are compacted after the crowded phase"), LowLoadCapacity <= 2 * FMath::Max(LowLoadLiveSize, uint64(BufferSize)));
+
+		AddInfo(FString::Printf(TEXT("Crowd: %d allocations, %d moved, peak %.1fMB (previous %.1fMB), %.1fMB for %.1fMB live at the end, %.3fms per generation (previous %.3fms)"),
+			NumAllocations,
+			NumMoves,
+			double(PeakCapacity) / (1024.0 * 1024.0),
+			double(ReferencePeakCapacity) / (1024.0 * 1024.0),
+			double(LowLoadCapacity) / (1024.0 * 1024.0),
+			double(LowLoadLiveSize) / (1024.0 * 1024.0),
+			FPlatformTime::ToMilliseconds64(Cycles) / NumGenerations,
+			FPlatformTime::ToMilliseconds64(ReferenceCycles) / NumGenerations));
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
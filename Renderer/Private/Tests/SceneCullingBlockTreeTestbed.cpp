@@ -0,0 +1,218 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "SceneCulling/SceneCullingBlockTree.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSceneCullingBlockTreeTestbed, "System.Renderer.SceneCulling.BlockTree", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace SceneCullingBlockTreeTestbed
+{
+
+static const int32 CellBlockDimLog2 = 3;
+
+struct FBlockResult
+{
+	int32 BlockId;
+	bool bFullyContained;
+
+	bool operator==(const FBlockResult& Other) const
+	{
+		return BlockId == Other.BlockId && bFullyContained == Other.bFullyContained;
+	}
+
+	bool operator<(const FBlockResult& Other) const
+	{
+		return BlockId < Other.BlockId;
+	}
+};
+
+static FConvexVolume MakeFrustum(const FVector3d& Eye, const FVector3d& Forward, double TanHalfFOV, double NearDistance, double FarDistance)
+{
+	const FVector3d Right = FVector3d::CrossProduct(FVector3d::UpVector, Forward).GetSafeNormal();
+	const FVector3d Up = FVector3d::CrossProduct(Forward, Right);
+
+	// Points inside satisfy Dot(Normal, P) <= W
+	FConvexVolume ConvexVolume;
+	ConvexVolume.Planes.Add(FPlane(-Forward, FVector3d::DotProduct(-Forward, Eye + Forward * NearDistance)));
+	ConvexVolume.Planes.Add(FPlane(Forward, FVector3d::DotProduct(Forward, Eye + Forward * FarDistance)));
+	for (const FVector3d& Side : { Right, -Right, Up, -Up })
+	{
+		const FVector3d Normal = (Side - Forward * TanHalfFOV).GetSafeNormal();
+		ConvexVolume.Planes.Add(FPlane(Normal, FVector3d::DotProduct(Normal, Eye)));
+	}
+	ConvexVolume.Init();
+	return ConvexVolume;
+}
+
+/** The previous flat loop over all blocks, as a reference. */
+static int32 TestFlat(TConstArrayView<FSceneCullingBlockTree::FBlockEntry> Blocks, const FConvexVolume& ConvexVolume, TArray<FBlockResult>& OutResults)
+{
+	for (const FSceneCullingBlockTree::FBlockEntry& Block : Blocks)
+	{
+		const double BlockLevelSize = RenderingSpatialHash::GetCellSize(Block.Level);
+		const double LevelCellSize = RenderingSpatialHash::GetCellSize(Block.Level - CellBlockDimLog2);
+		const FVector3d BlockBoundsCenter = FVector3d(Block.Coord) * BlockLevelSize + BlockLevelSize * 0.5;
+		// Extend extent by half a cell size in all directions
+		const FVector3d BlockBoundsExtent = FVector3d((BlockLevelSize + LevelCellSize) * 0.5);
+
+		const FOutcode Outcode = ConvexVolume.GetBoxIntersectionOutcode(BlockBoundsCenter, BlockBoundsExtent);
+		if (Outcode.GetInside())
+		{
+			OutResults.Add({ Block.BlockId, !Outcode.GetOutside() });
+		}
+	}
+	return Blocks.Num();
+}
+
+struct FWorldDesc
+{
+	const TCHAR* Name;
+	// Blocks per level, starting at level 15 (4096 unit cells)
+	int32 NumBlocks[3];
+	// Half size of the occupied area, in finest blocks
+	int32 HalfExtentXY;
+	int32 HalfExtentZ;
+};
+
+static TArray<FSceneCullingBlockTree::FBlockEntry> MakeWorld(FRandomStream& Random, const FWorldDesc& Desc)
+{
+	TArray<FSceneCullingBlockTree::FBlockEntry> Blocks;
+	TSet<FIntVector4> UsedLocations;
+
+	for (int32 LevelIndex = 0; LevelIndex < UE_ARRAY_COUNT(Desc.NumBlocks); ++LevelIndex)
+	{
+		const int32 Level = 15 + LevelIndex;
+		const int32 HalfExtentXY = FMath::Max(1, Desc.HalfExtentXY >> LevelIndex);
+		const int32 HalfExtentZ = FMath::Max(1, Desc.HalfExtentZ >> LevelIndex);
+
+		for (int32 Index = 0; Index < Desc.NumBlocks[LevelIndex]; ++Index)
+		{
+			const FIntVector3 Coord(Random.RandRange(-HalfExtentXY, HalfExtentXY - 1), Random.RandRange(-HalfExtentXY, HalfExtentXY - 1), Random.RandRange(-HalfExtentZ, HalfExtentZ - 1));
+
+			bool bAlreadyUsed = false;
+			UsedLocations.Add(FIntVector4(Coord.X, Coord.Y, Coord.Z, Level), &bAlreadyUsed);
+			if (!bAlreadyUsed)
+			{
+				// Sparse ids, like the hash map element ids
+				Blocks.Add({ Coord, Level, Blocks.Num() * 3 + 1 });
+			}
+		}
+	}
+
+	return Blocks;
+}
+
+} // SceneCullingBlockTreeTestbed
+
+bool FSceneCullingBlockTreeTestbed::RunTest(const FString& Parameters)
+{
+	using namespace SceneCullingBlockTreeTestbed;
+
+	FRandomStream Random(0xb10c);
+
+	// Single precision local volume, must agree with the double precision test far from the origin up to a small tolerance
+	{
+		const FVector3d Eye(8.0e6, -3.0e6, 1.0e5);
+		const FConvexVolume ConvexVolume = MakeFrustum(Eye, FVector3d(1.0, 1.0, -0.2).GetSafeNormal(), 0.8, 10.0, 2.0e5);
+		const FVector3d LocalOrigin = Eye + FVector3d(20000.0, 15000.0, -5000.0);
+		const FSceneCullingLocalConvexVolume LocalConvexVolume(ConvexVolume, LocalOrigin);
+
+		bool bConsistent = true;
+		for (int32 Index = 0; Index < 100000; ++Index)
+		{
+			const FVector3f Center(Random.FRandRange(-32768.0f, 65536.0f), Random.FRandRange(-32768.0f, 65536.0f), Random.FRandRange(-32768.0f, 65536.0f));
+			const FVector3f Extent(4096.0f);
+
+			const bool bLocal = LocalConvexVolume.IntersectBox(Center, Extent);
+			bConsistent &= !bLocal || ConvexVolume.IntersectBox(FVector3d(Center) + LocalOrigin, FVector3d(Extent) * 1.001);
+			bConsistent &= bLocal || !ConvexVolume.IntersectBox(FVector3d(Center) + LocalOrigin, FVector3d(Extent) * 0.999);
+		}
+		TestTrue(TEXT("Local volume agrees with the world space volume"), bConsistent);
+	}
+
+	// Empty tree
+	{
+		FSceneCullingBlockTree BlockTree(CellBlockDimLog2);
+		BlockTree.Build(TConstArrayView<FSceneCullingBlockTree::FBlockEntry>());
+		const int32 NumTests = BlockTree.Traverse(MakeFrustum(FVector3d::ZeroVector, FVector3d::ForwardVector, 1.0, 1.0, 1000.0), FVector3d::ZeroVector, [](int32, bool) {});
+		TestEqual(TEXT("Empty tree"), NumTests, 0);
+	}
+
+	const FWorldDesc WorldDescs[] =
+	{
+		{ TEXT("Streaming world"),	{ 40000,	4000,	400 },	128,	2 },
+		{ TEXT("Dense city"),		{ 8000,		500,	50 },	16,		4 },
+		{ TEXT("Sparse islands"),	{ 3000,		300,	30 },	4096,	4 },
+	};
+
+	const int32 NumViews = 16;
+	for (const FWorldDesc& Desc : WorldDescs)
+	{
+		const TArray<FSceneCullingBlockTree::FBlockEntry> Blocks = MakeWorld(Random, Desc);
+
+		const uint64 BuildTime0 = FPlatformTime::Cycles64();
+		FSceneCullingBlockTree BlockTree(CellBlockDimLog2);
+		BlockTree.Build(Blocks);
+		const uint64 BuildTime1 = FPlatformTime::Cycles64();
+
+		bool bMatches = true;
+		int64 NumFlatTests = 0;
+		int64 NumTreeTests = 0;
+		int64 NumVisibleBlocks = 0;
+		uint64 FlatCycles = 0;
+		uint64 TreeCycles = 0;
+
+		TArray<FBlockResult> FlatResults;
+		TArray<FBlockResult> TreeResults;
+
+		for (int32 ViewIndex = 0; ViewIndex < NumViews; ++ViewIndex)
+		{
+			const double WorldHalfExtent = RenderingSpatialHash::GetCellSize(15) * Desc.HalfExtentXY;
+			const FVector3d Eye(Random.FRandRange(-WorldHalfExtent, WorldHalfExtent), Random.FRandRange(-WorldHalfExtent, WorldHalfExtent), Random.FRandRange(-1.0e4, 1.0e4));
+			const FVector3d Forward = FVector3d(Random.FRandRange(-1.0, 1.0), Random.FRandRange(-1.0, 1.0), Random.FRandRange(-0.2, 0.2)).GetSafeNormal();
+			const FConvexVolume ConvexVolume = MakeFrustum(Eye, Forward, 1.0, 10.0, 5.0e5);
+
+			FlatResults.Reset();
+			TreeResults.Reset();
+
+			const uint64 Time0 = FPlatformTime::Cycles64();
+			NumFlatTests += TestFlat(Blocks, ConvexVolume, FlatResults);
+			const uint64 Time1 = FPlatformTime::Cycles64();
+			NumTreeTests += BlockTree.Traverse(ConvexVolume, FVector3d::ZeroVector, [&TreeResults](int32 BlockId, bool bFullyContained)
+			{
+				TreeResults.Add({ BlockId, bFullyContained });
+			});
+			const uint64 Time2 = FPlatformTime::Cycles64();
+
+			FlatCycles += Time1 - Time0;
+			TreeCycles += Time2 - Time1;
+			NumVisibleBlocks += FlatResults.Num();
+
+			// Same blocks, with the same containment
+			FlatResults.Sort();
+			TreeResults.Sort();
+			bMatches &= FlatResults == TreeResults;
+		}
+
+		TestTrue(FString::Printf(TEXT("%s: same blocks as the flat loop"), Desc.Name), bMatches);
+
+		AddInfo(FString::Printf(TEXT("%s: %d blocks, %d nodes (built in %.3fms), %.1f visible blocks, flat %.1f tests %.3fms, tree %.1f tests %.3fms (per view)"),
+			Desc.Name,
+			Blocks.Num(),
+			BlockTree.Num(),
+			FPlatformTime::ToMilliseconds64(BuildTime1 - BuildTime0),
+			double(NumVisibleBlocks) / NumViews,
+			double(NumFlatTests) / NumViews,
+			FPlatformTime::ToMilliseconds64(FlatCycles) / NumViews,
+			double(NumTreeTests) / NumViews,
+			FPlatformTime::ToMilliseconds64(TreeCycles) / NumViews));
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
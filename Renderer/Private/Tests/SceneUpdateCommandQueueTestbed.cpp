@@ -0,0 +1,236 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "SceneUpdateCommandQueue.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSceneUpdateCommandQueueTestbed, "System.Renderer.SceneUpdateCommandQueue.BatchedTransforms", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace SceneUpdateCommandQueueTestbed
+{
+
+/** Stand in for FPrimitiveSceneInfo, the queue only needs the persistent index. */
+struct FTestSceneInfo
+{
+	using FPersistentId = int32;
+
+	int32 PersistentIndex = INDEX_NONE;
+
+	FPersistentId GetPersistentIndex() const { return PersistentIndex; }
+};
+
+enum class ETestDirtyFlags : uint32
+{
+	None		= 0u,
+	Transform	= 1u << 0,
+	Previous	= 1u << 1,
+};
+ENUM_CLASS_FLAGS(ETestDirtyFlags);
+
+enum class ETestUpdateId : uint32
+{
+	UpdateTransform,
+	OverridePreviousTransform,
+	MAX
+};
+
+using FTestUpdateQueue = TSceneUpdateCommandQueue<FTestSceneInfo, ETestDirtyFlags, ETestUpdateId>;
+
+/** Same payload as FUpdateTransformCommand. */
+struct FTestTransformCommand : public FTestUpdateQueue::TPayloadBase<ETestUpdateId::UpdateTransform, ETestDirtyFlags::Transform>
+{
+	FBoxSphereBounds WorldBounds;
+	FBoxSphereBounds LocalBounds;
+	FMatrix LocalToWorld;
+	FVector AttachmentRootPosition;
+};
+
+struct FTestPreviousTransformCommand : public FTestUpdateQueue::TPayloadBase<ETestUpdateId::OverridePreviousTransform, ETestDirtyFlags::Previous>
+{
+	FMatrix PreviousLocalToWorld;
+};
+
+/** A frame of transform updates, in structure of arrays as BatchUpdatePrimitiveTransforms_RenderThread takes them. */
+struct FTransformUpdates
+{
+	TArray<FTestSceneInfo*> SceneInfos;
+	TArray<FBoxSphereBounds> WorldBounds;
+	TArray<FBoxSphereBounds> LocalBounds;
+	TArray<FMatrix> LocalToWorlds;
+	TArray<FVector> AttachmentRootPositions;
+	TArray<TOptional<FTransform>> PreviousTransforms;
+};
+
+static FTransformUpdates MakeUpdates(FRandomStream& Random, TArray<FTestSceneInfo>& SceneInfos, int32 NumUpdates)
+{
+	FTransformUpdates Updates;
+	for (int32 Index = 0; Index < NumUpdates; ++Index)
+	{
+		const FVector Origin(Random.FRandRange(-1.0e5f, 1.0e5f), Random.FRandRange(-1.0e5f, 1.0e5f), Random.FRandRange(0.0f, 1.0e3f));
+		const FTransform Transform(FRotator(0.0f, Random.FRandRange(0.0f, 360.0f), 0.0f), Origin);
+
+		Updates.SceneInfos.Add(&SceneInfos[Random.RandRange(0, SceneInfos.Num() - 1)]);
+		Updates.LocalBounds.Add(FBoxSphereBounds(FVector::ZeroVector, FVector(50.0f), 87.0f));
+		Updates.WorldBounds.Add(Updates.LocalBounds.Last().TransformBy(Transform));
+		Updates.LocalToWorlds.Add(Transform.ToMatrixWithScale());
+		Updates.AttachmentRootPositions.Add(Origin);
+		Updates.PreviousTransforms.Add(Random.FRand() < 0.1f ? TOptional<FTransform>(Transform) : TOptional<FTransform>());
+	}
+	return Updates;
+}
+
+static void EnqueueUpdate(FTestUpdateQueue& Queue, const FTransformUpdates& Updates, int32 Index)
+{
+	Queue.Enqueue(Updates.SceneInfos[Index], FTestTransformCommand { .WorldBounds = Updates.WorldBounds[Index], .LocalBounds = Updates.LocalBounds[Index], .LocalToWorld = Updates.LocalToWorlds[Index], .AttachmentRootPosition = Updates.AttachmentRootPositions[Index] });
+	if (Updates.PreviousTransforms[Index].IsSet())
+	{
+		Queue.Enqueue(Updates.SceneInfos[Index], FTestPreviousTransformCommand { .PreviousLocalToWorld = Updates.PreviousTransforms[Index].GetValue().ToMatrixWithScale() });
+	}
+}
+
+/** Reference: one render command per primitive, as UpdatePrimitiveTransform does. */
+static void RunPerCall(FTestUpdateQueue& Queue, const FTransformUpdates& Updates)
+{
+	TArray<TUniqueFunction<void()>> RenderCommands;
+	for (int32 Index = 0; Index < Updates.SceneInfos.Num(); ++Index)
+	{
+		RenderCommands.Add([&Queue, &Updates, Index]()
+		{
+			EnqueueUpdate(Queue, Updates, Index);
+		});
+	}
+
+	for (TUniqueFunction<void()>& RenderCommand : RenderCommands)
+	{
+		RenderCommand();
+	}
+}
+
+/** One reservation for all the primitives, as BatchUpdatePrimitiveTransforms_RenderThread does for a batch produced on the rendering thread. */
+static void RunBatched(FTestUpdateQueue& Queue, const FTransformUpdates& Updates)
+{
+	Queue.Reserve<FTestTransformCommand>(Updates.SceneInfos.Num());
+	for (int32 Index = 0; Index < Updates.SceneInfos.Num(); ++Index)
+	{
+		EnqueueUpdate(Queue, Updates, Index);
+	}
+}
+
+/** Last transform of each scene info in the queue. */
+static TMap<const FTestSceneInfo*, FMatrix> GetTransforms(FTestUpdateQueue& Queue)
+{
+	TMap<const FTestSceneInfo*, FMatrix> Transforms;
+	for (const auto& Item : Queue.GetRangeView<FTestTransformCommand>())
+	{
+		Transforms.Add(Item.SceneInfo, Item.Payload.LocalToWorld);
+	}
+	return Transforms;
+}
+
+static bool QueuesMatch(FTestUpdateQueue& QueueA, FTestUpdateQueue& QueueB)
+{
+	if (QueueA.NumCommands() != QueueB.NumCommands()
+		|| QueueA.GetNumItems<FTestTransformCommand>() != QueueB.GetNumItems<FTestTransformCommand>()
+		|| QueueA.GetNumItems<FTestPreviousTransformCommand>() != QueueB.GetNumItems<FTestPreviousTransformCommand>())
+	{
+		return false;
+	}
+
+	const TMap<const FTestSceneInfo*, FMatrix> TransformsA = GetTransforms(QueueA);
+	const TMap<const FTestSceneInfo*, FMatrix> TransformsB = GetTransforms(QueueB);
+	if (TransformsA.Num() != TransformsB.Num())
+	{
+		return false;
+	}
+	for (const TPair<const FTestSceneInfo*, FMatrix>& Pair : TransformsA)
+	{
+		const FMatrix* Other = TransformsB.Find(Pair.Key);
+		if (Other == nullptr || !Other->Equals(Pair.Value, 0.0f))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+} // SceneUpdateCommandQueueTestbed
+
+bool FSceneUpdateCommandQueueTestbed::RunTest(const FString& Parameters)
+{
+	using namespace SceneUpdateCommandQueueTestbed;
+
+	FRandomStream Random(0x5155);
+
+	TArray<FTestSceneInfo> SceneInfos;
+	SceneInfos.SetNum(100000);
+	for (int32 Index = 0; Index < SceneInfos.Num(); ++Index)
+	{
+		SceneInfos[Index].PersistentIndex = Index;
+	}
+
+	// Batched updates give the same queue as per call updates, including duplicate updates of the same primitive
+	{
+		bool bMatches = true;
+		for (int32 Frame = 0; Frame < 16; ++Frame)
+		{
+			const FTransformUpdates Updates = MakeUpdates(Random, SceneInfos, Random.RandRange(1, 4096));
+
+			FTestUpdateQueue PerCallQueue;
+			FTestUpdateQueue BatchedQueue;
+
+			// Commands already in the queue, e.g., from other updates of the frame
+			for (int32 Index = 0; Index < 64; ++Index)
+			{
+				FTestSceneInfo* SceneInfo = &SceneInfos[Random.RandRange(0, SceneInfos.Num() - 1)];
+				PerCallQueue.Enqueue(SceneInfo, FTestPreviousTransformCommand { .PreviousLocalToWorld = FMatrix::Identity });
+				BatchedQueue.Enqueue(SceneInfo, FTestPreviousTransformCommand { .PreviousLocalToWorld = FMatrix::Identity });
+			}
+
+			RunPerCall(PerCallQueue, Updates);
+			RunBatched(BatchedQueue, Updates);
+			bMatches &= QueuesMatch(PerCallQueue, BatchedQueue);
+		}
+		TestTrue(TEXT("Batched updates match per call updates"), bMatches);
+	}
+
+	// Benchmark: 50k moving primitives per frame
+	{
+		const int32 NumUpdates = 50000;
+		const int32 NumIterations = 8;
+		const FTransformUpdates Updates = MakeUpdates(Random, SceneInfos, NumUpdates);
+
+		FTestUpdateQueue PerCallQueue;
+		FTestUpdateQueue BatchedQueue;
+
+		uint64 PerCallCycles = 0;
+		uint64 BatchedCycles = 0;
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			// Queues are consumed and emptied every frame, as FScene::Update does
+			PerCallQueue.Reset();
+			BatchedQueue.Reset();
+
+			const uint64 Time0 = FPlatformTime::Cycles64();
+			RunPerCall(PerCallQueue, Updates);
+			const uint64 Time1 = FPlatformTime::Cycles64();
+			RunBatched(BatchedQueue, Updates);
+			const uint64 Time2 = FPlatformTime::Cycles64();
+
+			PerCallCycles += Time1 - Time0;
+			BatchedCycles += Time2 - Time1;
+		}
+
+		TestTrue(TEXT("Benchmark queues match"), QueuesMatch(PerCallQueue, BatchedQueue));
+		AddInfo(FString::Printf(TEXT("%d transform updates: per call %.3fms, batched %.3fms (per frame)"),
+			NumUpdates,
+			FPlatformTime::ToMilliseconds64(PerCallCycles) / NumIterations,
+			FPlatformTime::ToMilliseconds64(BatchedCycles) / NumIterations));
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
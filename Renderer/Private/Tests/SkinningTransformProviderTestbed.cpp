@@ -0,0 +1,143 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "RenderGraphBuilder.h"
+#include "RenderingThread.h"
+#include "Skinning/SkinningTransformProvider.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSkinningTransformProviderTestbed, "System.Renderer.Skinning.TransformProviderBroadcast", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace SkinningTransformProviderTestbed
+{
+
+/** Records, per indirection, how many times it was written and by which provider. */
+struct FMockTransformWrites
+{
+	TArray<int32> WriteCounts;
+	TArray<int32> WriterIndices;
+	const FUintVector2* IndirectionBase = nullptr;
+
+	void OnProvide(FSkinningTransformProvider::FProviderContext& Context, int32 ProviderIndex)
+	{
+		for (const FUintVector2& Indirection : Context.Indirections)
+		{
+			const int32 IndirectionIndex = int32(&Indirection - IndirectionBase);
+			++WriteCounts[IndirectionIndex];
+			WriterIndices[IndirectionIndex] = ProviderIndex;
+		}
+	}
+};
+
+static bool RunBroadcastTest_RenderThread(FRHICommandListImmediate& RHICmdList, FAutomationTestBase& Test)
+{
+	const int32 NumProviders = 6;
+	const int32 NumIndirections = 5000;
+
+	// The registry holds the extension's providers and broadcast, without needing a scene
+	FSkinningTransformProvider::FRegistry Registry;
+	FMockTransformWrites Writes;
+
+	TArray<FGuid> Ids;
+	for (int32 ProviderIndex = 0; ProviderIndex < NumProviders; ++ProviderIndex)
+	{
+		Ids.Add(FGuid::NewGuid());
+	}
+
+	// Register an extra provider and remove it again to exercise the index remapping
+	const FGuid RemovedId = FGuid::NewGuid();
+	Registry.RegisterProvider(RemovedId, FSkinningTransformProvider::FOnProvideTransforms::CreateLambda([](FSkinningTransformProvider::FProviderContext&) { checkNoEntry(); }));
+
+	for (int32 ProviderIndex = 0; ProviderIndex < NumProviders; ++ProviderIndex)
+	{
+		Registry.RegisterProvider(
+			Ids[ProviderIndex],
+			FSkinningTransformProvider::FOnProvideTransforms::CreateLambda([&Writes, ProviderIndex](FSkinningTransformProvider::FProviderContext& Context) { Writes.OnProvide(Context, ProviderIndex); })
+		);
+	}
+
+	Registry.UnregisterProvider(RemovedId);
+	Test.TestEqual(TEXT("Provider count"), Registry.GetNumProviders(), NumProviders);
+	Test.TestEqual(TEXT("Removed provider index"), Registry.FindProviderIndex(RemovedId), int32(INDEX_NONE));
+
+	// Split the indirections in random ranges, in reverse provider order so the ranges have to be matched by id
+	FRandomStream Random(0x1d5);
+	TArray<FSkinningTransformProvider::FProviderRange> Ranges;
+	TArray<int32> ExpectedWriters;
+	ExpectedWriters.SetNumUninitialized(NumIndirections);
+
+	uint32 Offset = 0;
+	for (int32 ProviderIndex = NumProviders - 1; ProviderIndex >= 0; --ProviderIndex)
+	{
+		const uint32 Count = ProviderIndex == 0 ? uint32(NumIndirections) - Offset : uint32(Random.RandRange(0, NumIndirections / NumProviders));
+
+		FSkinningTransformProvider::FProviderRange& Range = Ranges.AddDefaulted_GetRef();
+		Range.Id = Ids[ProviderIndex];
+		Range.Offset = Offset;
+		Range.Count = Count;
+
+		for (uint32 Index = Offset; Index < Offset + Count; ++Index)
+		{
+			ExpectedWriters[Index] = ProviderIndex;
+		}
+		Offset += Count;
+	}
+
+	TArray<FUintVector2> Indirections;
+	Indirections.SetNumZeroed(NumIndirections);
+	Writes.IndirectionBase = Indirections.GetData();
+	Writes.WriteCounts.Init(0, NumIndirections);
+	Writes.WriterIndices.Init(INDEX_NONE, NumIndirections);
+
+	FRDGBuilder GraphBuilder(RHICmdList);
+	FSkinningTransformProvider::FProviderContext Context(
+		TConstArrayView<FPrimitiveSceneInfo*>(),
+		Indirections,
+		0.0f,
+		GraphBuilder,
+		nullptr
+	);
+
+	Registry.Broadcast(Ranges, Context);
+	GraphBuilder.Execute();
+
+	int32 NumInvalidWrites = 0;
+	for (int32 Index = 0; Index < NumIndirections; ++Index)
+	{
+		if (Writes.WriteCounts[Index] != 1 || Writes.WriterIndices[Index] != ExpectedWriters[Index])
+		{
+			++NumInvalidWrites;
+		}
+	}
+
+	Test.TestEqual(TEXT("Indirections not written exactly once by their provider"), NumInvalidWrites, 0);
+	Test.TestEqual(TEXT("Context indirections are restored"), Context.Indirections.Num(), NumIndirections);
+
+	return NumInvalidWrites == 0;
+}
+
+} // SkinningTransformProviderTestbed
+
+bool FSkinningTransformProviderTestbed::RunTest(const FString& Parameters)
+{
+	using namespace SkinningTransformProviderTestbed;
+
+	bool bTestPassed = false;
+
+	FlushRenderingCommands();
+
+	ENQUEUE_RENDER_COMMAND(FSkinningTransformProviderTestbed)(
+		[&](FRHICommandListImmediate& RHICmdList)
+	{
+		bTestPassed = RunBroadcastTest_RenderThread(RHICmdList, *this);
+	});
+
+	FlushRenderingCommands();
+
+	return bTestPassed;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
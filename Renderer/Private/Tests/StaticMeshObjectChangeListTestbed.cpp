@@ -0,0 +1,225 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "StateStream/StaticMeshStateStreamImpl.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStaticMeshObjectChangeListTestbed, "System.Renderer.StateStream.StaticMeshChangeList", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace StaticMeshObjectChangeListTestbed
+{
+
+/** Stand in for FStaticMeshObject, with the state the scene is expected to have after each flush. */
+struct FMockObject
+{
+	FPrimitiveSceneInfoData PrimitiveSceneData;
+	FPrimitiveSceneDesc PrimitiveSceneDesc;
+
+	/** Latest state given by the mock transform stream */
+	FTransform Transform;
+	bool bVisible = true;
+	/** Visibility as last given to the change list, FStaticMeshObject::bVisible */
+	bool bNotifiedVisible = true;
+
+	/** State of the object in the scene */
+	FMatrix SceneLocalToWorld;
+	bool bSceneVisible = true;
+	bool bInScene = false;
+
+	bool bAlive = false;
+	bool bCreatedThisFrame = false;
+};
+
+static FTransform MakeTransform(FRandomStream& Random)
+{
+	return FTransform(FRotator(0.0f, Random.FRandRange(0.0f, 360.0f), 0.0f), FVector(Random.FRandRange(-1.0e4f, 1.0e4f), Random.FRandRange(-1.0e4f, 1.0e4f), 0.0f));
+}
+
+/** Same as FStaticMeshStateStreamImpl::Render_OnCreate */
+static void Create(FStaticMeshObjectChangeList& Changes, FMockObject& Object, FRandomStream& Random)
+{
+	Object.Transform = MakeTransform(Random);
+	Object.bVisible = Random.FRand() < 0.8f;
+	Object.bAlive = true;
+	Object.bCreatedThisFrame = true;
+
+	Object.PrimitiveSceneDesc.PrimitiveSceneData = &Object.PrimitiveSceneData;
+	Object.PrimitiveSceneDesc.LocalBounds = FBoxSphereBounds(FVector::ZeroVector, FVector(100.0f), 173.2f);
+	Object.PrimitiveSceneDesc.RenderMatrix = Object.Transform.ToMatrixWithScale();
+	Object.PrimitiveSceneDesc.AttachmentRootPosition = Object.Transform.GetLocation();
+	Object.PrimitiveSceneDesc.Bounds = Object.PrimitiveSceneDesc.LocalBounds.TransformBy(Object.Transform);
+
+	// The proxy is created with the visibility at creation time
+	Object.bSceneVisible = Object.bVisible;
+	Object.bNotifiedVisible = Object.bVisible;
+
+	Changes.AddCreated(Object.PrimitiveSceneDesc, Object.bVisible);
+}
+
+/** Same as FStaticMeshObject::OnTransformObjectDirty */
+static void Notify(FStaticMeshObjectChangeList& Changes, FMockObject& Object)
+{
+	Changes.MarkDirty(Object.PrimitiveSceneDesc, Object.Transform, Object.bVisible, Object.bNotifiedVisible);
+	Object.bNotifiedVisible = Object.bVisible;
+}
+
+} // StaticMeshObjectChangeListTestbed
+
+bool FStaticMeshObjectChangeListTestbed::RunTest(const FString& Parameters)
+{
+	using namespace StaticMeshObjectChangeListTestbed;
+
+	FRandomStream Random(0x534D4348);
+
+	const int32 MaxObjects = 8192;
+	TArray<FMockObject> Objects;
+	Objects.SetNum(MaxObjects);
+
+	TMap<const FPrimitiveSceneProxy*, int32> ProxyToObject;
+	for (int32 Index = 0; Index < MaxObjects; ++Index)
+	{
+		FPrimitiveSceneProxy* Proxy = reinterpret_cast<FPrimitiveSceneProxy*>(UPTRINT(Index + 1) * 16);
+		Objects[Index].PrimitiveSceneData.SceneProxy = Proxy;
+		ProxyToObject.Add(Proxy, Index);
+	}
+
+	FStaticMeshObjectChangeList Changes;
+	FStaticMeshObjectChangeList::FFlushedChanges Flushed;
+
+	bool bCountsMatch = true;
+	bool bSetsMatch = true;
+	bool bDescsMatch = true;
+	int32 NumNotifications = 0;
+	int32 NumSceneCalls = 0;
+	int32 NumObjectUpdates = 0;
+
+	for (int32 Frame = 0; Frame < 64; ++Frame)
+	{
+		// Mass spawn on the first frame, then a few objects created and destroyed every frame
+		const int32 NumCreates = Frame == 0 ? MaxObjects / 2 : Random.RandRange(0, 64);
+		for (int32 CreateIndex = 0; CreateIndex < NumCreates; ++CreateIndex)
+		{
+			const int32 ObjectIndex = Random.RandRange(0, MaxObjects - 1);
+			if (!Objects[ObjectIndex].bAlive)
+			{
+				Create(Changes, Objects[ObjectIndex], Random);
+			}
+		}
+
+		// Transform stream: objects move or change visibility, some of them several times in the frame
+		const int32 NumDirty = Random.RandRange(0, 4096);
+		for (int32 DirtyIndex = 0; DirtyIndex < NumDirty; ++DirtyIndex)
+		{
+			FMockObject& Object = Objects[Random.RandRange(0, MaxObjects - 1)];
+			if (!Object.bAlive)
+			{
+				continue;
+			}
+
+			const float Change = Random.FRand();
+			if (Change < 0.7f)
+			{
+				Object.Transform = MakeTransform(Random);
+			}
+			else if (Change < 0.9f)
+			{
+				Object.bVisible = !Object.bVisible;
+			}
+			// Otherwise a notification without any change
+			Notify(Changes, Object);
+			++NumNotifications;
+		}
+
+		const int32 NumDestroys = Random.RandRange(0, 32);
+		for (int32 DestroyIndex = 0; DestroyIndex < NumDestroys; ++DestroyIndex)
+		{
+			FMockObject& Object = Objects[Random.RandRange(0, MaxObjects - 1)];
+			if (Object.bAlive)
+			{
+				const bool bWasPendingCreate = Changes.Remove(Object.PrimitiveSceneDesc);
+				bCountsMatch &= bWasPendingCreate == Object.bCreatedThisFrame;
+				Object.bAlive = false;
+				Object.bInScene = false;
+				Object.bCreatedThisFrame = false;
+			}
+		}
+
+		// Expected scene updates, from the difference between the latest state and the scene state
+		int32 ExpectedCreated = 0;
+		int32 ExpectedMoved = 0;
+		int32 ExpectedShown = 0;
+		int32 ExpectedHidden = 0;
+		for (FMockObject& Object : Objects)
+		{
+			if (!Object.bAlive)
+			{
+				continue;
+			}
+
+			const FMatrix LocalToWorld = Object.Transform.ToMatrixWithScale();
+			if (Object.bCreatedThisFrame)
+			{
+				++ExpectedCreated;
+				Object.SceneLocalToWorld = LocalToWorld;
+				Object.bInScene = true;
+				Object.bCreatedThisFrame = false;
+				// Visibility changed since the creation is applied at the next flush, once the object is in the scene
+				continue;
+			}
+
+			if (!LocalToWorld.Equals(Object.SceneLocalToWorld, 0.0f))
+			{
+				++ExpectedMoved;
+				Object.SceneLocalToWorld = LocalToWorld;
+			}
+			if (Object.bVisible != Object.bSceneVisible)
+			{
+				++(Object.bVisible ? ExpectedShown : ExpectedHidden);
+				Object.bSceneVisible = Object.bVisible;
+			}
+		}
+
+		Changes.Flush(Flushed);
+
+		bCountsMatch &= Flushed.Created.Num() == ExpectedCreated;
+		bCountsMatch &= Flushed.MovedProxies.Num() == ExpectedMoved;
+		bCountsMatch &= Flushed.Shown.Num() == ExpectedShown;
+		bCountsMatch &= Flushed.Hidden.Num() == ExpectedHidden;
+
+		for (FPrimitiveSceneProxy* Proxy : Flushed.Shown)
+		{
+			bSetsMatch &= Objects[ProxyToObject[Proxy]].bSceneVisible;
+		}
+		for (FPrimitiveSceneProxy* Proxy : Flushed.Hidden)
+		{
+			bSetsMatch &= !Objects[ProxyToObject[Proxy]].bSceneVisible;
+		}
+		for (int32 MovedIndex = 0; MovedIndex < Flushed.MovedProxies.Num(); ++MovedIndex)
+		{
+			const FMockObject& Object = Objects[ProxyToObject[Flushed.MovedProxies[MovedIndex]]];
+			bSetsMatch &= Flushed.MovedLocalToWorlds[MovedIndex].Equals(Object.SceneLocalToWorld, 0.0f);
+		}
+		for (const FMockObject& Object : Objects)
+		{
+			bDescsMatch &= !Object.bInScene || Object.PrimitiveSceneDesc.RenderMatrix.Equals(Object.SceneLocalToWorld, 0.0f);
+		}
+
+		// One scene call per kind of change, as Render_PostUpdate does
+		NumSceneCalls += (Flushed.Created.IsEmpty() ? 0 : 1) + (Flushed.MovedProxies.IsEmpty() ? 0 : 1) + (Flushed.Shown.IsEmpty() ? 0 : 1) + (Flushed.Hidden.IsEmpty() ? 0 : 1);
+		NumObjectUpdates += ExpectedCreated + ExpectedMoved + ExpectedShown + ExpectedHidden;
+	}
+
+	TestTrue(TEXT("Flushed change counts match the state changes"), bCountsMatch);
+	TestTrue(TEXT("Flushed changes have the latest state"), bSetsMatch);
+	TestTrue(TEXT("Scene descs have the latest transform"), bDescsMatch);
+	TestTrue(TEXT("At most one scene call per kind of change and frame"), NumSceneCalls <= 64 * 4);
+
+	AddInfo(FString::Printf(TEXT("%d transform notifications, %d object updates: %d scene calls"), NumNotifications, NumObjectUpdates, NumSceneCalls));
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
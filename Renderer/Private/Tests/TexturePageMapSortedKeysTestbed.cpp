@@ -0,0 +1,367 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "VT/TexturePageMap.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTexturePageMapSortedKeysTestbed, "System.Renderer.VirtualTexture.TexturePageMapSortedKeys", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace TexturePageMapSortedKeysTestbed
+{
+
+static const uint32 vDimensions = 2;
+
+static uint32 EncodeSortKey(uint8 vLevel, uint32 vAddress)
+{
+	return vAddress | ((uint32)vLevel << 24);
+}
+
+/** Previous FTexturePageMap sorted key maintenance (comparison sort of the adds through the pages, three-way merge), as a reference. */
+class FReferenceSortedKeys
+{
+public:
+	void Add(uint32 Key, uint32 PageIndex, FPhysicalSpaceIDAndAddress Address)
+	{
+		if (PageIndex >= (uint32)PageKeys.Num())
+		{
+			PageKeys.SetNum(PageIndex + 1);
+			PageAddresses.SetNum(PageIndex + 1);
+		}
+		PageKeys[PageIndex] = Key;
+		PageAddresses[PageIndex] = Address;
+
+		const uint32 NewIndex = UpperBound(0, SortedKeys.Num(), Key, ~0u);
+		SortedAddIndexes.Add(((uint64)NewIndex << 32) | PageIndex);
+	}
+
+	void Remove(uint32 Key, uint32 PageIndex)
+	{
+		for (int32 AddIndex = 0; AddIndex < SortedAddIndexes.Num(); ++AddIndex)
+		{
+			if ((SortedAddIndexes[AddIndex] & 0xffffffff) == PageIndex)
+			{
+				SortedAddIndexes.RemoveAtSwap(AddIndex, EAllowShrinking::No);
+				return;
+			}
+		}
+
+		SortedSubIndexes.Add(LowerBound(0, SortedKeys.Num(), Key, ~0u));
+	}
+
+	void Build()
+	{
+		SortedSubIndexes.Sort();
+		SortedAddIndexes.Sort([this](const uint64& A, const uint64& B)
+		{
+			return PageKeys[(uint32)A] < PageKeys[(uint32)B];
+		});
+
+		Exchange(SortedKeys, UnsortedKeys);
+		Exchange(SortedAddresses, UnsortedAddresses);
+
+		uint32 NumUnsorted = UnsortedKeys.Num();
+		SortedKeys.SetNum(NumUnsorted + SortedAddIndexes.Num() - SortedSubIndexes.Num(), EAllowShrinking::No);
+		SortedAddresses.SetNum(NumUnsorted + SortedAddIndexes.Num() - SortedSubIndexes.Num(), EAllowShrinking::No);
+
+		int32 SubI = 0;
+		int32 AddI = 0;
+		int32 UnsortedI = 0;
+		int32 SortedI = 0;
+
+		while (SortedI < SortedKeys.Num())
+		{
+			const uint32 SubIndex = SubI < SortedSubIndexes.Num() ? SortedSubIndexes[SubI] : NumUnsorted;
+			const uint32 AddIndex = AddI < SortedAddIndexes.Num() ? (SortedAddIndexes[AddI] >> 32) : NumUnsorted;
+			const uint32 MinIndex = FMath::Min(SubIndex, AddIndex);
+
+			if (MinIndex > (uint32)UnsortedI)
+			{
+				const uint32 Interval = MinIndex - UnsortedI;
+				FMemory::Memcpy(&SortedKeys[SortedI], &UnsortedKeys[UnsortedI], Interval * sizeof(uint32));
+				FMemory::Memcpy(&SortedAddresses[SortedI], &UnsortedAddresses[UnsortedI], Interval * sizeof(FPhysicalSpaceIDAndAddress));
+
+				UnsortedI += Interval;
+				SortedI += Interval;
+
+				if (SortedI >= SortedKeys.Num())
+					break;
+			}
+
+			if (SubIndex < AddIndex)
+			{
+				UnsortedI++;
+				SubI++;
+			}
+			else
+			{
+				const uint32 PageIndex = (uint32)SortedAddIndexes[AddI];
+				SortedKeys[SortedI] = PageKeys[PageIndex];
+				SortedAddresses[SortedI] = PageAddresses[PageIndex];
+
+				SortedI++;
+				AddI++;
+			}
+		}
+
+		SortedSubIndexes.Reset();
+		SortedAddIndexes.Reset();
+	}
+
+	uint32 LowerBound(uint32 Min, uint32 Max, uint32 SearchKey, uint32 Mask) const
+	{
+		while (Min != Max)
+		{
+			uint32 Mid = Min + (Max - Min) / 2;
+			uint32 Key = SortedKeys[Mid] & Mask;
+
+			if (SearchKey <= Key)
+				Max = Mid;
+			else
+				Min = Mid + 1;
+		}
+
+		return Min;
+	}
+
+	uint32 UpperBound(uint32 Min, uint32 Max, uint32 SearchKey, uint32 Mask) const
+	{
+		while (Min != Max)
+		{
+			uint32 Mid = Min + (Max - Min) / 2;
+			uint32 Key = SortedKeys[Mid] & Mask;
+
+			if (SearchKey < Key)
+				Max = Mid;
+			else
+				Min = Mid + 1;
+		}
+
+		return Min;
+	}
+
+	uint64 EqualRange(uint32 Min, uint32 Max, uint32 SearchKey, uint32 Mask) const
+	{
+		while (Min != Max)
+		{
+			uint32 Mid = Min + (Max - Min) / 2;
+			uint32 Key = SortedKeys[Mid] & Mask;
+
+			if (SearchKey < Key)
+			{
+				Max = Mid;
+			}
+			else if (SearchKey > Key)
+			{
+				Min = Mid + 1;
+			}
+			else
+			{
+				Min = LowerBound(Min, Mid, SearchKey, Mask);
+				Max = UpperBound(Mid + 1, Max, SearchKey, Mask);
+				return Min | ((uint64)Max << 32);
+			}
+		}
+
+		return 0;
+	}
+
+	TArray< uint32 >						SortedKeys;
+	TArray< FPhysicalSpaceIDAndAddress >	SortedAddresses;
+
+private:
+	TArray< uint32 >						UnsortedKeys;
+	TArray< FPhysicalSpaceIDAndAddress >	UnsortedAddresses;
+	TArray< uint32 >	SortedSubIndexes;
+	TArray< uint64 >	SortedAddIndexes;
+	TArray< uint32 >	PageKeys;
+	TArray< FPhysicalSpaceIDAndAddress >	PageAddresses;
+};
+
+/** Mapped pages with stable page indexes, like the page entries of FTexturePageMap. */
+struct FMappedPages
+{
+	TMap<uint32, uint32> PageIndexByKey;
+	TArray<uint32> Keys;
+	TArray<uint32> FreePageIndexes;
+	uint32 NumPageIndexes = 0;
+
+	uint32 AcquirePageIndex()
+	{
+		return FreePageIndexes.Num() > 0 ? FreePageIndexes.Pop(EAllowShrinking::No) : NumPageIndexes++;
+	}
+};
+
+static uint32 RandomKey(FRandomStream& Random, uint32 MaxLevel)
+{
+	// Each level is half as common as the one below, addresses are aligned to the level like the virtual texture pages
+	const uint8 vLevel = (uint8)FMath::CountTrailingZeros(uint32(Random.RandHelper(1 << MaxLevel)) | (1u << (MaxLevel - 1)));
+	const uint32 vAddress = uint32(Random.RandHelper(1 << 24)) & (~0u << (vDimensions * vLevel)) & 0x00ffffffu;
+	return EncodeSortKey(vLevel, vAddress);
+}
+
+static bool AddressesEqual(const TArray<FPhysicalSpaceIDAndAddress>& A, const TArray<FPhysicalSpaceIDAndAddress>& B)
+{
+	if (A.Num() != B.Num())
+	{
+		return false;
+	}
+
+	for (int32 Index = 0; Index < A.Num(); ++Index)
+	{
+		if (A[Index].Packed != B[Index].Packed)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+} // TexturePageMapSortedKeysTestbed
+
+bool FTexturePageMapSortedKeysTestbed::RunTest(const FString& Parameters)
+{
+	using namespace TexturePageMapSortedKeysTestbed;
+
+	FRandomStream Random(0x7a9e);
+
+	struct FChurnDesc
+	{
+		const TCHAR* Name;
+		int32 NumFrames;
+		int32 MaxMapped;
+		// Max adds and removes per frame
+		int32 MaxDelta;
+	};
+
+	const FChurnDesc ChurnDescs[] =
+	{
+		{ TEXT("Small deltas"),		400,	20000,	FTexturePageSortedKeys::MaxInPlaceDelta },
+		{ TEXT("Steady streaming"),	200,	50000,	200 },
+		{ TEXT("Fast camera"),		60,		200000,	8000 },
+	};
+
+	for (const FChurnDesc& Desc : ChurnDescs)
+	{
+		FTexturePageSortedKeys SortedKeys;
+		FReferenceSortedKeys ReferenceSortedKeys;
+		FMappedPages MappedPages;
+
+		bool bKeysMatch = true;
+		bool bQueriesMatch = true;
+		uint64 Cycles = 0;
+		uint64 ReferenceCycles = 0;
+		int64 NumChanges = 0;
+
+		for (int32 Frame = 0; Frame < Desc.NumFrames; ++Frame)
+		{
+			// Mostly grow during the first quarter, then churn around the max
+			const int64 FrameChangesStart = NumChanges;
+			const int32 NumAdds = Random.RandRange(0, Desc.MaxDelta);
+			const int32 NumRemoves = Frame < Desc.NumFrames / 4 ? Random.RandRange(0, NumAdds / 4) : Random.RandRange(0, Desc.MaxDelta);
+
+			for (int32 Index = 0; Index < NumAdds && MappedPages.Keys.Num() < Desc.MaxMapped; ++Index)
+			{
+				const uint32 Key = RandomKey(Random, 11);
+				if (MappedPages.PageIndexByKey.Contains(Key))
+				{
+					continue;
+				}
+
+				const uint32 PageIndex = MappedPages.AcquirePageIndex();
+				const FPhysicalSpaceIDAndAddress Address((uint16)Random.RandHelper(16), (uint16)Random.RandHelper(65536));
+				MappedPages.PageIndexByKey.Add(Key, PageIndex);
+				MappedPages.Keys.Add(Key);
+
+				SortedKeys.Add(Key, PageIndex, Address);
+				ReferenceSortedKeys.Add(Key, PageIndex, Address);
+				++NumChanges;
+			}
+
+			// Removes include pages mapped during the same frame, some removed pages are mapped again right away
+			TArray<uint32> RemappedKeys;
+			for (int32 Index = 0; Index < NumRemoves && MappedPages.Keys.Num() > 0; ++Index)
+			{
+				const int32 KeyIndex = Random.RandHelper(MappedPages.Keys.Num());
+				const uint32 Key = MappedPages.Keys[KeyIndex];
+				const uint32 PageIndex = MappedPages.PageIndexByKey.FindAndRemoveChecked(Key);
+				MappedPages.Keys.RemoveAtSwap(KeyIndex, EAllowShrinking::No);
+				MappedPages.FreePageIndexes.Add(PageIndex);
+
+				SortedKeys.Remove(Key, PageIndex);
+				ReferenceSortedKeys.Remove(Key, PageIndex);
+				++NumChanges;
+
+				if (Random.GetFraction() < 0.1f)
+				{
+					RemappedKeys.Add(Key);
+				}
+			}
+
+			for (uint32 Key : RemappedKeys)
+			{
+				const uint32 PageIndex = MappedPages.AcquirePageIndex();
+				const FPhysicalSpaceIDAndAddress Address((uint16)Random.RandHelper(16), (uint16)Random.RandHelper(65536));
+				MappedPages.PageIndexByKey.Add(Key, PageIndex);
+				MappedPages.Keys.Add(Key);
+
+				SortedKeys.Add(Key, PageIndex, Address);
+				ReferenceSortedKeys.Add(Key, PageIndex, Address);
+				++NumChanges;
+			}
+
+			const uint64 Time0 = FPlatformTime::Cycles64();
+			if (SortedKeys.IsDirty())
+			{
+				SortedKeys.Build();
+			}
+			const uint64 Time1 = FPlatformTime::Cycles64();
+			if (NumChanges != FrameChangesStart)
+			{
+				ReferenceSortedKeys.Build();
+			}
+			const uint64 Time2 = FPlatformTime::Cycles64();
+
+			Cycles += Time1 - Time0;
+			ReferenceCycles += Time2 - Time1;
+
+			bKeysMatch &= SortedKeys.GetKeys() == ReferenceSortedKeys.SortedKeys;
+			bKeysMatch &= AddressesEqual(SortedKeys.GetAddresses(), ReferenceSortedKeys.SortedAddresses);
+
+			// Descendant queries as done by the page table update expansion
+			for (int32 QueryIndex = 0; QueryIndex < 64; ++QueryIndex)
+			{
+				const uint32 QueryKey = (QueryIndex & 1) && SortedKeys.Num() > 0 ? SortedKeys.GetKeys()[Random.RandHelper(SortedKeys.Num())] : RandomKey(Random, 11);
+				const uint8 vLogSize = (uint8)(QueryKey >> 24) + 1;
+				const uint32 vAddress = QueryKey & 0x00ffffffu & (~0u << (vDimensions * vLogSize));
+				const uint32 Mask = ~0u << (vDimensions * vLogSize);
+				const uint32 SearchRange = Random.RandRange(0, SortedKeys.Num());
+
+				for (uint32 Mip = vLogSize; Mip > 0; )
+				{
+					Mip--;
+					const uint32 SearchKey = EncodeSortKey((uint8)Mip, vAddress);
+					bQueriesMatch &= SortedKeys.EqualRange(0, SearchRange, SearchKey, Mask) == ReferenceSortedKeys.EqualRange(0, SearchRange, SearchKey, Mask);
+					bQueriesMatch &= SortedKeys.LowerBound(0, SearchRange, SearchKey, Mask) == ReferenceSortedKeys.LowerBound(0, SearchRange, SearchKey, Mask);
+					bQueriesMatch &= SortedKeys.UpperBound(0, SearchRange, SearchKey, ~0u) == ReferenceSortedKeys.UpperBound(0, SearchRange, SearchKey, ~0u);
+				}
+			}
+		}
+
+		TestTrue(FString::Printf(TEXT("%s: same sorted keys and addresses"), Desc.Name), bKeysMatch);
+		TestTrue(FString::Printf(TEXT("%s: same query results"), Desc.Name), bQueriesMatch);
+
+		AddInfo(FString::Printf(TEXT("%s: %d pages mapped, %.1f changes per frame, build %.3fms (previous %.3fms) per frame"),
+			Desc.Name,
+			SortedKeys.Num(),
+			double(NumChanges) / Desc.NumFrames,
+			FPlatformTime::ToMilliseconds64(Cycles) / Desc.NumFrames,
+			FPlatformTime::ToMilliseconds64(ReferenceCycles) / Desc.NumFrames));
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
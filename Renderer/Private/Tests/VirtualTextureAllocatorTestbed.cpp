@@ -0,0 +1,218 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreMinimal.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "VT/VirtualTextureAllocator.h"
+
+#if WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVirtualTextureAllocatorTestbed, "System.Renderer.VirtualTexture.Allocator", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace VirtualTextureAllocatorTestbed
+{
+
+struct FTraceOp
+{
+	// Allocation id, freed when the size is 0
+	int32 Id;
+	uint32 WidthInTiles;
+	uint32 HeightInTiles;
+	uint32 MaxLevel;
+};
+
+/** Allocation keys are never dereferenced by the allocator, only used for the hash table and Free(). */
+static FAllocatedVirtualTexture* GetKey(int32 Id)
+{
+	return reinterpret_cast<FAllocatedVirtualTexture*>(UPTRINT(Id + 1) * 16u);
+}
+
+/**
+ * Mix of streaming virtual textures (power of two, full mip chain) and runtime virtual textures (multiple of 8 tiles, fewer levels).
+ * Keeps the number of address blocks within the 16 bit indexes of the allocator.
+ */
+static FTraceOp RandomAllocation(FRandomStream& Random, int32 Id)
+{
+	FTraceOp Op;
+	Op.Id = Id;
+
+	if (Random.GetFraction() < 0.75f)
+	{
+		const uint32 LogWidth = FMath::Min(Random.RandHelper(6) + Random.RandHelper(3), 7);
+		const uint32 LogHeight = FMath::Clamp<int32>(LogWidth + Random.RandRange(-2, 2), 0, 7);
+		Op.WidthInTiles = 1u << LogWidth;
+		Op.HeightInTiles = 1u << LogHeight;
+		Op.MaxLevel = FMath::CeilLogTwo(FMath::Max(Op.WidthInTiles, Op.HeightInTiles));
+	}
+	else
+	{
+		Op.WidthInTiles = Random.RandRange(1, 12) * 8u;
+		Op.HeightInTiles = Random.RandRange(1, 12) * 8u;
+		Op.MaxLevel = Random.RandRange(3, FMath::CeilLogTwo(FMath::Max(Op.WidthInTiles, Op.HeightInTiles)));
+	}
+
+	return Op;
+}
+
+/** Fill up the address space, then free and allocate in random order, in bursts like streaming levels in and out. */
+static TArray<FTraceOp> GenerateTrace(FRandomStream& Random, int32 NumLive, int32 NumChurnOps)
+{
+	TArray<FTraceOp> Trace;
+	TArray<int32> LiveIds;
+	int32 NextId = 0;
+
+	for (int32 Index = 0; Index < NumLive; ++Index)
+	{
+		LiveIds.Add(NextId);
+		Trace.Add(RandomAllocation(Random, NextId++));
+	}
+
+	while (Trace.Num() < NumLive + NumChurnOps)
+	{
+		const int32 BurstSize = Random.RandRange(1, 64);
+		const bool bFree = LiveIds.Num() > NumLive / 2 && (LiveIds.Num() >= NumLive || Random.GetFraction() < 0.5f);
+
+		for (int32 Index = 0; Index < BurstSize; ++Index)
+		{
+			if (bFree)
+			{
+				const int32 LiveIndex = Random.RandHelper(LiveIds.Num());
+				Trace.Add({ LiveIds[LiveIndex], 0u, 0u, 0u });
+				LiveIds.RemoveAtSwap(LiveIndex, EAllowShrinking::No);
+			}
+			else
+			{
+				LiveIds.Add(NextId);
+				Trace.Add(RandomAllocation(Random, NextId++));
+			}
+		}
+	}
+
+	return Trace;
+}
+
+struct FReplayResult
+{
+	TArray<uint32> Addresses;
+	uint64 Cycles = 0;
+	bool bOverlap = false;
+	int32 NumFailed = 0;
+};
+
+static FReplayResult ReplayTrace(const TArray<FTraceOp>& Trace, uint32 MaxSize, int32 Validation)
+{
+	IConsoleVariable* CVarValidation = IConsoleManager::Get().FindConsoleVariable(TEXT("r.VT.AllocatorValidation"));
+	const int32 PreviousValidation = CVarValidation->GetInt();
+	CVarValidation->Set(Validation, ECVF_SetByCode);
+
+	FReplayResult Result;
+	FVirtualTextureAllocator Allocator(2);
+	Allocator.Initialize(MaxSize);
+
+	// Tile coverage, to check that the allocations never overlap
+	TArray<bool> Tiles;
+	Tiles.SetNumZeroed(MaxSize * MaxSize);
+	TMap<int32, TPair<uint32, const FTraceOp*>> LiveAllocations;
+
+	auto MarkTiles = [&](uint32 vAddress, const FTraceOp& Op, bool bAllocated)
+	{
+		const uint32 vTileX = FMath::ReverseMortonCode2(vAddress);
+		const uint32 vTileY = FMath::ReverseMortonCode2(vAddress >> 1);
+		if (vTileX + Op.WidthInTiles > MaxSize || vTileY + Op.HeightInTiles > MaxSize)
+		{
+			Result.bOverlap = true;
+			return;
+		}
+
+		for (uint32 Y = vTileY; Y < vTileY + Op.HeightInTiles; ++Y)
+		{
+			for (uint32 X = vTileX; X < vTileX + Op.WidthInTiles; ++X)
+			{
+				Result.bOverlap |= bAllocated && Tiles[Y * MaxSize + X];
+				Tiles[Y * MaxSize + X] = bAllocated;
+			}
+		}
+	};
+
+	for (const FTraceOp& Op : Trace)
+	{
+		if (Op.WidthInTiles > 0u)
+		{
+			const uint64 Time0 = FPlatformTime::Cycles64();
+			const uint32 vAddress = Allocator.Alloc(GetKey(Op.Id), Op.WidthInTiles, Op.HeightInTiles, Op.MaxLevel);
+			Result.Cycles += FPlatformTime::Cycles64() - Time0;
+
+			Result.Addresses.Add(vAddress);
+			if (vAddress != ~0u)
+			{
+				LiveAllocations.Add(Op.Id, { vAddress, &Op });
+				MarkTiles(vAddress, Op, true);
+			}
+			else
+			{
+				++Result.NumFailed;
+			}
+		}
+		else if (const TPair<uint32, const FTraceOp*>* LiveAllocation = LiveAllocations.Find(Op.Id))
+		{
+			const uint64 Time0 = FPlatformTime::Cycles64();
+			Allocator.Free(GetKey(Op.Id));
+			Result.Cycles += FPlatformTime::Cycles64() - Time0;
+
+			MarkTiles(LiveAllocation->Key, *LiveAllocation->Value, false);
+			LiveAllocations.Remove(Op.Id);
+		}
+	}
+
+	CVarValidation->Set(PreviousValidation, ECVF_SetByCode);
+	return Result;
+}
+
+} // VirtualTextureAllocatorTestbed
+
+bool FVirtualTextureAllocatorTestbed::RunTest(const FString& Parameters)
+{
+	using namespace VirtualTextureAllocatorTestbed;
+
+	struct FTraceDesc
+	{
+		const TCHAR* Name;
+		uint32 MaxSize;
+		int32 NumLive;
+		int32 NumChurnOps;
+	};
+
+	const FTraceDesc TraceDescs[] =
+	{
+		{ TEXT("Small page table"),		256,	200,	4000 },
+		{ TEXT("Large page table"),		1024,	2000,	20000 },
+		{ TEXT("Nearly full"),			512,	1000,	20000 },
+	};
+
+	FRandomStream Random(0x7a110c);
+
+	for (const FTraceDesc& Desc : TraceDescs)
+	{
+		const TArray<FTraceOp> Trace = GenerateTrace(Random, Desc.NumLive, Desc.NumChurnOps);
+
+		// Validation mode checks each allocation against the linear search, the replays must also match each other
+		const FReplayResult Result = ReplayTrace(Trace, Desc.MaxSize, 0);
+		const FReplayResult LinearResult = ReplayTrace(Trace, Desc.MaxSize, 2);
+		ReplayTrace(Trace, Desc.MaxSize, 1);
+
+		TestFalse(FString::Printf(TEXT("%s: allocations don't overlap"), Desc.Name), Result.bOverlap);
+		TestTrue(FString::Printf(TEXT("%s: same addresses as the linear search"), Desc.Name), Result.Addresses == LinearResult.Addresses);
+
+		AddInfo(FString::Printf(TEXT("%s: %d ops, %d allocations failed, %.2fms (linear search %.2fms)"),
+			Desc.Name,
+			Trace.Num(),
+			Result.NumFailed,
+			FPlatformTime::ToMilliseconds64(Result.Cycles),
+			FPlatformTime::ToMilliseconds64(LinearResult.Cycles)));
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS || WITH_EDITOR
@@ -2,6 +2,7 @@
 
 #include "AdaptiveVirtualTexture.h"
 
+#include "VT/AdaptiveVirtualTextureLRUPlanner.h"
 #include "VT/AllocatedVirtualTexture.h"
 #include "VT/VirtualTexturePhysicalSpace.h"
 #include "VT/VirtualTextureScalability.h"
@@ -23,6 +24,14 @@ static TAutoConsoleVariable<int32> CVarAVTMaxFreePerFrame(
 	ECVF_RenderThreadSafe
 );
 
+static TAutoConsoleVariable<int32> CVarAVTBatchedFreeLRU(
+	TEXT("r.VT.AVT.BatchedFreeLRU"),
+	1,
+	TEXT("Plan the frees of a frame as one batch, reallocating each least recently used allocation directly to its target level.\n")
+	TEXT("0 frees one level at a time, with a page remap for each level"),
+	ECVF_RenderThreadSafe
+);
+
 static TAutoConsoleVariable<int32> CVarAVTMaxPageResidency(
 	TEXT("r.VT.AVT.MaxPageResidency"),
 	75,
@@ -267,6 +276,9 @@ FAdaptiveVirtualTexture::FAdaptiveVirtualTexture(
 	ensure(AdaptiveGridLevelsX >= 0 && AdaptiveGridLevelsY >= 0); // Aspect ratio is too big for desired grid size. This will give bad results.
 
 	GridSize = FIntPoint(1 << FMath::Max(AdaptiveGridLevelsX, 0), 1 << FMath::Max(AdaptiveGridLevelsY, 0));
+
+	// The indirection texture is cleared on creation
+	IndirectionTextureValues.SetNumZeroed(GridSize.X * GridSize.Y);
 }
 
 void FAdaptiveVirtualTexture::Init(FRHICommandListBase& RHICmdList, FVirtualTextureSystem* InSystem)
@@ -681,6 +693,62 @@ bool FAdaptiveVirtualTexture::FreeLRU(FRHICommandListBase& RHICmdList, FVirtualT
 	return true;
 }
 
+int32 FAdaptiveVirtualTexture::FreeLRUBatched(FRHICommandListBase& RHICmdList, FVirtualTextureSystem* InSystem, uint32 InFrame, uint32 InFrameAgeToFree, uint64 InPagesToRelease, int32 InMaxDowngrades)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FAdaptiveVirtualTexture::FreeLRUBatched);
+
+	// All allocations ready for eviction, the LRU heap can't be walked in order.
+	TArray<FAdaptiveVirtualTextureLRUPlanner::FCandidate> Candidates;
+	for (int32 AllocationIndex = 0; AllocationIndex < AllocationSlots.Num(); ++AllocationIndex)
+	{
+		FAllocatedVirtualTexture* AllocatedVT = AllocationSlots[AllocationIndex].AllocatedVT;
+		if (AllocatedVT != nullptr)
+		{
+			const uint32 LastFrameUsed = LRUHeap.GetKey(AllocationIndex) >> 4;
+			if (LastFrameUsed + InFrameAgeToFree <= InFrame)
+			{
+				Candidates.Add({ (uint32)AllocationIndex, AllocatedVT->GetMaxLevel(), LastFrameUsed });
+			}
+		}
+	}
+
+	if (Candidates.Num() == 0)
+	{
+		return 0;
+	}
+
+	FVirtualTextureSpace* Space = InSystem->GetSpace(GetSpaceID());
+	TArray<uint32> NumFreeBlocks;
+	Space->GetAllocator().GetNumFreeBlocks(NumFreeBlocks);
+
+	TArray<FAdaptiveVirtualTextureLRUPlanner::FDowngrade> Downgrades;
+	FAdaptiveVirtualTextureLRUPlanner::Plan(Candidates, NumFreeBlocks, InPagesToRelease, InMaxDowngrades, Downgrades);
+
+	for (FAdaptiveVirtualTextureLRUPlanner::FDowngrade const& Downgrade : Downgrades)
+	{
+		// The plan fits in the free blocks, but fall back to the next lower level that we have space for like FreeLRU() if it doesn't.
+		int32 NewLevel = Downgrade.NewLevel;
+		while (NewLevel > 0 && !Space->GetAllocator().TryAlloc(NewLevel))
+		{
+			--NewLevel;
+		}
+
+		if (NewLevel < 1)
+		{
+			LRUHeap.Remove(Downgrade.AllocationIndex);
+			Free(InSystem, Downgrade.AllocationIndex, InFrame);
+		}
+		else
+		{
+			// Maintain the last used frame so that we can continue to deallocate levels.
+			const uint32 GridIndex = AllocationSlots[Downgrade.AllocationIndex].GridIndex;
+			Allocate(RHICmdList, InSystem, GridIndex, Downgrade.AllocationIndex, NewLevel, Downgrade.LastFrameUsed);
+		}
+	}
+
+	return Downgrades.Num();
+}
+
 void FAdaptiveVirtualTexture::UpdateAllocations(FVirtualTextureSystem* InSystem, FRHICommandListImmediate& RHICmdList, uint32 InFrame)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(FAdaptiveVirtualTexture::UpdateAllocations);
@@ -704,10 +772,17 @@ void FAdaptiveVirtualTexture::UpdateAllocations(FVirtualTextureSystem* InSystem,
 			{
 				const int32 NumToFree = FMath::Min(NumAllocated, CVarAVTMaxFreePerFrame.GetValueOnRenderThread());
 
-				bool bFreeSuccess = true;
-				for (int32 FreeCount = 0; bFreeSuccess && FreeCount < NumToFree; FreeCount++)
+				if (CVarAVTBatchedFreeLRU.GetValueOnRenderThread() != 0)
+				{
+					FreeLRUBatched(RHICmdList, InSystem, InFrame, FrameAgeToFree, 0, NumToFree);
+				}
+				else
 				{
-					bFreeSuccess = FreeLRU(RHICmdList, InSystem, InFrame, FrameAgeToFree);
+					bool bFreeSuccess = true;
+					for (int32 FreeCount = 0; bFreeSuccess && FreeCount < NumToFree; FreeCount++)
+					{
+						bFreeSuccess = FreeLRU(RHICmdList, InSystem, InFrame, FrameAgeToFree);
+					}
 				}
 			}
 		}
@@ -720,12 +795,24 @@ void FAdaptiveVirtualTexture::UpdateAllocations(FVirtualTextureSystem* InSystem,
 		const uint32 ResidencyPercent = FMath::Clamp(CVarAVTMaxPageResidency.GetValueOnRenderThread(), 10, 95);
 		const uint32 TargetPages = TotalPages * ResidencyPercent / 100;
 		const int32 NumToFree = FMath::Min(NumAllocated, CVarAVTMaxFreePerFrame.GetValueOnRenderThread());
+		const uint32 FrameAgeToFree = 15; // Hardcoded threshold. Don't release anything used more recently then this.
 
-		bool bFreeSuccess = true;
-		for (int32 FreeCount = 0; bFreeSuccess && FreeCount < NumToFree && Space->GetAllocator().GetNumAllocatedPages() > TargetPages; FreeCount++)
+		if (CVarAVTBatchedFreeLRU.GetValueOnRenderThread() != 0)
+		{
+			// Released pages only return to the allocator once the old allocated virtual textures are destroyed, so plan the whole excess at once.
+			const uint32 NumAllocatedPages = Space->GetAllocator().GetNumAllocatedPages();
+			if (NumAllocatedPages > TargetPages)
+			{
+				FreeLRUBatched(RHICmdList, InSystem, InFrame, FrameAgeToFree, NumAllocatedPages - TargetPages, NumToFree);
+			}
+		}
+		else
 		{
-			const uint32 FrameAgeToFree = 15; // Hardcoded threshold. Don't release anything used more recently then this.
-			bFreeSuccess = FreeLRU(RHICmdList, InSystem, InFrame, FrameAgeToFree);
+			bool bFreeSuccess = true;
+			for (int32 FreeCount = 0; bFreeSuccess && FreeCount < NumToFree && Space->GetAllocator().GetNumAllocatedPages() > TargetPages; FreeCount++)
+			{
+				bFreeSuccess = FreeLRU(RHICmdList, InSystem, InFrame, FrameAgeToFree);
+			}
 		}
 
 		// Process allocation requests.
@@ -773,12 +860,21 @@ void FAdaptiveVirtualTexture::UpdateAllocations(FVirtualTextureSystem* InSystem,
 		FVirtualTextureSpace* Space = InSystem->GetSpace(GetSpaceID());
 		FRHITexture* Texture = Space->GetPageTableIndirectionTexture()->GetReferencedTexture();
 
-		//todo[vt]: If we have more than 1 or 2 updates per frame then add a shader to batch updates.
+		// Apply the updates to the CPU copy in order, then upload their bounding rectangle with a single update.
+		FIntPoint DirtyMin(GridSize);
+		FIntPoint DirtyMax(0, 0);
+		for (FIndirectionTextureUpdate const& TextureUpdate : TextureUpdates)
+		{
+			IndirectionTextureValues[TextureUpdate.Y * GridSize.X + TextureUpdate.X] = TextureUpdate.Value;
+			DirtyMin = DirtyMin.ComponentMin(FIntPoint(TextureUpdate.X, TextureUpdate.Y));
+			DirtyMax = DirtyMax.ComponentMax(FIntPoint(TextureUpdate.X + 1, TextureUpdate.Y + 1));
+		}
+
 		RHICmdList.Transition({ FRHITransitionInfo(Texture, ERHIAccess::SRVMask, ERHIAccess::UAVCompute) }, ERHIPipeline::All, ERHIPipeline::Graphics);
-		for (FIndirectionTextureUpdate& TextureUpdate : TextureUpdates)
 		{
-			const FUpdateTextureRegion2D Region(TextureUpdate.X, TextureUpdate.Y, 0, 0, 1, 1);
-			RHIUpdateTexture2D((FRHITexture*)Texture, 0, Region, 4, (uint8*)&TextureUpdate.Value);
+			const FUpdateTextureRegion2D Region(DirtyMin.X, DirtyMin.Y, 0, 0, DirtyMax.X - DirtyMin.X, DirtyMax.Y - DirtyMin.Y);
+			const uint8* SourceData = (const uint8*)&IndirectionTextureValues[DirtyMin.Y * GridSize.X + DirtyMin.X];
+			RHIUpdateTexture2D((FRHITexture*)Texture, 0, Region, GridSize.X * sizeof(uint32), SourceData);
 		}
 		RHICmdList.Transition({ FRHITransitionInfo(Texture, ERHIAccess::UAVCompute, ERHIAccess::SRVMask) }, ERHIPipeline::Graphics, ERHIPipeline::All);
 	}
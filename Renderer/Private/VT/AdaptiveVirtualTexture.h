@@ -70,6 +70,8 @@ private:
 	void Free(FVirtualTextureSystem* InSystem, uint32 InAllocationIndex, uint32 InFrame);
 	/** Free or reduce and reallocate the least recently used allocation. */
 	bool FreeLRU(FRHICommandListBase& RHICmdList, FVirtualTextureSystem* InSystem, uint32 InFrame, uint32 InFrameUnusedThreshold);
+	/** Free or reduce and reallocate a batch of least recently used allocations, each directly to its target level. Returns the number of allocations changed. */
+	int32 FreeLRUBatched(FRHICommandListBase& RHICmdList, FVirtualTextureSystem* InSystem, uint32 InFrame, uint32 InFrameUnusedThreshold, uint64 InPagesToRelease, int32 InMaxDowngrades);
 
 	static IAllocatedVirtualTexture* AllocateVirtualTexture(
 		FRHICommandListBase& RHICmdList,
@@ -140,6 +142,8 @@ private:
 
 	/** Array of indirection texture updates to process. */
 	TArray<FIndirectionTextureUpdate> TextureUpdates;
+	/** CPU copy of the indirection texture, so that the updates of a frame can be uploaded as a single region. */
+	TArray<uint32> IndirectionTextureValues;
 
 	/** */
 	TArray<FVirtualTextureProducerHandle> ProducersToRelease;
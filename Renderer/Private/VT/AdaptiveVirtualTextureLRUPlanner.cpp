@@ -0,0 +1,87 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "AdaptiveVirtualTextureLRUPlanner.h"
+
+void FAdaptiveVirtualTextureLRUPlanner::Plan(TArray<FCandidate>& Candidates, TConstArrayView<uint32> NumFreeBlocks, uint64 PagesToRelease, int32 MaxDowngrades, TArray<FDowngrade>& OutDowngrades)
+{
+	OutDowngrades.Reset();
+
+	Candidates.Sort([](const FCandidate& A, const FCandidate& B)
+	{
+		if (A.LastFrameUsed != B.LastFrameUsed)
+		{
+			return A.LastFrameUsed < B.LastFrameUsed;
+		}
+		return A.Level != B.Level ? A.Level < B.Level : A.AllocationIndex < B.AllocationIndex;
+	});
+
+	// Target levels, in LRU order
+	TArray<FDowngrade> Pending;
+	uint64 PagesLeft = PagesToRelease;
+	uint32 MaxTargetLevel = 0;
+
+	for (const FCandidate& Candidate : Candidates)
+	{
+		if (Pending.Num() >= MaxDowngrades || (PagesToRelease > 0 && PagesLeft == 0))
+		{
+			break;
+		}
+
+		check(Candidate.Level > 0);
+		uint32 NewLevel = Candidate.Level - 1;
+
+		if (PagesToRelease > 0)
+		{
+			// Highest level that releases enough pages, or free the allocation when no level does
+			while (NewLevel > 0 && GetNumPages(Candidate.Level) - GetNumPages(NewLevel) < PagesLeft)
+			{
+				--NewLevel;
+			}
+
+			const uint64 NumReleased = GetNumPages(Candidate.Level) - (NewLevel > 0 ? GetNumPages(NewLevel) : 0);
+			PagesLeft -= FMath::Min(PagesLeft, NumReleased);
+		}
+
+		Pending.Add({ Candidate.AllocationIndex, NewLevel, Candidate.LastFrameUsed });
+		MaxTargetLevel = FMath::Max(MaxTargetLevel, NewLevel);
+	}
+
+	// Free space in units of the current level, from the blocks of this level and above.
+	// Only needs to count up to the number of downgrades, which also keeps it from overflowing.
+	const uint64 MaxFreeUnits = Pending.Num();
+	uint64 NumFreeUnits = 0;
+	for (int32 vLogSize = NumFreeBlocks.Num() - 1; vLogSize > (int32)MaxTargetLevel; --vLogSize)
+	{
+		NumFreeUnits = FMath::Min(NumFreeUnits * 4u + NumFreeBlocks[vLogSize], MaxFreeUnits);
+	}
+
+	// Place from the largest level down, the ones that don't fit fall through to the next level
+	TArray<FDowngrade> Reallocations;
+	for (uint32 Level = MaxTargetLevel; Level > 0; --Level)
+	{
+		const uint32 NumFreeBlocksAtLevel = Level < (uint32)NumFreeBlocks.Num() ? NumFreeBlocks[Level] : 0u;
+		NumFreeUnits = FMath::Min(NumFreeUnits * 4u + NumFreeBlocksAtLevel, MaxFreeUnits);
+
+		for (FDowngrade& Downgrade : Pending)
+		{
+			if (Downgrade.NewLevel == Level)
+			{
+				if (NumFreeUnits > 0)
+				{
+					--NumFreeUnits;
+					Reallocations.Add(Downgrade);
+				}
+				else
+				{
+					Downgrade.NewLevel = Level - 1;
+				}
+			}
+		}
+
+		Pending.RemoveAll([Level](const FDowngrade& Downgrade) { return Downgrade.NewLevel == Level; });
+	}
+
+	// Everything left is freed
+	OutDowngrades = MoveTemp(Pending);
+	OutDowngrades.Append(Reallocations);
+}
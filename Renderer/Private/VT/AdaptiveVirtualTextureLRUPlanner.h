@@ -0,0 +1,44 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Plans a batch of least recently used downgrades for the allocations of an adaptive virtual texture.
+ * Each allocation is moved once, directly to its target level, instead of one level per FreeLRU() step with a page remap for each step.
+ * Target levels are fitted against a snapshot of the free blocks of the page table allocator, per log size.
+ * Allocations are square power of two blocks of a 2D space, so placing the reallocations from the largest level down makes the fit independent
+ * of which free block the allocator picks: any block at least as large leaves only pieces that are large enough for the next ones.
+ * Space released by the batch is not reused by the batch, the old allocated virtual textures are only destroyed at the end of the frame.
+ */
+class FAdaptiveVirtualTextureLRUPlanner
+{
+public:
+	struct FCandidate
+	{
+		uint32 AllocationIndex;
+		uint32 Level;
+		uint32 LastFrameUsed;
+	};
+
+	struct FDowngrade
+	{
+		uint32 AllocationIndex;
+		/** 0 when the allocation is freed. */
+		uint32 NewLevel;
+		uint32 LastFrameUsed;
+	};
+
+	/** Number of pages of an allocation at the level. */
+	static uint64 GetNumPages(uint32 Level) { return 1ull << (2u * Level); }
+
+	/**
+	 * Plan the downgrades of the candidates, in LRU order (oldest first, then lowest level, as the keys of the LRU heap).
+	 * With PagesToRelease > 0 the oldest candidates are lowered just enough to release that many pages, otherwise each candidate is lowered by a single level.
+	 * Downgrades are output in execution order: frees first, then the reallocations from the largest level down.
+	 * @param NumFreeBlocks		Number of free blocks of the page table allocator, per log size.
+	 * @param MaxDowngrades		Max number of allocations to reallocate or free.
+	 */
+	static void Plan(TArray<FCandidate>& Candidates, TConstArrayView<uint32> NumFreeBlocks, uint64 PagesToRelease, int32 MaxDowngrades, TArray<FDowngrade>& OutDowngrades);
+};
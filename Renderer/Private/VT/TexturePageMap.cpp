@@ -25,7 +25,6 @@ FTexturePageMap::FTexturePageMap()
 	, vDimensions(0u)
 	, HashTable(4096u)
 	, MappedPageCount(0u)
-	, SortedKeysDirty(false)
 {
 }
 
@@ -45,7 +44,7 @@ void FTexturePageMap::Initialize(uint32 InSize, uint32 InLayerIndex, uint32 InDi
 	LayerIndex = InLayerIndex;
 	vDimensions = InDimensions;
 	HashTable.Resize(InSize);
-	SortedKeys.Reserve(InSize);
+	SortedPages.Reserve(InSize);
 }
 
 uint32 FTexturePageMap::FindPageIndex(uint8 vLogSize, uint32 vAddress) const
@@ -141,37 +140,13 @@ void FTexturePageMap::UnmapPage(FVirtualTextureSystem* System, FVirtualTextureSp
 	}
 	
 
-	// Deal with case where SortedAddIndexes has not been processed yet.
-	bool bFoundInAddIndexes = false;
-	for (int32 AddIndex = 0; AddIndex < SortedAddIndexes.Num(); ++AddIndex)
-	{
-		if ((SortedAddIndexes[AddIndex] & 0xffffffff) == PageIndex)
-		{
-			bFoundInAddIndexes = true;
-			SortedAddIndexes.RemoveAtSwap(AddIndex, EAllowShrinking::No);
-			break;
-		}
-	}
-
-	if (!bFoundInAddIndexes)
-	{
-		const uint32 OldKey = EncodeSortKey(vLogSize, vAddress);
-		const uint32 OldIndex = LowerBound(0, SortedKeys.Num(), OldKey, ~0u);
-		check(SortedKeys[OldIndex] == OldKey); // make sure we actually found the key (should always exist, since we're removing it)
-		checkSlow(UpperBound(0, SortedKeys.Num(), OldKey, ~0u) == OldIndex + 1u); // make sure key only exists once
-		checkSlow(!SortedSubIndexes.Contains(OldIndex)); // make sure we're not somehow removing the same key twice
-
-		SortedSubIndexes.Add(OldIndex);
-	}
+	SortedPages.Remove(EncodeSortKey(vLogSize, vAddress), PageIndex);
 
 	RemovePageFromList(PageIndex);
 	AddPageToList(PageListHead_Unmapped, PageIndex);
 
 	check(MappedPageCount > 0u);
 	--MappedPageCount;
-
-	SortedKeysDirty = true;
-
 }
 
 void FTexturePageMap::MapPage(FVirtualTextureSpace* Space, FVirtualTexturePhysicalSpace* PhysicalSpace, uint32 PackedProducerHandle, uint8 MaxLevel, uint8 vLogSize, uint32 vAddress, uint8 Local_vLevel, uint16 pAddress)
@@ -212,17 +187,13 @@ void FTexturePageMap::MapPage(FVirtualTextureSpace* Space, FVirtualTexturePhysic
 	AddPageToList(PageListHead_Mapped, PageIndex); // Add to list of allocated pages
 
 	{
-		const uint32 NewKey = EncodeSortKey(vLogSize, vAddress);
-		const uint32 NewIndex = UpperBound(0, SortedKeys.Num(), NewKey, ~0u);
-		SortedAddIndexes.Add(((uint64)NewIndex << 32) | PageIndex);
+		SortedPages.Add(EncodeSortKey(vLogSize, vAddress), PageIndex, FPhysicalSpaceIDAndAddress(Entry.PhysicalSpaceID, Entry.pAddress));
 
 		// Map new page
 		const uint16 Hash = MurmurFinalize32(Page.Packed);
 		HashTable.Add(Hash, PageIndex);
 		Space->QueueUpdate(LayerIndex, vLogSize, vAddress, Local_vLevel, PhysicalSpace->GetPhysicalLocation(pAddress));
 	}
-
-	SortedKeysDirty = true;
 }
 
 void FTexturePageMap::InvalidateUnmappedRootPage(FVirtualTextureSpace* Space, FVirtualTexturePhysicalSpace* PhysicalSpace, uint32 PackedProducerHandle, uint8 MaxLevel, uint8 vLogSize, uint32 vAddress, uint8 Local_vLevel)
@@ -269,113 +240,148 @@ void FTexturePageMap::GetMappedPagesInRange(uint32 vAddress, uint32 Width, uint3
 	check(MappedPageCount == CheckPageCount);
 }
 
-// Must call this before the below functions so that SortedKeys is up to date.
-inline void FTexturePageMap::BuildSortedKeys()
+void FTexturePageSortedKeys::Reserve(uint32 InSize)
+{
+	Keys.Reserve(InSize);
+	Addresses.Reserve(InSize);
+}
+
+void FTexturePageSortedKeys::Add(uint32 Key, uint32 PageIndex, FPhysicalSpaceIDAndAddress Address)
 {
-	checkSlow(SortedSubIndexes.Num() || SortedAddIndexes.Num());
+	PendingAdds.Add({ Key, PageIndex, Address });
+}
 
-	SortedSubIndexes.Sort();
-	SortedAddIndexes.Sort(
-		[this](const uint64& A, const uint64& B)
+void FTexturePageSortedKeys::Remove(uint32 Key, uint32 PageIndex)
+{
+	// Deal with case where the add has not been processed yet.
+	for (int32 AddIndex = 0; AddIndex < PendingAdds.Num(); ++AddIndex)
 	{
-		const FPageEntry& PageA = Pages[(uint32)A];
-		const FPageEntry& PageB = Pages[(uint32)B];
+		if (PendingAdds[AddIndex].PageIndex == PageIndex)
+		{
+			PendingAdds.RemoveAtSwap(AddIndex, EAllowShrinking::No);
+			return;
+		}
+	}
 
-		uint32 KeyA = EncodeSortKey(PageA.Page.vLogSize, PageA.Page.vAddress);
-		uint32 KeyB = EncodeSortKey(PageB.Page.vLogSize, PageB.Page.vAddress);
+	const uint32 OldIndex = LowerBound(0, Keys.Num(), Key, ~0u);
+	check(Keys[OldIndex] == Key); // make sure we actually found the key (should always exist, since we're removing it)
+	checkSlow(UpperBound(0, Keys.Num(), Key, ~0u) == OldIndex + 1u); // make sure key only exists once
+	checkSlow(!PendingSubIndexes.Contains(OldIndex)); // make sure we're not somehow removing the same key twice
 
-		return KeyA < KeyB;
-	});
+	PendingSubIndexes.Add(OldIndex);
+}
 
-	// Copy version
-	Exchange(SortedKeys, UnsortedKeys);
-	Exchange(SortedAddresses, UnsortedAddresses);
+void FTexturePageSortedKeys::Build()
+{
+	checkSlow(IsDirty());
 
-	uint32 NumUnsorted = UnsortedKeys.Num();
-	SortedKeys.SetNum(NumUnsorted + SortedAddIndexes.Num() - SortedSubIndexes.Num(), EAllowShrinking::No);
-	SortedAddresses.SetNum(NumUnsorted + SortedAddIndexes.Num() - SortedSubIndexes.Num(), EAllowShrinking::No);
+	if (PendingAdds.Num() + PendingSubIndexes.Num() <= MaxInPlaceDelta)
+	{
+		BuildInPlace();
+	}
+	else
+	{
+		BuildMerge();
+	}
 
-	int32 SubI = 0;
-	int32 AddI = 0;
-	int32 UnsortedI = 0;
-	int32 SortedI = 0;
+	PendingSubIndexes.Reset();
+	PendingAdds.Reset();
+}
 
-	while (SortedI < SortedKeys.Num())
+void FTexturePageSortedKeys::BuildInPlace()
+{
+	// Back to front, so the remaining indexes stay valid
+	PendingSubIndexes.Sort(TGreater<uint32>());
+	for (uint32 SubIndex : PendingSubIndexes)
 	{
-		const uint32 SubIndex = SubI < SortedSubIndexes.Num() ? SortedSubIndexes[SubI] : NumUnsorted;
-		const uint32 AddIndex = AddI < SortedAddIndexes.Num() ? (SortedAddIndexes[AddI] >> 32) : NumUnsorted;
-		const uint32 MinIndex = FMath::Min(SubIndex, AddIndex);
+		Keys.RemoveAt(SubIndex, 1, EAllowShrinking::No);
+		Addresses.RemoveAt(SubIndex, 1, EAllowShrinking::No);
+	}
 
-		check(MinIndex >= (uint32)UnsortedI);
-		if (MinIndex > (uint32)UnsortedI)
-		{
-			const uint32 Interval = MinIndex - UnsortedI;
-			FMemory::Memcpy(&SortedKeys[SortedI], &UnsortedKeys[UnsortedI], Interval * sizeof(uint32));
-			FMemory::Memcpy(&SortedAddresses[SortedI], &UnsortedAddresses[UnsortedI], Interval * sizeof(FPhysicalSpaceIDAndAddress));
+	for (const FPendingAdd& Add : PendingAdds)
+	{
+		const uint32 InsertIndex = UpperBound(0, Keys.Num(), Add.Key, ~0u);
+		Keys.Insert(Add.Key, InsertIndex);
+		Addresses.Insert(Add.Address, InsertIndex);
+	}
+}
 
-			UnsortedI += Interval;
-			SortedI += Interval;
+void FTexturePageSortedKeys::BuildMerge()
+{
+	PendingSubIndexes.Sort();
 
-			if (SortedI >= SortedKeys.Num())
-				break;
-		}
+	// Keys are precomputed, so sorting doesn't need to look at the pages
+	SortedAdds.SetNumUninitialized(PendingAdds.Num(), EAllowShrinking::No);
+	RadixSort32(SortedAdds.GetData(), PendingAdds.GetData(), PendingAdds.Num(), [](const FPendingAdd& Add) { return Add.Key; });
 
-		if (SubIndex < AddIndex)
-		{
-			checkSlow(SubI < SortedSubIndexes.Num());
+	const int32 NumOld = Keys.Num();
+	const int32 NumAdds = SortedAdds.Num();
+	const int32 NumSubs = PendingSubIndexes.Num();
+	const int32 NumMerged = NumOld + NumAdds - NumSubs;
 
-			// Skip hole
-			UnsortedI++;
-			SubI++;
-		}
-		else
-		{
-			checkSlow(AddI < SortedAddIndexes.Num());
+	MergeKeys.SetNumUninitialized(NumMerged, EAllowShrinking::No);
+	MergeAddresses.SetNumUninitialized(NumMerged, EAllowShrinking::No);
+
+	const uint32* RESTRICT OldKeys = Keys.GetData();
+	const FPhysicalSpaceIDAndAddress* RESTRICT OldAddresses = Addresses.GetData();
+	const FPendingAdd* RESTRICT Adds = SortedAdds.GetData();
+	uint32* RESTRICT OutKeys = MergeKeys.GetData();
+	FPhysicalSpaceIDAndAddress* RESTRICT OutAddresses = MergeAddresses.GetData();
+
+	int32 OldI = 0;
+	int32 AddI = 0;
+	int32 OutI = 0;
 
-			// Add new updated page
-			const uint32 PageIndex = (uint32)SortedAddIndexes[AddI];
-			const FPageEntry& Entry = Pages[PageIndex];
-			SortedKeys[SortedI] = EncodeSortKey(Entry.Page.vLogSize, Entry.Page.vAddress);
-			SortedAddresses[SortedI] = FPhysicalSpaceIDAndAddress(Entry.PhysicalSpaceID, Entry.pAddress);
+	// Merge the adds with each run of previous entries between removed ones, the removed entry is skipped after its run
+	for (int32 SubI = 0; SubI <= NumSubs; ++SubI)
+	{
+		const int32 RunEnd = SubI < NumSubs ? int32(PendingSubIndexes[SubI]) : NumOld;
 
-			SortedI++;
-			AddI++;
+		while (OldI < RunEnd && AddI < NumAdds)
+		{
+			const FPendingAdd& Add = Adds[AddI];
+			const bool bTakeAdd = Add.Key < OldKeys[OldI];
+			OutKeys[OutI] = bTakeAdd ? Add.Key : OldKeys[OldI];
+			OutAddresses[OutI] = bTakeAdd ? Add.Address : OldAddresses[OldI];
+			AddI += bTakeAdd ? 1 : 0;
+			OldI += bTakeAdd ? 0 : 1;
+			++OutI;
 		}
-	}
 
-	SortedSubIndexes.Reset();
-	SortedAddIndexes.Reset();
+		// Out of adds, copy the rest of the run
+		if (OldI < RunEnd)
+		{
+			const int32 Interval = RunEnd - OldI;
+			FMemory::Memcpy(&OutKeys[OutI], &OldKeys[OldI], Interval * sizeof(uint32));
+			FMemory::Memcpy(&OutAddresses[OutI], &OldAddresses[OldI], Interval * sizeof(FPhysicalSpaceIDAndAddress));
+			OldI += Interval;
+			OutI += Interval;
+		}
 
-	SortedKeysDirty = false;
-}
+		++OldI;
+	}
 
-void FTexturePageMap::ReleaseUnmappedPages()
-{
-	uint32 PageIndex = Pages[PageListHead_Unmapped].NextIndex;
-	uint32 CheckUnmappedCount = 0u;
-	while (PageIndex != PageListHead_Unmapped)
+	// Remaining adds are after all previous entries
+	for (; AddI < NumAdds; ++AddI, ++OutI)
 	{
-		FPageEntry& Entry = Pages[PageIndex];
-		const uint32 NextPageIndex = Entry.NextIndex;
-		Entry.Page.Packed = ~0u;
-		Entry.Packed = ~0u;
-		RemovePageFromList(PageIndex);
-		AddPageToList(PageListHead_Free, PageIndex);
-		PageIndex = NextPageIndex;
-		++CheckUnmappedCount;
+		OutKeys[OutI] = Adds[AddI].Key;
+		OutAddresses[OutI] = Adds[AddI].Address;
 	}
-	check(Pages[PageListHead_Unmapped].NextIndex == PageListHead_Unmapped);
+	check(OutI == NumMerged);
+
+	Exchange(Keys, MergeKeys);
+	Exchange(Addresses, MergeAddresses);
 }
 
 // Binary search lower bound
 // Similar to std::lower_bound
 // Range [Min,Max)
-uint32 FTexturePageMap::LowerBound(uint32 Min, uint32 Max, uint32 SearchKey, uint32 Mask) const
+uint32 FTexturePageSortedKeys::LowerBound(uint32 Min, uint32 Max, uint32 SearchKey, uint32 Mask) const
 {
 	while (Min != Max)
 	{
 		uint32 Mid = Min + (Max - Min) / 2;
-		uint32 Key = SortedKeys[Mid] & Mask;
+		uint32 Key = Keys[Mid] & Mask;
 
 		if (SearchKey <= Key)
 			Max = Mid;
@@ -389,12 +395,12 @@ uint32 FTexturePageMap::LowerBound(uint32 Min, uint32 Max, uint32 SearchKey, uin
 // Binary search upper bound
 // Similar to std::upper_bound
 // Range [Min,Max)
-uint32 FTexturePageMap::UpperBound(uint32 Min, uint32 Max, uint32 SearchKey, uint32 Mask) const
+uint32 FTexturePageSortedKeys::UpperBound(uint32 Min, uint32 Max, uint32 SearchKey, uint32 Mask) const
 {
 	while (Min != Max)
 	{
 		uint32 Mid = Min + (Max - Min) / 2;
-		uint32 Key = SortedKeys[Mid] & Mask;
+		uint32 Key = Keys[Mid] & Mask;
 
 		if (SearchKey < Key)
 			Max = Mid;
@@ -408,12 +414,12 @@ uint32 FTexturePageMap::UpperBound(uint32 Min, uint32 Max, uint32 SearchKey, uin
 // Binary search equal range
 // Similar to std::equal_range
 // Range [Min,Max)
-uint64 FTexturePageMap::EqualRange(uint32 Min, uint32 Max, uint32 SearchKey, uint32 Mask) const
+uint64 FTexturePageSortedKeys::EqualRange(uint32 Min, uint32 Max, uint32 SearchKey, uint32 Mask) const
 {
 	while (Min != Max)
 	{
 		uint32 Mid = Min + (Max - Min) / 2;
-		uint32 Key = SortedKeys[Mid] & Mask;
+		uint32 Key = Keys[Mid] & Mask;
 
 		if (SearchKey < Key)
 		{
@@ -434,13 +440,34 @@ uint64 FTexturePageMap::EqualRange(uint32 Min, uint32 Max, uint32 SearchKey, uin
 	return 0;
 }
 
+void FTexturePageMap::ReleaseUnmappedPages()
+{
+	uint32 PageIndex = Pages[PageListHead_Unmapped].NextIndex;
+	uint32 CheckUnmappedCount = 0u;
+	while (PageIndex != PageListHead_Unmapped)
+	{
+		FPageEntry& Entry = Pages[PageIndex];
+		const uint32 NextPageIndex = Entry.NextIndex;
+		Entry.Page.Packed = ~0u;
+		Entry.Packed = ~0u;
+		RemovePageFromList(PageIndex);
+		AddPageToList(PageListHead_Free, PageIndex);
+		PageIndex = NextPageIndex;
+		++CheckUnmappedCount;
+	}
+	check(Pages[PageListHead_Unmapped].NextIndex == PageListHead_Unmapped);
+}
+
 void FTexturePageMap::RefreshEntirePageTable(FVirtualTextureSystem* System, TArray< FPageTableUpdate >* Output)
 {
-	if (SortedKeysDirty)
+	if (SortedPages.IsDirty())
 	{
-		BuildSortedKeys();
+		SortedPages.Build();
 	}
 
+	const TArray< uint32 >& SortedKeys = SortedPages.GetKeys();
+	const TArray< FPhysicalSpaceIDAndAddress >& SortedAddresses = SortedPages.GetAddresses();
+
 	for (int i = SortedKeys.Num() - 1; i >= 0; i--)
 	{
 		FPageTableUpdate Update;
@@ -470,11 +497,14 @@ Outputs list of FPageTableUpdate which will be drawn on the GPU to the page tabl
 */
 void FTexturePageMap::ExpandPageTableUpdatePainters(FVirtualTextureSystem* System, FPageTableUpdate Update, TArray< FPageTableUpdate >* Output)
 {
-	if (SortedKeysDirty)
+	if (SortedPages.IsDirty())
 	{
-		BuildSortedKeys();
+		SortedPages.Build();
 	}
 
+	const TArray< uint32 >& SortedKeys = SortedPages.GetKeys();
+	const TArray< FPhysicalSpaceIDAndAddress >& SortedAddresses = SortedPages.GetAddresses();
+
 	static TArray< FPageTableUpdate > LoopOutput;
 
 	LoopOutput.Reset();
@@ -495,7 +525,7 @@ void FTexturePageMap::ExpandPageTableUpdatePainters(FVirtualTextureSystem* Syste
 		uint32 SearchKey = EncodeSortKey(Mip, vAddress);
 		uint32 Mask = ~0u << (vDimensions * vLogSize);
 
-		uint64 DescendantRange = EqualRange(0, SearchRange, SearchKey, Mask);
+		uint64 DescendantRange = SortedPages.EqualRange(0, SearchRange, SearchKey, Mask);
 		if (DescendantRange != 0)
 		{
 			uint32 DescendantMin = (uint32)DescendantRange;
@@ -544,11 +574,14 @@ Outputs list of FPageTableUpdate which will be drawn on the GPU to the page tabl
 */
 void FTexturePageMap::ExpandPageTableUpdateMasked(FVirtualTextureSystem* System, FPageTableUpdate Update, TArray< FPageTableUpdate >* Output)
 {
-	if (SortedKeysDirty)
+	if (SortedPages.IsDirty())
 	{
-		BuildSortedKeys();
+		SortedPages.Build();
 	}
 
+	const TArray< uint32 >& SortedKeys = SortedPages.GetKeys();
+	const TArray< FPhysicalSpaceIDAndAddress >& SortedAddresses = SortedPages.GetAddresses();
+
 	static TArray< FPageTableUpdate > LoopInput;
 	static TArray< FPageTableUpdate > LoopOutput;
 	static TArray< FPageTableUpdate > Stack;
@@ -573,7 +606,7 @@ void FTexturePageMap::ExpandPageTableUpdateMasked(FVirtualTextureSystem* System,
 		uint32 SearchKey = EncodeSortKey(Mip, vAddress);
 		uint32 Mask = ~0u << (vDimensions * vLogSize);
 
-		uint64 DescendantRange = EqualRange(0, SearchRange, SearchKey, Mask);
+		uint64 DescendantRange = SortedPages.EqualRange(0, SearchRange, SearchKey, Mask);
 		if (DescendantRange != 0)
 		{
 			uint32 DescendantMin = (uint32)DescendantRange;
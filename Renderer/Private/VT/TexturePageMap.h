@@ -52,6 +52,59 @@ struct FMappedTexturePage
 	uint32 Local_vLevel : 4;
 };
 
+/**
+ * Mapped pages of a FTexturePageMap sorted by key (vLevel, vAddress), for range queries of descendant pages.
+ * Adds and removes are queued and applied in one go by Build(): the adds are radix sorted on their precomputed keys and merged with the previous
+ * sorted arrays, skipping the removed entries. Very small deltas are applied in place with binary search insertion instead.
+ */
+class FTexturePageSortedKeys
+{
+public:
+	/** Max number of queued adds and removes applied in place. */
+	static constexpr int32 MaxInPlaceDelta = 8;
+
+	void		Reserve(uint32 InSize);
+
+	/** Queue a mapped page, PageIndex identifies it for Remove() until the next Build(). */
+	void		Add(uint32 Key, uint32 PageIndex, FPhysicalSpaceIDAndAddress Address);
+
+	/** Queue the removal of a mapped page. */
+	void		Remove(uint32 Key, uint32 PageIndex);
+
+	bool		IsDirty() const { return PendingAdds.Num() > 0 || PendingSubIndexes.Num() > 0; }
+
+	/** Must be called after Add/Remove before the keys and queries below are used. */
+	void		Build();
+
+	int32		Num() const { return Keys.Num(); }
+	const TArray< uint32 >& GetKeys() const { return Keys; }
+	const TArray< FPhysicalSpaceIDAndAddress >& GetAddresses() const { return Addresses; }
+
+	uint32		LowerBound(uint32 Min, uint32 Max, uint32 SearchKey, uint32 Mask) const;
+	uint32		UpperBound(uint32 Min, uint32 Max, uint32 SearchKey, uint32 Mask) const;
+	uint64		EqualRange(uint32 Min, uint32 Max, uint32 SearchKey, uint32 Mask) const;
+
+private:
+	struct FPendingAdd
+	{
+		uint32 Key;
+		uint32 PageIndex;
+		FPhysicalSpaceIDAndAddress Address;
+	};
+
+	void		BuildInPlace();
+	void		BuildMerge();
+
+	TArray< uint32 >						Keys;
+	TArray< FPhysicalSpaceIDAndAddress >	Addresses;
+	TArray< uint32 >						MergeKeys;
+	TArray< FPhysicalSpaceIDAndAddress >	MergeAddresses;
+
+	TArray< uint32 >		PendingSubIndexes;
+	TArray< FPendingAdd >	PendingAdds;
+	TArray< FPendingAdd >	SortedAdds;
+};
+
 /**
  * Manages a single layer of a VT page table, contains mappings of virtual->physical address
  * Pages should not be directly mapped/unmapped from this class, this should instead go through FTexturePagePool
@@ -109,13 +162,8 @@ public:
 	void		InvalidateUnmappedRootPage(FVirtualTextureSpace* Space, FVirtualTexturePhysicalSpace* PhysicalSpace, uint32 PackedProducerHandle, uint8 MaxLevel, uint8 vLogSize, uint32 vAddress, uint8 Local_vLevel);
 
 private:
-	void		BuildSortedKeys();
 	void        ReleaseUnmappedPages();
 
-	uint32		LowerBound(uint32 Min, uint32 Max, uint32 SearchKey, uint32 Mask) const;
-	uint32		UpperBound(uint32 Min, uint32 Max, uint32 SearchKey, uint32 Mask) const;
-	uint64		EqualRange(uint32 Min, uint32 Max, uint32 SearchKey, uint32 Mask) const;
-
 	uint32		FindPageIndex(uint8 vLogSize, uint32 vAddress) const;
 	uint32		FindNearestPageIndex(uint8 vLogSize, uint32 vAddress, uint8 MaxLevel) const;
 
@@ -194,14 +242,7 @@ private:
 	FHashTable			HashTable;
 	uint32				MappedPageCount;
 
-	TArray< uint32 >						UnsortedKeys;
-	TArray< FPhysicalSpaceIDAndAddress >	UnsortedAddresses;
-	TArray< uint32 >						SortedKeys;
-	TArray< FPhysicalSpaceIDAndAddress >	SortedAddresses;
-	bool									SortedKeysDirty;
-
-	TArray< uint32 >	SortedSubIndexes;
-	TArray< uint64 >	SortedAddIndexes;
+	FTexturePageSortedKeys	SortedPages;
 };
 
 inline FPhysicalSpaceIDAndAddress FTexturePageMap::FindPagePhysicalSpaceIDAndAddress(const FTexturePage& CheckPage, uint16 Hash) const
@@ -1,6 +1,8 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "VirtualTextureAllocator.h"
+#include "Algo/BinarySearch.h"
+#include "HAL/IConsoleManager.h"
 #include "AllocatedVirtualTexture.h"
 #include "VirtualTexturing.h"
 #include "Modules/ModuleManager.h"
@@ -16,6 +18,16 @@
 #include "Modules/ModuleManager.h"
 #endif // WITH_EDITOR
 
+static int32 GVirtualTextureAllocatorValidation = 0;
+static FAutoConsoleVariableRef CVarVirtualTextureAllocatorValidation(
+	TEXT("r.VT.AllocatorValidation"),
+	GVirtualTextureAllocatorValidation,
+	TEXT("Validation of the virtual texture address space allocation search.\n")
+	TEXT(" 0: Address ordered search (default)\n")
+	TEXT(" 1: Check the address ordered search against the linear search of all free blocks\n")
+	TEXT(" 2: Only use the linear search"),
+	ECVF_RenderThreadSafe);
+
 FVirtualTextureAllocator::FVirtualTextureAllocator(uint32 Dimensions)
 	: vDimensions(Dimensions)
 	, AllocatedWidth(0u)
@@ -36,6 +48,8 @@ void FVirtualTextureAllocator::Initialize(uint32 MaxSize)
 	SortedIndices.Reset(1);
 	FreeList.Reset(vLogSize + 1);
 	PartiallyFreeList.Reset(vLogSize + 1);
+	SortedFreeList.Reset(vLogSize + 1);
+	SortedPartiallyFreeList.Reset((vLogSize + 1) * PartiallyFreeMipDepth);
 
 	// Start with one empty block
 	FAddressBlock DefaultBlock(vLogSize);
@@ -56,6 +70,10 @@ void FVirtualTextureAllocator::Initialize(uint32 MaxSize)
 	FreeList[vLogSize] = 0;
 	FMemory::Memset(&PartiallyFreeList[vLogSize], 0xff, sizeof(FPartiallyFreeMip));
 
+	SortedFreeList.SetNum(vLogSize + 1);
+	SortedPartiallyFreeList.SetNum((vLogSize + 1) * PartiallyFreeMipDepth);
+	SortedFreeList[vLogSize].Add(0u);
+
 	// Init global free list
 	GlobalFreeList = 0xffff;
 
@@ -79,12 +97,27 @@ void FVirtualTextureAllocator::LinkFreeList(uint16& InOutListHead, EBlockState S
 		AddressBlocks[AddressBlock.NextFree].PrevFree = Index;
 	}
 	InOutListHead = Index;
+
+	if (TArray< uint64 >* SortedList = GetSortedFreeList(State, AddressBlock))
+	{
+		const uint64 SortKey = ((uint64)AddressBlock.vAddress << 16) | Index;
+		SortedList->Insert(SortKey, Algo::LowerBound(*SortedList, SortKey));
+	}
 }
 
 void FVirtualTextureAllocator::UnlinkFreeList(uint16& InOutListHead, EBlockState State, uint16 Index)
 {
 	FAddressBlock& AddressBlock = AddressBlocks[Index];
 	check(AddressBlock.State == State);
+
+	if (TArray< uint64 >* SortedList = GetSortedFreeList(State, AddressBlock))
+	{
+		const uint64 SortKey = ((uint64)AddressBlock.vAddress << 16) | Index;
+		const int32 SortedIndex = Algo::LowerBound(*SortedList, SortKey);
+		check(SortedIndex < SortedList->Num() && (*SortedList)[SortedIndex] == SortKey);
+		SortedList->RemoveAt(SortedIndex, 1, EAllowShrinking::No);
+	}
+
 	const uint32 PrevFreeIndex = AddressBlock.PrevFree;
 	const uint32 NextFreeIndex = AddressBlock.NextFree;
 	if (PrevFreeIndex != 0xffff)
@@ -104,6 +137,19 @@ void FVirtualTextureAllocator::UnlinkFreeList(uint16& InOutListHead, EBlockState
 	AddressBlock.State = EBlockState::None;
 }
 
+TArray< uint64 >* FVirtualTextureAllocator::GetSortedFreeList(EBlockState State, const FAddressBlock& Block)
+{
+	switch (State)
+	{
+	case EBlockState::FreeList:
+		return &SortedFreeList[Block.vLogSize];
+	case EBlockState::PartiallyFreeList:
+		return &SortedPartiallyFreeList[Block.vLogSize * PartiallyFreeMipDepth + Block.FreeMip];
+	default:
+		return nullptr;
+	}
+}
+
 int32 FVirtualTextureAllocator::AcquireBlock()
 {
 	int32 Index = GlobalFreeList;
@@ -182,6 +228,15 @@ bool FVirtualTextureAllocator::TryAlloc(uint32 InLogSize)
 	return false;
 }
 
+void FVirtualTextureAllocator::GetNumFreeBlocks(TArray<uint32>& OutNumFreeBlocks) const
+{
+	OutNumFreeBlocks.SetNumUninitialized(SortedFreeList.Num());
+	for (int32 vLogSize = 0; vLogSize < SortedFreeList.Num(); ++vLogSize)
+	{
+		OutNumFreeBlocks[vLogSize] = SortedFreeList[vLogSize].Num();
+	}
+}
+
 void FVirtualTextureAllocator::SubdivideBlock(uint32 ParentIndex)
 {
 	const uint32 NumChildren = (1 << vDimensions);
@@ -194,6 +249,7 @@ void FVirtualTextureAllocator::SubdivideBlock(uint32 ParentIndex)
 	check(AddressBlocks[ParentIndex].FirstChild == 0xffff);
 	UnlinkFreeList(FreeList[vParentLogSize], EBlockState::FreeList, ParentIndex);
 	AddressBlocks[ParentIndex].FreeMip = 0;
+	AddressBlocks[ParentIndex].AllocatedMap = 0;
 	LinkFreeList(PartiallyFreeList[vParentLogSize].Mips[0], EBlockState::PartiallyFreeList, ParentIndex);
 
 	const uint32 vAddress = AddressBlocks[ParentIndex].vAddress;
@@ -251,7 +307,7 @@ void FVirtualTextureAllocator::FreeMipUpdateParents(uint16 ParentIndex)
 
 		FAddressBlock& ParentBlock = AddressBlocks[ParentIndex];
 		uint8 OldFreeMip = ParentBlock.FreeMip;
-		uint8 NewFreeMip = ComputeFreeMip(ParentIndex);
+		uint8 NewFreeMip = ComputeFreeMip(ParentIndex, ParentBlock.AllocatedMap);
 
 		if (NewFreeMip != OldFreeMip)
 		{
@@ -264,7 +320,7 @@ void FVirtualTextureAllocator::FreeMipUpdateParents(uint16 ParentIndex)
 	}
 }
 
-void FVirtualTextureAllocator::MarkBlockAllocated(uint32 Index, uint32 vAllocatedTileX0, uint32 vAllocatedTileY0, FAllocatedVirtualTexture* VT)
+void FVirtualTextureAllocator::MarkBlockAllocated(uint32 Index, uint32 vAllocatedTileX0, uint32 vAllocatedTileY0, uint32 vAllocatedTileX1, uint32 vAllocatedTileY1, FAllocatedVirtualTexture* VT)
 {
 	FAddressBlock* AllocBlock = &AddressBlocks[Index];
 	check(AllocBlock->State != EBlockState::None);
@@ -273,8 +329,6 @@ void FVirtualTextureAllocator::MarkBlockAllocated(uint32 Index, uint32 vAllocate
 	const uint32 vLogSize = AllocBlock->vLogSize;
 
 	// check to see if block is in the correct position
-	const uint32 vAllocatedTileX1 = vAllocatedTileX0 + VT->GetWidthInTiles();
-	const uint32 vAllocatedTileY1 = vAllocatedTileY0 + VT->GetHeightInTiles();
 	const uint32 BlockSize = (1u << vLogSize);
 	const uint32 vBlockAddress = AllocBlock->vAddress;
 	const uint32 vBlockTileX0 = FMath::ReverseMortonCode2(vBlockAddress);
@@ -330,7 +384,7 @@ void FVirtualTextureAllocator::MarkBlockAllocated(uint32 Index, uint32 vAllocate
 			{
 				check(AddressBlocks[ChildIndex].Parent == Index);
 
-				MarkBlockAllocated(ChildIndex, vAllocatedTileX0, vAllocatedTileY0, VT);
+				MarkBlockAllocated(ChildIndex, vAllocatedTileX0, vAllocatedTileY0, vAllocatedTileX1, vAllocatedTileY1, VT);
 
 				ChildIndex = AddressBlocks[ChildIndex].NextSibling;
 				NumChildren++;
@@ -393,25 +447,180 @@ bool FVirtualTextureAllocator::TestAllocation(uint32 Index, uint32 vAllocatedTil
 	return true;
 }
 
-uint32 FVirtualTextureAllocator::Alloc(FAllocatedVirtualTexture* VT)
+// Helpers for the 8x8 block maps of ComputeFreeMip, bit index is X + Y * 8
+namespace VirtualTextureAllocatorBlockMap
 {
-	const uint32 WidthInTiles = VT->GetWidthInTiles();
-	const uint32 HeightInTiles = VT->GetHeightInTiles();
-	const uint32 MinSize = FMath::Min(WidthInTiles, HeightInTiles);
-	const uint32 MaxSize = FMath::Max(WidthInTiles, HeightInTiles);
-	const int32 vLogMinSize = FMath::CeilLogTwo(MinSize);
-	const int32 vLogMaxSize = FMath::CeilLogTwo(MaxSize);
+	// Pixels with X < Width
+	static inline uint64 ColumnMask(uint32 Width)
+	{
+		return (0xffull >> (8u - Width)) * 0x0101010101010101ull;
+	}
+
+	// Pixels with Y < Height
+	static inline uint64 RowMask(uint32 Height)
+	{
+		return Height >= 8u ? ~0ull : (1ull << (8u * Height)) - 1ull;
+	}
+
+	// Pixels where a Width x Height region starting at the pixel overlaps a set pixel
+	static inline uint64 Dilate(uint64 BlockMap, uint32 Width, uint32 Height)
+	{
+		uint64 Rows = BlockMap;
+		for (uint32 X = 1u; X < Width; ++X)
+		{
+			Rows |= (BlockMap >> X) & ColumnMask(8u - X);
+		}
+
+		uint64 Result = Rows;
+		for (uint32 Y = 1u; Y < Height; ++Y)
+		{
+			Result |= Rows >> (8u * Y);
+		}
+		return Result;
+	}
+
+	// Reorders the bits from X + Y * 8 to the morton code of (X, Y), by swapping bits of the bit index with delta swaps
+	static inline uint64 ToMortonOrder(uint64 BlockMap)
+	{
+		auto DeltaSwap = [](uint64 Value, uint64 Mask, uint32 Delta)
+		{
+			const uint64 Swap = ((Value >> Delta) ^ Value) & Mask;
+			return Value ^ Swap ^ (Swap << Delta);
+		};
+
+		// (x0 x1 x2 y0 y1 y2) -> (x0 y0 x2 x1 y1 y2) -> (x0 y0 x1 x2 y1 y2) -> (x0 y0 x1 y1 x2 y2)
+		BlockMap = DeltaSwap(BlockMap, 0x00cc00cc00cc00ccull, 6u);
+		BlockMap = DeltaSwap(BlockMap, 0x00f000f000f000f0ull, 4u);
+		BlockMap = DeltaSwap(BlockMap, 0x0000ff000000ff00ull, 8u);
+		return BlockMap;
+	}
+
+	static inline uint64 LowBitsMask(uint32 NumBits)
+	{
+		return NumBits >= 64u ? ~0ull : (1ull << NumBits) - 1ull;
+	}
+}
+
+bool FVirtualTextureAllocator::FindPartiallyFreeBlockFitLinear(uint16 BlockIndex, uint32 WidthInTiles, uint32 HeightInTiles, uint32 MaxLevel, uint32& OutAddress) const
+{
+	const FAddressBlock& AllocBlock = AddressBlocks[BlockIndex];
+	check(AllocBlock.State == EBlockState::PartiallyFreeList);
 
 	// Tile must be aligned to match the max level of the VT, otherwise tiles at lower mip levels may intersect neighboring regions
-	const uint32 MaxLevel = VT->GetMaxLevel();
 	const uint32 vAddressAlignment = 1u << (vDimensions * MaxLevel);
+	const uint32 BlockSize = 1u << AllocBlock.vLogSize;
+	uint32 vCheckAddress = AllocBlock.vAddress;
+	const uint32 vBlockTileX0 = FMath::ReverseMortonCode2(vCheckAddress);
+	const uint32 vBlockTileY0 = FMath::ReverseMortonCode2(vCheckAddress >> 1);
+	const uint32 vBlockTileX1 = vBlockTileX0 + BlockSize;
+	const uint32 vBlockTileY1 = vBlockTileY0 + BlockSize;
 
-	if (vLogMaxSize >= FreeList.Num())
+	// Search all valid positions within the block (in ascending morton order), looking for a fit for the texture we're trying to allocate
+	// Step size is driven by our alignment requirements
+	while (true)
 	{
-		// VT is larger than the entire page table
-		return ~0u;
+		const uint32 vTileX0 = FMath::ReverseMortonCode2(vCheckAddress);
+		const uint32 vTileY0 = FMath::ReverseMortonCode2(vCheckAddress >> 1);
+		const uint32 vTileX1 = vTileX0 + WidthInTiles;
+		const uint32 vTileY1 = vTileY0 + HeightInTiles;
+		if (vTileY1 > vBlockTileY1)
+		{
+			break;
+		}
+
+		if (vTileX1 <= vBlockTileX1)
+		{
+			if (TestAllocation(BlockIndex, vTileX0, vTileY0, vTileX1, vTileY1))
+			{
+				OutAddress = vCheckAddress;
+				return true;
+			}
+		}
+
+		vCheckAddress += vAddressAlignment;
 	}
 
+	return false;
+}
+
+bool FVirtualTextureAllocator::FindPartiallyFreeBlockFit(uint16 BlockIndex, uint32 WidthInTiles, uint32 HeightInTiles, uint32 MaxLevel, uint32& OutAddress) const
+{
+	using namespace VirtualTextureAllocatorBlockMap;
+
+	const FAddressBlock& AllocBlock = AddressBlocks[BlockIndex];
+	check(AllocBlock.State == EBlockState::PartiallyFreeList);
+	checkSlow(AllocBlock.vLogSize >= MaxLevel);
+
+	// Positions finer than the pixels of the block map need to be tested one by one
+	const uint32 vLogSize = AllocBlock.vLogSize;
+	if (vDimensions != 2u || vLogSize < 3u || MaxLevel + 3u < vLogSize)
+	{
+		return FindPartiallyFreeBlockFitLinear(BlockIndex, WidthInTiles, HeightInTiles, MaxLevel, OutAddress);
+	}
+
+	// Pixels aligned to the allocation, same as the "BlockOverlapByDepth" corners of ComputeFreeMip
+	static const uint64 AlignedPixelsByLogAlignment[4] =
+	{
+		0xffffffffffffffffull,		// 1x1
+		0x0055005500550055ull,		// 2x2
+		0x0000001100000011ull,		// 4x4
+		0x0000000000000001ull,		// 8x8
+	};
+
+	const uint32 vPixelLogSize = vLogSize - 3u;
+	const uint32 WidthInPixels = FMath::DivideAndRoundUp(WidthInTiles, 1u << vPixelLogSize);
+	const uint32 HeightInPixels = FMath::DivideAndRoundUp(HeightInTiles, 1u << vPixelLogSize);
+	const uint64 AlignedPixels = AlignedPixelsByLogAlignment[MaxLevel - vPixelLogSize];
+
+	// Positions which fit horizontally.  Like the linear search, stop at the first position in morton order which doesn't fit vertically.
+	const uint64 FitPixels = AlignedPixels & ColumnMask(9u - WidthInPixels);
+	const uint64 OverflowPixels = ToMortonOrder(AlignedPixels & ~RowMask(9u - HeightInPixels));
+	const uint64 SearchMask = LowBitsMask(OverflowPixels ? FMath::CountTrailingZeros64(OverflowPixels) : 64u);
+
+	// Positions overlapping an allocated pixel can't fit
+	const uint64 Candidates = ToMortonOrder(FitPixels & ~Dilate(AllocBlock.AllocatedMap, WidthInPixels, HeightInPixels)) & SearchMask;
+	if (Candidates == 0u)
+	{
+		return false;
+	}
+
+	// Positions which only overlap free pixels always fit, the ones before the first of those need to be tested
+	uint64 UnusedBlockMap = 0u;
+	uint64 OccupiedMap = 0u;
+	RecurseComputeFreeMip(BlockIndex, 0, UnusedBlockMap, &OccupiedMap);
+
+	const uint64 Fits = ToMortonOrder(FitPixels & ~Dilate(OccupiedMap, WidthInPixels, HeightInPixels)) & SearchMask;
+	const uint32 FirstFit = Fits ? FMath::CountTrailingZeros64(Fits) : 64u;
+
+	uint64 TestCandidates = Candidates & ~Fits & LowBitsMask(FirstFit);
+	while (TestCandidates)
+	{
+		const uint32 Candidate = FMath::CountTrailingZeros64(TestCandidates);
+		TestCandidates &= TestCandidates - 1u;
+
+		const uint32 vCheckAddress = AllocBlock.vAddress + (Candidate << (vDimensions * vPixelLogSize));
+		const uint32 vTileX0 = FMath::ReverseMortonCode2(vCheckAddress);
+		const uint32 vTileY0 = FMath::ReverseMortonCode2(vCheckAddress >> 1);
+		if (TestAllocation(BlockIndex, vTileX0, vTileY0, vTileX0 + WidthInTiles, vTileY0 + HeightInTiles))
+		{
+			OutAddress = vCheckAddress;
+			return true;
+		}
+	}
+
+	if (FirstFit < 64u)
+	{
+		OutAddress = AllocBlock.vAddress + (FirstFit << (vDimensions * vPixelLogSize));
+		return true;
+	}
+
+	return false;
+}
+
+uint32 FVirtualTextureAllocator::FindAllocationLinear(uint32 WidthInTiles, uint32 HeightInTiles, uint32 MaxLevel, uint16& OutAllocIndex) const
+{
+	const int32 vLogMaxSize = FMath::CeilLogTwo(FMath::Max(WidthInTiles, HeightInTiles));
+
 	uint16 AllocIndex = 0xffff;
 	uint32 vAddress = ~0u;
 
@@ -419,7 +628,6 @@ uint32 FVirtualTextureAllocator::Alloc(FAllocatedVirtualTexture* VT)
 	// Here we search all free blocks, including ones that are too large (large blocks will still be subdivided to fit)
 	for (int32 vLogSize = vLogMaxSize; vLogSize < FreeList.Num(); ++vLogSize)
 	{
-		// Could avoid this loop if FreeList was kept sorted by vAddress
 		uint16 FreeIndex = FreeList[vLogSize];
 		while (FreeIndex != 0xffff)
 		{
@@ -445,62 +653,124 @@ uint32 FVirtualTextureAllocator::Alloc(FAllocatedVirtualTexture* VT)
 		uint16 FreeIndex = PartiallyFreeList[vLogMaxSize].Mips[FreeMipIndex];
 		while (FreeIndex != 0xffff)
 		{
-			FAddressBlock& AllocBlock = AddressBlocks[FreeIndex];
+			const FAddressBlock& AllocBlock = AddressBlocks[FreeIndex];
 
-			// TODO:  consider making "ComputeFreeMip" test a checkSlow once system is proven reliable
-			check((AllocBlock.FreeMip == FreeMipIndex) && (AllocBlock.FreeMip == ComputeFreeMip(FreeIndex)));
+#if DO_CHECK
+			uint64 BlockMap = 0;
+			check((AllocBlock.FreeMip == FreeMipIndex) && (AllocBlock.FreeMip == ComputeFreeMip(FreeIndex, BlockMap)) && (AllocBlock.AllocatedMap == BlockMap));
+#endif
 
-			if (AllocBlock.vAddress < vAddress)
+			// here AllocIndex won't point to exactly the correct block yet, but we don't want to subdivide yet, until we're sure this is the best fit
+			// MarkBlockAllocated will properly subdivide the initial block as needed
+			uint32 vCheckAddress = ~0u;
+			if (AllocBlock.vAddress < vAddress && FindPartiallyFreeBlockFitLinear(FreeIndex, WidthInTiles, HeightInTiles, MaxLevel, vCheckAddress))
 			{
-				check(AllocBlock.State == EBlockState::PartiallyFreeList);
-				const uint32 BlockSize = 1u << vLogMaxSize;
-				uint32 vCheckAddress = AllocBlock.vAddress;
-				const uint32 vBlockTileX0 = FMath::ReverseMortonCode2(vCheckAddress);
-				const uint32 vBlockTileY0 = FMath::ReverseMortonCode2(vCheckAddress >> 1);
-				const uint32 vBlockTileX1 = vBlockTileX0 + BlockSize;
-				const uint32 vBlockTileY1 = vBlockTileY0 + BlockSize;
-
-				// Search all valid positions within the block (in ascending morton order), looking for a fit for the texture we're trying to allocate
-				// Step size is driven by our alignment requirements
-				// Seems like there is probably a more clever way to accomplish this, if perf becomes an issue
-				while (true)
-				{
-					const uint32 vTileX0 = FMath::ReverseMortonCode2(vCheckAddress);
-					const uint32 vTileY0 = FMath::ReverseMortonCode2(vCheckAddress >> 1);
-					const uint32 vTileX1 = vTileX0 + WidthInTiles;
-					const uint32 vTileY1 = vTileY0 + HeightInTiles;
-					if (vTileY1 > vBlockTileY1)
-					{
-						break;
-					}
-
-					if (vTileX1 <= vBlockTileX1)
-					{
-						if (TestAllocation(FreeIndex, vTileX0, vTileY0, vTileX1, vTileY1))
-						{
-							// here AllocIndex won't point to exactly the correct block yet, but we don't want to subdivide yet, until we're sure this is the best fit
-							// MarkBlockAllocated will properly subdivide the initial block as needed
-							AllocIndex = FreeIndex;
-							vAddress = vCheckAddress;
-							break;
-						}
-					}
-
-					vCheckAddress += vAddressAlignment;
-				}
+				AllocIndex = FreeIndex;
+				vAddress = vCheckAddress;
 			}
 			FreeIndex = AllocBlock.NextFree;
 		}
 	}
 
+	OutAllocIndex = AllocIndex;
+	return vAddress;
+}
+
+uint32 FVirtualTextureAllocator::FindAllocation(uint32 WidthInTiles, uint32 HeightInTiles, uint32 MaxLevel, uint16& OutAllocIndex) const
+{
+	const int32 vLogMaxSize = FMath::CeilLogTwo(FMath::Max(WidthInTiles, HeightInTiles));
+
+	uint16 AllocIndex = 0xffff;
+	uint32 vAddress = ~0u;
+
+	// Lowest completely free block big enough, the first one of each address sorted size
+	for (int32 vLogSize = vLogMaxSize; vLogSize < SortedFreeList.Num(); ++vLogSize)
+	{
+		if (SortedFreeList[vLogSize].Num() > 0)
+		{
+			const uint64 SortKey = SortedFreeList[vLogSize][0];
+			if ((uint32)(SortKey >> 16) < vAddress)
+			{
+				AllocIndex = (uint16)SortKey;
+				vAddress = (uint32)(SortKey >> 16);
+			}
+		}
+	}
+
+	// Same partially allocated blocks as the linear search.  Blocks of the same size don't overlap, so the fits of a block are all
+	// lower than the ones of the blocks after it: each list only needs to be walked up to its first fit, or up to the best address so far.
+	check((uint32)vLogMaxSize >= MaxLevel);
+	const uint32 FreeMipCount = FMath::Min(3u, vLogMaxSize - MaxLevel);
+
+	for (uint32 FreeMipIndex = 0; FreeMipIndex <= FreeMipCount; FreeMipIndex++)
+	{
+		for (const uint64 SortKey : SortedPartiallyFreeList[vLogMaxSize * PartiallyFreeMipDepth + FreeMipIndex])
+		{
+			if ((uint32)(SortKey >> 16) >= vAddress)
+			{
+				break;
+			}
+
+			const uint16 FreeIndex = (uint16)SortKey;
+			checkSlow(AddressBlocks[FreeIndex].FreeMip == FreeMipIndex);
+
+			uint32 vCheckAddress = ~0u;
+			if (FindPartiallyFreeBlockFit(FreeIndex, WidthInTiles, HeightInTiles, MaxLevel, vCheckAddress))
+			{
+				AllocIndex = FreeIndex;
+				vAddress = vCheckAddress;
+				break;
+			}
+		}
+	}
+
+	OutAllocIndex = AllocIndex;
+	return vAddress;
+}
+
+uint32 FVirtualTextureAllocator::Alloc(FAllocatedVirtualTexture* VT)
+{
+	return Alloc(VT, VT->GetWidthInTiles(), VT->GetHeightInTiles(), VT->GetMaxLevel());
+}
+
+uint32 FVirtualTextureAllocator::Alloc(FAllocatedVirtualTexture* VT, uint32 WidthInTiles, uint32 HeightInTiles, uint32 MaxLevel)
+{
+	const uint32 MaxSize = FMath::Max(WidthInTiles, HeightInTiles);
+	const int32 vLogMaxSize = FMath::CeilLogTwo(MaxSize);
+
+	if (vLogMaxSize >= FreeList.Num())
+	{
+		// VT is larger than the entire page table
+		return ~0u;
+	}
+
+	uint16 AllocIndex = 0xffff;
+	uint32 vAddress = ~0u;
+
+	if (GVirtualTextureAllocatorValidation == 2)
+	{
+		vAddress = FindAllocationLinear(WidthInTiles, HeightInTiles, MaxLevel, AllocIndex);
+	}
+	else
+	{
+		vAddress = FindAllocation(WidthInTiles, HeightInTiles, MaxLevel, AllocIndex);
+
+		if (GVirtualTextureAllocatorValidation == 1)
+		{
+			uint16 LinearAllocIndex = 0xffff;
+			const uint32 LinearAddress = FindAllocationLinear(WidthInTiles, HeightInTiles, MaxLevel, LinearAllocIndex);
+			checkf(LinearAddress == vAddress && LinearAllocIndex == AllocIndex, TEXT("Virtual texture allocation of %ux%u tiles (%u levels) found address %u in block %u, linear search found %u in block %u"),
+				WidthInTiles, HeightInTiles, MaxLevel, vAddress, AllocIndex, LinearAddress, LinearAllocIndex);
+		}
+	}
+
 	if (AllocIndex != 0xffff)
 	{
 		check(vAddress != ~0u);
-		FAddressBlock& AllocBlock = AddressBlocks[AllocIndex];
 		const uint32 vTileX = FMath::ReverseMortonCode2(vAddress);
 		const uint32 vTileY = FMath::ReverseMortonCode2(vAddress >> 1);
 
-		MarkBlockAllocated(AllocIndex, vTileX, vTileY, VT);
+		MarkBlockAllocated(AllocIndex, vTileX, vTileY, vTileX + WidthInTiles, vTileY + HeightInTiles, VT);
 
 		check(AddressBlocks[AllocIndex].State != EBlockState::FreeList);
 
@@ -638,7 +908,7 @@ void FVirtualTextureAllocator::FreeAddressBlock(uint32 Index, bool bTopLevelBloc
 	}
 }
 
-void FVirtualTextureAllocator::RecurseComputeFreeMip(uint16 BlockIndex, uint32 Depth, uint64& IoBlockMap) const
+void FVirtualTextureAllocator::RecurseComputeFreeMip(uint16 BlockIndex, uint32 Depth, uint64& IoBlockMap, uint64* IoOccupiedMap) const
 {
 	const FAddressBlock& Block = AddressBlocks[BlockIndex];
 
@@ -648,12 +918,16 @@ void FVirtualTextureAllocator::RecurseComputeFreeMip(uint16 BlockIndex, uint32 D
 		uint32 ChildIndex = Block.FirstChild;
 		while (ChildIndex != 0xffff)
 		{
-			RecurseComputeFreeMip(ChildIndex, Depth + 1, IoBlockMap);
+			RecurseComputeFreeMip(ChildIndex, Depth + 1, IoBlockMap, IoOccupiedMap);
 			ChildIndex = AddressBlocks[ChildIndex].NextSibling;
 		}
 	}
 
-	if (Block.State == EBlockState::AllocatedTexture)
+	// Optional map of pixels with any allocation: also includes the partially free blocks at the max depth, shallower ones are covered by their children
+	const bool bAllocated = Block.State == EBlockState::AllocatedTexture;
+	const bool bOccupied = IoOccupiedMap && Depth == 3 && Block.State == EBlockState::PartiallyFreeList;
+
+	if (bAllocated || bOccupied)
 	{
 		// Bit mask of pixels covered by a block of the given log2 size.  Think of each byte
 		// as a row of 8 single bit pixels, moving left in bits representing increasing X, and bytes
@@ -712,20 +986,25 @@ void FVirtualTextureAllocator::RecurseComputeFreeMip(uint16 BlockIndex, uint32 D
 
 		// Set bits in our bitmap
 		uint32 BitIndex = MapX + MapY * 8;
-		IoBlockMap |= BlockMaskByDepth[Depth] << BitIndex;
+		if (bAllocated)
+		{
+			IoBlockMap |= BlockMaskByDepth[Depth] << BitIndex;
+		}
+		if (IoOccupiedMap)
+		{
+			*IoOccupiedMap |= BlockMaskByDepth[Depth] << BitIndex;
+		}
 	}
 }
 
-uint32 FVirtualTextureAllocator::ComputeFreeMip(uint16 BlockIndex) const
+uint32 FVirtualTextureAllocator::ComputeFreeMip(uint16 BlockIndex, uint64& OutBlockMap) const
 {
 	// First we need to generate a map of the block, where data is allocated.  This is an
-	// 8x8 pixel map in bits in a single 64-bit word.
-	// 
-	// TODO (perf):  It might be interesting to actually store this map in the block itself,
-	// since we've spent the time computing it, as you could use it to early out in
-	// "TestAllocation".
+	// 8x8 pixel map in bits in a single 64-bit word.  It's returned so it can be stored in
+	// the block, FindPartiallyFreeBlockFit uses it to reject positions without "TestAllocation".
 	uint64 BlockMap = 0;
 	RecurseComputeFreeMip(BlockIndex, 0, BlockMap);
+	OutBlockMap = BlockMap;
 
 	// Mapping that specifies pixels that need to be covered by child blocks to block any allocation at the
 	// given alignment.  If the corner pixel at a given resolution alone is covered, we can't allocate,
@@ -36,6 +36,12 @@ public:
 	 */
 	RENDERER_API uint32 Alloc(FAllocatedVirtualTexture* VT);
 
+	/**
+	 * Allocate address space for the given size and mip count, VT is only used as the key for Find/Free.
+	 * @return (~0) if no space left, the virtual page address if successfully allocated.
+	 */
+	RENDERER_API uint32 Alloc(FAllocatedVirtualTexture* VT, uint32 WidthInTiles, uint32 HeightInTiles, uint32 MaxLevel);
+
 	/**
 	 * Test if an allocation of the given size will succeed.
 	 * @return false if there isn't enough space left.
@@ -53,6 +59,9 @@ public:
 	/** Get current number of allocated pages. */
 	inline uint32 GetNumAllocatedPages() const { return NumAllocatedPages; }
 
+	/** Get the number of completely free blocks, per log size. */
+	RENDERER_API void GetNumFreeBlocks(TArray<uint32>& OutNumFreeBlocks) const;
+
 	/** Output debugging information to the console. */
 	RENDERER_API void DumpToConsole(bool verbose);
 
@@ -88,12 +97,20 @@ private:
 
 	RENDERER_API void SubdivideBlock(uint32 ParentIndex);
 
-	RENDERER_API void MarkBlockAllocated(uint32 Index, uint32 vAllocatedTileX, uint32 vAllocatedTileY, FAllocatedVirtualTexture* VT);
+	RENDERER_API void MarkBlockAllocated(uint32 Index, uint32 vAllocatedTileX0, uint32 vAllocatedTileY0, uint32 vAllocatedTileX1, uint32 vAllocatedTileY1, FAllocatedVirtualTexture* VT);
 
 	RENDERER_API bool TestAllocation(uint32 Index, uint32 vTileX0, uint32 vTileY0, uint32 vTileX1, uint32 vTileY1) const;
 
-	RENDERER_API void RecurseComputeFreeMip(uint16 BlockIndex, uint32 Depth, uint64& IoBlockMap) const;
-	RENDERER_API uint32 ComputeFreeMip(uint16 BlockIndex) const;
+	/** Address of the lowest block (and position within a partially free block) that fits the allocation, ~0 if none. */
+	RENDERER_API uint32 FindAllocation(uint32 WidthInTiles, uint32 HeightInTiles, uint32 MaxLevel, uint16& OutAllocIndex) const;
+	/** Same as FindAllocation, walking the free lists and testing each position of partially free blocks, used for validation. */
+	RENDERER_API uint32 FindAllocationLinear(uint32 WidthInTiles, uint32 HeightInTiles, uint32 MaxLevel, uint16& OutAllocIndex) const;
+
+	RENDERER_API bool FindPartiallyFreeBlockFit(uint16 BlockIndex, uint32 WidthInTiles, uint32 HeightInTiles, uint32 MaxLevel, uint32& OutAddress) const;
+	RENDERER_API bool FindPartiallyFreeBlockFitLinear(uint16 BlockIndex, uint32 WidthInTiles, uint32 HeightInTiles, uint32 MaxLevel, uint32& OutAddress) const;
+
+	RENDERER_API void RecurseComputeFreeMip(uint16 BlockIndex, uint32 Depth, uint64& IoBlockMap, uint64* IoOccupiedMap = nullptr) const;
+	RENDERER_API uint32 ComputeFreeMip(uint16 BlockIndex, uint64& OutBlockMap) const;
 
 	RENDERER_API void FreeMipUpdateParents(uint16 ParentIndex);
 
@@ -104,6 +121,7 @@ private:
 	struct FAddressBlock
 	{
 		FAllocatedVirtualTexture*	VT;
+		uint64						AllocatedMap;		// 8x8 map of allocated children, see ComputeFreeMip (partially free blocks only)
 		uint32						vAddress : 24;
 		uint32						vLogSize : 4;
 		uint32						MipBias : 4;
@@ -121,6 +139,7 @@ private:
 
 		FAddressBlock(uint8 LogSize)
 			: VT(nullptr)
+			, AllocatedMap(0)
 			, vAddress(0)
 			, vLogSize(LogSize)
 			, MipBias(0)
@@ -136,6 +155,7 @@ private:
 
 		FAddressBlock(const FAddressBlock& Block, uint32 Offset, uint32 Dimensions)
 			: VT(nullptr)
+			, AllocatedMap(0)
 			, vAddress(Block.vAddress + (Offset << (Dimensions * Block.vLogSize)))
 			, vLogSize(Block.vLogSize)
 			, MipBias(0)
@@ -162,6 +182,8 @@ private:
 		uint16	Mips[PartiallyFreeMipDepth];
 	};
 
+	TArray< uint64 >* GetSortedFreeList(EBlockState State, const FAddressBlock& Block);
+
 	const uint32				vDimensions;
 	uint32						AllocatedWidth;
 	uint32						AllocatedHeight;
@@ -169,6 +191,9 @@ private:
 	TArray< FAddressBlock >		AddressBlocks;
 	TArray< uint16 >			FreeList;
 	TArray< FPartiallyFreeMip >	PartiallyFreeList;
+	// Free list entries as (vAddress << 16 | Index) sorted by address, per vLogSize and per vLogSize * PartiallyFreeMipDepth + FreeMip
+	TArray< TArray< uint64 > >	SortedFreeList;
+	TArray< TArray< uint64 > >	SortedPartiallyFreeList;
 	uint16						GlobalFreeList;
 	TArray< uint32 >			SortedAddresses;
 	TArray< uint16 >			SortedIndices;
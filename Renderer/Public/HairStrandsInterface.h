@@ -230,6 +230,9 @@ public:
 	
 	uint32 GetGroupIndex() const { return GroupIndex; }
 
+	/** Id unique to this group data for the lifetime of the process. Unlike the address, it is never reused after the data is freed. */
+	uint64 GetUniqueId() const { return UniqueId; }
+
 	FRDGExternalBuffer& GetDrawIndirectRasterComputeBuffer() { return Culling->DrawIndirectRasterComputeBuffer; }
 	const FRDGExternalBuffer& GetDrawIndirectRasterComputeBuffer() const { return Culling->DrawIndirectRasterComputeBuffer; }
 	FRDGExternalBuffer& GetDrawIndirectBuffer() { return Culling->DrawIndirectBuffer; }
@@ -380,6 +383,7 @@ public:
 	uint32 ClusterDataIndex = ~0; // #hair_todo: move this into instance data, or remove FHairStrandClusterData
 
 	uint32 GroupIndex = 0;
+	uint64 UniqueId = 0;
 	uint32 RestPointCount = 0;
 	uint32 RestCurveCount = 0;
 	uint32 ClusterCount = 0;
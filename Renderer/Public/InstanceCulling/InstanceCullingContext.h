@@ -14,6 +14,7 @@ class FInstanceCullingDrawParams;
 class FScene;
 class FGPUScenePrimitiveCollector;
 class FInstanceCullingDeferredContext;
+class FInstanceCullingSetupCacheEntry;
 struct FMeshDrawCommandPassStats;
 
 
@@ -222,6 +223,9 @@ public:
 	 */
 	static void AddClearIndirectArgInstanceCountPass(FRDGBuilder& GraphBuilder, FGlobalShaderMap* ShaderMap, FRDGBufferRef DrawIndirectArgsBuffer, TFunction<int32()> NumIndirectArgsCallback = TFunction<int32()>());
 
+	/**
+	 * @param SetupCacheEntry if non-null, the output is reused from the entry when the visible mesh draw commands are unchanged since it was stored, or stored into it otherwise.
+	 */
 	void SetupDrawCommands(
 		FMeshCommandOneFrameArray& VisibleMeshDrawCommandsInOut,
 		bool bCompactIdenticalCommands,
@@ -229,7 +233,8 @@ public:
 		// Stats
 		int32& MaxInstancesOut,
 		int32& VisibleMeshDrawCommandsNumOut,
-		int32& NewPassVisibleMeshDrawCommandsNumOut);
+		int32& NewPassVisibleMeshDrawCommandsNumOut,
+		FInstanceCullingSetupCacheEntry* SetupCacheEntry = nullptr);
 
 	void SubmitDrawCommands(
 		const FMeshCommandOneFrameArray& VisibleMeshDrawCommands,
@@ -360,6 +365,27 @@ public:
 	// Optional pass stats
 	FMeshDrawCommandPassStats* MeshDrawCommandPassStats = nullptr;
 #endif
+
+private:
+	/**
+	 * Chunk-parallel implementation of SetupDrawCommands for large passes, produces the same output as the serial path.
+	 * Returns false if the serial path must be used instead.
+	 */
+	bool SetupDrawCommandsParallel(
+		FMeshCommandOneFrameArray& VisibleMeshDrawCommandsInOut,
+		bool bCompactIdenticalCommands,
+		const FScene* Scene,
+		int32 ChunkSize,
+		// Stats
+		int32& MaxInstancesOut,
+		int32& VisibleMeshDrawCommandsNumOut,
+		int32& NewPassVisibleMeshDrawCommandsNumOut,
+		TArray<int32>* OutRetainedCommands);
+
+	/**
+	 * Add the compaction data needed to preserve the order of the instances that were just added to a draw command.
+	 */
+	void AddCompactionData(uint32 IndirectArgsOffset, uint32 InstanceIdOffset, uint32 NumInstancesAdded);
 };
 
 ENUM_CLASS_FLAGS(FInstanceCullingContext::EInstanceFlags)
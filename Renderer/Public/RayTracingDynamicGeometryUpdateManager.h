@@ -18,6 +18,8 @@ class FViewInfo;
 class FRDGBuilder;
 class FRayTracingGeometry;
 class FRayTracingDynamicGeometryConverterCS;
+class FRayTracingDynamicGeometryUpdateCache;
+class FRayTracingDynamicVertexBufferAllocator;
 struct FRayTracingDynamicGeometryUpdateParams;
 
 DECLARE_UNIFORM_BUFFER_STRUCT(FSceneUniformParameters, RENDERER_API)
@@ -32,6 +34,32 @@ struct FMeshComputeDispatchCommand
 	FRWBuffer* TargetBuffer;
 };
 
+/**
+ * Inputs of the vertex deformation of a dynamic geometry, provided by its owner to skip the update while they don't change.
+ * Must cover everything that animates the vertices, e.g. time dependent world position offset has to be reflected in MaterialParametersHash.
+ */
+struct FRayTracingDynamicGeometryInputFingerprint
+{
+	/** Revision of the bone transforms, changed by the owner whenever the pose changes. */
+	uint64 BoneTransformRevision = 0;
+	/** Hash of the active morph target weights. */
+	uint32 MorphTargetWeightsHash = 0;
+	/** Hash of the material parameters that affect world position offset. */
+	uint32 MaterialParametersHash = 0;
+
+	bool operator==(const FRayTracingDynamicGeometryInputFingerprint& Other) const
+	{
+		return BoneTransformRevision == Other.BoneTransformRevision
+			&& MorphTargetWeightsHash == Other.MorphTargetWeightsHash
+			&& MaterialParametersHash == Other.MaterialParametersHash;
+	}
+
+	bool operator!=(const FRayTracingDynamicGeometryInputFingerprint& Other) const
+	{
+		return !(*this == Other);
+	}
+};
+
 class FRayTracingDynamicGeometryUpdateManager
 {
 public:
@@ -49,6 +77,12 @@ public:
 		uint32 PrimitiveId 
 	);
 
+	/**
+	 * Provide the input fingerprint of a geometry for the current update, before AddDynamicGeometryToUpdate is called for it. Thread safe.
+	 * Geometries with a fingerprint get a persistent vertex buffer (unless they provide their own) and skip the dispatch and BLAS update while the fingerprint is unchanged.
+	 */
+	RENDERER_API void SetDynamicGeometryInputFingerprint(const FRayTracingGeometry* Geometry, const FRayTracingDynamicGeometryInputFingerprint& Fingerprint);
+
 	/** Starts an update batch and returns the current shared buffer generation ID which is used for validation. */
 	RENDERER_API int64 BeginUpdate();
 
@@ -89,6 +123,8 @@ private:
 		FRHIUniformBuffer* ViewUniformBuffer = nullptr;
 		FRayTracingGeometry* Geometry = nullptr;
 		int32 SegmentOffset = -1;
+		// Inputs were recorded in the update cache, which has to be invalidated if the update is dropped
+		bool bCachedInputs = false;
 	};
 
 	void AddDispatchCommands(FRHICommandListBase& RHICmdList,
@@ -102,7 +138,7 @@ private:
 							 uint32 VertexBufferOffset,
 							 uint32 VertexBufferSize,
 	                         FRayTracingDynamicGeometryBuildParams& BuildParams);
-	FRWBuffer* AllocateSharedBuffer(FRHICommandListBase& RHICmdList, uint32 VertexBufferSize, uint32& OutVertexBufferOffset);
+	FRWBuffer* AllocateSharedBuffer(FRHICommandListBase& RHICmdList, const FRayTracingGeometry* Geometry, uint32 VertexBufferSize, uint32& OutVertexBufferOffset);
 
 
 	TArray<FRayTracingDynamicGeometryBuildParams> DynamicGeometryBuilds;
@@ -116,11 +152,20 @@ private:
 	struct FVertexPositionBuffer
 	{
 		FRWBuffer RWBuffer;
-		uint32 UsedSize = 0;
-		uint32 LastUsedGenerationID = 0;
 	};
+	// Indexed by the buffer index of the allocator, null for released buffers
 	TArray<FVertexPositionBuffer*> VertexPositionBuffers;
 
+	// Sub-allocates the shared vertex position buffers, allocations persist per geometry while the size doesn't change
+	TUniquePtr<FRayTracingDynamicVertexBufferAllocator> VertexBufferAllocator;
+
+	// Input fingerprints provided for the current update, consumed by AddDynamicGeometryToUpdate
+	FCriticalSection PendingInputFingerprintsCS;
+	TMap<const FRayTracingGeometry*, FRayTracingDynamicGeometryInputFingerprint> PendingInputFingerprints;
+
+	// Last processed inputs and persistent vertex buffers of the geometries with input fingerprints
+	TUniquePtr<FRayTracingDynamicGeometryUpdateCache> UpdateCache;
+
 	// Any uniform buffers that must be kept alive until EndUpdate (after DispatchUpdates is called)
 	TArray<FUniformBufferRHIRef> ReferencedUniformBuffers;
 